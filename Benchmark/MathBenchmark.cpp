@@ -0,0 +1,606 @@
+/*******************************************
+	MathBenchmark.cpp
+
+	Microbenchmarks for the maths library
+	(Source/Math). Linux build, see Makefile
+********************************************/
+
+// Each benchmark runs one operation over a pool of pre-generated inputs. Inputs come from a
+// fixed seed so runs are repeatable and can be compared. Every benchmark is warmed up, then
+// timed over several repeats - the fastest repeat is reported (least disturbed by the OS) along
+// with the median. Results are written as JSON to stdout (or a file) for comparison by scripts
+//
+// Usage: MathBenchmark [--filter <substring>] [--seed <n>] [--repeats <n>] [--min-time <ms>]
+//                      [--out <file>]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+#include "CAffine3x4.h"
+#include "CQuaternion.h"
+#include "CQuatTransform.h"
+using namespace gen;
+
+namespace
+{
+
+/*-----------------------------------------------------------------------------------------
+	Settings
+-----------------------------------------------------------------------------------------*/
+
+// Number of distinct inputs in each pool. Small enough to stay in L1/L2 cache so the timings
+// measure the arithmetic rather than memory bandwidth
+const TUInt32 kPoolSize = 1024;
+
+// Number of points in each batch for the batch transform benchmarks
+const TUInt32 kBatchSize = 256;
+
+// Command line settings
+struct SSettings
+{
+	string   filter;
+	TUInt32  seed;
+	TUInt32  repeats;
+	TFloat64 minTimeMs; // Minimum time for a single timed repeat
+	string   outFile;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Input data
+-----------------------------------------------------------------------------------------*/
+
+// Pools of random inputs shared by all benchmarks. Matrices are affine with moderate scale so
+// inverse and decomposition are well defined
+struct SInputs
+{
+	vector<CVector3>       vectors;
+	vector<CVector3>       angles;
+	vector<CVector3>       scales;
+	vector<CMatrix4x4>     matrices;
+	vector<CAffine3x4>     affines;
+	vector<CQuaternion>    quats;
+	vector<CQuatTransform> quatTransforms;
+	vector<TFloat32>       params;
+};
+
+void CreateInputs( TUInt32 seed, SInputs& inputs )
+{
+	mt19937 rng( seed );
+	uniform_real_distribution<TFloat32> position( -100.0f, 100.0f );
+	uniform_real_distribution<TFloat32> angle( -kfPi, kfPi );
+	uniform_real_distribution<TFloat32> scale( 0.5f, 2.0f );
+	uniform_real_distribution<TFloat32> param( 0.0f, 1.0f );
+
+	for (TUInt32 i = 0; i < kPoolSize; ++i)
+	{
+		CVector3 p( position( rng ), position( rng ), position( rng ) );
+		CVector3 a( angle( rng ), angle( rng ), angle( rng ) );
+		CVector3 s( scale( rng ), scale( rng ), scale( rng ) );
+		inputs.vectors.push_back( p );
+		inputs.angles.push_back( a );
+		inputs.scales.push_back( s );
+
+		CMatrix4x4 m( p, a, kZXY, s );
+		inputs.matrices.push_back( m );
+		inputs.affines.push_back( CAffine3x4( m ) );
+
+		CQuaternion q( CMatrix4x4( CVector3::kOrigin, a ) );
+		q.Normalise();
+		inputs.quats.push_back( q );
+		inputs.quatTransforms.push_back( CQuatTransform( q, p, s ) );
+
+		inputs.params.push_back( param( rng ) );
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Benchmarks
+-----------------------------------------------------------------------------------------*/
+
+// Results are folded into this value so the compiler cannot remove the work being timed
+volatile TFloat32 Sink;
+
+// A benchmark performs a number of operations and returns the count performed
+typedef TUInt64 (*TBenchmarkFn)( const SInputs& inputs, TUInt64 iterations );
+
+struct SBenchmark
+{
+	const char*  name;
+	TBenchmarkFn fn;
+};
+
+// Cycle through a pool - kPoolSize is a power of 2
+inline TUInt32 Wrap( TUInt64 i )
+{
+	return static_cast<TUInt32>(i) & (kPoolSize - 1);
+}
+
+
+// Vectors
+
+TUInt64 Vector3Construct( const SInputs& inputs, TUInt64 iterations )
+{
+	const TFloat32* f = &inputs.params[0];
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		CVector3 v( f[Wrap(i)], f[Wrap(i + 1)], f[Wrap(i + 2)] );
+		sum += v.y;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Vector3Normalise( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += Normalise( inputs.vectors[Wrap(i)] ).x;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Vector3Cross( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += Cross( inputs.vectors[Wrap(i)], inputs.angles[Wrap(i)] ).z;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+
+// 4x4 matrices
+
+TUInt64 Matrix4x4ConstructEuler( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		TUInt32 n = Wrap(i);
+		CMatrix4x4 m( inputs.vectors[n], inputs.angles[n], kZXY, inputs.scales[n] );
+		sum += m.e21;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Matrix4x4Multiply( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += (inputs.matrices[Wrap(i)] * inputs.matrices[Wrap(i + 1)]).e31;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Matrix4x4MultiplyAffine( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += MultiplyAffine( inputs.matrices[Wrap(i)], inputs.matrices[Wrap(i + 1)] ).e31;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Matrix4x4Inverse( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += Inverse( inputs.matrices[Wrap(i)] ).e31;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Matrix4x4InverseAffine( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += InverseAffine( inputs.matrices[Wrap(i)] ).e31;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Matrix4x4DecomposeEuler( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		CVector3 position, rotation, scale;
+		inputs.matrices[Wrap(i)].DecomposeAffineEuler( &position, &rotation, &scale );
+		sum += rotation.y;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Matrix4x4TransformBatch( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	TUInt64 batches = (iterations + kBatchSize - 1) / kBatchSize;
+	for (TUInt64 batch = 0; batch < batches; ++batch)
+	{
+		const CMatrix4x4& m = inputs.matrices[Wrap(batch)];
+		for (TUInt32 p = 0; p < kBatchSize; ++p)
+		{
+			sum += m.TransformPoint( inputs.vectors[p] ).x;
+		}
+	}
+	Sink = sum;
+	return batches * kBatchSize;
+}
+
+
+// 3x4 affine transforms
+
+TUInt64 Affine3x4Multiply( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	CAffine3x4 m;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		Concatenate( inputs.affines[Wrap(i)], inputs.affines[Wrap(i + 1)], m );
+		sum += m.e31;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Affine3x4Inverse( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += Inverse( inputs.affines[Wrap(i)] ).e31;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 Affine3x4TransformBatch( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	TUInt64 batches = (iterations + kBatchSize - 1) / kBatchSize;
+	for (TUInt64 batch = 0; batch < batches; ++batch)
+	{
+		const CAffine3x4& m = inputs.affines[Wrap(batch)];
+		for (TUInt32 p = 0; p < kBatchSize; ++p)
+		{
+			sum += m.TransformPoint( inputs.vectors[p] ).x;
+		}
+	}
+	Sink = sum;
+	return batches * kBatchSize;
+}
+
+
+// Quaternions
+
+TUInt64 QuaternionFromMatrix( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += CQuaternion( inputs.matrices[Wrap(i)] ).x;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuaternionMultiply( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += (inputs.quats[Wrap(i)] * inputs.quats[Wrap(i + 1)]).w;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuaternionNormalise( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		CQuaternion q = inputs.quats[Wrap(i)] * inputs.params[Wrap(i)];
+		q.Normalise();
+		sum += q.w;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuaternionSlerp( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	CQuaternion q;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		Slerp( inputs.quats[Wrap(i)], inputs.quats[Wrap(i + 1)], inputs.params[Wrap(i)], q );
+		sum += q.w;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuaternionRotateBatch( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	TUInt64 batches = (iterations + kBatchSize - 1) / kBatchSize;
+	for (TUInt64 batch = 0; batch < batches; ++batch)
+	{
+		const CQuaternion& q = inputs.quats[Wrap(batch)];
+		for (TUInt32 p = 0; p < kBatchSize; ++p)
+		{
+			sum += q.Rotate( inputs.vectors[p] ).x;
+		}
+	}
+	Sink = sum;
+	return batches * kBatchSize;
+}
+
+
+// Quaternion transforms
+
+TUInt64 QuatTransformMultiply( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		sum += (inputs.quatTransforms[Wrap(i)] * inputs.quatTransforms[Wrap(i + 1)]).pos.x;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuatTransformSlerp( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	CQuatTransform qt;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		Slerp( inputs.quatTransforms[Wrap(i)], inputs.quatTransforms[Wrap(i + 1)],
+		       inputs.params[Wrap(i)], qt );
+		sum += qt.quat.w;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuatTransformGetMatrix( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	CMatrix4x4 m;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		inputs.quatTransforms[Wrap(i)].GetMatrix( m );
+		sum += m.e12;
+	}
+	Sink = sum;
+	return iterations;
+}
+
+TUInt64 QuatTransformTransformBatch( const SInputs& inputs, TUInt64 iterations )
+{
+	TFloat32 sum = 0.0f;
+	TUInt64 batches = (iterations + kBatchSize - 1) / kBatchSize;
+	for (TUInt64 batch = 0; batch < batches; ++batch)
+	{
+		const CQuatTransform& qt = inputs.quatTransforms[Wrap(batch)];
+		for (TUInt32 p = 0; p < kBatchSize; ++p)
+		{
+			sum += qt.TransformPoint( inputs.vectors[p] ).x;
+		}
+	}
+	Sink = sum;
+	return batches * kBatchSize;
+}
+
+
+// List of all benchmarks
+const SBenchmark kBenchmarks[] =
+{
+	{ "vector3.construct",               Vector3Construct },
+	{ "vector3.normalise",               Vector3Normalise },
+	{ "vector3.cross",                   Vector3Cross },
+	{ "matrix4x4.construct_euler",       Matrix4x4ConstructEuler },
+	{ "matrix4x4.multiply",              Matrix4x4Multiply },
+	{ "matrix4x4.multiply_affine",       Matrix4x4MultiplyAffine },
+	{ "matrix4x4.inverse",               Matrix4x4Inverse },
+	{ "matrix4x4.inverse_affine",        Matrix4x4InverseAffine },
+	{ "matrix4x4.decompose_euler",       Matrix4x4DecomposeEuler },
+	{ "matrix4x4.transform_batch",       Matrix4x4TransformBatch },
+	{ "affine3x4.multiply",              Affine3x4Multiply },
+	{ "affine3x4.inverse",               Affine3x4Inverse },
+	{ "affine3x4.transform_batch",       Affine3x4TransformBatch },
+	{ "quaternion.from_matrix",          QuaternionFromMatrix },
+	{ "quaternion.multiply",             QuaternionMultiply },
+	{ "quaternion.normalise",            QuaternionNormalise },
+	{ "quaternion.slerp",                QuaternionSlerp },
+	{ "quaternion.rotate_batch",         QuaternionRotateBatch },
+	{ "quattransform.multiply",          QuatTransformMultiply },
+	{ "quattransform.slerp",             QuatTransformSlerp },
+	{ "quattransform.get_matrix",        QuatTransformGetMatrix },
+	{ "quattransform.transform_batch",   QuatTransformTransformBatch },
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Timing
+-----------------------------------------------------------------------------------------*/
+
+struct SResult
+{
+	const char* name;
+	TUInt64     opsPerRepeat;
+	TFloat64    minNsPerOp;
+	TFloat64    medianNsPerOp;
+	TFloat64    opsPerSecond; // Based on the fastest repeat
+};
+
+typedef chrono::steady_clock TClock;
+
+// Time a number of iterations of a benchmark, returns elapsed nanoseconds and sets the actual
+// number of operations performed
+TFloat64 TimeIterations( const SBenchmark& benchmark, const SInputs& inputs, TUInt64 iterations,
+                         TUInt64& ops )
+{
+	TClock::time_point start = TClock::now();
+	ops = benchmark.fn( inputs, iterations );
+	TClock::time_point end = TClock::now();
+	return static_cast<TFloat64>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+}
+
+SResult RunBenchmark( const SBenchmark& benchmark, const SInputs& inputs,
+                      const SSettings& settings )
+{
+	// Warm up and calibrate - double the iteration count until one run lasts the minimum time
+	TFloat64 minTimeNs = settings.minTimeMs * 1.0e6;
+	TUInt64 iterations = kPoolSize;
+	TUInt64 ops;
+	while (TimeIterations( benchmark, inputs, iterations, ops ) < minTimeNs)
+	{
+		iterations *= 2;
+	}
+
+	// Timed repeats
+	vector<TFloat64> nsPerOp;
+	for (TUInt32 repeat = 0; repeat < settings.repeats; ++repeat)
+	{
+		TFloat64 ns = TimeIterations( benchmark, inputs, iterations, ops );
+		nsPerOp.push_back( ns / static_cast<TFloat64>(ops) );
+	}
+	sort( nsPerOp.begin(), nsPerOp.end() );
+
+	SResult result;
+	result.name = benchmark.name;
+	result.opsPerRepeat = ops;
+	result.minNsPerOp = nsPerOp.front();
+	result.medianNsPerOp = nsPerOp[nsPerOp.size() / 2];
+	result.opsPerSecond = 1.0e9 / result.minNsPerOp;
+	return result;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Output
+-----------------------------------------------------------------------------------------*/
+
+void WriteJSON( FILE* file, const SSettings& settings, const vector<SResult>& results )
+{
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"compiler\": \"%s\",\n", ksCompiler.c_str() );
+	fprintf( file, "  \"seed\": %u,\n", settings.seed );
+	fprintf( file, "  \"repeats\": %u,\n", settings.repeats );
+	fprintf( file, "  \"min_time_ms\": %g,\n", settings.minTimeMs );
+	fprintf( file, "  \"pool_size\": %u,\n", kPoolSize );
+	fprintf( file, "  \"batch_size\": %u,\n", kBatchSize );
+	fprintf( file, "  \"benchmarks\": [\n" );
+	for (TUInt32 i = 0; i < results.size(); ++i)
+	{
+		const SResult& r = results[i];
+		fprintf( file, "    { \"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.3f, "
+		               "\"median_ns_per_op\": %.3f, \"ops_per_sec\": %.0f }%s\n",
+		         r.name, static_cast<unsigned long long>(r.opsPerRepeat), r.minNsPerOp,
+		         r.medianNsPerOp, r.opsPerSecond, (i + 1 < results.size()) ? "," : "" );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+}
+
+
+bool ParseSettings( int argc, char* argv[], SSettings& settings )
+{
+	settings.seed = 12345;
+	settings.repeats = 7;
+	settings.minTimeMs = 20.0;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (arg + 1 >= argc)
+		{
+			return false;
+		}
+		if      (!strcmp( argv[arg], "--filter" ))   settings.filter = argv[++arg];
+		else if (!strcmp( argv[arg], "--seed" ))     settings.seed = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--repeats" ))  settings.repeats = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--min-time" )) settings.minTimeMs = strtod( argv[++arg], 0 );
+		else if (!strcmp( argv[arg], "--out" ))      settings.outFile = argv[++arg];
+		else return false;
+	}
+	return settings.repeats > 0 && settings.minTimeMs > 0.0;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Main
+-----------------------------------------------------------------------------------------*/
+
+int main( int argc, char* argv[] )
+{
+	SSettings settings;
+	if (!ParseSettings( argc, argv, settings ))
+	{
+		fprintf( stderr, "Usage: %s [--filter <substring>] [--seed <n>] [--repeats <n>] "
+		                 "[--min-time <ms>] [--out <file>]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	SInputs inputs;
+	CreateInputs( settings.seed, inputs );
+
+	vector<SResult> results;
+	for (TUInt32 i = 0; i < sizeof(kBenchmarks) / sizeof(kBenchmarks[0]); ++i)
+	{
+		if (settings.filter.empty() || strstr( kBenchmarks[i].name, settings.filter.c_str() ))
+		{
+			results.push_back( RunBenchmark( kBenchmarks[i], inputs, settings ) );
+			fprintf( stderr, "%-32s %10.3f ns/op\n", results.back().name, results.back().minNsPerOp );
+		}
+	}
+
+	FILE* file = stdout;
+	if (!settings.outFile.empty())
+	{
+		file = fopen( settings.outFile.c_str(), "w" );
+		if (!file)
+		{
+			fprintf( stderr, "Cannot open %s\n", settings.outFile.c_str() );
+			return EXIT_FAILURE;
+		}
+	}
+	WriteJSON( file, settings, results );
+	if (file != stdout)
+	{
+		fclose( file );
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,374 @@
+/*******************************************
+	MeshOptimiseBenchmark.cpp
+
+	Benchmarks for the vertex cache and fetch
+	optimisation of mesh index buffers
+	(Source/Render/MeshOptimise.h). Linux
+	build, see Makefile
+********************************************/
+
+// Every mesh in the media folder is parsed and the triangle lists of its meshes are optimised
+// as the importer does - triangles reordered for the vertex cache then vertices renumbered in
+// the order they are used. The cache efficiency (ACMR and ATVR) of each file's triangles is
+// reported before and after, along with the optimisation time. Every benchmark is warmed up,
+// then timed over several repeats - the fastest repeat is reported along with the median.
+// Results are written as JSON to stdout (or a file) for comparison by scripts
+//
+// Usage: MeshOptimiseBenchmark [--media <folder>] [--repeats <n>] [--min-time <ms>] [--out <file>]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+#include "Defines.h"
+#include "CXFileParser.h"
+#include "MeshOptimise.h"
+using namespace gen;
+
+namespace
+{
+
+/*-----------------------------------------------------------------------------------------
+	Settings
+-----------------------------------------------------------------------------------------*/
+
+// Mesh files loaded, relative to the media folder
+const char* const kMediaFiles[] =
+{
+	"Box.x",
+	"Building.x",
+	"Bullet.x",
+	"Floor.x",
+	"HoverTank01.x",
+	"HoverTank02.x",
+	"HoverTank03.x",
+	"HoverTank04.x",
+	"HoverTank05.x",
+	"HoverTank06.x",
+	"HoverTank07.x",
+	"HoverTank08.x",
+	"Skybox.x",
+	"Tree.x",
+	"mars.x",
+	"sa8.x",
+	"tigerAusfH.x",
+	"tree1.x",
+	"warrior.x",
+};
+const TUInt32 kNumMediaFiles = sizeof(kMediaFiles) / sizeof(kMediaFiles[0]);
+
+// Command line settings
+struct SSettings
+{
+	string   media;
+	TUInt32  repeats;
+	TFloat64 minTimeMs; // Minimum time for a single timed repeat
+	string   outFile;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Input data
+-----------------------------------------------------------------------------------------*/
+
+bool ReadFile( const string& fileName, vector<char>& contents )
+{
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if (!file)
+	{
+		return false;
+	}
+	fseek( file, 0, SEEK_END );
+	contents.resize( static_cast<size_t>(ftell( file )) );
+	fseek( file, 0, SEEK_SET );
+	bool ok = !contents.empty() && fread( &contents[0], 1, contents.size(), file ) == contents.size();
+	fclose( file );
+	return ok;
+}
+
+// Triangle list of a single mesh
+struct SIndexList
+{
+	TUInt32         numVertices;
+	vector<TUInt32> indices;
+};
+
+// Parse a file and extract the triangle lists of its meshes, returns false on a parse error
+bool LoadIndexLists( const string& name, const vector<char>& contents, vector<SIndexList>& lists )
+{
+	TXFileFrames frames;
+	TXFileMeshes meshes;
+	CXFileParser parser;
+	if (parser.Parse( &contents[0], static_cast<TUInt32>(contents.size()), &frames, &meshes ) != kSuccess)
+	{
+		fprintf( stderr, "%s: %s\n", name.c_str(), parser.GetError().c_str() );
+		return false;
+	}
+
+	lists.resize( meshes.size() );
+	for (TUInt32 mesh = 0; mesh < meshes.size(); ++mesh)
+	{
+		lists[mesh].numVertices = static_cast<TUInt32>(meshes[mesh].vertices.size());
+		for (TUInt32 face = 0; face < meshes[mesh].faces.size(); ++face)
+		{
+			const TUInt32* pFace = meshes[mesh].faces[face].aiVertex;
+			lists[mesh].indices.insert( lists[mesh].indices.end(), pFace, pFace + 3 );
+		}
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Timing
+-----------------------------------------------------------------------------------------*/
+
+struct SResult
+{
+	string   name;
+	TUInt32  meshes, vertices, triangles;
+	TFloat64 acmrBefore, acmrAfter; // Averaged over all triangles in the file
+	TFloat64 atvrBefore, atvrAfter; // Averaged over all vertices used in the file
+	TFloat64 minMs;
+	TFloat64 medianMs;
+	TFloat64 mTrisPerSecond; // Fastest repeat
+};
+
+typedef chrono::steady_clock TClock;
+
+// Optimise copies of the triangle lists, as the importer does
+void Optimise( const vector<SIndexList>& lists, vector<SIndexList>& optimised )
+{
+	optimised = lists;
+	vector<TUInt32> remap;
+	for (TUInt32 mesh = 0; mesh < optimised.size(); ++mesh)
+	{
+		SIndexList& list = optimised[mesh];
+		if (list.indices.empty())
+		{
+			continue;
+		}
+		TUInt32 numTriangles = static_cast<TUInt32>(list.indices.size() / 3);
+		OptimiseVertexCache( &list.indices[0], numTriangles, list.numVertices );
+		OptimiseVertexFetch( &list.indices[0], numTriangles, list.numVertices, &remap );
+	}
+}
+
+// Time a number of optimisations, returns elapsed nanoseconds
+TFloat64 TimeOptimises( const vector<SIndexList>& lists, TUInt64 iterations )
+{
+	vector<SIndexList> optimised;
+	TClock::time_point start = TClock::now();
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		Optimise( lists, optimised );
+	}
+	TClock::time_point end = TClock::now();
+	return static_cast<TFloat64>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+}
+
+// Sum the cache misses and used vertices of a set of triangle lists
+void Analyse( const vector<SIndexList>& lists, TFloat64* pMisses, TFloat64* pUsed )
+{
+	*pMisses = *pUsed = 0.0;
+	for (TUInt32 mesh = 0; mesh < lists.size(); ++mesh)
+	{
+		const SIndexList& list = lists[mesh];
+		if (list.indices.empty())
+		{
+			continue;
+		}
+		TUInt32 numTriangles = static_cast<TUInt32>(list.indices.size() / 3);
+		SVertexCacheStats stats = AnalyseVertexCache( &list.indices[0], numTriangles, list.numVertices );
+		TFloat64 misses = static_cast<TFloat64>(stats.acmr) * numTriangles;
+		*pMisses += misses;
+		if (stats.atvr > 0.0f)
+		{
+			*pUsed += misses / stats.atvr;
+		}
+	}
+}
+
+void RunBenchmark( const string& name, const vector<SIndexList>& lists, const SSettings& settings,
+                   SResult& result )
+{
+	result.name = name;
+	result.meshes = static_cast<TUInt32>(lists.size());
+	result.vertices = result.triangles = 0;
+	for (TUInt32 mesh = 0; mesh < lists.size(); ++mesh)
+	{
+		result.vertices += lists[mesh].numVertices;
+		result.triangles += static_cast<TUInt32>(lists[mesh].indices.size() / 3);
+	}
+
+	// Cache efficiency before and after
+	vector<SIndexList> optimised;
+	Optimise( lists, optimised );
+	TFloat64 missesBefore, usedBefore, missesAfter, usedAfter;
+	Analyse( lists, &missesBefore, &usedBefore );
+	Analyse( optimised, &missesAfter, &usedAfter );
+	TFloat64 triangles = result.triangles ? static_cast<TFloat64>(result.triangles) : 1.0;
+	result.acmrBefore = missesBefore / triangles;
+	result.acmrAfter = missesAfter / triangles;
+	result.atvrBefore = usedBefore > 0.0 ? missesBefore / usedBefore : 0.0;
+	result.atvrAfter = usedAfter > 0.0 ? missesAfter / usedAfter : 0.0;
+
+	// Warm up and calibrate - double the iteration count until one run lasts the minimum time
+	TFloat64 minTimeNs = settings.minTimeMs * 1.0e6;
+	TUInt64 iterations = 1;
+	while (TimeOptimises( lists, iterations ) < minTimeNs)
+	{
+		iterations *= 2;
+	}
+
+	// Timed repeats
+	vector<TFloat64> ms;
+	for (TUInt32 repeat = 0; repeat < settings.repeats; ++repeat)
+	{
+		TFloat64 ns = TimeOptimises( lists, iterations );
+		ms.push_back( ns * 1.0e-6 / static_cast<TFloat64>(iterations) );
+	}
+	sort( ms.begin(), ms.end() );
+
+	result.minMs = ms.front();
+	result.medianMs = ms[ms.size() / 2];
+	result.mTrisPerSecond = static_cast<TFloat64>(result.triangles) * 1.0e-3 / result.minMs;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Output
+-----------------------------------------------------------------------------------------*/
+
+void WriteJSON( FILE* file, const SSettings& settings, const vector<SResult>& results )
+{
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"compiler\": \"%s\",\n", ksCompiler.c_str() );
+	fprintf( file, "  \"repeats\": %u,\n", settings.repeats );
+	fprintf( file, "  \"min_time_ms\": %g,\n", settings.minTimeMs );
+	fprintf( file, "  \"vertex_cache_size\": %u,\n", kVertexCacheAnalyseSize );
+	fprintf( file, "  \"benchmarks\": [\n" );
+	for (TUInt32 i = 0; i < results.size(); ++i)
+	{
+		const SResult& r = results[i];
+		fprintf( file, "    { \"name\": \"%s\", \"meshes\": %u, \"vertices\": %u, \"triangles\": %u, "
+		               "\"acmr_before\": %.4f, \"acmr_after\": %.4f, \"atvr_before\": %.4f, "
+		               "\"atvr_after\": %.4f, \"ms\": %.4f, \"median_ms\": %.4f, "
+		               "\"mtris_per_sec\": %.2f }%s\n",
+		         r.name.c_str(), r.meshes, r.vertices, r.triangles, r.acmrBefore, r.acmrAfter,
+		         r.atvrBefore, r.atvrAfter, r.minMs, r.medianMs, r.mTrisPerSecond,
+		         (i + 1 < results.size()) ? "," : "" );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+}
+
+void PrintResult( const SResult& r )
+{
+	fprintf( stderr, "%-14s %6u tris  ACMR %5.3f -> %5.3f  ATVR %5.3f -> %5.3f %9.3f ms %7.2f Mtris/s\n",
+	         r.name.c_str(), r.triangles, r.acmrBefore, r.acmrAfter, r.atvrBefore, r.atvrAfter,
+	         r.minMs, r.mTrisPerSecond );
+}
+
+
+bool ParseSettings( int argc, char* argv[], SSettings& settings )
+{
+	settings.media = "../Media/";
+	settings.repeats = 7;
+	settings.minTimeMs = 50.0;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (arg + 1 >= argc)
+		{
+			return false;
+		}
+		if      (!strcmp( argv[arg], "--media" ))    settings.media = string( argv[++arg] ) + "/";
+		else if (!strcmp( argv[arg], "--repeats" ))  settings.repeats = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--min-time" )) settings.minTimeMs = strtod( argv[++arg], 0 );
+		else if (!strcmp( argv[arg], "--out" ))      settings.outFile = argv[++arg];
+		else return false;
+	}
+	return settings.repeats > 0 && settings.minTimeMs > 0.0;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Main
+-----------------------------------------------------------------------------------------*/
+
+int main( int argc, char* argv[] )
+{
+	SSettings settings;
+	if (!ParseSettings( argc, argv, settings ))
+	{
+		fprintf( stderr, "Usage: %s [--media <folder>] [--repeats <n>] [--min-time <ms>] [--out <file>]\n",
+		         argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	vector<SResult> results;
+	SResult total = { "total", 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	TFloat64 missesBefore = 0.0, missesAfter = 0.0, usedBefore = 0.0, usedAfter = 0.0;
+	for (TUInt32 i = 0; i < kNumMediaFiles; ++i)
+	{
+		vector<char> contents;
+		vector<SIndexList> lists;
+		if (!ReadFile( settings.media + kMediaFiles[i], contents ))
+		{
+			fprintf( stderr, "Cannot read %s%s\n", settings.media.c_str(), kMediaFiles[i] );
+			return EXIT_FAILURE;
+		}
+		if (!LoadIndexLists( kMediaFiles[i], contents, lists ))
+		{
+			return EXIT_FAILURE;
+		}
+
+		SResult result;
+		RunBenchmark( kMediaFiles[i], lists, settings, result );
+		results.push_back( result );
+		PrintResult( result );
+
+		total.meshes += result.meshes;
+		total.vertices += result.vertices;
+		total.triangles += result.triangles;
+		total.minMs += result.minMs;
+		total.medianMs += result.medianMs;
+		missesBefore += result.acmrBefore * result.triangles;
+		missesAfter += result.acmrAfter * result.triangles;
+		if (result.atvrBefore > 0.0) usedBefore += result.acmrBefore * result.triangles / result.atvrBefore;
+		if (result.atvrAfter > 0.0)  usedAfter += result.acmrAfter * result.triangles / result.atvrAfter;
+	}
+	total.acmrBefore = missesBefore / total.triangles;
+	total.acmrAfter = missesAfter / total.triangles;
+	total.atvrBefore = missesBefore / usedBefore;
+	total.atvrAfter = missesAfter / usedAfter;
+	total.mTrisPerSecond = static_cast<TFloat64>(total.triangles) * 1.0e-3 / total.minMs;
+	results.push_back( total );
+	PrintResult( total );
+
+	FILE* file = stdout;
+	if (!settings.outFile.empty())
+	{
+		file = fopen( settings.outFile.c_str(), "w" );
+		if (!file)
+		{
+			fprintf( stderr, "Cannot open %s\n", settings.outFile.c_str() );
+			return EXIT_FAILURE;
+		}
+	}
+	WriteJSON( file, settings, results );
+	if (file != stdout)
+	{
+		fclose( file );
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,390 @@
+/*******************************************
+	NumberBenchmark.cpp
+
+	Benchmarks for the locale-free number
+	parser (Source/Common/NumberParser.h).
+	Linux build, see Makefile
+********************************************/
+
+// Every number in a text mesh file (by default Media/tree1.x, the largest) is found once, then
+// the numbers are converted with the C library (atof and strtof) and with ParseFloat. The
+// ParseFloatArray benchmark reads the same numbers as runs of floats, as a mesh importer reads
+// vertex arrays. All parsers must give identical values for the benchmark to run. Every
+// benchmark is warmed up, then timed over several repeats - the fastest repeat is reported
+// along with the median. Results are written as JSON to stdout (or a file)
+//
+// Usage: NumberBenchmark [--file <mesh file>] [--repeats <n>] [--min-time <ms>] [--out <file>]
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+#include "Defines.h"
+#include "NumberParser.h"
+using namespace gen;
+
+namespace
+{
+
+/*-----------------------------------------------------------------------------------------
+	Settings
+-----------------------------------------------------------------------------------------*/
+
+// Command line settings
+struct SSettings
+{
+	string   file;
+	TUInt32  repeats;
+	TFloat64 minTimeMs; // Minimum time for a single timed repeat
+	string   outFile;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Input data
+-----------------------------------------------------------------------------------------*/
+
+// File contents (null-terminated) and the position of each number in it
+vector<char>    Text;
+vector<TUInt32> Numbers;
+
+// A run of numbers only separated by whitespace, commas and semicolons
+struct SRun
+{
+	TUInt32 start; // Text offset
+	TUInt32 count;
+};
+vector<SRun> Runs;
+
+bool IsNumberStart( const char* p )
+{
+	return (*p >= '0' && *p <= '9') || ((*p == '-' || *p == '+' || *p == '.') && p[1] >= '0' && p[1] <= '9');
+}
+
+bool IsSeparator( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ';';
+}
+
+// Read the file and find every number that is not part of a name or comment
+bool ReadNumbers( const string& fileName )
+{
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if (!file)
+	{
+		return false;
+	}
+	fseek( file, 0, SEEK_END );
+	Text.resize( static_cast<size_t>(ftell( file )) + 1 );
+	fseek( file, 0, SEEK_SET );
+	bool ok = fread( &Text[0], 1, Text.size() - 1, file ) == Text.size() - 1;
+	fclose( file );
+	Text.back() = 0;
+	if (!ok)
+	{
+		return false;
+	}
+
+	const char* text = &Text[0];
+	const char* end = text + Text.size() - 1;
+	const char* p = text;
+	bool separated = true; // Only separators since the last number
+	while (p < end)
+	{
+		if (*p == '/' && p[1] == '/')
+		{
+			while (p < end && *p != '\n') ++p;
+			continue;
+		}
+		bool wordStart = (p == text || !(isalnum( p[-1] ) || p[-1] == '_' || p[-1] == '.'));
+		TFloat32 value;
+		const char* numberEnd;
+		if (wordStart && IsNumberStart( p ) && (numberEnd = ParseFloat( p, end, &value )) != 0 &&
+		    (numberEnd == end || !(isalnum( *numberEnd ) || *numberEnd == '_')))
+		{
+			TUInt32 offset = static_cast<TUInt32>(p - text);
+			if (separated && !Runs.empty() && Numbers.size() > 0)
+			{
+				++Runs.back().count;
+			}
+			else
+			{
+				SRun run = { offset, 1 };
+				Runs.push_back( run );
+			}
+			Numbers.push_back( offset );
+			separated = true;
+			p = numberEnd;
+			continue;
+		}
+		if (!IsSeparator( *p )) separated = false;
+		++p;
+	}
+	return !Numbers.empty();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Benchmarks
+-----------------------------------------------------------------------------------------*/
+
+enum EParser { Parser_Atof, Parser_Strtof, Parser_ParseFloat, Parser_ParseFloatArray, Parser_Count };
+const char* const kParserNames[Parser_Count] = { "atof", "strtof", "ParseFloat", "ParseFloatArray" };
+
+// Stops the compiler removing unused results
+volatile TFloat32 Sink;
+
+// Convert every number once with the given parser into values, returns false on a parse error
+bool ParseAll( EParser parser, vector<TFloat32>& values )
+{
+	const char* text = &Text[0];
+	const char* end = text + Text.size() - 1;
+	TFloat32* out = &values[0];
+	switch (parser)
+	{
+	case Parser_Atof:
+		for (TUInt32 i = 0; i < Numbers.size(); ++i)
+		{
+			out[i] = static_cast<TFloat32>(atof( text + Numbers[i] ));
+		}
+		break;
+	case Parser_Strtof:
+		for (TUInt32 i = 0; i < Numbers.size(); ++i)
+		{
+			out[i] = strtof( text + Numbers[i], 0 );
+		}
+		break;
+	case Parser_ParseFloat:
+		for (TUInt32 i = 0; i < Numbers.size(); ++i)
+		{
+			if (!ParseFloat( text + Numbers[i], end, &out[i] ))
+			{
+				return false;
+			}
+		}
+		break;
+	case Parser_ParseFloatArray:
+		for (TUInt32 i = 0; i < Runs.size(); ++i)
+		{
+			if (!ParseFloatArray( text + Runs[i].start, end, out, Runs[i].count ))
+			{
+				return false;
+			}
+			out += Runs[i].count;
+		}
+		break;
+	default:
+		return false;
+	}
+	Sink = values.back();
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Timing
+-----------------------------------------------------------------------------------------*/
+
+struct SResult
+{
+	string   name;
+	TFloat64 minNsPerNumber;
+	TFloat64 medianNsPerNumber;
+	TFloat64 mbPerSecond; // File size over time to parse all its numbers, fastest repeat
+};
+
+typedef chrono::steady_clock TClock;
+
+// Time a number of passes over all numbers, returns elapsed nanoseconds or a negative value on error
+TFloat64 TimeParses( EParser parser, vector<TFloat32>& values, TUInt64 iterations )
+{
+	TClock::time_point start = TClock::now();
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		if (!ParseAll( parser, values ))
+		{
+			return -1.0;
+		}
+	}
+	TClock::time_point end = TClock::now();
+	return static_cast<TFloat64>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+}
+
+bool RunBenchmark( EParser parser, const SSettings& settings, SResult& result )
+{
+	vector<TFloat32> values( Numbers.size() );
+
+	// Warm up and calibrate - double the iteration count until one run lasts the minimum time
+	TFloat64 minTimeNs = settings.minTimeMs * 1.0e6;
+	TUInt64 iterations = 1;
+	TFloat64 ns;
+	while ((ns = TimeParses( parser, values, iterations )) < minTimeNs)
+	{
+		if (ns < 0.0)
+		{
+			return false;
+		}
+		iterations *= 2;
+	}
+
+	// Timed repeats
+	vector<TFloat64> nsPerNumber;
+	for (TUInt32 repeat = 0; repeat < settings.repeats; ++repeat)
+	{
+		ns = TimeParses( parser, values, iterations );
+		nsPerNumber.push_back( ns / static_cast<TFloat64>(iterations * Numbers.size()) );
+	}
+	sort( nsPerNumber.begin(), nsPerNumber.end() );
+
+	result.name = kParserNames[parser];
+	result.minNsPerNumber = nsPerNumber.front();
+	result.medianNsPerNumber = nsPerNumber[nsPerNumber.size() / 2];
+	result.mbPerSecond = static_cast<TFloat64>(Text.size() - 1) * 1.0e3 /
+	                     (result.minNsPerNumber * static_cast<TFloat64>(Numbers.size()));
+	return true;
+}
+
+// Check all parsers give exactly the same values as strtof, returns number of differences
+TUInt32 CheckParsers()
+{
+	vector<TFloat32> expected( Numbers.size() ), values( Numbers.size() );
+	ParseAll( Parser_Strtof, expected );
+
+	TUInt32 differences = 0;
+	for (int parser = 0; parser < Parser_Count; ++parser)
+	{
+		if (!ParseAll( static_cast<EParser>(parser), values ))
+		{
+			fprintf( stderr, "%s failed\n", kParserNames[parser] );
+			++differences;
+			continue;
+		}
+		for (TUInt32 i = 0; i < values.size(); ++i)
+		{
+			if (memcmp( &values[i], &expected[i], sizeof(TFloat32) ) != 0)
+			{
+				fprintf( stderr, "%s differs at offset %u: %.9g vs %.9g\n", kParserNames[parser],
+				         Numbers[i], values[i], expected[i] );
+				++differences;
+			}
+		}
+	}
+	return differences;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Output
+-----------------------------------------------------------------------------------------*/
+
+void WriteJSON( FILE* file, const SSettings& settings, const vector<SResult>& results )
+{
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"compiler\": \"%s\",\n", ksCompiler.c_str() );
+	fprintf( file, "  \"file\": \"%s\",\n", settings.file.c_str() );
+	fprintf( file, "  \"bytes\": %llu,\n", static_cast<unsigned long long>(Text.size() - 1) );
+	fprintf( file, "  \"numbers\": %llu,\n", static_cast<unsigned long long>(Numbers.size()) );
+	fprintf( file, "  \"repeats\": %u,\n", settings.repeats );
+	fprintf( file, "  \"min_time_ms\": %g,\n", settings.minTimeMs );
+	fprintf( file, "  \"benchmarks\": [\n" );
+	for (TUInt32 i = 0; i < results.size(); ++i)
+	{
+		const SResult& r = results[i];
+		fprintf( file, "    { \"name\": \"%s\", \"ns_per_number\": %.3f, \"median_ns_per_number\": %.3f, "
+		               "\"mb_per_sec\": %.1f }%s\n",
+		         r.name.c_str(), r.minNsPerNumber, r.medianNsPerNumber, r.mbPerSecond,
+		         (i + 1 < results.size()) ? "," : "" );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+}
+
+
+bool ParseSettings( int argc, char* argv[], SSettings& settings )
+{
+	settings.file = "../Media/tree1.x";
+	settings.repeats = 7;
+	settings.minTimeMs = 50.0;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (arg + 1 >= argc)
+		{
+			return false;
+		}
+		if      (!strcmp( argv[arg], "--file" ))     settings.file = argv[++arg];
+		else if (!strcmp( argv[arg], "--repeats" ))  settings.repeats = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--min-time" )) settings.minTimeMs = strtod( argv[++arg], 0 );
+		else if (!strcmp( argv[arg], "--out" ))      settings.outFile = argv[++arg];
+		else return false;
+	}
+	return settings.repeats > 0 && settings.minTimeMs > 0.0;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Main
+-----------------------------------------------------------------------------------------*/
+
+int main( int argc, char* argv[] )
+{
+	SSettings settings;
+	if (!ParseSettings( argc, argv, settings ))
+	{
+		fprintf( stderr, "Usage: %s [--file <mesh file>] [--repeats <n>] [--min-time <ms>] [--out <file>]\n",
+		         argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	if (!ReadNumbers( settings.file ))
+	{
+		fprintf( stderr, "Cannot read numbers from %s\n", settings.file.c_str() );
+		return EXIT_FAILURE;
+	}
+	fprintf( stderr, "%s: %u bytes, %u numbers in %u runs\n", settings.file.c_str(),
+	         static_cast<TUInt32>(Text.size() - 1), static_cast<TUInt32>(Numbers.size()),
+	         static_cast<TUInt32>(Runs.size()) );
+	if (CheckParsers() != 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	vector<SResult> results;
+	for (int parser = 0; parser < Parser_Count; ++parser)
+	{
+		SResult result;
+		if (!RunBenchmark( static_cast<EParser>(parser), settings, result ))
+		{
+			fprintf( stderr, "%s failed\n", kParserNames[parser] );
+			return EXIT_FAILURE;
+		}
+		results.push_back( result );
+		fprintf( stderr, "%-16s %8.2f ns/number %8.1f MB/s\n", result.name.c_str(), result.minNsPerNumber,
+		         result.mbPerSecond );
+	}
+
+	FILE* file = stdout;
+	if (!settings.outFile.empty())
+	{
+		file = fopen( settings.outFile.c_str(), "w" );
+		if (!file)
+		{
+			fprintf( stderr, "Cannot open %s\n", settings.outFile.c_str() );
+			return EXIT_FAILURE;
+		}
+	}
+	WriteJSON( file, settings, results );
+	if (file != stdout)
+	{
+		fclose( file );
+	}
+	return EXIT_SUCCESS;
+}
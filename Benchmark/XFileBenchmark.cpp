@@ -0,0 +1,308 @@
+/*******************************************
+	XFileBenchmark.cpp
+
+	Benchmarks for mesh loading with the
+	native .X file parser (Source/Render/
+	CXFileParser.h). Linux build, see
+	Makefile
+********************************************/
+
+// Every mesh in the media folder is parsed from memory into the frame and mesh lists used by
+// CImportXFile. Files are read into memory before timing, as the importer maps them, so the
+// times are parsing only. Every benchmark is warmed up, then timed over several repeats - the
+// fastest repeat is reported along with the median. Results are written as JSON to stdout (or
+// a file) for comparison by scripts
+//
+// Usage: XFileBenchmark [--media <folder>] [--repeats <n>] [--min-time <ms>] [--out <file>]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+#include "Defines.h"
+#include "CXFileParser.h"
+using namespace gen;
+
+namespace
+{
+
+/*-----------------------------------------------------------------------------------------
+	Settings
+-----------------------------------------------------------------------------------------*/
+
+// Mesh files loaded, relative to the media folder
+const char* const kMediaFiles[] =
+{
+	"Box.x",
+	"Building.x",
+	"Bullet.x",
+	"Floor.x",
+	"HoverTank01.x",
+	"HoverTank02.x",
+	"HoverTank03.x",
+	"HoverTank04.x",
+	"HoverTank05.x",
+	"HoverTank06.x",
+	"HoverTank07.x",
+	"HoverTank08.x",
+	"Skybox.x",
+	"Tree.x",
+	"mars.x",
+	"sa8.x",
+	"tigerAusfH.x",
+	"tree1.x",
+	"warrior.x",
+};
+const TUInt32 kNumMediaFiles = sizeof(kMediaFiles) / sizeof(kMediaFiles[0]);
+
+// Command line settings
+struct SSettings
+{
+	string   media;
+	TUInt32  repeats;
+	TFloat64 minTimeMs; // Minimum time for a single timed repeat
+	string   outFile;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Input data
+-----------------------------------------------------------------------------------------*/
+
+bool ReadFile( const string& fileName, vector<char>& contents )
+{
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if (!file)
+	{
+		return false;
+	}
+	fseek( file, 0, SEEK_END );
+	contents.resize( static_cast<size_t>(ftell( file )) );
+	fseek( file, 0, SEEK_SET );
+	bool ok = !contents.empty() && fread( &contents[0], 1, contents.size(), file ) == contents.size();
+	fclose( file );
+	return ok;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Timing
+-----------------------------------------------------------------------------------------*/
+
+struct SResult
+{
+	string   name;
+	TUInt64  bytes;
+	TUInt32  frames, meshes, vertices, triangles;
+	TFloat64 minMs;
+	TFloat64 medianMs;
+	TFloat64 mbPerSecond; // Fastest repeat
+};
+
+typedef chrono::steady_clock TClock;
+
+// Parse the file once, returns false on a parse error
+bool Parse( const vector<char>& contents, TXFileFrames& frames, TXFileMeshes& meshes, string* pError = 0 )
+{
+	frames.clear();
+	meshes.clear();
+	CXFileParser parser;
+	if (parser.Parse( &contents[0], static_cast<TUInt32>(contents.size()), &frames, &meshes ) != kSuccess)
+	{
+		if (pError) *pError = parser.GetError();
+		return false;
+	}
+	return true;
+}
+
+// Time a number of parses, returns elapsed nanoseconds or a negative value on error
+TFloat64 TimeParses( const vector<char>& contents, TUInt64 iterations )
+{
+	TXFileFrames frames;
+	TXFileMeshes meshes;
+	TClock::time_point start = TClock::now();
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		if (!Parse( contents, frames, meshes ))
+		{
+			return -1.0;
+		}
+	}
+	TClock::time_point end = TClock::now();
+	return static_cast<TFloat64>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+}
+
+bool RunBenchmark( const string& name, const vector<char>& contents, const SSettings& settings,
+                   SResult& result )
+{
+	// Check the file parses and count its contents
+	TXFileFrames frames;
+	TXFileMeshes meshes;
+	string error;
+	if (!Parse( contents, frames, meshes, &error ))
+	{
+		fprintf( stderr, "%s: %s\n", name.c_str(), error.c_str() );
+		return false;
+	}
+	result.name = name;
+	result.bytes = contents.size();
+	result.frames = static_cast<TUInt32>(frames.size());
+	result.meshes = static_cast<TUInt32>(meshes.size());
+	result.vertices = result.triangles = 0;
+	for (TUInt32 i = 0; i < meshes.size(); ++i)
+	{
+		result.vertices += static_cast<TUInt32>(meshes[i].vertices.size());
+		result.triangles += static_cast<TUInt32>(meshes[i].faces.size());
+	}
+
+	// Warm up and calibrate - double the iteration count until one run lasts the minimum time
+	TFloat64 minTimeNs = settings.minTimeMs * 1.0e6;
+	TUInt64 iterations = 1;
+	TFloat64 ns;
+	while ((ns = TimeParses( contents, iterations )) < minTimeNs)
+	{
+		if (ns < 0.0)
+		{
+			return false;
+		}
+		iterations *= 2;
+	}
+
+	// Timed repeats
+	vector<TFloat64> ms;
+	for (TUInt32 repeat = 0; repeat < settings.repeats; ++repeat)
+	{
+		ns = TimeParses( contents, iterations );
+		ms.push_back( ns * 1.0e-6 / static_cast<TFloat64>(iterations) );
+	}
+	sort( ms.begin(), ms.end() );
+
+	result.minMs = ms.front();
+	result.medianMs = ms[ms.size() / 2];
+	result.mbPerSecond = static_cast<TFloat64>(result.bytes) * 1.0e-3 / result.minMs;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Output
+-----------------------------------------------------------------------------------------*/
+
+void WriteJSON( FILE* file, const SSettings& settings, const vector<SResult>& results )
+{
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"compiler\": \"%s\",\n", ksCompiler.c_str() );
+	fprintf( file, "  \"repeats\": %u,\n", settings.repeats );
+	fprintf( file, "  \"min_time_ms\": %g,\n", settings.minTimeMs );
+	fprintf( file, "  \"benchmarks\": [\n" );
+	for (TUInt32 i = 0; i < results.size(); ++i)
+	{
+		const SResult& r = results[i];
+		fprintf( file, "    { \"name\": \"%s\", \"bytes\": %llu, \"frames\": %u, \"meshes\": %u, "
+		               "\"vertices\": %u, \"triangles\": %u, \"ms\": %.4f, \"median_ms\": %.4f, "
+		               "\"mb_per_sec\": %.1f }%s\n",
+		         r.name.c_str(), static_cast<unsigned long long>(r.bytes), r.frames, r.meshes,
+		         r.vertices, r.triangles, r.minMs, r.medianMs, r.mbPerSecond,
+		         (i + 1 < results.size()) ? "," : "" );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+}
+
+
+bool ParseSettings( int argc, char* argv[], SSettings& settings )
+{
+	settings.media = "../Media/";
+	settings.repeats = 7;
+	settings.minTimeMs = 50.0;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (arg + 1 >= argc)
+		{
+			return false;
+		}
+		if      (!strcmp( argv[arg], "--media" ))    settings.media = string( argv[++arg] ) + "/";
+		else if (!strcmp( argv[arg], "--repeats" ))  settings.repeats = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--min-time" )) settings.minTimeMs = strtod( argv[++arg], 0 );
+		else if (!strcmp( argv[arg], "--out" ))      settings.outFile = argv[++arg];
+		else return false;
+	}
+	return settings.repeats > 0 && settings.minTimeMs > 0.0;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Main
+-----------------------------------------------------------------------------------------*/
+
+int main( int argc, char* argv[] )
+{
+	SSettings settings;
+	if (!ParseSettings( argc, argv, settings ))
+	{
+		fprintf( stderr, "Usage: %s [--media <folder>] [--repeats <n>] [--min-time <ms>] [--out <file>]\n",
+		         argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	vector<SResult> results;
+	SResult total = { "total", 0, 0, 0, 0, 0, 0.0, 0.0, 0.0 };
+	for (TUInt32 i = 0; i < kNumMediaFiles; ++i)
+	{
+		vector<char> contents;
+		if (!ReadFile( settings.media + kMediaFiles[i], contents ))
+		{
+			fprintf( stderr, "Cannot read %s%s\n", settings.media.c_str(), kMediaFiles[i] );
+			return EXIT_FAILURE;
+		}
+
+		SResult result;
+		if (!RunBenchmark( kMediaFiles[i], contents, settings, result ))
+		{
+			return EXIT_FAILURE;
+		}
+		results.push_back( result );
+		fprintf( stderr, "%-14s %8u bytes %6u verts %6u tris %9.3f ms %7.1f MB/s\n", result.name.c_str(),
+		         static_cast<TUInt32>(result.bytes), result.vertices, result.triangles, result.minMs,
+		         result.mbPerSecond );
+
+		total.bytes += result.bytes;
+		total.frames += result.frames;
+		total.meshes += result.meshes;
+		total.vertices += result.vertices;
+		total.triangles += result.triangles;
+		total.minMs += result.minMs;
+		total.medianMs += result.medianMs;
+	}
+	total.mbPerSecond = static_cast<TFloat64>(total.bytes) * 1.0e-3 / total.minMs;
+	results.push_back( total );
+	fprintf( stderr, "%-14s %8u bytes %6u verts %6u tris %9.3f ms %7.1f MB/s\n", total.name.c_str(),
+	         static_cast<TUInt32>(total.bytes), total.vertices, total.triangles, total.minMs,
+	         total.mbPerSecond );
+
+	FILE* file = stdout;
+	if (!settings.outFile.empty())
+	{
+		file = fopen( settings.outFile.c_str(), "w" );
+		if (!file)
+		{
+			fprintf( stderr, "Cannot open %s\n", settings.outFile.c_str() );
+			return EXIT_FAILURE;
+		}
+	}
+	WriteJSON( file, settings, results );
+	if (file != stdout)
+	{
+		fclose( file );
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,338 @@
+/*******************************************
+	XMLBenchmark.cpp
+
+	Benchmarks for XML document loading with
+	the bundled TinyXML (Source/XML). Linux
+	build, see Makefile
+********************************************/
+
+// Each file is loaded into a TiXmlDocument using the default parsing mode and the in-situ mode
+// (see TiXmlDocument::SetInSitu), then every attribute is read as the scene loader does. The
+// resource files are used along with a generated scene, which is much larger than any of the
+// current resources and shows how loading scales. Every benchmark is warmed up, then timed over
+// several repeats - the fastest repeat is reported along with the median. Results are written
+// as JSON to stdout (or a file) for comparison by scripts
+//
+// Usage: XMLBenchmark [--resources <folder>] [--entities <n>] [--repeats <n>]
+//                     [--min-time <ms>] [--out <file>]
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+using namespace std;
+
+#include "Defines.h"
+#include "tinyxml.h"
+using namespace gen;
+
+namespace
+{
+
+/*-----------------------------------------------------------------------------------------
+	Settings
+-----------------------------------------------------------------------------------------*/
+
+// Resource files loaded, relative to the resource folder
+const char* const kResourceFiles[] =
+{
+	"Scene.xml",
+	"OberonMKIITemplate.xml",
+	"BuildingTemplate.xml",
+	"PatrolRoute1.xml",
+};
+
+// Name of the generated scene file, written to the current folder
+const char* const kGeneratedScene = "XMLBenchmarkScene.xml";
+
+// Command line settings
+struct SSettings
+{
+	string   resources;
+	TUInt32  entities;  // Number of entities in the generated scene
+	TUInt32  repeats;
+	TFloat64 minTimeMs; // Minimum time for a single timed repeat
+	string   outFile;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Input data
+-----------------------------------------------------------------------------------------*/
+
+// Write a scene file in the same layout as Source/Resources/Scene.xml, with the given number
+// of entities and tanks. Values are fixed so runs are repeatable
+bool WriteGeneratedScene( const char* fileName, TUInt32 entities )
+{
+	FILE* file = fopen( fileName, "w" );
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf( file, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n\n<Scene>\n  <Templates>\n" );
+	fprintf( file, "    <TankTemplate file=\"OberonMKIITemplate.xml\"/>\n" );
+	fprintf( file, "    <EntityTemplate file=\"BuildingTemplate.xml\"/>\n" );
+	fprintf( file, "  </Templates>\n\n  <Entities>\n" );
+	for (TUInt32 i = 0; i < entities; ++i)
+	{
+		TFloat32 x = static_cast<TFloat32>(i % 100) * 12.5f - 600.0f;
+		TFloat32 z = static_cast<TFloat32>(i / 100) * 12.5f - 600.0f;
+		if (i % 4 == 0)
+		{
+			fprintf( file, "    <Tank templateName=\"Oberon MK II\" name=\"Tank%u\" team=\"%u\">\n", i, i % 2 );
+			fprintf( file, "      <Position x=\"%.2f\" y=\"0.5\" z=\"%.2f\"/>\n", x, z );
+			fprintf( file, "      <Rotation x=\"0.0\" y=\"%.1f\" z=\"0.0\"/>\n", static_cast<TFloat32>(i % 360) );
+			fprintf( file, "      <PatrolRoute file=\"PatrolRoute%u.xml\"/>\n", i % 2 + 1 );
+			fprintf( file, "    </Tank>\n" );
+		}
+		else
+		{
+			fprintf( file, "    <Entity templateName=\"Building\" name=\"Building%u\">\n", i );
+			fprintf( file, "      <Position x=\"%.2f\" y=\"0.0\" z=\"%.2f\"/>\n", x, z );
+			fprintf( file, "      <Scale x=\"2.0\" y=\"2.0\" z=\"2.0\"/>\n" );
+			fprintf( file, "    </Entity>\n" );
+		}
+	}
+	fprintf( file, "  </Entities>\n</Scene>\n" );
+
+	bool ok = !ferror( file );
+	fclose( file );
+	return ok;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Benchmarks
+-----------------------------------------------------------------------------------------*/
+
+// Stops the compiler removing unused results
+volatile TUInt64 Sink;
+
+// Read every attribute name and value of an element and its children, returns number read
+TUInt64 ReadAttributes( const TiXmlElement* element )
+{
+	TUInt64 count = 0;
+	for (const TiXmlAttribute* attribute = element->FirstAttribute(); attribute;
+	     attribute = attribute->Next())
+	{
+		count += strlen( attribute->Name() ) + strlen( attribute->Value() );
+	}
+	for (const TiXmlElement* child = element->FirstChildElement(); child;
+	     child = child->NextSiblingElement())
+	{
+		count += ReadAttributes( child );
+	}
+	return count;
+}
+
+// Load a file and read all its attributes a number of times, returns false on a load error
+bool LoadFile( const string& fileName, bool inSitu, TUInt64 iterations )
+{
+	TUInt64 sum = 0;
+	for (TUInt64 i = 0; i < iterations; ++i)
+	{
+		TiXmlDocument doc( fileName.c_str() );
+		doc.SetInSitu( inSitu );
+		if (!doc.LoadFile())
+		{
+			return false;
+		}
+		sum += ReadAttributes( doc.RootElement() );
+	}
+	Sink = sum;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Timing
+-----------------------------------------------------------------------------------------*/
+
+struct SResult
+{
+	string   name;
+	bool     inSitu;
+	TUInt64  fileSize;
+	TFloat64 minUsPerLoad;
+	TFloat64 medianUsPerLoad;
+	TFloat64 mbPerSecond; // Based on the fastest repeat
+};
+
+typedef chrono::steady_clock TClock;
+
+// Time a number of loads of a file, returns elapsed nanoseconds or a negative value on error
+TFloat64 TimeLoads( const string& fileName, bool inSitu, TUInt64 iterations )
+{
+	TClock::time_point start = TClock::now();
+	bool ok = LoadFile( fileName, inSitu, iterations );
+	TClock::time_point end = TClock::now();
+	return ok ? static_cast<TFloat64>(chrono::duration_cast<chrono::nanoseconds>(end - start).count()) : -1.0;
+}
+
+bool RunBenchmark( const string& name, const string& fileName, bool inSitu,
+                   const SSettings& settings, SResult& result )
+{
+	FILE* file = fopen( fileName.c_str(), "rb" );
+	if (!file)
+	{
+		return false;
+	}
+	fseek( file, 0, SEEK_END );
+	result.fileSize = static_cast<TUInt64>(ftell( file ));
+	fclose( file );
+
+	// Warm up and calibrate - double the iteration count until one run lasts the minimum time
+	TFloat64 minTimeNs = settings.minTimeMs * 1.0e6;
+	TUInt64 iterations = 1;
+	TFloat64 ns;
+	while ((ns = TimeLoads( fileName, inSitu, iterations )) < minTimeNs)
+	{
+		if (ns < 0.0)
+		{
+			return false;
+		}
+		iterations *= 2;
+	}
+
+	// Timed repeats
+	vector<TFloat64> usPerLoad;
+	for (TUInt32 repeat = 0; repeat < settings.repeats; ++repeat)
+	{
+		ns = TimeLoads( fileName, inSitu, iterations );
+		usPerLoad.push_back( ns * 1.0e-3 / static_cast<TFloat64>(iterations) );
+	}
+	sort( usPerLoad.begin(), usPerLoad.end() );
+
+	result.name = name;
+	result.inSitu = inSitu;
+	result.minUsPerLoad = usPerLoad.front();
+	result.medianUsPerLoad = usPerLoad[usPerLoad.size() / 2];
+	result.mbPerSecond = static_cast<TFloat64>(result.fileSize) / result.minUsPerLoad;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Output
+-----------------------------------------------------------------------------------------*/
+
+void WriteJSON( FILE* file, const SSettings& settings, const vector<SResult>& results )
+{
+	fprintf( file, "{\n" );
+	fprintf( file, "  \"compiler\": \"%s\",\n", ksCompiler.c_str() );
+	fprintf( file, "  \"repeats\": %u,\n", settings.repeats );
+	fprintf( file, "  \"min_time_ms\": %g,\n", settings.minTimeMs );
+	fprintf( file, "  \"generated_entities\": %u,\n", settings.entities );
+	fprintf( file, "  \"benchmarks\": [\n" );
+	for (TUInt32 i = 0; i < results.size(); ++i)
+	{
+		const SResult& r = results[i];
+		fprintf( file, "    { \"name\": \"%s\", \"mode\": \"%s\", \"bytes\": %llu, \"us_per_load\": %.3f, "
+		               "\"median_us_per_load\": %.3f, \"mb_per_sec\": %.1f }%s\n",
+		         r.name.c_str(), r.inSitu ? "in-situ" : "default",
+		         static_cast<unsigned long long>(r.fileSize), r.minUsPerLoad, r.medianUsPerLoad,
+		         r.mbPerSecond, (i + 1 < results.size()) ? "," : "" );
+	}
+	fprintf( file, "  ]\n" );
+	fprintf( file, "}\n" );
+}
+
+
+bool ParseSettings( int argc, char* argv[], SSettings& settings )
+{
+	settings.resources = "../Source/Resources/";
+	settings.entities = 10000;
+	settings.repeats = 7;
+	settings.minTimeMs = 50.0;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if (arg + 1 >= argc)
+		{
+			return false;
+		}
+		if      (!strcmp( argv[arg], "--resources" )) settings.resources = string( argv[++arg] ) + "/";
+		else if (!strcmp( argv[arg], "--entities" ))  settings.entities = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--repeats" ))   settings.repeats = static_cast<TUInt32>(strtoul( argv[++arg], 0, 10 ));
+		else if (!strcmp( argv[arg], "--min-time" ))  settings.minTimeMs = strtod( argv[++arg], 0 );
+		else if (!strcmp( argv[arg], "--out" ))       settings.outFile = argv[++arg];
+		else return false;
+	}
+	return settings.repeats > 0 && settings.minTimeMs > 0.0;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Main
+-----------------------------------------------------------------------------------------*/
+
+int main( int argc, char* argv[] )
+{
+	SSettings settings;
+	if (!ParseSettings( argc, argv, settings ))
+	{
+		fprintf( stderr, "Usage: %s [--resources <folder>] [--entities <n>] [--repeats <n>] "
+		                 "[--min-time <ms>] [--out <file>]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	// List of files to load: the resource files then the generated scene
+	vector<string> names, fileNames;
+	for (TUInt32 i = 0; i < sizeof(kResourceFiles) / sizeof(kResourceFiles[0]); ++i)
+	{
+		names.push_back( kResourceFiles[i] );
+		fileNames.push_back( settings.resources + kResourceFiles[i] );
+	}
+	if (settings.entities > 0)
+	{
+		if (!WriteGeneratedScene( kGeneratedScene, settings.entities ))
+		{
+			fprintf( stderr, "Cannot write %s\n", kGeneratedScene );
+			return EXIT_FAILURE;
+		}
+		names.push_back( "generated" );
+		fileNames.push_back( kGeneratedScene );
+	}
+
+	vector<SResult> results;
+	for (TUInt32 i = 0; i < fileNames.size(); ++i)
+	{
+		for (int inSitu = 0; inSitu < 2; ++inSitu)
+		{
+			SResult result;
+			if (!RunBenchmark( names[i], fileNames[i], inSitu != 0, settings, result ))
+			{
+				fprintf( stderr, "Cannot load %s\n", fileNames[i].c_str() );
+				return EXIT_FAILURE;
+			}
+			results.push_back( result );
+			fprintf( stderr, "%-24s %-8s %10.3f us/load %8.1f MB/s\n", result.name.c_str(),
+			         inSitu ? "in-situ" : "default", result.minUsPerLoad, result.mbPerSecond );
+		}
+	}
+	remove( kGeneratedScene );
+
+	FILE* file = stdout;
+	if (!settings.outFile.empty())
+	{
+		file = fopen( settings.outFile.c_str(), "w" );
+		if (!file)
+		{
+			fprintf( stderr, "Cannot open %s\n", settings.outFile.c_str() );
+			return EXIT_FAILURE;
+		}
+	}
+	WriteJSON( file, settings, results );
+	if (file != stdout)
+	{
+		fclose( file );
+	}
+
+	return EXIT_SUCCESS;
+}
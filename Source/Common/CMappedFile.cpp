@@ -0,0 +1,108 @@
+/*******************************************
+	CMappedFile.cpp
+
+	Read-only memory mapped file
+********************************************/
+
+#include <Windows.h>
+
+#include "CMappedFile.h"
+
+namespace gen
+{
+
+// Constructor, file is not open
+CMappedFile::CMappedFile()
+{
+	m_File = INVALID_HANDLE_VALUE;
+	m_Mapping = 0;
+	m_Data = 0;
+	m_Size = 0;
+}
+
+
+// Map the given file into memory, returns false on failure. Any file currently open is
+// closed first. Empty files cannot be mapped
+bool CMappedFile::Open( const string& fileName )
+{
+	Close();
+
+	m_File = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if (m_File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	// Only files up to 4GB supported
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx( m_File, &fileSize ) || fileSize.QuadPart == 0 || fileSize.HighPart != 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = fileSize.LowPart;
+
+	m_Mapping = CreateFileMappingA( m_File, NULL, PAGE_READONLY, 0, 0, NULL );
+	if (!m_Mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_Data = static_cast<const TUInt8*>(MapViewOfFile( m_Mapping, FILE_MAP_READ, 0, 0, 0 ));
+	if (!m_Data)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+// Unmap and close the file
+void CMappedFile::Close()
+{
+	if (m_Data)
+	{
+		UnmapViewOfFile( m_Data );
+		m_Data = 0;
+	}
+	if (m_Mapping)
+	{
+		CloseHandle( m_Mapping );
+		m_Mapping = 0;
+	}
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle( m_File );
+		m_File = INVALID_HANDLE_VALUE;
+	}
+	m_Size = 0;
+}
+
+
+// Get the last write time (OS specific units, only useful for comparison) and size of the
+// given file. Returns false if the file does not exist
+bool CMappedFile::GetFileStamp( const string& fileName, TUInt64* pWriteTime, TUInt64* pSize )
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA( fileName.c_str(), GetFileExInfoStandard, &attributes ))
+	{
+		return false;
+	}
+
+	if (pWriteTime)
+	{
+		*pWriteTime = (static_cast<TUInt64>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+		              attributes.ftLastWriteTime.dwLowDateTime;
+	}
+	if (pSize)
+	{
+		*pSize = (static_cast<TUInt64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	}
+	return true;
+}
+
+
+} // namespace gen
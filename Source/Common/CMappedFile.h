@@ -0,0 +1,92 @@
+/*******************************************
+	CMappedFile.h
+
+	Read-only memory mapped file
+********************************************/
+
+#pragma once
+
+#include <string>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+// A file mapped read-only into memory. The contents can be accessed directly through the
+// returned pointer for as long as the object exists, with pages loaded from disk on demand by
+// the OS. Used for fast loading of compiled / binary resource files
+class CMappedFile
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	// Constructor, file is not open
+	CMappedFile();
+
+	// Destructor unmaps and closes the file
+	~CMappedFile()
+	{
+		Close();
+	}
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CMappedFile( const CMappedFile& );
+	CMappedFile& operator=( const CMappedFile& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Map the given file into memory, returns false on failure. Any file currently open is
+	// closed first. Empty files cannot be mapped
+	bool Open( const string& fileName );
+
+	// Unmap and close the file
+	void Close();
+
+	// Return whether a file is currently mapped
+	bool IsOpen()
+	{
+		return m_Data != 0;
+	}
+
+	// Access the mapped data
+	const TUInt8* GetData()
+	{
+		return m_Data;
+	}
+
+	// Return the size of the mapped data in bytes
+	TUInt32 GetSize()
+	{
+		return m_Size;
+	}
+
+
+	/////////////////////////////////////
+	// File information
+
+	// Get the last write time (OS specific units, only useful for comparison) and size of the
+	// given file. Returns false if the file does not exist
+	static bool GetFileStamp( const string& fileName, TUInt64* pWriteTime, TUInt64* pSize );
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// OS handles for the file and mapping (kept as void* to avoid including Windows.h here)
+	void* m_File;
+	void* m_Mapping;
+
+	// Mapped view of file
+	const TUInt8* m_Data;
+	TUInt32       m_Size;
+};
+
+
+} // namespace gen
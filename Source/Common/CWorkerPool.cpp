@@ -0,0 +1,98 @@
+/*******************************************
+	CWorkerPool.cpp
+
+	Pool of worker threads running queued jobs
+********************************************/
+
+#include "CWorkerPool.h"
+
+namespace gen
+{
+
+// Start the given number of worker threads, 0 for one per hardware thread
+CWorkerPool::CWorkerPool( TUInt32 numThreads /*= 0*/ )
+{
+	m_NumPendingJobs = 0;
+	m_Stopping = false;
+
+	if (numThreads == 0)
+	{
+		numThreads = thread::hardware_concurrency();
+		if (numThreads == 0) numThreads = 1; // Count not available
+	}
+	m_Threads.reserve( numThreads );
+	for (TUInt32 i = 0; i < numThreads; ++i)
+	{
+		m_Threads.push_back( thread( &CWorkerPool::WorkerThread, this ) );
+	}
+}
+
+// Destructor waits for all queued jobs to complete then stops the threads
+CWorkerPool::~CWorkerPool()
+{
+	Wait();
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_Stopping = true;
+	}
+	m_JobAdded.notify_all();
+	for (TUInt32 i = 0; i < m_Threads.size(); ++i)
+	{
+		m_Threads[i].join();
+	}
+}
+
+
+// Queue a job to be run on one of the worker threads
+void CWorkerPool::AddJob( const function<void()>& job )
+{
+	{
+		lock_guard<mutex> lock( m_Mutex );
+		m_Jobs.push_back( job );
+		++m_NumPendingJobs;
+	}
+	m_JobAdded.notify_one();
+}
+
+// Wait until all jobs queued so far have completed
+void CWorkerPool::Wait()
+{
+	unique_lock<mutex> lock( m_Mutex );
+	while (m_NumPendingJobs > 0)
+	{
+		m_JobsComplete.wait( lock );
+	}
+}
+
+
+// Worker thread function, runs jobs until the pool is destroyed
+void CWorkerPool::WorkerThread()
+{
+	unique_lock<mutex> lock( m_Mutex );
+	while (true)
+	{
+		while (m_Jobs.empty() && !m_Stopping)
+		{
+			m_JobAdded.wait( lock );
+		}
+		if (m_Jobs.empty())
+		{
+			return; // Stopping and no work left
+		}
+
+		// Run the next job without holding the lock
+		function<void()> job = m_Jobs.front();
+		m_Jobs.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
+
+		if (--m_NumPendingJobs == 0)
+		{
+			m_JobsComplete.notify_all();
+		}
+	}
+}
+
+
+} // namespace gen
@@ -0,0 +1,78 @@
+/*******************************************
+	CWorkerPool.h
+
+	Pool of worker threads running queued jobs
+********************************************/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+// A fixed set of worker threads that run jobs from a shared queue. Used to spread independent
+// CPU work, such as resource loading, over all cores. Jobs must not throw and must not use
+// DirectX - anything needing the device is left for the calling thread once the jobs complete
+class CWorkerPool
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	// Start the given number of worker threads, 0 for one per hardware thread
+	CWorkerPool( TUInt32 numThreads = 0 );
+
+	// Destructor waits for all queued jobs to complete then stops the threads
+	~CWorkerPool();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CWorkerPool( const CWorkerPool& );
+	CWorkerPool& operator=( const CWorkerPool& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Return the number of worker threads
+	TUInt32 GetNumThreads()
+	{
+		return static_cast<TUInt32>(m_Threads.size());
+	}
+
+	// Queue a job to be run on one of the worker threads
+	void AddJob( const function<void()>& job );
+
+	// Wait until all jobs queued so far have completed
+	void Wait();
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Worker thread function, runs jobs until the pool is destroyed
+	void WorkerThread();
+
+	vector<thread>          m_Threads;
+
+	// Job queue and count of jobs queued or running, all protected by the mutex
+	mutex                   m_Mutex;
+	condition_variable      m_JobAdded;
+	condition_variable      m_JobsComplete;
+	deque<function<void()>> m_Jobs;
+	TUInt32                 m_NumPendingJobs;
+	bool                    m_Stopping;
+};
+
+
+} // namespace gen
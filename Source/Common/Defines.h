@@ -20,8 +20,10 @@ using namespace std;
 // Include platform specific definitions
 #if defined (_MSC_VER)
 	#include "MSDefines.h" // _MSC_VER is only defined on Microsoft compilers
+#elif defined (__GNUC__) && defined (__linux__)
+	#include "GCCDefines.h" // Non-graphical modules only (maths library, benchmarks)
 #else
-	#error "Unsupported OS/compiler - only Windows and Visual Studio supported at present"
+	#error "Unsupported OS/compiler - only Windows/Visual Studio and Linux/GCC supported at present"
 #endif
 
 namespace gen
@@ -0,0 +1,38 @@
+/**************************************************************************************************
+	Module:       GCCDefines.cpp
+	Date created: 18/10/26
+
+	Utility functions for GCC / Clang on Linux
+
+	Change history:
+		V1.0    Created 18/10/26
+**************************************************************************************************/
+
+#include <stdio.h>
+
+#include "Defines.h"
+#include "GCCDefines.h"
+
+namespace gen
+{
+
+/*------------------------------------------------------------------------------------------------
+	OS-specific GUI support
+ ------------------------------------------------------------------------------------------------*/
+
+// System message box used to display errors or warnings. There is no GUI on this platform, so the
+// message is written to stderr. If Yes/No buttons are requested the answer is always No.
+// Return value is whether the Yes or OK button was "pressed".
+bool SystemMessageBox
+(
+	const string& sMessage, // Main message to display
+	const string& sCaption, // Caption to display at top of box
+	const bool    bYesNo    // Display Yes and No buttons instead of OK
+)
+{
+	fprintf( stderr, "%s: %s\n", sCaption.c_str(), sMessage.c_str() );
+	return !bYesNo;
+}
+
+
+} // namespace gen
@@ -0,0 +1,400 @@
+/*******************************************
+	NumberParser.cpp
+
+	Fast locale-free number parsing for
+	text resource files
+********************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <float.h>
+#include <locale.h>
+
+#include "NumberParser.h"
+
+// Digit runs are found 16 characters at a time with SSE2 where available
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define GEN_NUMBER_PARSER_SSE2
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+namespace gen
+{
+
+/*-----------------------------------------------------------------------------------------
+	Digit scanning
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+
+// Maximum number of significant digits held exactly in the 64-bit mantissa
+const TUInt32 kMaxMantissaDigits = 19;
+
+// Powers of ten that are exact as doubles
+const TFloat64 kPowersOf10[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const TInt32 kMaxExactPower = 22;
+
+inline bool IsDigit( char c )
+{
+	return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline bool IsSpace( char c )
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Return the number of digits at the start of [p, end)
+inline TUInt32 CountDigits( const char* p, const char* end )
+{
+	const char* start = p;
+#ifdef GEN_NUMBER_PARSER_SSE2
+	// Offset characters so '0'-'9' become the lowest ten signed bytes, then a single signed
+	// compare finds all digits. Long runs occur in large mesh files
+	const __m128i offset = _mm_set1_epi8( static_cast<char>('0' + 128) );
+	const __m128i limit = _mm_set1_epi8( static_cast<char>(-128 + 10) );
+	while (end - p >= 16)
+	{
+		__m128i chars = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+		__m128i digits = _mm_cmplt_epi8( _mm_sub_epi8( chars, offset ), limit );
+		unsigned int nonDigits = ~static_cast<unsigned int>(_mm_movemask_epi8( digits )) & 0xffff;
+		if (nonDigits)
+		{
+		#ifdef _MSC_VER
+			unsigned long first;
+			_BitScanForward( &first, nonDigits );
+		#else
+			unsigned int first = __builtin_ctz( nonDigits );
+		#endif
+			return static_cast<TUInt32>(p - start) + first;
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && IsDigit( *p ))
+	{
+		++p;
+	}
+	return static_cast<TUInt32>(p - start);
+}
+
+// Convert eight digit characters to their value, all eight at once in a 64-bit register
+inline TUInt32 EightDigitsValue( const char* p )
+{
+	TUInt64 v;
+	memcpy( &v, p, 8 );
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+	     (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+	return static_cast<TUInt32>(v);
+}
+
+// Add a run of digits to a mantissa. Once the mantissa holds its maximum number of digits the
+// rest are counted in numDropped, and inexact is set if any of them are non-zero. The digit
+// count is conservative (may include leading zeros), which only affects when digits are dropped
+void AddDigits( const char* p, TUInt32 count, TUInt64& mantissa, TUInt32& numDigits,
+                TUInt32& numDropped, bool& inexact )
+{
+	while (count >= 8 && numDigits + 8 <= kMaxMantissaDigits)
+	{
+		mantissa = mantissa * 100000000 + EightDigitsValue( p );
+		if (mantissa != 0) numDigits += 8;
+		p += 8;
+		count -= 8;
+	}
+	for (; count > 0; --count, ++p)
+	{
+		if (numDigits < kMaxMantissaDigits)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) ++numDigits;
+		}
+		else
+		{
+			++numDropped;
+			if (*p != '0') inexact = true;
+		}
+	}
+}
+
+// Locale-independent conversion used for the rare numbers the fast path cannot round exactly.
+// The text has already been validated and holds exactly one number
+TFloat32 SlowParseFloat( const char* text, const char* end, bool* rangeError )
+{
+	char buffer[128];
+	size_t length = end - text;
+	char* copy = (length < sizeof(buffer)) ? buffer : new char[length + 1];
+	memcpy( copy, text, length );
+	copy[length] = 0;
+
+#ifdef _MSC_VER
+	static _locale_t cLocale = _create_locale( LC_NUMERIC, "C" );
+	TFloat32 value = _strtof_l( copy, 0, cLocale );
+#else
+	static locale_t cLocale = newlocale( LC_NUMERIC_MASK, "C", 0 );
+	TFloat32 value = strtof_l( copy, 0, cLocale );
+#endif
+	*rangeError = (value > FLT_MAX || value < -FLT_MAX);
+
+	if (copy != buffer) delete[] copy;
+	return value;
+}
+
+// Parse the digits of an integer with a sign already read, up to the given maximum magnitude
+const char* ParseMagnitude( const char* text, const char* end, TUInt64 maxMagnitude, TUInt64* magnitude )
+{
+	TUInt32 numDigits = CountDigits( text, end );
+	if (numDigits == 0)
+	{
+		return 0;
+	}
+
+	// Skip leading zeros so only the significant digits are limited
+	const char* p = text;
+	const char* digitsEnd = text + numDigits;
+	while (p + 1 < digitsEnd && *p == '0')
+	{
+		++p;
+	}
+	if (digitsEnd - p > 10)
+	{
+		return 0; // Too many digits for 32-bit
+	}
+
+	TUInt64 value = 0;
+	for (; p < digitsEnd; ++p)
+	{
+		value = value * 10 + (*p - '0');
+	}
+	if (value > maxMagnitude)
+	{
+		return 0;
+	}
+	*magnitude = value;
+	return digitsEnd;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Range parsing
+-----------------------------------------------------------------------------------------*/
+
+const char* ParseFloat( const char* text, const char* end, TFloat32* value )
+{
+	const char* p = text;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		++p;
+	}
+
+	// Integer and fraction digits are collected into a single mantissa with a decimal exponent
+	TUInt64 mantissa = 0;
+	TUInt32 numDigits = 0, numDropped = 0;
+	bool inexact = false;
+
+	TUInt32 numIntDigits = CountDigits( p, end );
+	AddDigits( p, numIntDigits, mantissa, numDigits, numDropped, inexact );
+	p += numIntDigits;
+	TInt32 exponent = static_cast<TInt32>(numDropped);
+
+	TUInt32 numFracDigits = 0;
+	if (p < end && *p == '.')
+	{
+		++p;
+		numFracDigits = CountDigits( p, end );
+		numDropped = 0;
+		AddDigits( p, numFracDigits, mantissa, numDigits, numDropped, inexact );
+		p += numFracDigits;
+		exponent -= static_cast<TInt32>(numFracDigits - numDropped);
+	}
+	if (numIntDigits + numFracDigits == 0)
+	{
+		return 0;
+	}
+
+	// Exponent - must have digits if present
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negativeExp = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExp = (*p == '-');
+			++p;
+		}
+		TUInt32 numExpDigits = CountDigits( p, end );
+		if (numExpDigits == 0)
+		{
+			return 0;
+		}
+		TInt32 expValue = 0;
+		for (TUInt32 i = 0; i < numExpDigits; ++i, ++p)
+		{
+			if (expValue < 100000) expValue = expValue * 10 + (*p - '0'); // Far out of range anyway
+		}
+		exponent += negativeExp ? -expValue : expValue;
+	}
+
+	// Fast path - the mantissa and power of ten are exact doubles so the double result is
+	// correctly rounded. Rounding that to float is also correct unless the double lies exactly
+	// halfway between two floats (it may have been rounded there), or the result is outside the
+	// normal float range
+	TFloat32 result;
+	if (mantissa == 0)
+	{
+		result = 0.0f;
+	}
+	else
+	{
+		bool fast = false;
+		if (!inexact && mantissa <= (1ULL << 53) && exponent >= -kMaxExactPower && exponent <= kMaxExactPower)
+		{
+			TFloat64 d = static_cast<TFloat64>(mantissa);
+			d = (exponent < 0) ? d / kPowersOf10[-exponent] : d * kPowersOf10[exponent];
+
+			TUInt64 bits;
+			memcpy( &bits, &d, sizeof(bits) );
+			bool halfway = (bits & ((1ULL << 29) - 1)) == (1ULL << 28);
+			if (!halfway && d >= FLT_MIN && d <= FLT_MAX)
+			{
+				result = static_cast<TFloat32>(d);
+				fast = true;
+			}
+		}
+		if (!fast)
+		{
+			bool rangeError;
+			result = SlowParseFloat( text, p, &rangeError );
+			if (rangeError)
+			{
+				return 0;
+			}
+			negative = false; // Sign included in the slow parse
+		}
+	}
+
+	*value = negative ? -result : result;
+	return p;
+}
+
+const char* ParseInt( const char* text, const char* end, TInt32* value )
+{
+	const char* p = text;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		++p;
+	}
+
+	TUInt64 magnitude;
+	p = ParseMagnitude( p, end, negative ? 0x80000000ULL : 0x7fffffffULL, &magnitude );
+	if (!p)
+	{
+		return 0;
+	}
+	*value = negative ? static_cast<TInt32>(0 - magnitude) : static_cast<TInt32>(magnitude);
+	return p;
+}
+
+const char* ParseUInt( const char* text, const char* end, TUInt32* value )
+{
+	const char* p = text;
+	if (p < end && *p == '+')
+	{
+		++p;
+	}
+
+	TUInt64 magnitude;
+	p = ParseMagnitude( p, end, 0xffffffffULL, &magnitude );
+	if (!p)
+	{
+		return 0;
+	}
+	*value = static_cast<TUInt32>(magnitude);
+	return p;
+}
+
+// Parse an array of floats as found in text mesh files, separated by any whitespace, commas and
+// semicolons. Returns a pointer to the character after the last number or 0 on error
+const char* ParseFloatArray( const char* text, const char* end, TFloat32* values, TUInt32 count )
+{
+	const char* p = text;
+	for (TUInt32 i = 0; i < count; ++i)
+	{
+		while (p < end && (IsSpace( *p ) || *p == ',' || *p == ';'))
+		{
+			++p;
+		}
+		p = ParseFloat( p, end, &values[i] );
+		if (!p)
+		{
+			return 0;
+		}
+	}
+	return p;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	String parsing
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+
+// Parse a whole string with one of the range functions, allowing surrounding whitespace
+template <class T> bool ParseString( const char* text, T* value,
+                                     const char* (*parse)( const char*, const char*, T* ) )
+{
+	while (IsSpace( *text ))
+	{
+		++text;
+	}
+	const char* end = text + strlen( text );
+	while (end > text && IsSpace( end[-1] ))
+	{
+		--end;
+	}
+
+	T parsed;
+	if (end == text || parse( text, end, &parsed ) != end)
+	{
+		return false;
+	}
+	*value = parsed;
+	return true;
+}
+
+} // namespace
+
+bool ParseFloat( const char* text, TFloat32* value )
+{
+	return ParseString<TFloat32>( text, value, ParseFloat );
+}
+
+bool ParseInt( const char* text, TInt32* value )
+{
+	return ParseString<TInt32>( text, value, ParseInt );
+}
+
+bool ParseUInt( const char* text, TUInt32* value )
+{
+	return ParseString<TUInt32>( text, value, ParseUInt );
+}
+
+
+} // namespace gen
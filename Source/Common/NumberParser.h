@@ -0,0 +1,50 @@
+/*******************************************
+	NumberParser.h
+
+	Fast locale-free number parsing for
+	text resource files
+********************************************/
+
+#pragma once
+
+#include "Defines.h"
+
+namespace gen
+{
+
+// Numbers are parsed in the fixed "C" format whatever the current locale - an optional sign,
+// decimal digits with an optional '.' fraction, then an optional exponent for floats. At least
+// one digit is required before or after the '.'. Hex, inf and nan are not accepted. Parsing is
+// strict: numbers that are malformed or out of range are errors rather than being partly read
+// as with atof/atoi. Floats are correctly rounded
+//
+// The range functions parse a number at the start of the text [text, end) and return a pointer
+// to the character after it, or 0 if there is no valid number there (the value is unchanged).
+// No whitespace is skipped and the text need not be null-terminated. The string functions
+// require the whole null-terminated string to be a number, other than surrounding whitespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Range parsing
+-----------------------------------------------------------------------------------------*/
+
+const char* ParseFloat( const char* text, const char* end, TFloat32* value );
+const char* ParseInt( const char* text, const char* end, TInt32* value );
+const char* ParseUInt( const char* text, const char* end, TUInt32* value );
+
+// Parse an array of floats as found in text mesh files. Whitespace, commas and semicolons
+// before each number are skipped, so "1.0; 2.0;-3.0;," gives three values. Returns a pointer
+// to the character after the last number or 0 if fewer than count valid numbers were found
+const char* ParseFloatArray( const char* text, const char* end, TFloat32* values, TUInt32 count );
+
+
+/*-----------------------------------------------------------------------------------------
+	String parsing
+-----------------------------------------------------------------------------------------*/
+
+bool ParseFloat( const char* text, TFloat32* value );
+bool ParseInt( const char* text, TInt32* value );
+bool ParseUInt( const char* text, TUInt32* value );
+
+
+} // namespace gen
@@ -76,7 +76,11 @@ enum ERoundingMethod
 // Many versions provided here to allow mixing of parameter types for these basic functions
 
 inline TUInt32 Abs( const TInt32 x ) { return abs( static_cast<int>(x) ); }
+#if defined(_MSC_VER)
 inline TUInt64 Abs( const TInt64 x ) { return _abs64( x ); }
+#else
+inline TUInt64 Abs( const TInt64 x ) { return llabs( x ); }
+#endif
 inline TFloat32 Abs( const TFloat32 x ) { return fabsf( x ); }
 inline TFloat64 Abs( const TFloat64 x ) { return fabs( x ); }
 
@@ -0,0 +1,224 @@
+/*******************************************
+	CAffine3x4.cpp
+
+	A compact affine transformation - the
+	upper 4x3 part of an affine CMatrix4x4
+	(12 floats, 48 bytes)
+********************************************/
+
+#include "CAffine3x4.h"
+#include "Error.h"
+
+namespace gen
+{
+
+/*-----------------------------------------------------------------------------------------
+	Constructors
+-----------------------------------------------------------------------------------------*/
+
+// Construct by value, rows are X axis, Y axis, Z axis and position
+CAffine3x4::CAffine3x4
+(
+	const TFloat32 elt00, const TFloat32 elt01, const TFloat32 elt02,
+	const TFloat32 elt10, const TFloat32 elt11, const TFloat32 elt12,
+	const TFloat32 elt20, const TFloat32 elt21, const TFloat32 elt22,
+	const TFloat32 elt30, const TFloat32 elt31, const TFloat32 elt32
+)
+{
+	e00 = elt00;  e01 = elt01;  e02 = elt02;
+	e10 = elt10;  e11 = elt11;  e12 = elt12;
+	e20 = elt20;  e21 = elt21;  e22 = elt22;
+	e30 = elt30;  e31 = elt31;  e32 = elt32;
+}
+
+// Construct from the affine part of a CMatrix4x4 (right-hand column is ignored)
+CAffine3x4::CAffine3x4( const CMatrix4x4& m )
+{
+	SetMatrix( m );
+}
+
+// Construct affine transformation from position, Euler angles and optional scaling. May
+// specify order to apply rotations
+CAffine3x4::CAffine3x4
+(
+	const CVector3&      position,
+	const CVector3&      angles,
+	const ERotationOrder eRotOrder /*= kZXY*/,
+	const CVector3&      scale /*= CVector3::kOne*/
+)
+{
+	MakeAffineEuler( position, angles, eRotOrder, scale );
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Creation and Decomposition
+-----------------------------------------------------------------------------------------*/
+
+// Make this transform the identity
+void CAffine3x4::MakeIdentity()
+{
+	e00 = 1.0f;  e01 = 0.0f;  e02 = 0.0f;
+	e10 = 0.0f;  e11 = 1.0f;  e12 = 0.0f;
+	e20 = 0.0f;  e21 = 0.0f;  e22 = 1.0f;
+	e30 = 0.0f;  e31 = 0.0f;  e32 = 0.0f;
+}
+
+// Make transform from position & optional Euler angles & scaling. Uses the CMatrix4x4 method
+// so the two types stay consistent for all rotation orders - creation is not time critical
+void CAffine3x4::MakeAffineEuler
+(
+	const CVector3&      position,
+	const CVector3&      angles /*= CVector3::kZero*/,
+	const ERotationOrder eRotOrder /*= kZXY*/,
+	const CVector3&      scale /*= CVector3::kOne*/
+)
+{
+	CMatrix4x4 m;
+	m.MakeAffineEuler( position, angles, eRotOrder, scale );
+	SetMatrix( m );
+}
+
+// Decompose transform into position, Euler angles of rotation and scale. Pass NULL for any
+// unneeded parameters
+void CAffine3x4::DecomposeAffineEuler
+(
+	CVector3*            pPosition,
+	CVector3*            pAngles,
+	CVector3*            pScale,
+	const ERotationOrder eRotOrder /*= kZXY*/
+) const
+{
+	// Position and scale can be read directly, only the angles need the full decomposition
+	if (pPosition)
+	{
+		*pPosition = GetPosition();
+	}
+	if (pAngles)
+	{
+		GetMatrix().DecomposeAffineEuler( NULL, pAngles, pScale, eRotOrder );
+	}
+	else if (pScale)
+	{
+		*pScale = GetScale();
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Inverse
+-----------------------------------------------------------------------------------------*/
+
+// Set this transform to its inverse
+void CAffine3x4::Invert()
+{
+	*this = Inverse( *this );
+}
+
+// Return the inverse of given affine transform
+CAffine3x4 Inverse( const CAffine3x4& m )
+{
+	GEN_GUARD;
+
+	CAffine3x4 mOut;
+
+	// Calculate determinant of upper left 3x3
+	TFloat32 det0 = m.e11*m.e22 - m.e12*m.e21;
+	TFloat32 det1 = m.e12*m.e20 - m.e10*m.e22;
+	TFloat32 det2 = m.e10*m.e21 - m.e11*m.e20;
+	TFloat32 det = m.e00*det0 + m.e01*det1 + m.e02*det2;
+	GEN_ASSERT( !IsZero(det), "Singular matrix" );
+
+	// Calculate inverse of upper left 3x3
+	TFloat32 invDet = 1.0f / det;
+	mOut.e00 = invDet * det0;
+	mOut.e10 = invDet * det1;
+	mOut.e20 = invDet * det2;
+
+	mOut.e01 = invDet * (m.e21*m.e02 - m.e22*m.e01);
+	mOut.e11 = invDet * (m.e22*m.e00 - m.e20*m.e02);
+	mOut.e21 = invDet * (m.e20*m.e01 - m.e21*m.e00);
+
+	mOut.e02 = invDet * (m.e01*m.e12 - m.e02*m.e11);
+	mOut.e12 = invDet * (m.e02*m.e10 - m.e00*m.e12);
+	mOut.e22 = invDet * (m.e00*m.e11 - m.e01*m.e10);
+
+	// Transform negative translation by inverted 3x3 to get inverse
+	mOut.e30 = -m.e30*mOut.e00 - m.e31*mOut.e10 - m.e32*mOut.e20;
+	mOut.e31 = -m.e30*mOut.e01 - m.e31*mOut.e11 - m.e32*mOut.e21;
+	mOut.e32 = -m.e30*mOut.e02 - m.e31*mOut.e12 - m.e32*mOut.e22;
+
+	return mOut;
+
+	GEN_ENDGUARD;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Concatenation
+-----------------------------------------------------------------------------------------*/
+
+// Post-multiply this transform by the given one
+CAffine3x4& CAffine3x4::operator*=( const CAffine3x4& m )
+{
+	Concatenate( *this, m, *this );
+	return *this;
+}
+
+// Concatenate two affine transforms: apply m1 then m2 - non-member version
+CAffine3x4 operator*
+(
+	const CAffine3x4& m1,
+	const CAffine3x4& m2
+)
+{
+	CAffine3x4 mOut;
+	Concatenate( m1, m2, mOut );
+	return mOut;
+}
+
+// Concatenate into an existing transform, mOut = m1 * m2. The implicit right-hand column of
+// (0,0,0,1) means the 3x3 part is a plain 3x3 product and the translation row only needs
+// the extra add of m2's position - 36 multiplies rather than the 64 of a full 4x4 product
+void Concatenate
+(
+	const CAffine3x4& m1,
+	const CAffine3x4& m2,
+	CAffine3x4&       mOut
+)
+{
+	// Calculate into a local so the compiler knows the output does not alias the inputs
+	CAffine3x4 m;
+
+	m.e00 = m1.e00*m2.e00 + m1.e01*m2.e10 + m1.e02*m2.e20;
+	m.e01 = m1.e00*m2.e01 + m1.e01*m2.e11 + m1.e02*m2.e21;
+	m.e02 = m1.e00*m2.e02 + m1.e01*m2.e12 + m1.e02*m2.e22;
+
+	m.e10 = m1.e10*m2.e00 + m1.e11*m2.e10 + m1.e12*m2.e20;
+	m.e11 = m1.e10*m2.e01 + m1.e11*m2.e11 + m1.e12*m2.e21;
+	m.e12 = m1.e10*m2.e02 + m1.e11*m2.e12 + m1.e12*m2.e22;
+
+	m.e20 = m1.e20*m2.e00 + m1.e21*m2.e10 + m1.e22*m2.e20;
+	m.e21 = m1.e20*m2.e01 + m1.e21*m2.e11 + m1.e22*m2.e21;
+	m.e22 = m1.e20*m2.e02 + m1.e21*m2.e12 + m1.e22*m2.e22;
+
+	m.e30 = m1.e30*m2.e00 + m1.e31*m2.e10 + m1.e32*m2.e20 + m2.e30;
+	m.e31 = m1.e30*m2.e01 + m1.e31*m2.e11 + m1.e32*m2.e21 + m2.e31;
+	m.e32 = m1.e30*m2.e02 + m1.e31*m2.e12 + m1.e32*m2.e22 + m2.e32;
+
+	mOut = m;
+}
+
+
+/*---------------------------------------------------------------------------------------------
+	Static constants
+---------------------------------------------------------------------------------------------*/
+
+// Standard transforms
+const CAffine3x4 CAffine3x4::kIdentity(1.0f, 0.0f, 0.0f,
+                                       0.0f, 1.0f, 0.0f,
+                                       0.0f, 0.0f, 1.0f,
+                                       0.0f, 0.0f, 0.0f);
+
+
+} // namespace gen
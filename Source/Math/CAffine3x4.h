@@ -0,0 +1,467 @@
+/*******************************************
+	CAffine3x4.h
+
+	A compact affine transformation - the
+	upper 4x3 part of an affine CMatrix4x4
+	(12 floats, 48 bytes)
+********************************************/
+
+// An affine CMatrix4x4 always has a right-hand column of (0, 0, 0, 1):
+//     Xx Xy Xz 0
+//     Yx Yy Yz 0   where (Xx, Xy, Xz) is the X axis, (Yx, Yy, Yz) the Y axis
+//     Zx Zy Zz 0         (Zx, Zy, Zz) the Z axis and (Px, Py, Pz) the local origin (position)
+//     Px Py Pz 1
+// This class stores only the first three columns, using the same element names and the same row
+// vector conventions as CMatrix4x4, so code can move between the two without change. Storage is
+// 25% smaller and multiplication / inversion / point transformation skip the constant 0 & 1
+// entries. Convert to a CMatrix4x4 (GetMatrix) only where a full matrix is required, e.g. when
+// passing a world matrix to the shaders
+//
+// The affine methods make the same assumption as CMatrix4x4, i.e. that the transformation is
+// composed in this order: M = Scale*Rotation*Translation
+
+#ifndef GEN_C_AFFINE_3X4_H_INCLUDED
+#define GEN_C_AFFINE_3X4_H_INCLUDED
+
+#include "Defines.h"
+#include "BaseMath.h"
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+
+namespace gen
+{
+
+class CAffine3x4
+{
+	GEN_CLASS( CAffine3x4 );
+
+// Concrete class - public access
+public:
+
+	/*-----------------------------------------------------------------------------------------
+		Constructors/Destructors
+	-----------------------------------------------------------------------------------------*/
+
+	// Default constructor - leaves values uninitialised (for performance)
+	CAffine3x4() {}
+
+	// Construct by value, rows are X axis, Y axis, Z axis and position
+	CAffine3x4
+	(
+		const TFloat32 elt00, const TFloat32 elt01, const TFloat32 elt02,
+		const TFloat32 elt10, const TFloat32 elt11, const TFloat32 elt12,
+		const TFloat32 elt20, const TFloat32 elt21, const TFloat32 elt22,
+		const TFloat32 elt30, const TFloat32 elt31, const TFloat32 elt32
+	);
+
+	// Construct from the affine part of a CMatrix4x4 (right-hand column is ignored)
+	explicit CAffine3x4( const CMatrix4x4& m );
+	// Require explicit conversion from CMatrix4x4 (loses data for non-affine matrices)
+
+	// Construct affine transformation from position, Euler angles and optional scaling. May
+	// specify order to apply rotations
+	// Transform is effectively built in this order: M = Scale*Rotation*Translation
+	CAffine3x4
+	(
+		const CVector3&      position,
+		const CVector3&      angles,
+		const ERotationOrder eRotOrder = kZXY,
+		const CVector3&      scale = CVector3::kOne
+	);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Conversion
+	-----------------------------------------------------------------------------------------*/
+
+	// Get the 4x4 matrix equivalent to this transform
+	void GetMatrix( CMatrix4x4& mat ) const
+	{
+		mat.e00 = e00;  mat.e01 = e01;  mat.e02 = e02;  mat.e03 = 0.0f;
+		mat.e10 = e10;  mat.e11 = e11;  mat.e12 = e12;  mat.e13 = 0.0f;
+		mat.e20 = e20;  mat.e21 = e21;  mat.e22 = e22;  mat.e23 = 0.0f;
+		mat.e30 = e30;  mat.e31 = e31;  mat.e32 = e32;  mat.e33 = 1.0f;
+	}
+
+	// Return the 4x4 matrix equivalent to this transform
+	CMatrix4x4 GetMatrix() const
+	{
+		CMatrix4x4 mat;
+		GetMatrix( mat );
+		return mat;
+	}
+
+	// Set this transform from the affine part of a CMatrix4x4
+	void SetMatrix( const CMatrix4x4& mat )
+	{
+		e00 = mat.e00;  e01 = mat.e01;  e02 = mat.e02;
+		e10 = mat.e10;  e11 = mat.e11;  e12 = mat.e12;
+		e20 = mat.e20;  e21 = mat.e21;  e22 = mat.e22;
+		e30 = mat.e30;  e31 = mat.e31;  e32 = mat.e32;
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Row access
+	-----------------------------------------------------------------------------------------*/
+	// Rows are exactly three floats so can be reinterpreted as CVector3 (see CMatrix4x4 for notes
+	// on portability of this approach)
+
+	// Get a single row (range 0-3) of the transform - X axis, Y axis, Z axis or position
+	CVector3 GetRow( const TUInt32 iRow ) const
+	{
+		GEN_ASSERT_OPT( iRow < 4, "Invalid parameter" );
+		return *reinterpret_cast<const CVector3*>(&e00 + iRow * 3);
+	}
+
+	// Direct access to rows as CVector3. Index in range 0-3 - no validation of index
+	CVector3& operator[]( const TUInt32 iRow )
+	{
+		return *reinterpret_cast<CVector3*>(&e00 + iRow * 3);
+	}
+	const CVector3& operator[]( const TUInt32 iRow ) const
+	{
+		return *reinterpret_cast<const CVector3*>(&e00 + iRow * 3);
+	}
+
+	// Direct access to X, Y and Z axes and position (translation) as CVector3
+	CVector3& XAxis()
+	{
+		return *reinterpret_cast<CVector3*>(&e00);
+	}
+	const CVector3& XAxis() const
+	{
+		return *reinterpret_cast<const CVector3*>(&e00);
+	}
+	CVector3& YAxis()
+	{
+		return *reinterpret_cast<CVector3*>(&e10);
+	}
+	const CVector3& YAxis() const
+	{
+		return *reinterpret_cast<const CVector3*>(&e10);
+	}
+	CVector3& ZAxis()
+	{
+		return *reinterpret_cast<CVector3*>(&e20);
+	}
+	const CVector3& ZAxis() const
+	{
+		return *reinterpret_cast<const CVector3*>(&e20);
+	}
+	CVector3& Position()
+	{
+		return *reinterpret_cast<CVector3*>(&e30);
+	}
+	const CVector3& Position() const
+	{
+		return *reinterpret_cast<const CVector3*>(&e30);
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Creation and Decomposition
+	-----------------------------------------------------------------------------------------*/
+
+	// Make this transform the identity
+	void MakeIdentity();
+
+	// Make transform from position & optional Euler angles & scaling. May specify order to apply
+	// rotations. Transform is built in this order: M = Scale*Rotation*Translation
+	void MakeAffineEuler
+	(
+		const CVector3&      position,
+		const CVector3&      angles = CVector3::kZero,
+		const ERotationOrder eRotOrder = kZXY,
+		const CVector3&      scale = CVector3::kOne
+	);
+
+	// Decompose transform into position, Euler angles of rotation and scale. Optionally pass
+	// order of rotations. Pass NULL for any unneeded parameters
+	void DecomposeAffineEuler
+	(
+		CVector3*            pPosition,
+		CVector3*            pAngles,
+		CVector3*            pScale,
+		const ERotationOrder eRotOrder = kZXY
+	) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Manipulation
+	-----------------------------------------------------------------------------------------*/
+	// Same behaviour as the equivalent CMatrix4x4 methods
+
+	// Get / set the position (translation)
+	CVector3 GetPosition() const
+	{
+		return CVector3( e30, e31, e32 );
+	}
+	void SetPosition( const CVector3& p )
+	{
+		e30 = p.x;
+		e31 = p.y;
+		e32 = p.z;
+	}
+
+	// Move position (translation) by the given vector
+	void Move( const CVector3 v )
+	{
+		e30 += v.x;
+		e31 += v.y;
+		e32 += v.z;
+	}
+
+	// Move position (translation) by the given vector in the transform's local coordinate space.
+	// Will move exactly |v| units, regardless of scaling
+	void MoveLocal( const CVector3 v )
+	{
+		// Adjust for any scaling
+		TFloat32 scaledX = v.x * InvSqrt( e00*e00 + e01*e01 + e02*e02 );
+		TFloat32 scaledY = v.y * InvSqrt( e10*e10 + e11*e11 + e12*e12 );
+		TFloat32 scaledZ = v.z * InvSqrt( e20*e20 + e21*e21 + e22*e22 );
+		e30 += scaledX * e00 + scaledY * e10 + scaledZ * e20;
+		e31 += scaledX * e01 + scaledY * e11 + scaledZ * e21;
+		e32 += scaledX * e02 + scaledY * e12 + scaledZ * e22;
+	}
+
+	// Move position along local X, Y or Z axis. Will move exactly the given units, regardless of
+	// scaling
+	void MoveLocalX( const TFloat32 x )
+	{
+		TFloat32 scaledX = x * InvSqrt( e00*e00 + e01*e01 + e02*e02 );
+		e30 += scaledX * e00;
+		e31 += scaledX * e01;
+		e32 += scaledX * e02;
+	}
+	void MoveLocalY( const TFloat32 y )
+	{
+		TFloat32 scaledY = y * InvSqrt( e10*e10 + e11*e11 + e12*e12 );
+		e30 += scaledY * e10;
+		e31 += scaledY * e11;
+		e32 += scaledY * e12;
+	}
+	void MoveLocalZ( const TFloat32 z )
+	{
+		TFloat32 scaledZ = z * InvSqrt( e20*e20 + e21*e21 + e22*e22 );
+		e30 += scaledZ * e20;
+		e31 += scaledZ * e21;
+		e32 += scaledZ * e22;
+	}
+
+
+	// Get the X, Y & Z scaling of the transform
+	CVector3 GetScale() const
+	{
+		return CVector3( Sqrt( e00*e00 + e01*e01 + e02*e02 ),
+		                 Sqrt( e10*e10 + e11*e11 + e12*e12 ),
+		                 Sqrt( e20*e20 + e21*e21 + e22*e22 ) );
+	}
+
+
+	// Rotate by given angle (radians) around world X, Y or Z axis & local origin. The position
+	// (translation) will not be altered
+	void RotateX( const TFloat32 x )
+	{
+		TFloat32 sX, cX;
+		SinCos( x, &sX, &cX );
+		TFloat32 t;
+		t   = e01*sX + e02*cX;
+		e01 = e01*cX - e02*sX;
+		e02 = t;
+		t   = e11*sX + e12*cX;
+		e11 = e11*cX - e12*sX;
+		e12 = t;
+		t   = e21*sX + e22*cX;
+		e21 = e21*cX - e22*sX;
+		e22 = t;
+	}
+	void RotateY( const TFloat32 y )
+	{
+		TFloat32 sY, cY;
+		SinCos( y, &sY, &cY );
+		TFloat32 t;
+		t   = e00*cY + e02*sY;
+		e02 = e02*cY - e00*sY;
+		e00 = t;
+		t   = e10*cY + e12*sY;
+		e12 = e12*cY - e10*sY;
+		e10 = t;
+		t   = e20*cY + e22*sY;
+		e22 = e22*cY - e20*sY;
+		e20 = t;
+	}
+	void RotateZ( const TFloat32 z )
+	{
+		TFloat32 sZ, cZ;
+		SinCos( z, &sZ, &cZ );
+		TFloat32 t;
+		t   = e00*sZ + e01*cZ;
+		e00 = e00*cZ - e01*sZ;
+		e01 = t;
+		t   = e10*sZ + e11*cZ;
+		e10 = e10*cZ - e11*sZ;
+		e11 = t;
+		t   = e20*sZ + e21*cZ;
+		e20 = e20*cZ - e21*sZ;
+		e21 = t;
+	}
+
+	// Rotate by given angle (radians) around local X, Y or Z axis/origin
+	// Assumes transform built in the order: M = Scale*Rotation*Translation
+	void RotateLocalX( const TFloat32 x )
+	{
+		// Adjust for scaling component - becoming Scale*[XRot*Rot]*Trans
+		TFloat32 scaleSqY = e10*e10 + e11*e11 + e12*e12;
+		TFloat32 scaleSqZ = e20*e20 + e21*e21 + e22*e22;
+		GEN_ASSERT_OPT( !IsZero(scaleSqY) && !IsZero(scaleSqZ), "Singular matrix" );
+		TFloat32 scaleYZ = Sqrt( scaleSqY ) * InvSqrt( scaleSqZ );
+
+		TFloat32 sX, cX, sXY, sXZ;
+		SinCos( x, &sX, &cX );
+		sXY = sX * scaleYZ;
+		sXZ = sX / scaleYZ;
+
+		TFloat32 t;
+		t   = e10*cX + e20*sXY;
+		e20 = e20*cX - e10*sXZ;
+		e10 = t;
+		t   = e11*cX + e21*sXY;
+		e21 = e21*cX - e11*sXZ;
+		e11 = t;
+		t   = e12*cX + e22*sXY;
+		e22 = e22*cX - e12*sXZ;
+		e12 = t;
+	}
+	void RotateLocalY( const TFloat32 y )
+	{
+		// Adjust for scaling component - becoming Scale*[YRot*Rot]*Trans
+		TFloat32 scaleSqX = e00*e00 + e01*e01 + e02*e02;
+		TFloat32 scaleSqZ = e20*e20 + e21*e21 + e22*e22;
+		GEN_ASSERT_OPT( !IsZero(scaleSqX) && !IsZero(scaleSqZ), "Singular matrix" );
+		TFloat32 scaleZX = Sqrt( scaleSqZ ) * InvSqrt( scaleSqX );
+
+		TFloat32 sY, cY, sYZ, sYX;
+		SinCos( y, &sY, &cY );
+		sYZ = sY * scaleZX;
+		sYX = sY / scaleZX;
+
+		TFloat32 t;
+		t   = e20*cY + e00*sYZ;
+		e00 = e00*cY - e20*sYX;
+		e20 = t;
+		t   = e21*cY + e01*sYZ;
+		e01 = e01*cY - e21*sYX;
+		e21 = t;
+		t   = e22*cY + e02*sYZ;
+		e02 = e02*cY - e22*sYX;
+		e22 = t;
+	}
+	void RotateLocalZ( const TFloat32 z )
+	{
+		// Adjust for scaling component - becoming Scale*[ZRot*Rot]*Trans
+		TFloat32 scaleSqX = e00*e00 + e01*e01 + e02*e02;
+		TFloat32 scaleSqY = e10*e10 + e11*e11 + e12*e12;
+		GEN_ASSERT_OPT( !IsZero(scaleSqX) && !IsZero(scaleSqY), "Singular matrix" );
+		TFloat32 scaleXY = Sqrt( scaleSqX ) * InvSqrt( scaleSqY );
+
+		TFloat32 sZ, cZ, sZX, sZY;
+		SinCos( z, &sZ, &cZ );
+		sZX = sZ * scaleXY;
+		sZY = sZ / scaleXY;
+
+		TFloat32 t;
+		t   = e00*cZ + e10*sZX;
+		e10 = e10*cZ - e00*sZY;
+		e00 = t;
+		t   = e01*cZ + e11*sZX;
+		e11 = e11*cZ - e01*sZY;
+		e01 = t;
+		t   = e02*cZ + e12*sZX;
+		e12 = e12*cZ - e02*sZY;
+		e02 = t;
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Inverse
+	-----------------------------------------------------------------------------------------*/
+	// Non-member version given after the class definition
+
+	// Set this transform to its inverse
+	void Invert();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Transformation
+	-----------------------------------------------------------------------------------------*/
+
+	// Return the given vector transformed by this transform (pre-multiplication: V' = V*M)
+	// Assuming it is a vector rather then a point, i.e. translation is not applied
+	CVector3 TransformVector( const CVector3& v ) const
+	{
+		return CVector3( v.x*e00 + v.y*e10 + v.z*e20,
+		                 v.x*e01 + v.y*e11 + v.z*e21,
+		                 v.x*e02 + v.y*e12 + v.z*e22 );
+	}
+
+	// Return the given point transformed by this transform (pre-multiplication: V' = V*M)
+	CVector3 TransformPoint( const CVector3& p ) const
+	{
+		return CVector3( p.x*e00 + p.y*e10 + p.z*e20 + e30,
+		                 p.x*e01 + p.y*e11 + p.z*e21 + e31,
+		                 p.x*e02 + p.y*e12 + p.z*e22 + e32 );
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Concatenation
+	-----------------------------------------------------------------------------------------*/
+	// Non-member version given after the class definition
+
+	// Post-multiply this transform by the given one
+	CAffine3x4& operator*=( const CAffine3x4& m );
+
+
+	/*---------------------------------------------------------------------------------------------
+		Data
+	---------------------------------------------------------------------------------------------*/
+
+	// Transform elements - rows are X axis, Y axis, Z axis and position
+	TFloat32 e00, e01, e02;
+	TFloat32 e10, e11, e12;
+	TFloat32 e20, e21, e22;
+	TFloat32 e30, e31, e32;
+
+	// Standard transforms
+	static const CAffine3x4 kIdentity;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member Operations
+-----------------------------------------------------------------------------------------*/
+
+// Concatenate two affine transforms: apply m1 then m2 (same order as CMatrix4x4 m1 * m2)
+CAffine3x4 operator*
+(
+	const CAffine3x4& m1,
+	const CAffine3x4& m2
+);
+
+// Concatenate into an existing transform, mOut = m1 * m2. Avoids returning by value in tight
+// loops such as hierarchy updates. mOut may be one of the inputs
+void Concatenate
+(
+	const CAffine3x4& m1,
+	const CAffine3x4& m2,
+	CAffine3x4&       mOut
+);
+
+// Return the inverse of given affine transform
+CAffine3x4 Inverse( const CAffine3x4& m );
+
+
+} // namespace gen
+
+#endif // GEN_C_AFFINE_3X4_H_INCLUDED
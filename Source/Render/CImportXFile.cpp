@@ -11,22 +11,43 @@
 		V1.0    Created 12/06/06 - LN
 **************************************************************************************************/
 
+#include <math.h>
+#include <string.h>
 #include <algorithm>
 #include <numeric>
+#include <exception>
 using namespace std;
 
-#define INITGUID
-#include <windows.h>
-#include <dxfile.h>
-#include <rmxfguid.h>
-#include <rmxftmpl.h>
-
 #include "Error.h"
+#include "CMappedFile.h"
+#include "CTimer.h"
+#include "CWorkerPool.h"
+#include "MeshSimplify.h"
 #include "CImportXFile.h"
 
 namespace gen
 {
 
+// Minimum total faces in a file before meshes are processed in parallel, below this starting the
+// worker threads costs more than is saved
+const TUInt32 kiMinParallelFaces = 20000;
+
+// Copy a list of X-file faces to sub-mesh faces with 16 or 32-bit vertex indices
+template <class TFace> static void CopySubMeshFaces
+(
+	const TXFileFaces& faces,
+	TFace*             pOutFaces
+)
+{
+	for (TUInt32 iFace = 0; iFace < faces.size(); ++iFace)
+	{
+		pOutFaces[iFace].aiVertex[0] = faces[iFace].aiVertex[0];
+		pOutFaces[iFace].aiVertex[1] = faces[iFace].aiVertex[1];
+		pOutFaces[iFace].aiVertex[2] = faces[iFace].aiVertex[2];
+	}
+}
+
+
 /*-----------------------------------------------------------------------------------------
 	CImportXFile public member functions
 -----------------------------------------------------------------------------------------*/
@@ -65,16 +86,16 @@ bool CImportXFile::IsXFile
 }
 
 	
-// Import a Microsoft X-File into a list of meshes and a frame hierarchy
+// Import a Microsoft X-File into a list of meshes and a frame hierarchy. The options select
+// welding, optimisation and level of detail generation for the sub-meshes
 // Possible return values:
 //		kSuccess:			...
-//		kFileError:			Missing file or not an X-file
+//		kFileError:			Missing file or not a text X-file
 //		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-//		kOutOfSystemMemory:	...
-//		kSystemFailure:		X-file API failure
 EImportError CImportXFile::ImportFile
 (
-	const string& sFileName
+	const string&              sFileName,
+	const SXFileImportOptions& options /*= SXFileImportOptions()*/
 )
 {
 	GEN_GUARD;
@@ -82,48 +103,68 @@ EImportError CImportXFile::ImportFile
 	// Wipe any existing data
 	m_Frames.clear();
 	m_Meshes.clear();
+	m_Materials.clear();
+	m_CacheStats.clear();
+	m_sError.clear();
 	m_bImported = false;
+	m_Options = options;
+	m_Options.numLODs = min( max( m_Options.numLODs, 1u ), kiMaxLODs );
+	m_Times = SXFileImportTimes();
+	m_WeldStats = SXFileWeldStats();
 
 	// Ensure the file is an X-file
 	if (!IsXFile( sFileName ))
 	{
+		m_sError = "Not an X-file";
 		return kFileError;
 	}
 
-	// Create X-File object
-	ID3DXFile* pXFile;
-	EImportError eError = PrepareXFileObject( &pXFile );
-	if (eError != kSuccess)
+	// Map the file into memory, it is parsed directly from the mapped data
+	CMappedFile file;
+	if (!file.Open( sFileName ))
 	{
-		return eError;
+		m_sError = "Cannot open file";
+		return kFileError;
 	}
 
-	// Get X-File enumerator
-	ID3DXFileEnumObject* pXFileEnumer;
-	eError = GetXFileEnumerator( sFileName, pXFile, &pXFileEnumer );
-	if (eError != kSuccess)
+	// Parse X file to create frame hierachy and meshes
+	CTimer timer;
+	CXFileParser parser;
+	EImportError eError = parser.Parse( reinterpret_cast<const char*>(file.GetData()), file.GetSize(),
+	                                    &m_Frames, &m_Meshes );
+	file.Close();
+	m_Times.parseTime = timer.GetLapTime();
+	if (eError == kSuccess)
+	{
+		// Make a single global material list for all meshes
+		MakeGlobalMaterialList();
+
+		// Validate bones and match them to their frames
+		eError = ProcessBones();
+		if (eError != kSuccess)
+		{
+			m_sError = "Skin weights for a missing frame";
+		}
+		m_Times.materialTime = timer.GetLapTime();
+	}
+	else
 	{
-		pXFile->Release();
-		return eError;
+		m_sError = parser.GetError();
 	}
 
-	// Parse X file to create frame hierachy and meshes
-	eError = ParseXFile( pXFileEnumer );
-
-	// Release X-File interfaces
-	pXFileEnumer->Release();
-	pXFile->Release();
-
 	// Check for errors
 	if (eError != kSuccess)
 	{
 		m_Frames.clear();
 		m_Meshes.clear();
+		m_Materials.clear();
 		return eError;
 	}
 
-	// Split into meshes containing only one material each
-	SplitMeshes();
+	// Match normals to vertices, split into meshes containing only one material each and
+	// calculate tangents
+	ProcessMeshes();
+	m_Times.meshTime = timer.GetLapTime();
 
 	// Mark file as loaded
 	m_bImported = true;
@@ -134,6 +175,23 @@ EImportError CImportXFile::ImportFile
 }
 
 
+// Get the vertex cache efficiency of a sub-mesh before and after optimisation. Returns false
+// if the last import was not optimised
+bool CImportXFile::GetSubMeshCacheStats
+(
+	const TUInt32     iSubMesh,
+	SXFileCacheStats* pStats
+) const
+{
+	if (iSubMesh >= m_CacheStats.size())
+	{
+		return false;
+	}
+	*pStats = m_CacheStats[iSubMesh];
+	return true;
+}
+
+
 /////////////////////////////////////
 // Data access
 
@@ -166,7 +224,7 @@ ERenderMethod CImportXFile::GetSubMeshRenderMethod( const TUInt32 iSubMesh ) con
 
 
 // Get the specification and data for given sub-mesh, returned through a pointer. May request
-// tangents to be calculated
+// tangents to be calculated. The faces of any levels of detail follow the full detail faces
 // Possible return values:
 //		kSuccess:			...
 //		kOutOfSystemMemory:	...
@@ -182,26 +240,19 @@ EImportError CImportXFile::GetSubMesh
 	// Set sub-mesh owner node
 	pOutSubMesh->node = m_Meshes[iSubMesh].iParentFrame;
 
-	// Calculate tangents if required
+	// Use the tangents calculated during import if required, or calculate them now if the render
+	// method for the sub-mesh doesn't use them. Tangents need normals and texture coordinates
 	TXFileVectors tangents;
-	pOutSubMesh->hasTangents = bTangents;
-	if (pOutSubMesh->hasTangents)
+	const TXFileVectors* pTangents = &m_Meshes[iSubMesh].tangents;
+	if (bTangents && pTangents->empty())
 	{
-		CalculateTangents( iSubMesh, &tangents );
+		CalculateTangents( m_Meshes[iSubMesh], &tangents );
+		pTangents = &tangents;
 	}
+	pOutSubMesh->hasTangents = bTangents && !pTangents->empty();
 
 	// Find what vertex data there is and calculate total vertex size
-	pOutSubMesh->hasSkinningData = (m_Meshes[iSubMesh].bones.size() > 0);
-	pOutSubMesh->hasNormals = (m_Meshes[iSubMesh].normals.size() > 0);
-	pOutSubMesh->hasTextureCoords = (m_Meshes[iSubMesh].textureCoords.size() > 0);
-	pOutSubMesh->hasVertexColours = (m_Meshes[iSubMesh].vertexColours.size() > 0);
-	pOutSubMesh->vertexSize = sizeof(CVector3) + 
-							  (pOutSubMesh->hasSkinningData ? 4 * sizeof(TFloat32) + sizeof(TUInt32) : 0) +
-	                          (pOutSubMesh->hasNormals ? sizeof(CVector3) : 0) +
-	                          (pOutSubMesh->hasTangents ? sizeof(CVector3) : 0) +
-	                          (pOutSubMesh->hasTextureCoords ? sizeof(SXFileUV) : 0) +
-	                          (pOutSubMesh->hasVertexColours ? sizeof(SXFileRGBAColour) : 0);
-	                          // Skinning data: assuming 4 float weights / 4 byte indices in TUInt32
+	SetVertexLayout( m_Meshes[iSubMesh], pOutSubMesh->hasTangents, pOutSubMesh );
 
 	// Set number of vertices and reserve space for vertex data
 	pOutSubMesh->numVertices = static_cast<TUInt32>(m_Meshes[iSubMesh].vertices.size());
@@ -210,132 +261,48 @@ EImportError CImportXFile::GetSubMesh
 	{
 		return kOutOfSystemMemory;
 	}
+	WriteVertices( m_Meshes[iSubMesh], *pTangents, *pOutSubMesh, pOutSubMesh->vertices );
 
-	// Prefetch relevant vertex list info
-	TXFileVectors::const_iterator itVertex = m_Meshes[iSubMesh].vertices.begin();
-	TXFileVectors::const_iterator itVertexEnd = m_Meshes[iSubMesh].vertices.end();
-	TXFileVectors::const_iterator itNormal = m_Meshes[iSubMesh].normals.begin();
-	TXFileVectors::const_iterator itTangent = tangents.begin();
-	TXFileUVs::const_iterator itTextureCooord = m_Meshes[iSubMesh].textureCoords.begin();
-	TXFileRGBAColours::const_iterator itVertexColour = m_Meshes[iSubMesh].vertexColours.begin();
-
-	// Loop through vertices, add each component present to the raw output stream
-	TUInt8* pVertexData = pOutSubMesh->vertices;
-	while (itVertex != itVertexEnd)
+	// Set the face range of each level of detail, the full detail faces are level 0
+	const SXFileMesh& mesh = m_Meshes[iSubMesh];
+	pOutSubMesh->numFaces = static_cast<TUInt32>(mesh.faces.size());
+	pOutSubMesh->numLODs = 1 + static_cast<TUInt32>(mesh.lodFaces.size());
+	pOutSubMesh->lods[0].firstFace = 0;
+	pOutSubMesh->lods[0].numFaces = pOutSubMesh->numFaces;
+	pOutSubMesh->lods[0].error = 0.0f;
+	for (TUInt32 iLOD = 1; iLOD < pOutSubMesh->numLODs; ++iLOD)
 	{
-		*reinterpret_cast<CVector3*>(pVertexData) = *itVertex++;
-		pVertexData += sizeof(CVector3);
-		if (pOutSubMesh->hasSkinningData)
-		{
-			// Initialise vertex with no influencing bones
-			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
-			pVertexData += sizeof(TFloat32);
-			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
-			pVertexData += sizeof(TFloat32);
-			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
-			pVertexData += sizeof(TFloat32);
-			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
-			pVertexData += sizeof(TFloat32);
-			*reinterpret_cast<TUInt32*>(pVertexData) = 0;
-			pVertexData += sizeof(TUInt32);
-		}
-		if (pOutSubMesh->hasNormals)
-		{
-			*reinterpret_cast<CVector3*>(pVertexData) = *itNormal++;
-			pVertexData += sizeof(CVector3);
-		}
-		if (pOutSubMesh->hasTangents)
-		{
-			*reinterpret_cast<CVector3*>(pVertexData) = *itTangent++;
-			pVertexData += sizeof(CVector3);
-		}
-		if (pOutSubMesh->hasTextureCoords)
-		{
-			*reinterpret_cast<SXFileUV*>(pVertexData) = *itTextureCooord++;
-			pVertexData += sizeof(SXFileUV);
-		}
-		if (pOutSubMesh->hasVertexColours)
-		{
-			*reinterpret_cast<SXFileRGBAColour*>(pVertexData) = *itVertexColour++;
-			pVertexData += sizeof(SXFileRGBAColour);
-		}
+		const SSubMeshLOD& prevLOD = pOutSubMesh->lods[iLOD - 1];
+		pOutSubMesh->lods[iLOD].firstFace = prevLOD.firstFace + prevLOD.numFaces;
+		pOutSubMesh->lods[iLOD].numFaces = static_cast<TUInt32>(mesh.lodFaces[iLOD - 1].size());
+		pOutSubMesh->lods[iLOD].error = mesh.lodErrors[iLOD - 1];
 	}
 
-	// Calculate bone influences if necessary
-	if (pOutSubMesh->hasSkinningData)
-	{
-		// Offsets to bone data in a vertex (data is immediately after vertex coord)
-		TUInt32 boneWeightsOffset = sizeof(CVector3);
-		int boneIndicesOffset = boneWeightsOffset + 4 * sizeof(TFloat32);
+	// Pre-size face array, using 32-bit vertex indices only if there are too many vertices for
+	// 16-bit indices
+	TUInt32 iTotalFaces = SubMeshTotalFaces( *pOutSubMesh );
+	bool bLargeIndices = pOutSubMesh->numVertices > kiMaxSmallIndexVertices;
+	pOutSubMesh->faces = bLargeIndices ? 0 : new SMeshFace[iTotalFaces];
+	pOutSubMesh->largeFaces = bLargeIndices ? new SMeshLargeFace[iTotalFaces] : 0;
 
-		// For each bone...
-		TXFileBones::const_iterator itBone = m_Meshes[iSubMesh].bones.begin();
-		TXFileBones::const_iterator itBoneEnd = m_Meshes[iSubMesh].bones.end();
-		while (itBone != itBoneEnd)
-		{
-			// For each bone weight (influence)...
-			TXFileBoneWeights::const_iterator itBoneWeight = itBone->weights.begin();
-			TXFileBoneWeights::const_iterator itBoneWeightEnd = itBone->weights.end();
-			while (itBoneWeight != itBoneWeightEnd)
-			{
-				// Find affected vertex data - weights and bone indexes
-				TUInt8* pVert = pOutSubMesh->vertices + 
-					itBoneWeight->iVertexIndex * pOutSubMesh->vertexSize;
-				TFloat32* pVertBoneWeights = reinterpret_cast<TFloat32*>(pVert + boneWeightsOffset);
-				TUInt8* pVertBoneIndices = reinterpret_cast<TUInt8*>(pVert + boneIndicesOffset);
+	// Get material from material map (all faces in sub-mesh have the same material at this point)
+	pOutSubMesh->material = mesh.materialMap.front();
 
-				// Add influence of this bone to the vertex data
-				AddBoneInfluence( itBone->iFrame, itBoneWeight->fWeight,
-				                  pVertBoneWeights, pVertBoneIndices );
-				++itBoneWeight;
-			}
-			++itBone;
+	// Loop through the faces of each level outputing to given sub-mesh
+	for (TUInt32 iLOD = 0; iLOD < pOutSubMesh->numLODs; ++iLOD)
+	{
+		const TXFileFaces& faces = (iLOD == 0) ? mesh.faces : mesh.lodFaces[iLOD - 1];
+		TUInt32 iFirstFace = pOutSubMesh->lods[iLOD].firstFace;
+		if (bLargeIndices)
+		{
+			CopySubMeshFaces( faces, pOutSubMesh->largeFaces + iFirstFace );
 		}
-
-		// Normalise vertex bone weights (ensure they add up to 1)
-		TUInt8* pVert = pOutSubMesh->vertices;
-		for (TUInt32 vert = 0; vert < pOutSubMesh->numVertices; ++vert)
+		else
 		{
-			TFloat32* pVertBoneWeights = reinterpret_cast<TFloat32*>(pVert + boneWeightsOffset);
-			TUInt8* pVertBoneIndices = reinterpret_cast<TUInt8*>(pVert + boneIndicesOffset);
-
-			TFloat32 sum = pVertBoneWeights[0] + pVertBoneWeights[1] +
-			               pVertBoneWeights[2] + pVertBoneWeights[3];
-			if (sum == 0.0f)
-			{
-				// Vertex with no weights - reference root bone only (model is probably not skinned)
-				pVertBoneWeights[0] = 1.0f;
-				pVertBoneIndices[0] = pOutSubMesh->node;
-			}
-			else
-			{
-				pVertBoneWeights[0] /= sum;
-				pVertBoneWeights[1] /= sum;
-				pVertBoneWeights[2] /= sum;
-				pVertBoneWeights[3] /= sum;
-			}
-			pVert += pOutSubMesh->vertexSize;
+			CopySubMeshFaces( faces, pOutSubMesh->faces + iFirstFace );
 		}
 	}
 
-	// Pre-size face array
-	pOutSubMesh->numFaces = static_cast<TUInt32>(m_Meshes[iSubMesh].faces.size());
-	pOutSubMesh->faces = new SMeshFace[pOutSubMesh->numFaces];
-
-	// Get material from material map (all faces in sub-mesh have the same material at this point)
-	pOutSubMesh->material = m_Meshes[iSubMesh].materialMap.front();
-
-	// Loop through faces outputing to given sub-mesh
-	TXFileFaces::const_iterator itFace = m_Meshes[iSubMesh].faces.begin();
-	TXFileFaces::const_iterator itFaceEnd = m_Meshes[iSubMesh].faces.end();
-	for (TUInt32 iFace = 0; iFace < pOutSubMesh->numFaces; ++iFace)
-	{
-		pOutSubMesh->faces[iFace].aiVertex[0] = itFace->aiVertex[0];
-		pOutSubMesh->faces[iFace].aiVertex[1] = itFace->aiVertex[1];
-		pOutSubMesh->faces[iFace].aiVertex[2] = itFace->aiVertex[2];
-		++itFace;
-	}
-
 	return kSuccess;
 
 	GEN_ENDGUARD;
@@ -400,1495 +367,313 @@ void CImportXFile::GetMaterial
 
 
 /*-----------------------------------------------------------------------------------------
-	X-File API support
+	Geometry processing
 -----------------------------------------------------------------------------------------*/
 
-// Prepare and return an X-file object
-// Possible return values:
-//		kSuccess:			...
-//		kOutOfSystemMemory:	...
-//		kSystemFailure:		Problem registering X-file templates or other API error
-EImportError CImportXFile::PrepareXFileObject
+// Match the face lists of vertices and normals, so there is exactly one normal per vertex
+// See the comment to SXFileMesh::normalFaces in CXFileParser.h
+void CImportXFile::MatchFaceLists
 (
-	ID3DXFile** ppXFile
+	const TUInt32  iMesh
 )
 {
 	GEN_GUARD;
 
-	HRESULT xFileError = D3DXFileCreate( ppXFile );
-	if (xFileError != S_OK)
+	// Unclutter code with a reference to the mesh 
+	SXFileMesh& mesh = m_Meshes[iMesh];
+
+	if (!mesh.normals.empty())
 	{
-		*ppXFile = 0;
-		switch (xFileError)
-		{
-		case E_OUTOFMEMORY:
-			return kOutOfSystemMemory;
+		// Maximum vertices (and normals) possible is the total number of indices in the original
+		// face lists (if each index was different). Use std library accumulate from <numeric>
+		TUInt32 iMaxVertices = accumulate( mesh.origFaceEdges.begin(), 
+		                                   mesh.origFaceEdges.end(), 0 );
+
+		// Create empty vertex and normal maps - use max vertex value as unused marker
+		TXFileInts vertexMap( iMaxVertices, iMaxVertices );
+		TXFileInts normalMap( iMaxVertices, iMaxVertices );
 
-		case E_POINTER:
-			GEN_ERROR( "Invalid parameter to D3DXFileCreate" );
+		// Table of vertex duplicates created by this process, each entry is next copy of vertex
+		TXFileInts vertexDup( iMaxVertices, iMaxVertices );
 
-		default:
-			return kSystemFailure;
-		}
-	}
+		// May need to duplicate vertices, count from original number of vertices
+		TUInt32 iNewNumVertices = static_cast<TUInt32>(mesh.vertices.size()); 
 
-    // Register templates for d3drm, skinning and patch extensions.
-    xFileError = (*ppXFile)->RegisterTemplates( (void*)D3DRM_XTEMPLATES, D3DRM_XTEMPLATE_BYTES );
-	if (xFileError != S_OK)
-	{
-        (*ppXFile)->Release();
-		*ppXFile = 0;
-		switch (xFileError)
+		// Create vertex and normal mapping tables
+		for (TUInt32 iFace = 0; iFace != mesh.faces.size(); ++iFace)
 		{
-		case D3DXFERR_BADVALUE: 
-			GEN_ERROR( "Invalid parameter to RegisterTemplates" );
+			// Unclutter code with references to current faces (vertex and normal)
+			SXFileFace& vertexFace = mesh.faces[iFace];
+			SXFileFace& normalFace = mesh.normalFaces[iFace];
+
+			// For each face edge
+			for (int i = 0; i < 3; ++i)
+			{
+				// Will try to use vertex face index for the normal face index, if unused then OK
+				if (normalMap[vertexFace.aiVertex[i]] == iMaxVertices) 
+				{
+					// Use the vertex face index for both vertices and normals
+					vertexMap[vertexFace.aiVertex[i]] = vertexFace.aiVertex[i];
+					normalMap[vertexFace.aiVertex[i]] = normalFace.aiVertex[i];
+				}
+				// otherwise the vertex face index has already been used...
+				else
+				{
+					// See if the normal face index is correct for this vertex or the duplicates
+					// already created
+					TUInt32 iVert = vertexFace.aiVertex[i];
+					while (normalMap[iVert] != normalFace.aiVertex[i] &&
+					       vertexDup[iVert] != iMaxVertices)
+					{
+						iVert = vertexDup[iVert];
+					}
+					// Can't find correct normal face index on any of this vertices copies, so
+					// create another copy
+					if (normalMap[iVert] != normalFace.aiVertex[i])
+					{
+						// Add new vertex index
+						vertexMap[iNewNumVertices] = vertexFace.aiVertex[i];
+						normalMap[iNewNumVertices] = normalFace.aiVertex[i];
+						vertexDup[iVert] = iNewNumVertices;
 
-		default:
-			return kSystemFailure;
+						// Update the face indices to point at this new vertex
+						vertexFace.aiVertex[i] = iNewNumVertices;
+						++iNewNumVertices;
+					}
+					else
+					{
+						// Update the face indices to point at appropriate vertex duplicate
+						vertexFace.aiVertex[i] = iVert;
+					}
+				}
+			}
 		}
-    }
 
-    xFileError = (*ppXFile)->RegisterTemplates( (void*)XSKINEXP_TEMPLATES, strlen(XSKINEXP_TEMPLATES) );
-	if (xFileError != S_OK)
-	{
-        (*ppXFile)->Release();
-		switch (xFileError)
+		// Add any required duplicate vertex data (if necessary)
+		TUInt32 iOldNumVertices = static_cast<TUInt32>(mesh.vertices.size());
+		if (iNewNumVertices > iOldNumVertices)
 		{
-		case D3DXFERR_BADVALUE:
-			GEN_ERROR( "Invalid parameter to RegisterTemplates" );
-
-		default:
-			return kSystemFailure;
+			// For every added vertex...
+			for (TUInt32 iVertex = iOldNumVertices; iVertex < iNewNumVertices; ++iVertex)
+			{
+				// Use the vertex map to duplicate the various vertex data
+				mesh.vertices.push_back( mesh.vertices[vertexMap[iVertex]] );
+				if (!mesh.textureCoords.empty())
+				{
+					mesh.textureCoords.push_back( mesh.textureCoords[vertexMap[iVertex]] );
+				}
+				if (!mesh.vertexColours.empty())
+				{
+					mesh.vertexColours.push_back( mesh.vertexColours[vertexMap[iVertex]] );
+				}
+				if (!mesh.duplicateIndices.empty())
+				{
+					mesh.duplicateIndices.push_back( mesh.duplicateIndices[vertexMap[iVertex]] );
+				}
+			}
 		}
-    }
 
-    xFileError = (*ppXFile)->RegisterTemplates( (void*)XEXTENSIONS_TEMPLATES, strlen(XEXTENSIONS_TEMPLATES) );
-	if (xFileError != S_OK)
-	{
-        (*ppXFile)->Release();
-		*ppXFile = 0;
-		switch (xFileError)
+		// Build full updated normal list and replace original normals
+		TXFileVectors newNormals( iNewNumVertices );
+		for (TUInt32 iNormal = 0; iNormal < iNewNumVertices; ++iNormal)
 		{
-		case D3DXFERR_BADVALUE:
-			GEN_ERROR( "Invalid parameter to RegisterTemplates" );
-
-		default:
-			return kInvalidData;
+			newNormals[iNormal] = mesh.normals[normalMap[iNormal]];
 		}
-    }
+		mesh.normals.swap( newNormals );
+	}
 
-	return kSuccess;
+	mesh.origFaceEdges.clear();
+	mesh.normalFaces.clear();
 
 	GEN_ENDGUARD;
 }
 
 
-// Prepare and return an X-file enumerator given a filename and an X-file object
-// Possible return values:
-//		kSuccess:			...
-//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-//		kSystemFailure:		X-file API error
-EImportError CImportXFile::GetXFileEnumerator
-(
-	const string&         sFilename,
-	ID3DXFile*            pXFile,
-	ID3DXFileEnumObject** ppXFileEnumer
-)
+// Create a global list of materials used by all the meshes - removing any duplicates. Also 
+// create a list for each mesh mapping local material indices to global ones
+void CImportXFile::MakeGlobalMaterialList()
 {
 	GEN_GUARD;
 
-	HRESULT xFileError =
-		pXFile->CreateEnumObject( (LPVOID)sFilename.c_str(), DXFILELOAD_FROMFILE, ppXFileEnumer );
-	if (xFileError != S_OK)
+	// Process each mesh
+	for (TUInt32 iMesh = 0; iMesh < m_Meshes.size(); ++iMesh)
 	{
-		switch (xFileError)
+		// Unclutter code with a reference to the mesh 
+		SXFileMesh& mesh = m_Meshes[iMesh];
+		
+		// Initialise material map for this mesh and look through each of its materials
+		mesh.materialMap.resize( mesh.materials.size() );
+		for (TUInt32 iMaterial = 0; iMaterial < mesh.materials.size(); ++iMaterial)
 		{
-		case D3DXFERR_PARSEERROR:
-			return kInvalidData;
-
-		case D3DXFERR_BADVALUE:
-			GEN_ERROR( "Invalid parameter to CreateEnumObject" );
-
-		default:
-			return kSystemFailure;
-		}
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-/*-----------------------------------------------------------------------------------------
-	X-File parsing
------------------------------------------------------------------------------------------*/
-
-// Create a single root frame and parse the X-File to add all the bottom level frames and
-// meshes. Any frames and meshes found will be children of this root frame, child frames are
-// recursively parsed to create a frame hierarchy
-// Possible return values:
-//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-EImportError CImportXFile::ParseXFile
-(
-	ID3DXFileEnumObject* pXFileEnumer
-)
-{
-	GEN_GUARD;
-
-	// Create new root frame
-	m_Frames.push_back( SXFileFrame() );
-
-	// Set root frame values
-	m_Frames[0].sName = "Root";
-	m_Frames[0].iDepth = 0;
-	m_Frames[0].iParentIndex = 0;
-	m_Frames[0].iNumChildren = 0;
-	m_Frames[0].defaultMatrix = CMatrix4x4::kIdentity;
-	m_Frames[0].offsetMatrix = CMatrix4x4::kIdentity;
-
-	// Get number of child objects for the current object
-	TUInt32 iNumChildren;
-	EImportError eError = GetXFileNumChildren( pXFileEnumer, &iNumChildren );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// For each child object
-	for (TUInt32 iChild = 0; iChild < iNumChildren; ++iChild)
-	{
-		// Get child data and ID
-		ID3DXFileData* pChildData;
-		GUID childGUID;
-		eError = GetXFileChild( pXFileEnumer, iChild, &pChildData, &childGUID );
-		if (eError != kSuccess)
-		{
-			return kInvalidData;
-		}
-		
-		// Found child frame
-		if (childGUID == TID_D3DRMFrame)
-		{
-			++m_Frames[0].iNumChildren;
-			eError = ParseXFileFrame( pChildData, 0 );
-		}
-
-		// Found child frame transformation matrix
-		else if (childGUID == TID_D3DRMFrameTransformMatrix)
-		{
-			CMatrix4x4 transMat;
-			TUInt32 iSize = 16 * sizeof(TFloat32);
-			TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Frames[0].defaultMatrix.e00);
-			eError = CopyXFileData( pChildData, pDest, &iSize );
-		}
-
-		// Found child mesh
-		else if (childGUID == TID_D3DRMMesh)
-		{
-			eError = ParseXFileMesh( pChildData, 0 );
-		}
-
-		// Release current child data before moving to the next or quiting on error
-		pChildData->Release();
-
-		// Return any errors found
-		if (eError != kSuccess)
-		{
-			return eError;
-		}
-	}		
-
-	// Make a single global material list for all meshes
-	MakeGlobalMaterialList();
-	
-	// Validate bones and match them to their frames
-	eError = ProcessBones();
-	if (eError != kSuccess)
-	{
-		return eError;
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-// Create a new frame and parse the X-File to add all the contained frames and meshes. Any
-// frames and meshes found will become children of this new frame. Child frames are recursively
-// parsed to create a frame hierarchy
-// Possible return values:
-//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-EImportError CImportXFile::ParseXFileFrame
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iParentFrame
-)
-{
-	GEN_GUARD;
-
-	// Create new frame
-	TUInt32 iCurrFrame = static_cast<TUInt32>(m_Frames.size());
-	m_Frames.push_back( SXFileFrame() );
-
-	// Get name for frame
-	EImportError eError = GetXFileDataName( pXFileData, m_Frames[iCurrFrame].sName );
-	if (eError != kSuccess)
-	{
-		return eError;
-	}
-
-	// Initialise other frame values
-	m_Frames[iCurrFrame].iDepth = m_Frames[iParentFrame].iDepth + 1;
-	m_Frames[iCurrFrame].iParentIndex = iParentFrame;
-	m_Frames[iCurrFrame].iNumChildren = 0;
-	m_Frames[iCurrFrame].defaultMatrix = CMatrix4x4::kIdentity;
-	m_Frames[iCurrFrame].offsetMatrix = CMatrix4x4::kIdentity;
-
-	// Get number of child objects for the current object
-	TUInt32 iNumChildren;
-	eError = GetXFileNumChildren( pXFileData, &iNumChildren );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// For each child object
-	for (TUInt32 iChild = 0; iChild < iNumChildren; ++iChild)
-	{
-		// Get child data and ID
-		ID3DXFileData* pChildData;
-		GUID childGUID;
-		eError = GetXFileChild( pXFileData, iChild, &pChildData, &childGUID );
-		if (eError != kSuccess)
-		{
-			return kInvalidData;
-		}
-		
-		// Found child frame
-		if (childGUID == TID_D3DRMFrame)
-		{
-			++m_Frames[iCurrFrame].iNumChildren;
-			eError = ParseXFileFrame( pChildData, iCurrFrame );
-		}
-
-		// Found child frame transformation matrix
-		else if (childGUID == TID_D3DRMFrameTransformMatrix)
-		{
-			CMatrix4x4 transMat;
-			TUInt32 iSize = 16 * sizeof(TFloat32);
-			TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Frames[iCurrFrame].defaultMatrix.e00);
-			eError = CopyXFileData( pChildData, pDest, &iSize );
-		}
-
-		// Found child mesh
-		else if (childGUID == TID_D3DRMMesh)
-		{
-			eError = ParseXFileMesh( pChildData, iCurrFrame );
-		}
-
-		// Release current child data before moving to the next or quiting on error
-		pChildData->Release();
-
-		// Return any errors found
-		if (eError != kSuccess)
-		{
-			return eError;
-		}
-	}		
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-// Create a new mesh in the given frame and parse its data from the X-File
-EImportError CImportXFile::ParseXFileMesh
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iCurrFrame
-)
-{
-	GEN_GUARD;
-
-	// Create new mesh
-	TUInt32 iCurrMesh = static_cast<TUInt32>(m_Meshes.size());
-	m_Meshes.push_back( SXFileMesh() );
-
-	// Set owner frame
-	m_Meshes[iCurrMesh].iParentFrame = iCurrFrame;
-	m_Meshes[iCurrMesh].iNumUniqueVertices = 0;
-	m_Meshes[iCurrMesh].iMaxBonesPerVertex = 0;
-	m_Meshes[iCurrMesh].iMaxBonesPerFace = 0;
-
-	// Read vertices and faces for the mesh
-	EImportError eError = ReadMeshData( pXFileData, iCurrMesh );
-	if (eError != kSuccess)
-	{
-		return eError;
-	}
-
-	// Counter for bones read from child data objects
-	TUInt32 iCurrBone = 0; 
-
-	// Get number of child objects for the current object
-	TUInt32 iNumChildren;
-	eError = GetXFileNumChildren( pXFileData, &iNumChildren );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// For each child object
-	for (TUInt32 iChild = 0; iChild < iNumChildren; ++iChild)
-	{
-		// Get child data and ID
-		ID3DXFileData* pChildData;
-		GUID childGUID;
-		eError = GetXFileChild( pXFileData, iChild, &pChildData, &childGUID );
-		if (eError != kSuccess)
-		{
-			return kInvalidData;
-		}
-
-		// Found normal data
-		if (childGUID == TID_D3DRMMeshNormals)
-		{
-			eError = ReadNormalData( pChildData, iCurrMesh );
-		}
-
-		// Found texture coordinate data
-		else if (childGUID == TID_D3DRMMeshTextureCoords)
-		{
-			eError = ReadTextureUVData( pChildData, iCurrMesh );
-		}
-
-		// Found vertex colour data
-		else if (childGUID == TID_D3DRMMeshVertexColors)
-		{
-			eError = ReadVertexColourData( pChildData, iCurrMesh );
-		}
-
-		// Found material list
-		else if (childGUID == TID_D3DRMMeshMaterialList)
-		{
-			eError = ReadMaterialData( pChildData, iCurrMesh );
-		}
-
-		// Found vertex duplication list
-		else if (childGUID == DXFILEOBJ_VertexDuplicationIndices)
-		{
-			eError = ReadDuplicationData( pChildData, iCurrMesh );
-		}
-
-		// Found face adjacency data
-		else if (childGUID == DXFILEOBJ_FaceAdjacency)
-		{
-			eError = ReadAdjacencyData( pChildData, iCurrMesh );
-		}
-
-		// Found skinning definition
-		else if (childGUID == DXFILEOBJ_XSkinMeshHeader)
-		{
-			eError = ReadSkinDefnData( pChildData, iCurrMesh );
-		}
-
-		// Found skin weights
-		else if (childGUID == DXFILEOBJ_SkinWeights)
-		{
-			eError = ReadSkinWeightsData( pChildData, iCurrMesh, iCurrBone );
-			++iCurrBone;
-		}
-
-		// Found unknown mesh data
-		else
-		{
-			eError = kSuccess; // Won't flag this as failure though
-		}
-
-		if (eError != kSuccess)
-		{
-			return eError;
+			// See if this material is already in the global list
+			TXFileMaterials::iterator duplicate = find( m_Materials.begin(), m_Materials.end(), 
+														mesh.materials[iMaterial] );
+			
+			// If not found...
+			if (duplicate == m_Materials.end())
+			{
+				// ...add new global material...
+				mesh.materialMap[iMaterial] = static_cast<TUInt32>(m_Materials.size());
+				m_Materials.push_back( mesh.materials[iMaterial] );
+			}
+			else
+			{
+				// ...otherwise refer to existing material
+				mesh.materialMap[iMaterial] =
+					static_cast<TUInt32>(duplicate - m_Materials.begin());
+			}
 		}
-
-		// Release current child data before moving to the next
-		pChildData->Release();
-	}
-
-	// Check if not enough bones
-	if (iCurrBone != m_Meshes[iCurrMesh].bones.size())
-	{
-		return kInvalidData;
 	}
 
-	// Match the face lists of vertices and normals, so there is exactly one normal per vertex
-	MatchFaceLists( iCurrMesh );
-
-	return kSuccess;
-
 	GEN_ENDGUARD;
 }
 
 
 /*-----------------------------------------------------------------------------------------
-	X-File template parsing
+	Vertex data
 -----------------------------------------------------------------------------------------*/
 
-// Read vertex and face data from a mesh template
-EImportError CImportXFile::ReadMeshData
+// Set the vertex components and vertex size of a sub-mesh for the given mesh
+void CImportXFile::SetVertexLayout
 (
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
+	const SXFileMesh& mesh,
+	bool              bTangents,
+	SSubMesh*         pSubMesh
 )
 {
-	GEN_GUARD;
-
-	// Lock mesh data pointer
-	TUInt32 iMeshDataSize = 0;
-	const TUInt8* pMeshDataStart;
-	EImportError eError = LockXFileData( pXFileData, &pMeshDataStart, &iMeshDataSize );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-	const TUInt8* pMeshData = pMeshDataStart;
-
-	// Get vertices
-	TUInt32 iNumVertices;
-	ReadXFileLockedUInt( pMeshData, &iNumVertices );
-	m_Meshes[iMesh].vertices.resize( iNumVertices );
-	for (TUInt32 iVertex = 0; iVertex < iNumVertices; ++iVertex)
-	{
-		TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].vertices[iVertex]);
-		ReadXFileLockedData( pMeshData, pDest, sizeof(CVector3) );
-	}
-
-	// Read faces - they can be general polygons - convert them all to triangles
-	TUInt32 iNumFaces;
-	ReadXFileLockedUInt( pMeshData, &iNumFaces );
-	m_Meshes[iMesh].origFaceEdges.resize( iNumFaces ); // See below
-	for (TUInt32 iFace = 0; iFace < iNumFaces; ++iFace)
-	{
-		TUInt32 iNumEdges;
-		ReadXFileLockedUInt( pMeshData, &iNumEdges );
-
-		// Store original number of edges for normal face validation below
-		m_Meshes[iMesh].origFaceEdges[iFace] = iNumEdges;
-
-		// Read first index of polygon, then use successive pairs of indices to form triangles
-		// with this first one
-		TUInt32 iFirstIndex, iIndexA, iIndexB;
-		ReadXFileLockedUInt( pMeshData, &iFirstIndex );
-		ReadXFileLockedUInt( pMeshData, &iIndexA );
-		for (TUInt32 iEdge = 2; iEdge < iNumEdges; ++iEdge)
-		{
-			ReadXFileLockedUInt( pMeshData, &iIndexB );
-			SXFileFace face = { iFirstIndex, iIndexA, iIndexB };
-			m_Meshes[iMesh].faces.push_back( face );
-			iIndexA = iIndexB;
-		}
-	}
-
-	// Unlock mesh data
-	pXFileData->Unlock();
-
-	// Validate amount of data read
-	if (static_cast<TUInt32>(pMeshData - pMeshDataStart) != iMeshDataSize)
-	{
-		return kInvalidData;
-	}
+	pSubMesh->hasTangents = bTangents;
+	pSubMesh->hasSkinningData = (mesh.bones.size() > 0);
+	pSubMesh->hasNormals = (mesh.normals.size() > 0);
+	pSubMesh->hasTextureCoords = (mesh.textureCoords.size() > 0);
+	pSubMesh->hasVertexColours = (mesh.vertexColours.size() > 0);
+	pSubMesh->vertexSize = sizeof(CVector3) + 
+							  (pSubMesh->hasSkinningData ? 4 * sizeof(TFloat32) + sizeof(TUInt32) : 0) +
+	                          (pSubMesh->hasNormals ? sizeof(CVector3) : 0) +
+	                          (bTangents ? sizeof(CVector3) : 0) +
+	                          (pSubMesh->hasTextureCoords ? sizeof(SXFileUV) : 0) +
+	                          (pSubMesh->hasVertexColours ? sizeof(SXFileRGBAColour) : 0);
+	                          // Skinning data: assuming 4 float weights / 4 byte indices in TUInt32
 
-	return kSuccess;
-	GEN_ENDGUARD;
+	// Vertices are imported uncompressed
+	pSubMesh->compression = 0;
+	pSubMesh->positionOffset = CVector3( 0.0f, 0.0f, 0.0f );
+	pSubMesh->positionScale = CVector3( 1.0f, 1.0f, 1.0f );
 }
 
-
-// Read a normal data mesh template
-EImportError CImportXFile::ReadNormalData
+// Write the interleaved vertex data of a mesh with the layout and node of the given sub-mesh
+void CImportXFile::WriteVertices
 (
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
+	const SXFileMesh&    mesh,
+	const TXFileVectors& tangents,
+	const SSubMesh&      subMesh,
+	TUInt8*              pVertices
 )
 {
 	GEN_GUARD;
 
-	// Only allow one vertex normal list in a mesh
-	if (m_Meshes[iMesh].normals.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get normal data
-	const TUInt8* pNormalData;
-	EImportError eError = LockXFileData( pXFileData, &pNormalData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read normals
-	TUInt32 iNumNormals;
-	ReadXFileLockedUInt( pNormalData, &iNumNormals );
-	m_Meshes[iMesh].normals.resize( iNumNormals );
-	for (TUInt32 iNormal = 0; iNormal < iNumNormals; ++iNormal)
-	{
-		TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].normals[iNormal]);
-		ReadXFileLockedData( pNormalData, pDest, sizeof(CVector3) );
-	}
-
-	// Verify that normal face list matches face list
-	TUInt32 iNumNormalFaces;
-	ReadXFileLockedUInt( pNormalData, &iNumNormalFaces );
-	if (iNumNormalFaces != m_Meshes[iMesh].origFaceEdges.size())
-	{
-		pXFileData->Unlock();
-		return kInvalidData;
-	}
+	// Prefetch relevant vertex list info
+	TXFileVectors::const_iterator itVertex = mesh.vertices.begin();
+	TXFileVectors::const_iterator itVertexEnd = mesh.vertices.end();
+	TXFileVectors::const_iterator itNormal = mesh.normals.begin();
+	TXFileVectors::const_iterator itTangent = tangents.begin();
+	TXFileUVs::const_iterator itTextureCooord = mesh.textureCoords.begin();
+	TXFileRGBAColours::const_iterator itVertexColour = mesh.vertexColours.begin();
 
-	// Read normal faces - they can be general polygons - convert them all to triangles
-	for (TUInt32 iFace = 0; iFace < iNumNormalFaces; ++iFace)
+	// Loop through vertices, add each component present to the raw output stream
+	TUInt8* pVertexData = pVertices;
+	while (itVertex != itVertexEnd)
 	{
-		TUInt32 iNumEdges;
-		ReadXFileLockedUInt( pNormalData, &iNumEdges );
-
-		// Check number of edges against original face data
-		if (iNumEdges != m_Meshes[iMesh].origFaceEdges[iFace])
-		{
-			pXFileData->Unlock();
-			return kInvalidData;
-		}
-
-		// Read first index of polygon, then use successive pairs of indices to form triangles
-		// with this first one
-		TUInt32 iFirstIndex, iIndexA, iIndexB;
-		ReadXFileLockedUInt( pNormalData, &iFirstIndex );
-		ReadXFileLockedUInt( pNormalData, &iIndexA );
-		for (TUInt32 iEdge = 2; iEdge < iNumEdges; ++iEdge)
+		*reinterpret_cast<CVector3*>(pVertexData) = *itVertex++;
+		pVertexData += sizeof(CVector3);
+		if (subMesh.hasSkinningData)
 		{
-			ReadXFileLockedUInt( pNormalData, &iIndexB );
-			SXFileFace face = { iFirstIndex, iIndexA, iIndexB };
-			m_Meshes[iMesh].normalFaces.push_back( face );
-			iIndexA = iIndexB;
-		}
-	}
-
-	// Finished with normal data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read a texture coordinate mesh template
-EImportError CImportXFile::ReadTextureUVData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Only allow one texture coordinate list in a mesh
-	if (m_Meshes[iMesh].textureCoords.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get texture coordinate data
-	const TUInt8* pTexCoordData;
-	EImportError eError = LockXFileData( pXFileData, &pTexCoordData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read texture coordinates
-	TUInt32 iNumTextureCoords;
-	ReadXFileLockedUInt( pTexCoordData, &iNumTextureCoords );
-	if (iNumTextureCoords != m_Meshes[iMesh].vertices.size())
-	{
-		pXFileData->Unlock();
-		return kInvalidData;
-	}
-	m_Meshes[iMesh].textureCoords.resize( iNumTextureCoords );
-	for (TUInt32 iUV = 0; iUV < iNumTextureCoords; ++iUV)
-	{
-		TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].textureCoords[iUV]);
-		ReadXFileLockedData( pTexCoordData, pDest, sizeof(SXFileUV) );
-	}
-
-	// Finished with texture coordinate data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read a vertex colour mesh template, any vertices not assigned a colour will get white
-EImportError CImportXFile::ReadVertexColourData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Only allow one vertex colour list in a mesh
-	if (m_Meshes[iMesh].vertexColours.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get vertex colour data
-	const TUInt8* pVertexColourData;
-	EImportError eError = LockXFileData( pXFileData, &pVertexColourData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read vertex colours
-	TUInt32 iNumVertexColours;
-	ReadXFileLockedUInt( pVertexColourData, &iNumVertexColours );
-
-	// All colours default to white if not assigned
-	// TODO: Could split mesh into sections with and without vertex colours - not worth it?
-	SXFileRGBAColour defaultColour = { 1.0f, 1.0f, 1.0f, 1.0f };
-	m_Meshes[iMesh].vertexColours.resize( iNumVertexColours, defaultColour );
-	for (TUInt32 iColour = 0; iColour < iNumVertexColours; ++iColour)
-	{
-		TUInt32 iVertexIndex;
-		ReadXFileLockedUInt( pVertexColourData, &iVertexIndex );
-		TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].vertexColours[iVertexIndex]);
-		ReadXFileLockedData( pVertexColourData, pDest, sizeof(SXFileRGBAColour) );
-	}
-
-	// Finished with vertex colour data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read a vertex colour mesh template
-EImportError CImportXFile::ReadMaterialData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Only allow one material list in a mesh
-	if (m_Meshes[iMesh].materials.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get material data
-	const TUInt8* pMaterialData;
-	EImportError eError = LockXFileData( pXFileData, &pMaterialData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read number of materials and initialise material list
-	TUInt32 iNumMaterials;
-	ReadXFileLockedUInt( pMaterialData, &iNumMaterials );
-	for (TUInt32 iMaterial = 0; iMaterial < iNumMaterials; ++iMaterial)
-	{
-		SXFileMaterial material = 
-		{
-			"",
-			{ 1.0f, 1.0f, 1.0f, 1.0f },
-			20.0f, { 0.0f, 0.0f, 0.0f },
-			{ 0.0f, 0.0f, 0.0f },
-			""
-		};
-		m_Meshes[iMesh].materials.push_back( material );
-	}
-
-	// Read face materials - matching the original face list before it was split into triangles.
-	// Will convert to match the new (triangle-only) face list
-	TUInt32 iNumFaceMaterials;
-	ReadXFileLockedUInt( pMaterialData, &iNumFaceMaterials );
-
-	// Handle undocumented case with only one face material - all faces use same material
-	if (iNumFaceMaterials == 1 && m_Meshes[iMesh].origFaceEdges.size() != 1)
-	{
-		// Read the single face material
-		TUInt32 iFaceMaterial;
-		ReadXFileLockedUInt( pMaterialData, &iFaceMaterial );
-
-		// Create a full face material list from this value
-		m_Meshes[iMesh].faceMaterials.resize( m_Meshes[iMesh].faces.size(), iFaceMaterial );
-	}
-	else // Read standard face materials - one material reference for each face
-	{
-		if (iNumFaceMaterials != m_Meshes[iMesh].origFaceEdges.size())
-		{
-			pXFileData->Unlock();
-			return kInvalidData;
-		}
-		m_Meshes[iMesh].faceMaterials.resize( m_Meshes[iMesh].faces.size() );
-		TUInt32 iFace = 0;
-		for (TUInt32 iOrigFace = 0; iOrigFace < iNumFaceMaterials; ++iOrigFace)
-		{
-			TUInt32 iMaterial;
-			ReadXFileLockedUInt( pMaterialData, &iMaterial );
-			m_Meshes[iMesh].faceMaterials[iFace] = iMaterial;
-			++iFace;
-			for (TUInt32 iEdge = 3; iEdge < m_Meshes[iMesh].origFaceEdges[iOrigFace]; ++iEdge)
-			{
-				m_Meshes[iMesh].faceMaterials[iFace] = iMaterial;
-				++iFace;
-			}
-		}
-	}
-
-	// Finished with material data
-	pXFileData->Unlock();
-
-
-	// Counter for materials read from optional data objects
-	TUInt32 iMaterialsRead = 0;
-
-	// Get number of child objects for the current object
-	TUInt32 iNumMatListChildren;
-	eError = GetXFileNumChildren( pXFileData, &iNumMatListChildren );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// For each child object
-	for (TUInt32 iMatListChild = 0; iMatListChild < iNumMatListChildren; ++iMatListChild)
-	{
-		// Get child data and ID
-		ID3DXFileData* pMatListChildData;
-		GUID matListChildGUID;
-		eError = GetXFileChild( pXFileData, iMatListChild, &pMatListChildData, &matListChildGUID );
-		if (eError != kSuccess)
-		{
-			return kInvalidData;
-		}
-
-		// Found material in material list
-		if (matListChildGUID == TID_D3DRMMaterial)
-		{
-			// Check if too many materials
-			if (iMaterialsRead >= m_Meshes[iMesh].materials.size())
-			{
-				pMatListChildData->Release();
-				return kInvalidData;
-			}
-
-			// Read material name
-			EImportError eError =
-				GetXFileDataName( pMatListChildData, m_Meshes[iMesh].materials[iMaterialsRead].sName );
-			if (eError != kSuccess)
-			{
-				pMatListChildData->Release();
-				return kInvalidData;
-			}
-
-			// Get material data (11 floats in material template up to optional data)
-			// Fills in all of SXFileMaterial between name & texture name TODO a bit dodgy
-			TUInt32 iSize = 11 * sizeof(TFloat32);
-			TUInt8* pDest = 
-				reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].materials[iMaterialsRead].faceColour);
-			CopyXFileData( pMatListChildData, pDest, &iSize );
-
-
-			// Get number of child objects for the current object
-			TUInt32 iNumMatChildren;
-			eError = GetXFileNumChildren( pMatListChildData, &iNumMatChildren );
-			if (eError != kSuccess)
-			{
-				pMatListChildData->Release();
-				return kInvalidData;
-			}
-
-			// For each child object
-			for (TUInt32 iMatChild = 0; iMatChild < iNumMatChildren; ++iMatChild)
-			{
-				// Get child data and ID
-				ID3DXFileData* pMatChildData;
-				GUID matChildGUID;
-				eError = GetXFileChild( pMatListChildData, iMatChild,
-				                        &pMatChildData, &matChildGUID );
-				if (eError != kSuccess)
-				{
-					pMatListChildData->Release();
-					return kInvalidData;
-				}
-
-				// Found texture filename in material
-				if (matChildGUID == TID_D3DRMTextureFilename)
-				{
-					const TUInt8* pFileNameData;
-					EImportError eError = LockXFileData( pMatChildData, &pFileNameData );
-					if (eError != kSuccess)
-					{
-						pMatChildData->Release();
-						pMatListChildData->Release();
-						return kInvalidData;
-					}
-					m_Meshes[iMesh].materials[iMaterialsRead].sTextureName = 
-						reinterpret_cast<const char*>(pFileNameData);
-					pMatChildData->Unlock();
-				}
-
-				// Found unknown material data
-				else
-				{
-					// Ignore
-				}
-
-				// Release material child data before moving to the next
-				pMatChildData->Release();
-			}
-
-			// Increase nubmer of materials that have been found and read
-			++iMaterialsRead;
-		}
-
-		// Found unknown material list data
-		else
-		{
-			// Ignore
-		}
-
-		// Release material list child data before moving to the next
-		pMatListChildData->Release();
-	}
-
-	// Check if not enough materials
-	if (iMaterialsRead != m_Meshes[iMesh].materials.size())
-	{
-		return kInvalidData;
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read a vertex duplication mesh template
-EImportError CImportXFile::ReadDuplicationData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Only allow one vertex duplication list in a mesh
-	if (m_Meshes[iMesh].duplicateIndices.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get vertex duplication data
-	const TUInt8* pDuplicationData;
-	EImportError eError = LockXFileData( pXFileData, &pDuplicationData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read duplicaton indices, also fetch number of unique vertices
-	TUInt32 iNumDuplicationIndices;
-	ReadXFileLockedUInt( pDuplicationData, &iNumDuplicationIndices );
-	if (iNumDuplicationIndices != m_Meshes[iMesh].vertices.size())
-	{
-		pXFileData->Unlock();
-		return kInvalidData;
-	}
-	ReadXFileLockedUInt( pDuplicationData, &m_Meshes[iMesh].iNumUniqueVertices );
-	m_Meshes[iMesh].duplicateIndices.resize( iNumDuplicationIndices );
-	for (TUInt32 iIndex = 0; iIndex < iNumDuplicationIndices; ++iIndex)
-	{
-		ReadXFileLockedUInt( pDuplicationData, &m_Meshes[iMesh].duplicateIndices[iIndex] );
-	}
-
-	// Finished with vertex duplication data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read a adjacancy data mesh template
-// TODO: Unknown usage
-EImportError CImportXFile::ReadAdjacencyData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Only allow one face adjacency list in a mesh
-	if (m_Meshes[iMesh].adjacencyIndices.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get face adjacency data
-	const TUInt8* pAdjacencyData;
-	EImportError eError = LockXFileData( pXFileData, &pAdjacencyData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read face adjacency list
-	TUInt32 iNumAdjacencyIndices;
-	ReadXFileLockedUInt( pAdjacencyData, &iNumAdjacencyIndices );
-	m_Meshes[iMesh].adjacencyIndices.resize( iNumAdjacencyIndices );
-	for (TUInt32 iIndex = 0; iIndex < iNumAdjacencyIndices; ++iIndex)
-	{
-		ReadXFileLockedUInt( pAdjacencyData, &m_Meshes[iMesh].adjacencyIndices[iIndex] );
-	}
-
-	// Finished with face adjacency data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read skinning header mesh template
-EImportError CImportXFile::ReadSkinDefnData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Only allow one skining definition in a mesh
-	if (m_Meshes[iMesh].bones.size() > 0)
-	{
-		return kInvalidData;
-	}
-
-	// Get skinning definition data
-	const TUInt8* pSkinDefnData;
-	EImportError eError = LockXFileData( pXFileData, &pSkinDefnData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read maximum weights info
-	ReadXFileLockedUInt16( pSkinDefnData, &m_Meshes[iMesh].iMaxBonesPerVertex );
-	ReadXFileLockedUInt16( pSkinDefnData, &m_Meshes[iMesh].iMaxBonesPerFace );
-
-	// Get number of bones used and initialise bone structures
-	TUInt16 iNumBones;
-	ReadXFileLockedUInt16( pSkinDefnData, &iNumBones );
-	for (TUInt32 iBone = 0; iBone < iNumBones; ++iBone)
-	{
-		SXFileBone bone;
-		bone.iFrame = 0;
-		bone.offsetMatrix = CMatrix4x4::kIdentity;
-		m_Meshes[iMesh].bones.push_back( bone );
-	}
-
-	// Finished with skinning definition data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-// Read a skinning weights mesh template
-EImportError CImportXFile::ReadSkinWeightsData
-(
-	ID3DXFileData* pXFileData,
-	const TUInt32  iMesh,
-	const TUInt32  iBone
-)
-{
-	GEN_GUARD;
-
-	// Check if no skinning definition or too many bones
-	if (m_Meshes[iMesh].bones.size() == 0 || iBone >= m_Meshes[iMesh].bones.size())
-	{
-		return kInvalidData;
-	}
-
-	// Get skin weights data
-	const TUInt8* pSkinWeightData;
-	EImportError eError = LockXFileData( pXFileData, &pSkinWeightData );
-	if (eError != kSuccess)
-	{
-		return kInvalidData;
-	}
-
-	// Read name of bone
-	m_Meshes[iMesh].bones[iBone].sFrameName = reinterpret_cast<const char*>(pSkinWeightData);
-	pSkinWeightData += m_Meshes[iMesh].bones[iBone].sFrameName.length() + 1;
-
-	// Read number of weights
-	TUInt32 iNumWeights;
-	ReadXFileLockedUInt( pSkinWeightData, &iNumWeights );
-	m_Meshes[iMesh].bones[iBone].weights.resize( iNumWeights );
-
-	// Read skinning indices, weights and offset matrix
-	for (TUInt32 iIndex = 0; iIndex < iNumWeights; ++iIndex)
-	{
-		ReadXFileLockedUInt( pSkinWeightData,
-		                     &m_Meshes[iMesh].bones[iBone].weights[iIndex].iVertexIndex );
-	}
-
-	for (TUInt32 iWeight = 0; iWeight < iNumWeights; ++iWeight)
-	{
-		TUInt8* pDest = 
-			reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].bones[iBone].weights[iWeight].fWeight);
-		ReadXFileLockedData( pSkinWeightData, pDest, sizeof(TFloat32) );
-	}
-
-	TUInt8* pDest = reinterpret_cast<TUInt8*>(&m_Meshes[iMesh].bones[iBone].offsetMatrix);
-	ReadXFileLockedData( pSkinWeightData, pDest, 16 * sizeof(TFloat32) );
-
-	// Finished with skin weight data
-	pXFileData->Unlock();
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-/*-----------------------------------------------------------------------------------------
-	X-File parsing
------------------------------------------------------------------------------------------*/
-
-EImportError CImportXFile::GetXFileNumChildren
-(
-	ID3DXFileEnumObject* pXFileEnumer, 
-	TUInt32*             iNumChildren
-)
-{
-	GEN_GUARD;
-
-	HRESULT xFileError = pXFileEnumer->GetChildren( reinterpret_cast<DWORD*>(iNumChildren) );
-	if (xFileError != S_OK)
-	{
-		return kInvalidData;
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-EImportError CImportXFile::GetXFileNumChildren
-(
-	ID3DXFileData* pXFileData,
-	TUInt32*       iNumChildren
-)
-{
-	GEN_GUARD;
-
-	HRESULT xFileError = pXFileData->GetChildren( reinterpret_cast<DWORD*>(iNumChildren) );
-	if (xFileError != S_OK)
-	{
-		return kInvalidData;
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-EImportError CImportXFile::GetXFileChild
-(
-	ID3DXFileEnumObject* pXFileEnumer,
-	const TUInt32        iChild, 
-	ID3DXFileData**      ppChildData, 
-	GUID*                pChildGUID
-)
-{
-	GEN_GUARD;
-
-	HRESULT xFileError = pXFileEnumer->GetChild( iChild, ppChildData );
-	if (xFileError != S_OK)
-	{
-		GEN_ASSERT( xFileError != D3DXFERR_NOMOREOBJECTS, "Invalid child ID" );
-		return kInvalidData;
-	}
-
-	xFileError = (*ppChildData)->GetType( pChildGUID );
-	GEN_ASSERT( xFileError == S_OK, "Failure getting X-File GUID" );
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-EImportError CImportXFile::GetXFileChild
-(
-	ID3DXFileData*  pXFileData,
-	const TUInt32   iChild, 
-	ID3DXFileData** ppChildData, 
-	GUID*           pChildGUID
-)
-{
-	GEN_GUARD;
-
-	HRESULT xFileError = pXFileData->GetChild( iChild, ppChildData );
-	if (xFileError != S_OK)
-	{
-		GEN_ASSERT( xFileError != D3DXFERR_NOMOREOBJECTS, "Invalid child ID" );
-		return kInvalidData;
-	}
-
-	xFileError = (*ppChildData)->GetType( pChildGUID );
-	GEN_ASSERT( xFileError == S_OK, "Failure getting X-File GUID" );
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-EImportError CImportXFile::GetXFileDataName
-(
-	ID3DXFileData* pXFileData,
-	string&        sName
-)
-{
-	GEN_GUARD;
-
-	DWORD iDataSize;
-	HRESULT xFileError = pXFileData->GetName( NULL, &iDataSize );
-	if (!iDataSize)
-	{
-		sName = "";
-	}
-	else
-	{
-		char* szName = new char[iDataSize];
-		if (!szName)
-		{
-			return kOutOfSystemMemory;
-		}
-		xFileError = pXFileData->GetName( szName, &iDataSize );
-		GEN_ASSERT( xFileError == S_OK, "Failure getting X-File name" );
-		sName = szName;
-		delete[] szName;
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-
-EImportError CImportXFile::LockXFileData
-(
-	ID3DXFileData* pXFileData,
-    const TUInt8** ppLockData,
-    TUInt32*       pSize /*= 0*/
-)
-{
-	GEN_GUARD;
- 
-	DWORD iActualSize;
-	HRESULT xFileError = 
-		pXFileData->Lock( &iActualSize, reinterpret_cast<const void**>(ppLockData) );
-	GEN_ASSERT( xFileError == S_OK, "Unexpected failure in Lock" );
-	if (pSize)
-	{
-		if (*pSize != 0 && *pSize != iActualSize)
-		{
-			pXFileData->Unlock();
-			return kInvalidData;
-		}
-		*pSize = iActualSize;
-	}
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-void CImportXFile::UnlockXFileData
-(
-	ID3DXFileData* pXFileData
-)
-{
-	GEN_GUARD;
- 
-	pXFileData->Unlock();
-
-	GEN_ENDGUARD;
-}
-
-
-EImportError CImportXFile::CopyXFileData
-(
-	ID3DXFileData* pXFileData,
-    TUInt8*        pDest,
-    TUInt32*       pSize
-)
-{
-	GEN_GUARD;
- 
-	const TUInt8* pLockData;
-	EImportError eError = LockXFileData( pXFileData, &pLockData, pSize );
-	if (eError != kSuccess)
-	{
-		return eError;
-	}
-	memcpy( pDest, pLockData, *pSize );
-	UnlockXFileData( pXFileData );
-
-	return kSuccess;
-
-	GEN_ENDGUARD;
-}
-
-void CImportXFile::ReadXFileLockedData
-(
-	const TUInt8*& pMeshData,
-	TUInt8*        pDest,
-	const TUInt32  iSize
-)
-{
-	GEN_GUARD;
- 
-	memcpy( pDest, pMeshData, iSize );
-	pMeshData += iSize;
-
-	GEN_ENDGUARD;
-}
-
-void CImportXFile::ReadXFileLockedUInt
-(
-	const TUInt8*& pMeshData,
-	TUInt32*       piDest
-)
-{
-	GEN_GUARD;
- 
-	memcpy( piDest, pMeshData, 4 );
-	pMeshData += 4;
-
-	GEN_ENDGUARD;
-}
-
-void CImportXFile::ReadXFileLockedUInt16
-(
-	const TUInt8*& pMeshData,
-	TUInt16*       piDest
-)
-{
-	GEN_GUARD;
- 
-	memcpy( piDest, pMeshData, 2 );
-	pMeshData += 2;
-
-	GEN_ENDGUARD;
-}
-
-
-/*-----------------------------------------------------------------------------------------
-	X-file type support
------------------------------------------------------------------------------------------*/
-
-// Equality operator for SXFileMaterial structure (needed for searching material lists)
-bool operator==
-(
-	const CImportXFile::SXFileMaterial& cmp1,
-	const CImportXFile::SXFileMaterial& cmp2
-)
-{
-	return cmp1.faceColour.fRed == cmp2.faceColour.fRed &&
-	       cmp1.faceColour.fGreen == cmp2.faceColour.fGreen &&
-	       cmp1.faceColour.fBlue == cmp2.faceColour.fBlue &&
-	       cmp1.faceColour.fAlpha == cmp2.faceColour.fAlpha &&
-	       cmp1.fSpecularPower == cmp2.fSpecularPower &&
-	       cmp1.specularColour.fRed == cmp2.specularColour.fRed &&
-	       cmp1.specularColour.fGreen == cmp2.specularColour.fGreen &&
-	       cmp1.specularColour.fBlue == cmp2.specularColour.fBlue &&
-	       cmp1.emmisiveColour.fRed == cmp2.emmisiveColour.fRed &&
-	       cmp1.emmisiveColour.fGreen == cmp2.emmisiveColour.fGreen &&
-	       cmp1.emmisiveColour.fBlue == cmp2.emmisiveColour.fBlue &&
-		   cmp1.sTextureName == cmp2.sTextureName;
-}
-
-
-/*-----------------------------------------------------------------------------------------
-	Geometry processing
------------------------------------------------------------------------------------------*/
-
-// Match the face lists of vertices and normals, so there is exactly one normal per vertex
-// See the comment to SXFileMesh::normalFaces in the header file
-void CImportXFile::MatchFaceLists
-(
-	const TUInt32  iMesh
-)
-{
-	GEN_GUARD;
-
-	// Unclutter code with a reference to the mesh 
-	SXFileMesh& mesh = m_Meshes[iMesh];
-
-	if (!mesh.normals.empty())
-	{
-		// Maximum vertices (and normals) possible is the total number of indices in the original
-		// face lists (if each index was different). Use std library accumulate from <numeric>
-		TUInt32 iMaxVertices = accumulate( mesh.origFaceEdges.begin(), 
-		                                   mesh.origFaceEdges.end(), 0 );
-
-		// Create empty vertex and normal maps - use max vertex value as unused marker
-		TXFileInts vertexMap( iMaxVertices, iMaxVertices );
-		TXFileInts normalMap( iMaxVertices, iMaxVertices );
-
-		// Table of vertex duplicates created by this process, each entry is next copy of vertex
-		TXFileInts vertexDup( iMaxVertices, iMaxVertices );
-
-		// May need to duplicate vertices, count from original number of vertices
-		TUInt32 iNewNumVertices = static_cast<TUInt32>(mesh.vertices.size()); 
-
-		// Create vertex and normal mapping tables
-		for (TUInt32 iFace = 0; iFace != mesh.faces.size(); ++iFace)
-		{
-			// Unclutter code with references to current faces (vertex and normal)
-			SXFileFace& vertexFace = mesh.faces[iFace];
-			SXFileFace& normalFace = mesh.normalFaces[iFace];
-
-			// For each face edge
-			for (int i = 0; i < 3; ++i)
-			{
-				// Will try to use vertex face index for the normal face index, if unused then OK
-				if (normalMap[vertexFace.aiVertex[i]] == iMaxVertices) 
-				{
-					// Use the vertex face index for both vertices and normals
-					vertexMap[vertexFace.aiVertex[i]] = vertexFace.aiVertex[i];
-					normalMap[vertexFace.aiVertex[i]] = normalFace.aiVertex[i];
-				}
-				// otherwise the vertex face index has already been used...
-				else
-				{
-					// See if the normal face index is correct for this vertex or the duplicates
-					// already created
-					TUInt32 iVert = vertexFace.aiVertex[i];
-					while (normalMap[iVert] != normalFace.aiVertex[i] &&
-					       vertexDup[iVert] != iMaxVertices)
-					{
-						iVert = vertexDup[iVert];
-					}
-					// Can't find correct normal face index on any of this vertices copies, so
-					// create another copy
-					if (normalMap[iVert] != normalFace.aiVertex[i])
-					{
-						// Add new vertex index
-						vertexMap[iNewNumVertices] = vertexFace.aiVertex[i];
-						normalMap[iNewNumVertices] = normalFace.aiVertex[i];
-						vertexDup[iVert] = iNewNumVertices;
-
-						// Update the face indices to point at this new vertex
-						vertexFace.aiVertex[i] = iNewNumVertices;
-						++iNewNumVertices;
-					}
-					else
-					{
-						// Update the face indices to point at appropriate vertex duplicate
-						vertexFace.aiVertex[i] = iVert;
-					}
-				}
-			}
-		}
-
-		// Add any required duplicate vertex data (if necessary)
-		TUInt32 iOldNumVertices = static_cast<TUInt32>(mesh.vertices.size());
-		if (iNewNumVertices > iOldNumVertices)
-		{
-			// For every added vertex...
-			for (TUInt32 iVertex = iOldNumVertices; iVertex < iNewNumVertices; ++iVertex)
-			{
-				// Use the vertex map to duplicate the various vertex data
-				mesh.vertices.push_back( mesh.vertices[vertexMap[iVertex]] );
-				if (!mesh.textureCoords.empty())
-				{
-					mesh.textureCoords.push_back( mesh.textureCoords[vertexMap[iVertex]] );
-				}
-				if (!mesh.vertexColours.empty())
-				{
-					mesh.vertexColours.push_back( mesh.vertexColours[vertexMap[iVertex]] );
-				}
-				if (!mesh.duplicateIndices.empty())
-				{
-					mesh.duplicateIndices.push_back( mesh.duplicateIndices[vertexMap[iVertex]] );
-				}
-			}
+			// Initialise vertex with no influencing bones
+			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
+			pVertexData += sizeof(TFloat32);
+			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
+			pVertexData += sizeof(TFloat32);
+			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
+			pVertexData += sizeof(TFloat32);
+			*reinterpret_cast<TFloat32*>(pVertexData) = 0.0f;
+			pVertexData += sizeof(TFloat32);
+			*reinterpret_cast<TUInt32*>(pVertexData) = 0;
+			pVertexData += sizeof(TUInt32);
 		}
-
-		// Build full updated normal list and replace original normals
-		TXFileVectors newNormals( iNewNumVertices );
-		for (TUInt32 iNormal = 0; iNormal < iNewNumVertices; ++iNormal)
+		if (subMesh.hasNormals)
 		{
-			newNormals[iNormal] = mesh.normals[normalMap[iNormal]];
+			*reinterpret_cast<CVector3*>(pVertexData) = *itNormal++;
+			pVertexData += sizeof(CVector3);
+		}
+		if (subMesh.hasTangents)
+		{
+			*reinterpret_cast<CVector3*>(pVertexData) = *itTangent++;
+			pVertexData += sizeof(CVector3);
+		}
+		if (subMesh.hasTextureCoords)
+		{
+			*reinterpret_cast<SXFileUV*>(pVertexData) = *itTextureCooord++;
+			pVertexData += sizeof(SXFileUV);
+		}
+		if (subMesh.hasVertexColours)
+		{
+			*reinterpret_cast<SXFileRGBAColour*>(pVertexData) = *itVertexColour++;
+			pVertexData += sizeof(SXFileRGBAColour);
 		}
-		mesh.normals.swap( newNormals );
 	}
 
-	mesh.origFaceEdges.clear();
-	mesh.normalFaces.clear();
-
-	GEN_ENDGUARD;
-}
+	// Calculate bone influences if necessary
+	if (subMesh.hasSkinningData)
+	{
+		// Offsets to bone data in a vertex (data is immediately after vertex coord)
+		TUInt32 boneWeightsOffset = sizeof(CVector3);
+		int boneIndicesOffset = boneWeightsOffset + 4 * sizeof(TFloat32);
 
+		// For each bone...
+		TXFileBones::const_iterator itBone = mesh.bones.begin();
+		TXFileBones::const_iterator itBoneEnd = mesh.bones.end();
+		while (itBone != itBoneEnd)
+		{
+			// For each bone weight (influence)...
+			TXFileBoneWeights::const_iterator itBoneWeight = itBone->weights.begin();
+			TXFileBoneWeights::const_iterator itBoneWeightEnd = itBone->weights.end();
+			while (itBoneWeight != itBoneWeightEnd)
+			{
+				// Find affected vertex data - weights and bone indexes
+				TUInt8* pVert = pVertices + itBoneWeight->iVertexIndex * subMesh.vertexSize;
+				TFloat32* pVertBoneWeights = reinterpret_cast<TFloat32*>(pVert + boneWeightsOffset);
+				TUInt8* pVertBoneIndices = reinterpret_cast<TUInt8*>(pVert + boneIndicesOffset);
 
-// Create a global list of materials used by all the meshes - removing any duplicates. Also 
-// create a list for each mesh mapping local material indices to global ones
-void CImportXFile::MakeGlobalMaterialList()
-{
-	GEN_GUARD;
+				// Add influence of this bone to the vertex data
+				AddBoneInfluence( itBone->iFrame, itBoneWeight->fWeight,
+				                  pVertBoneWeights, pVertBoneIndices );
+				++itBoneWeight;
+			}
+			++itBone;
+		}
 
-	// Process each mesh
-	for (TUInt32 iMesh = 0; iMesh < m_Meshes.size(); ++iMesh)
-	{
-		// Unclutter code with a reference to the mesh 
-		SXFileMesh& mesh = m_Meshes[iMesh];
-		
-		// Initialise material map for this mesh and look through each of its materials
-		mesh.materialMap.resize( mesh.materials.size() );
-		for (TUInt32 iMaterial = 0; iMaterial < mesh.materials.size(); ++iMaterial)
+		// Normalise vertex bone weights (ensure they add up to 1)
+		TUInt8* pVert = pVertices;
+		for (TUInt32 vert = 0; vert < mesh.vertices.size(); ++vert)
 		{
-			// See if this material is already in the global list
-			TXFileMaterials::iterator duplicate = find( m_Materials.begin(), m_Materials.end(), 
-														mesh.materials[iMaterial] );
-			
-			// If not found...
-			if (duplicate == m_Materials.end())
+			TFloat32* pVertBoneWeights = reinterpret_cast<TFloat32*>(pVert + boneWeightsOffset);
+			TUInt8* pVertBoneIndices = reinterpret_cast<TUInt8*>(pVert + boneIndicesOffset);
+
+			TFloat32 sum = pVertBoneWeights[0] + pVertBoneWeights[1] +
+			               pVertBoneWeights[2] + pVertBoneWeights[3];
+			if (sum == 0.0f)
 			{
-				// ...add new global material...
-				mesh.materialMap[iMaterial] = static_cast<TUInt32>(m_Materials.size());
-				m_Materials.push_back( mesh.materials[iMaterial] );
+				// Vertex with no weights - reference root bone only (model is probably not skinned)
+				pVertBoneWeights[0] = 1.0f;
+				pVertBoneIndices[0] = subMesh.node;
 			}
 			else
 			{
-				// ...otherwise refer to existing material
-				mesh.materialMap[iMaterial] =
-					static_cast<TUInt32>(duplicate - m_Materials.begin());
+				pVertBoneWeights[0] /= sum;
+				pVertBoneWeights[1] /= sum;
+				pVertBoneWeights[2] /= sum;
+				pVertBoneWeights[3] /= sum;
 			}
+			pVert += subMesh.vertexSize;
 		}
 	}
 
@@ -1984,99 +769,526 @@ EImportError CImportXFile::ProcessBones()
 	Mesh processing
 -----------------------------------------------------------------------------------------*/
 
-// Split each mesh into a set of meshes - each of which contains only a single material
-void CImportXFile::SplitMeshes()
+// Match normals, split each mesh into a set of meshes - each of which contains only a single
+// material - and calculate tangents where needed. Meshes are processed in parallel
+void CImportXFile::ProcessMeshes()
 {
 	GEN_GUARD;
 
-	TUInt32 iNumOrigMeshes = static_cast<TUInt32>(m_Meshes.size());
-	for (TUInt32 iMesh = 0; iMesh < iNumOrigMeshes; ++iMesh)
+	// Each mesh is processed into its own list of split meshes, with its own phase times
+	TUInt32 iNumMeshes = static_cast<TUInt32>(m_Meshes.size());
+	vector<TXFileMeshes> subMeshes( iNumMeshes );
+	vector< vector<SXFileCacheStats> > cacheStats( iNumMeshes );
+	vector<SXFileWeldStats> weldStats( iNumMeshes, SXFileWeldStats() );
+	vector<SXFileImportTimes> meshTimes( iNumMeshes, SXFileImportTimes() );
+
+	TUInt32 iNumFaces = 0;
+	for (TUInt32 iMesh = 0; iMesh < iNumMeshes; ++iMesh)
 	{
-		TUInt32 iMaxVertices = static_cast<TUInt32>(m_Meshes[iMesh].vertices.size());
+		iNumFaces += static_cast<TUInt32>(m_Meshes[iMesh].faces.size());
+	}
 
-		for (TUInt32 iMaterial = 0; iMaterial < m_Meshes[iMesh].materials.size(); ++iMaterial)
+	m_Times.numThreads = 1;
+	TUInt32 iMaxThreads = min( iNumMeshes, thread::hardware_concurrency() );
+	if (iMaxThreads > 1 && iNumFaces >= kiMinParallelFaces)
+	{
+		// Jobs only touch their own mesh and outputs. Exceptions cannot leave a worker thread, so
+		// they are stored and the first one rethrown here
+		vector<exception_ptr> errors( iNumMeshes );
 		{
-			SXFileMesh newMesh;
-			newMesh.iParentFrame = m_Meshes[iMesh].iParentFrame;
-			newMesh.materials.push_back( m_Meshes[iMesh].materials[iMaterial] );
-			newMesh.materialMap.push_back( m_Meshes[iMesh].materialMap[iMaterial] );
-
-			TXFileInts vertexMap( iMaxVertices, iMaxVertices );
-
-			for (TUInt32 iFace = 0; iFace < m_Meshes[iMesh].faceMaterials.size(); ++iFace)
+			CWorkerPool pool( iMaxThreads );
+			m_Times.numThreads = pool.GetNumThreads();
+			for (TUInt32 iMesh = 0; iMesh < iNumMeshes; ++iMesh)
 			{
-				if (m_Meshes[iMesh].faceMaterials[iFace] == iMaterial)
+				pool.AddJob( [this, iMesh, &subMeshes, &cacheStats, &weldStats, &meshTimes, &errors]()
 				{
-					newMesh.faceMaterials.push_back( 0 );
-					SXFileFace newFace;
-					for (TUInt32 iIndex = 0; iIndex < 3; ++iIndex)
+					try
+					{
+						ProcessMesh( iMesh, &subMeshes[iMesh], &cacheStats[iMesh], &weldStats[iMesh],
+						             &meshTimes[iMesh] );
+					}
+					catch (...)
 					{
-						TUInt32 iVert = m_Meshes[iMesh].faces[iFace].aiVertex[iIndex];
-						if (vertexMap[iVert] == iMaxVertices)
-						{
-							vertexMap[iVert] = static_cast<TUInt32>(newMesh.vertices.size());
-							newMesh.vertices.push_back( m_Meshes[iMesh].vertices[iVert] );
-							if (m_Meshes[iMesh].normals.size() > 0)
-							{
-								newMesh.normals.push_back( m_Meshes[iMesh].normals[iVert] );
-							}
-							if (m_Meshes[iMesh].textureCoords.size() > 0)
-							{
-								newMesh.textureCoords.push_back( m_Meshes[iMesh].textureCoords[iVert] );
-							}
-							if (m_Meshes[iMesh].vertexColours.size() > 0)
-							{
-								newMesh.vertexColours.push_back( m_Meshes[iMesh].vertexColours[iVert] );
-							}
-						}
-						newFace.aiVertex[iIndex] = vertexMap[iVert];
+						errors[iMesh] = current_exception();
 					}
-					newMesh.faces.push_back( newFace );
+				});
+			}
+			pool.Wait();
+		}
+		for (TUInt32 iMesh = 0; iMesh < iNumMeshes; ++iMesh)
+		{
+			if (errors[iMesh])
+			{
+				rethrow_exception( errors[iMesh] );
+			}
+		}
+	}
+	else
+	{
+		for (TUInt32 iMesh = 0; iMesh < iNumMeshes; ++iMesh)
+		{
+			ProcessMesh( iMesh, &subMeshes[iMesh], &cacheStats[iMesh], &weldStats[iMesh], &meshTimes[iMesh] );
+		}
+	}
+
+	// Replace the original meshes with the split meshes, keeping them in the same order, and
+	// total the phase times and welding statistics
+	TUInt32 iNumSubMeshes = 0;
+	for (TUInt32 iMesh = 0; iMesh < iNumMeshes; ++iMesh)
+	{
+		iNumSubMeshes += static_cast<TUInt32>(subMeshes[iMesh].size());
+		m_Times.normalTime += meshTimes[iMesh].normalTime;
+		m_Times.splitTime += meshTimes[iMesh].splitTime;
+		m_Times.weldTime += meshTimes[iMesh].weldTime;
+		m_Times.optimiseTime += meshTimes[iMesh].optimiseTime;
+		m_Times.lodTime += meshTimes[iMesh].lodTime;
+		m_Times.tangentTime += meshTimes[iMesh].tangentTime;
+		m_WeldStats.originalVertices += weldStats[iMesh].originalVertices;
+		m_WeldStats.weldedVertices += weldStats[iMesh].weldedVertices;
+		m_WeldStats.originalBytes += weldStats[iMesh].originalBytes;
+		m_WeldStats.weldedBytes += weldStats[iMesh].weldedBytes;
+	}
+	TXFileMeshes newMeshes;
+	newMeshes.reserve( iNumSubMeshes );
+	for (TUInt32 iMesh = 0; iMesh < iNumMeshes; ++iMesh)
+	{
+		for (TUInt32 iSubMesh = 0; iSubMesh < subMeshes[iMesh].size(); ++iSubMesh)
+		{
+			newMeshes.push_back( move( subMeshes[iMesh][iSubMesh] ) );
+		}
+		m_CacheStats.insert( m_CacheStats.end(), cacheStats[iMesh].begin(), cacheStats[iMesh].end() );
+	}
+	m_Meshes.swap( newMeshes );
+
+	GEN_ENDGUARD;
+}
+
+
+// Process a single mesh for ProcessMeshes, the split meshes are added to the given list along
+// with their cache statistics if optimising. Adds the time taken by each phase and the
+// welding statistics to the given structures
+void CImportXFile::ProcessMesh
+(
+	const TUInt32             iMesh,
+	TXFileMeshes*             pSubMeshes,
+	vector<SXFileCacheStats>* pCacheStats,
+	SXFileWeldStats*          pWeldStats,
+	SXFileImportTimes*        pTimes
+)
+{
+	GEN_GUARD;
+
+	CTimer timer;
+
+	// Match the face lists of vertices and normals, so there is exactly one normal per vertex
+	MatchFaceLists( iMesh );
+	pTimes->normalTime += timer.GetLapTime();
+
+	// Split into meshes containing only one material each, the original mesh is no longer needed
+	SplitMesh( m_Meshes[iMesh], pSubMeshes );
+	m_Meshes[iMesh] = SXFileMesh();
+	pTimes->splitTime += timer.GetLapTime();
+
+	// Weld identical vertices of the split meshes, before reordering so the optimisation sees the
+	// shared vertices
+	if (m_Options.weld)
+	{
+		for (TUInt32 iSubMesh = 0; iSubMesh < pSubMeshes->size(); ++iSubMesh)
+		{
+			SXFileMesh& subMesh = (*pSubMeshes)[iSubMesh];
+			WeldMesh( &subMesh, MeshUsesTangents( subMesh ), m_Options.weldEpsilon, pWeldStats );
+		}
+		pTimes->weldTime += timer.GetLapTime();
+	}
+
+	// Reorder triangles and vertices of the split meshes, before tangents as they are per-vertex
+	if (m_Options.optimise)
+	{
+		pCacheStats->resize( pSubMeshes->size() );
+		for (TUInt32 iSubMesh = 0; iSubMesh < pSubMeshes->size(); ++iSubMesh)
+		{
+			OptimiseMesh( &(*pSubMeshes)[iSubMesh], &(*pCacheStats)[iSubMesh] );
+		}
+		pTimes->optimiseTime += timer.GetLapTime();
+	}
+
+	// Generate levels of detail from the final full detail faces. They use the same vertices, so
+	// this must follow the vertex reordering
+	if (m_Options.numLODs > 1)
+	{
+		for (TUInt32 iSubMesh = 0; iSubMesh < pSubMeshes->size(); ++iSubMesh)
+		{
+			GenerateLODs( &(*pSubMeshes)[iSubMesh], m_Options.numLODs, m_Options.lodReduction,
+			              m_Options.lodMaxError );
+		}
+		pTimes->lodTime += timer.GetLapTime();
+	}
+
+	// Calculate tangents for the split meshes whose render method uses them
+	for (TUInt32 iSubMesh = 0; iSubMesh < pSubMeshes->size(); ++iSubMesh)
+	{
+		SXFileMesh& subMesh = (*pSubMeshes)[iSubMesh];
+		if (MeshUsesTangents( subMesh ))
+		{
+			CalculateTangents( subMesh, &subMesh.tangents );
+		}
+	}
+	pTimes->tangentTime += timer.GetLapTime();
+
+	GEN_ENDGUARD;
+}
+
+
+// Split a mesh into a set of meshes, each of which contains only a single material, added to
+// the given list. The faces are bucketed by material with a counting sort, then each new mesh
+// is built from its own faces with preallocated face and vertex lists. The faces and vertices
+// keep their original relative order
+void CImportXFile::SplitMesh
+(
+	const SXFileMesh& mesh,
+	TXFileMeshes*     pSubMeshes
+) const
+{
+	GEN_GUARD;
+
+	TUInt32 iNumMaterials = static_cast<TUInt32>(mesh.materials.size());
+	TUInt32 iNumFaces = static_cast<TUInt32>(mesh.faceMaterials.size());
+	TUInt32 iNumVertices = static_cast<TUInt32>(mesh.vertices.size());
+
+	// Count the faces using each material, then convert the counts to the start of each
+	// material's faces in a list of face indices sorted by material
+	TXFileInts materialStart( iNumMaterials + 1, 0 );
+	for (TUInt32 iFace = 0; iFace < iNumFaces; ++iFace)
+	{
+		++materialStart[mesh.faceMaterials[iFace] + 1];
+	}
+	for (TUInt32 iMaterial = 0; iMaterial < iNumMaterials; ++iMaterial)
+	{
+		materialStart[iMaterial + 1] += materialStart[iMaterial];
+	}
+	TXFileInts sortedFaces( iNumFaces );
+	TXFileInts insertPos( materialStart.begin(), materialStart.end() - 1 );
+	for (TUInt32 iFace = 0; iFace < iNumFaces; ++iFace)
+	{
+		sortedFaces[insertPos[mesh.faceMaterials[iFace]]++] = iFace;
+	}
+
+	// Map from original to new vertex index, only valid where the vertex material is the one
+	// currently being processed, so the map doesn't need clearing for each material
+	TXFileInts vertexMap( iNumVertices );
+	TXFileInts vertexMaterial( iNumVertices, iNumMaterials );
+	TXFileInts usedVertices;
+	usedVertices.reserve( iNumVertices );
+
+	for (TUInt32 iMaterial = 0; iMaterial < iNumMaterials; ++iMaterial)
+	{
+		TUInt32 iFirstFace = materialStart[iMaterial];
+		TUInt32 iNumNewFaces = materialStart[iMaterial + 1] - iFirstFace;
+		if (iNumNewFaces == 0)
+		{
+			continue;
+		}
+
+		pSubMeshes->push_back( SXFileMesh() );
+		SXFileMesh& newMesh = pSubMeshes->back();
+		newMesh.iParentFrame = mesh.iParentFrame;
+		newMesh.materials.push_back( mesh.materials[iMaterial] );
+		newMesh.materialMap.push_back( mesh.materialMap[iMaterial] );
+		newMesh.faces.resize( iNumNewFaces );
+		newMesh.faceMaterials.resize( iNumNewFaces, 0 );
+
+		// Renumber the vertices used by this material's faces in the order they are first used
+		usedVertices.clear();
+		for (TUInt32 iFace = 0; iFace < iNumNewFaces; ++iFace)
+		{
+			const SXFileFace& face = mesh.faces[sortedFaces[iFirstFace + iFace]];
+			SXFileFace& newFace = newMesh.faces[iFace];
+			for (TUInt32 iIndex = 0; iIndex < 3; ++iIndex)
+			{
+				TUInt32 iVert = face.aiVertex[iIndex];
+				if (vertexMaterial[iVert] != iMaterial)
+				{
+					vertexMaterial[iVert] = iMaterial;
+					vertexMap[iVert] = static_cast<TUInt32>(usedVertices.size());
+					usedVertices.push_back( iVert );
+				}
+				newFace.aiVertex[iIndex] = vertexMap[iVert];
+			}
+		}
+
+		// Copy the data for the vertices used
+		TUInt32 iNumNewVertices = static_cast<TUInt32>(usedVertices.size());
+		newMesh.vertices.resize( iNumNewVertices );
+		for (TUInt32 iVert = 0; iVert < iNumNewVertices; ++iVert)
+		{
+			newMesh.vertices[iVert] = mesh.vertices[usedVertices[iVert]];
+		}
+		if (!mesh.normals.empty())
+		{
+			newMesh.normals.resize( iNumNewVertices );
+			for (TUInt32 iVert = 0; iVert < iNumNewVertices; ++iVert)
+			{
+				newMesh.normals[iVert] = mesh.normals[usedVertices[iVert]];
+			}
+		}
+		if (!mesh.textureCoords.empty())
+		{
+			newMesh.textureCoords.resize( iNumNewVertices );
+			for (TUInt32 iVert = 0; iVert < iNumNewVertices; ++iVert)
+			{
+				newMesh.textureCoords[iVert] = mesh.textureCoords[usedVertices[iVert]];
+			}
+		}
+		if (!mesh.vertexColours.empty())
+		{
+			newMesh.vertexColours.resize( iNumNewVertices );
+			for (TUInt32 iVert = 0; iVert < iNumNewVertices; ++iVert)
+			{
+				newMesh.vertexColours[iVert] = mesh.vertexColours[usedVertices[iVert]];
+			}
+		}
+	}
+
+	GEN_ENDGUARD;
+}
+
+
+// Return whether the render method of a split mesh uses tangents
+bool CImportXFile::MeshUsesTangents
+(
+	const SXFileMesh& mesh
+)
+{
+	const SXFileMaterial& material = mesh.materials.front();
+	return RenderMethodUsesTangents( RenderMethodFromMaterial( material.sName, material.sTextureName ) );
+}
+
+
+// Weld the vertices of a split mesh whose final vertex data is identical, or with an epsilon
+// greater than 0 whose components round to the same multiple of the epsilon. The vertex data is
+// built as GetSubMesh does, without tangents as they are calculated later from the welded mesh.
+// Adds to the given statistics, sizes include tangents if requested
+void CImportXFile::WeldMesh
+(
+	SXFileMesh*      pMesh,
+	bool             bTangents,
+	TFloat32         fEpsilon,
+	SXFileWeldStats* pStats
+)
+{
+	GEN_GUARD;
+
+	SSubMesh layout;
+	layout.node = pMesh->iParentFrame;
+	SetVertexLayout( *pMesh, false, &layout );
+	TUInt32 iNumVertices = static_cast<TUInt32>(pMesh->vertices.size());
+	TUInt32 iVertexWords = layout.vertexSize / sizeof(TUInt32);
+	if (iNumVertices == 0)
+	{
+		return;
+	}
+	TXFileInts vertexData( iNumVertices * iVertexWords );
+	WriteVertices( *pMesh, TXFileVectors(), layout, reinterpret_cast<TUInt8*>(&vertexData[0]) );
+
+	// Snap every float to the nearest multiple of the epsilon so nearby values become identical.
+	// The bone indices are packed bytes rather than a float (after the position and 4 weights)
+	if (fEpsilon > 0.0f)
+	{
+		TUInt32 iBoneIndexWord = layout.hasSkinningData ? 7 : iVertexWords;
+		for (TUInt32 iWord = 0; iWord < vertexData.size(); ++iWord)
+		{
+			if (iWord % iVertexWords != iBoneIndexWord)
+			{
+				TFloat32* pValue = reinterpret_cast<TFloat32*>(&vertexData[iWord]);
+				*pValue = floorf( *pValue / fEpsilon + 0.5f ) * fEpsilon;
+				if (*pValue == 0.0f)
+				{
+					*pValue = 0.0f; // Don't distinguish -0
 				}
 			}
-			if (newMesh.vertices.size() > 0)
+		}
+	}
+
+	TXFileInts remap;
+	TUInt32 iNumWelded = WeldVertices( &vertexData[0], iNumVertices, iVertexWords, &remap );
+	TUInt32 iVertexSize = layout.vertexSize + (bTangents ? sizeof(CVector3) : 0);
+	pStats->originalVertices += iNumVertices;
+	pStats->weldedVertices += iNumWelded;
+	pStats->originalBytes += iNumVertices * iVertexSize;
+	pStats->weldedBytes += iNumWelded * iVertexSize;
+	if (iNumWelded == iNumVertices)
+	{
+		return;
+	}
+
+	// Renumber the faces and compact the vertex data, keeping the first of each welded vertex
+	for (TUInt32 iFace = 0; iFace < pMesh->faces.size(); ++iFace)
+	{
+		for (TUInt32 iIndex = 0; iIndex < 3; ++iIndex)
+		{
+			pMesh->faces[iFace].aiVertex[iIndex] = remap[pMesh->faces[iFace].aiVertex[iIndex]];
+		}
+	}
+	WeldVertexData( &pMesh->vertices, remap, iNumWelded );
+	WeldVertexData( &pMesh->normals, remap, iNumWelded );
+	WeldVertexData( &pMesh->textureCoords, remap, iNumWelded );
+	WeldVertexData( &pMesh->vertexColours, remap, iNumWelded );
+
+	// Bone weights of the removed vertices are dropped, the kept vertex has the same influences
+	if (!pMesh->bones.empty())
+	{
+		TXFileInts keptVertex( iNumWelded );
+		for (TUInt32 iVertex = iNumVertices; iVertex-- > 0;)
+		{
+			keptVertex[remap[iVertex]] = iVertex;
+		}
+		for (TUInt32 iBone = 0; iBone < pMesh->bones.size(); ++iBone)
+		{
+			TXFileBoneWeights& weights = pMesh->bones[iBone].weights;
+			TUInt32 iNumKept = 0;
+			for (TUInt32 iWeight = 0; iWeight < weights.size(); ++iWeight)
 			{
-				m_Meshes.push_back( newMesh );
+				TUInt32 iVertex = weights[iWeight].iVertexIndex;
+				if (keptVertex[remap[iVertex]] == iVertex)
+				{
+					weights[iNumKept] = weights[iWeight];
+					weights[iNumKept++].iVertexIndex = remap[iVertex];
+				}
 			}
+			weights.resize( iNumKept );
 		}
 	}
-	m_Meshes.erase( m_Meshes.begin(), m_Meshes.begin() + iNumOrigMeshes );
 
 	GEN_ENDGUARD;
 }
 
 
+// Reorder the triangles of a mesh for the vertex cache, then its vertices into the order the
+// triangles use them. Returns the cache efficiency before and after
+void CImportXFile::OptimiseMesh
+(
+	SXFileMesh*       pMesh,
+	SXFileCacheStats* pStats
+)
+{
+	// The faces are a packed list of indices, three per triangle
+	static_assert( sizeof(SXFileFace) == 3 * sizeof(TUInt32), "SXFileFace must be three packed indices" );
+	TUInt32 iNumFaces = static_cast<TUInt32>(pMesh->faces.size());
+	TUInt32 iNumVertices = static_cast<TUInt32>(pMesh->vertices.size());
+	if (iNumFaces == 0)
+	{
+		pStats->original = pStats->optimised = AnalyseVertexCache( 0, 0, iNumVertices );
+		return;
+	}
+	TUInt32* pIndices = pMesh->faces[0].aiVertex;
+
+	pStats->original = AnalyseVertexCache( pIndices, iNumFaces, iNumVertices );
+	OptimiseVertexCache( pIndices, iNumFaces, iNumVertices );
+
+	TXFileInts remap;
+	OptimiseVertexFetch( pIndices, iNumFaces, iNumVertices, &remap );
+	RemapVertices( &pMesh->vertices, remap );
+	RemapVertices( &pMesh->normals, remap );
+	RemapVertices( &pMesh->textureCoords, remap );
+	RemapVertices( &pMesh->vertexColours, remap );
+	pStats->optimised = AnalyseVertexCache( pIndices, iNumFaces, iNumVertices );
+}
+
+
+// Generate simplified levels of detail for a mesh, up to the given number of levels in total
+// including the full detail level. Each level is simplified from the full detail faces, so
+// errors don't accumulate, then reordered for the vertex cache
+void CImportXFile::GenerateLODs
+(
+	SXFileMesh* pMesh,
+	TUInt32     iNumLODs,
+	TFloat32    fReduction,
+	TFloat32    fMaxError
+)
+{
+	pMesh->lodFaces.clear();
+	pMesh->lodErrors.clear();
+	TUInt32 iNumFaces = static_cast<TUInt32>(pMesh->faces.size());
+	TUInt32 iNumVertices = static_cast<TUInt32>(pMesh->vertices.size());
+	if (iNumFaces == 0)
+	{
+		return;
+	}
+
+	// The allowed error is relative to the largest dimension of the mesh
+	CVector3 minBounds = pMesh->vertices[0];
+	CVector3 maxBounds = pMesh->vertices[0];
+	for (TUInt32 iVertex = 1; iVertex < iNumVertices; ++iVertex)
+	{
+		const CVector3& vertex = pMesh->vertices[iVertex];
+		minBounds.x = min( minBounds.x, vertex.x );
+		minBounds.y = min( minBounds.y, vertex.y );
+		minBounds.z = min( minBounds.z, vertex.z );
+		maxBounds.x = max( maxBounds.x, vertex.x );
+		maxBounds.y = max( maxBounds.y, vertex.y );
+		maxBounds.z = max( maxBounds.z, vertex.z );
+	}
+	CVector3 extent = maxBounds - minBounds;
+	TFloat32 fMaxDistance = fMaxError * max( extent.x, max( extent.y, extent.z ) );
+
+	// A level is only kept if it is clearly smaller than the previous one, otherwise there is
+	// little to gain from switching to it and no further level will be either
+	const TFloat32 kfMinLODReduction = 0.75f;
+	const TUInt32* pIndices = pMesh->faces[0].aiVertex;
+	TUInt32 iPrevFaces = iNumFaces;
+	vector<TUInt32> lodIndices;
+	for (TUInt32 iLOD = 1; iLOD < iNumLODs; ++iLOD)
+	{
+		TUInt32 iTargetFaces = static_cast<TUInt32>(iPrevFaces * fReduction);
+		TFloat32 fError;
+		SimplifyMesh( pIndices, iNumFaces, &pMesh->vertices[0], iNumVertices, iTargetFaces,
+		              fMaxDistance, &lodIndices, &fError );
+		TUInt32 iLODFaces = static_cast<TUInt32>(lodIndices.size() / 3);
+		if (iLODFaces == 0 || iLODFaces > iPrevFaces * kfMinLODReduction)
+		{
+			break;
+		}
+		OptimiseVertexCache( &lodIndices[0], iLODFaces, iNumVertices );
+
+		pMesh->lodFaces.push_back( TXFileFaces( iLODFaces ) );
+		copy( lodIndices.begin(), lodIndices.end(), pMesh->lodFaces.back()[0].aiVertex );
+		pMesh->lodErrors.push_back( fError );
+		iPrevFaces = iLODFaces;
+	}
+}
+
+
 // Create a list of tangent vectors for the given mesh. The tangent vector is the direction of
 // a vertex's texture U axis in model-space. Returns true on success
 bool CImportXFile::CalculateTangents
 (
-	TUInt32 iMesh,
-	TXFileVectors* pTangents
-) const
+	const SXFileMesh& mesh,
+	TXFileVectors*    pTangents
+)
 {
 	// Normals and UVs are required for tangent calculation
-	if (!m_Meshes[iMesh].normals.size() || !m_Meshes[iMesh].textureCoords.size())
+	if (!mesh.normals.size() || !mesh.textureCoords.size())
 	{
 		return false;
 	}
 
 	pTangents->clear();
-	pTangents->resize( m_Meshes[iMesh].vertices.size(), CVector3::kOrigin );
+	pTangents->resize( mesh.vertices.size(), CVector3::kOrigin );
 
 	// Step through faces
-	for (TUInt32 iFace = 0; iFace < m_Meshes[iMesh].faces.size(); ++iFace)
+	for (TUInt32 iFace = 0; iFace < mesh.faces.size(); ++iFace)
 	{
-		int i1 = m_Meshes[iMesh].faces[iFace].aiVertex[0];
-		int i2 = m_Meshes[iMesh].faces[iFace].aiVertex[1];
-		int i3 = m_Meshes[iMesh].faces[iFace].aiVertex[2];
+		int i1 = mesh.faces[iFace].aiVertex[0];
+		int i2 = mesh.faces[iFace].aiVertex[1];
+		int i3 = mesh.faces[iFace].aiVertex[2];
 
-		CVector3 v1 = m_Meshes[iMesh].vertices[i1];
-		CVector3 v2 = m_Meshes[iMesh].vertices[i2];
-		CVector3 v3 = m_Meshes[iMesh].vertices[i3];
+		CVector3 v1 = mesh.vertices[i1];
+		CVector3 v2 = mesh.vertices[i2];
+		CVector3 v3 = mesh.vertices[i3];
 
-		SXFileUV uv1 = m_Meshes[iMesh].textureCoords[i1];
-		SXFileUV uv2 = m_Meshes[iMesh].textureCoords[i2];
-		SXFileUV uv3 = m_Meshes[iMesh].textureCoords[i3];
+		SXFileUV uv1 = mesh.textureCoords[i1];
+		SXFileUV uv2 = mesh.textureCoords[i2];
+		SXFileUV uv3 = mesh.textureCoords[i3];
 
 		CVector3 edge1 = v2 - v1;
 		CVector3 edge2 = v3 - v1;
@@ -2103,11 +1315,11 @@ bool CImportXFile::CalculateTangents
 	}
 
 	// Orthogonalise normals and tangents
-	for (TUInt32 iVert = 0; iVert < m_Meshes[iMesh].vertices.size(); ++iVert)
+	for (TUInt32 iVert = 0; iVert < mesh.vertices.size(); ++iVert)
 	{
 		// Gram-Schmidt orthogonalize
-		TFloat32 dot = Dot( m_Meshes[iMesh].normals[iVert], (*pTangents)[iVert] );
-		(*pTangents)[iVert] -= dot * m_Meshes[iMesh].normals[iVert];
+		TFloat32 dot = Dot( mesh.normals[iVert], (*pTangents)[iVert] );
+		(*pTangents)[iVert] -= dot * mesh.normals[iVert];
 		(*pTangents)[iVert].Normalise();
 	}
 
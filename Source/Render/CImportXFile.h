@@ -15,27 +15,79 @@
 #define GEN_C_IMPORT_XFILE_H_INCLUDED
 
 #include <vector>
+#include <string>
 using namespace std;
-#include <d3d9.h>
-#include <d3dx9.h>
 
 #include "CVector3.h"
 #include "CMatrix4x4.h"
-#include "Mesh.h"
+#include "MeshData.h"
+#include "CXFileParser.h"
+#include "MeshOptimise.h"
 
 namespace gen
 {
 
-// List of errors returned from import functions
-enum EImportError
+// Processing applied to the sub-meshes of an imported X-file, all off by default
+struct SXFileImportOptions
 {
-	kSuccess           = 0,
-	kSystemFailure     = 1,
-	kOutOfSystemMemory = 2,
-	kFileError         = 3,
-	kInvalidData       = 4,
+	// Reorder the triangles and vertices of each sub-mesh for vertex cache and fetch efficiency
+	bool     optimise;
+
+	// Weld vertices of each sub-mesh with identical vertex data, or with an epsilon greater than
+	// 0 vertices whose components all round to the same multiple of the epsilon
+	bool     weld;
+	TFloat32 weldEpsilon;
+
+	// Number of levels of detail to generate for each sub-mesh, including the full detail level
+	// (1 for none, up to kiMaxLODs). Each level aims for lodReduction times the triangles of the
+	// previous one, without moving the surface further than lodMaxError times the size of the
+	// sub-mesh. Levels that can't be reduced much further are dropped
+	TUInt32  numLODs;
+	TFloat32 lodReduction;
+	TFloat32 lodMaxError;
+
+	SXFileImportOptions()
+	{
+		optimise = false;
+		weld = false;
+		weldEpsilon = 0.0f;
+		numLODs = 1;
+		lodReduction = 0.5f;
+		lodMaxError = 0.05f;
+	}
 };
 
+// Time taken by each phase of an import, in seconds. The per-mesh phases run in parallel across
+// meshes, so their times are totals over all meshes and may add up to more than meshTime
+struct SXFileImportTimes
+{
+	TFloat32 parseTime;    // Reading the file into frames and meshes
+	TFloat32 materialTime; // Global material list and matching bones to frames
+	TFloat32 meshTime;     // Elapsed time for all the per-mesh phases below
+	TFloat32 normalTime;   // Matching normal and vertex face lists
+	TFloat32 splitTime;    // Splitting meshes by material
+	TFloat32 weldTime;     // Welding identical vertices, if requested
+	TFloat32 optimiseTime; // Reordering triangles and vertices, if requested
+	TFloat32 lodTime;      // Generating levels of detail, if requested
+	TFloat32 tangentTime;  // Calculating tangents
+	TUInt32  numThreads;   // Threads used for the per-mesh phases
+};
+
+// Vertex count and size of the vertex data over all sub-meshes before and after welding
+struct SXFileWeldStats
+{
+	TUInt32 originalVertices;
+	TUInt32 weldedVertices;
+	TUInt32 originalBytes;
+	TUInt32 weldedBytes;
+};
+
+// Vertex cache efficiency of a sub-mesh before and after reordering its triangles and vertices
+struct SXFileCacheStats
+{
+	SVertexCacheStats original;
+	SVertexCacheStats optimised;
+};
 
 class CImportXFile
 {
@@ -49,6 +101,8 @@ public:
 	CImportXFile()
 	{
 		m_bImported = false;
+		m_Times = SXFileImportTimes();
+		m_WeldStats = SXFileWeldStats();
 	}
 
 private:
@@ -71,18 +125,46 @@ public:
 		return m_bImported;
 	}
 
-	// Import a Microsoft X-File into a list of meshes and a frame hierarchy
+	// Import a Microsoft X-File into a list of meshes and a frame hierarchy. The options select
+	// welding, optimisation and level of detail generation for the sub-meshes
 	// Possible return values:
 	//		kSuccess:			...
-	//		kFileError:			Missing file or not an X-file
+	//		kFileError:			Missing file or not a text X-file
 	//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-	//		kOutOfSystemMemory:	...
-	//		kSystemFailure:		X-file API failure
 	EImportError ImportFile
 	(
-		const string& sXName
+		const string&              sXName,
+		const SXFileImportOptions& options = SXFileImportOptions()
 	);
 
+	// Return a description of the last import error, including the line in the file for
+	// invalid data
+	const string& GetError() const
+	{
+		return m_sError;
+	}
+
+	// Return the time taken by each phase of the last import
+	const SXFileImportTimes& GetImportTimes() const
+	{
+		return m_Times;
+	}
+
+	// Return the vertex count and data size before and after welding in the last import, the
+	// sizes include tangents for sub-meshes whose render method uses them
+	const SXFileWeldStats& GetWeldStats() const
+	{
+		return m_WeldStats;
+	}
+
+	// Get the vertex cache efficiency of a sub-mesh before and after optimisation. Returns false
+	// if the last import was not optimised
+	bool GetSubMeshCacheStats
+	(
+		const TUInt32     iSubMesh,
+		SXFileCacheStats* pStats
+	) const;
+
 
 	/////////////////////////////////////
 	// Data access
@@ -111,7 +193,9 @@ public:
 	ERenderMethod GetSubMeshRenderMethod( const TUInt32 iSubMesh ) const;
 		
 	// Get the specification and data for given submesh, returned through a pointer. May request
-	// tangents to be calculated
+	// tangents, which are calculated during import for sub-meshes whose render method uses them.
+	// The faces of any levels of detail follow the full detail faces. Faces use 16-bit vertex
+	// indices, or 32-bit (largeFaces) if the sub-mesh has too many vertices for them
 	// Possible return values:
 	//		kSuccess:			...
 	//		kOutOfSystemMemory:	...
@@ -163,415 +247,122 @@ public:
 private:
 
 	/////////////////////////////////////
-	// X-File types
-
-	// Container types used
-	typedef vector<TUInt32>  TXFileInts;
-	typedef vector<CVector3> TXFileVectors;
-
-	// Single face in an X-file - three vertex indices (will convert all faces to triangles)
-	struct SXFileFace
-	{
-		TUInt32 aiVertex[3];
-	};
-	typedef vector<SXFileFace> TXFileFaces;
-
-
-	// 2D texture coordinate in an X-file
-	struct SXFileUV
-	{
-		TFloat32 fU;
-		TFloat32 fV;
-	};
-	typedef vector<SXFileUV> TXFileUVs;
-
-
-	// RGB colour used in structures below
-	struct SXFileRGBColour
-	{
-		TFloat32 fRed;
-		TFloat32 fGreen;
-		TFloat32 fBlue;
-	};
-
-	// RGBA colour used in structures below
-	struct SXFileRGBAColour
-	{
-		TFloat32 fRed;
-		TFloat32 fGreen;
-		TFloat32 fBlue;
-		TFloat32 fAlpha;
-	};
-	typedef vector<SXFileRGBAColour> TXFileRGBAColours;
-
-
-	// Material used in an X-file, material name, diffuse, specular and emmisive colours and a
-	// single (diffuse) texture
-	struct SXFileMaterial
-	{
-		string           sName;
-		SXFileRGBAColour faceColour;
-		TFloat32         fSpecularPower;
-		SXFileRGBColour  specularColour;
-		SXFileRGBColour  emmisiveColour;
-		string           sTextureName;
-	};
-	typedef vector<SXFileMaterial> TXFileMaterials;
-
-	// Equality operator for SXFileMaterial structure (needed for searching material lists)
-	friend bool operator==
-	(
-		const SXFileMaterial& cmp1,
-		const SXFileMaterial& cmp2
-	);
-
-
-	// Single bone weight as used in the bone structure below, contains the index of the affected
-	// vertex and the weight that the bone applies to that vertex
-	struct SXFileBoneWeight
-	{
-		TUInt32  iVertexIndex;
-		TFloat32 fWeight;
-	};
-	typedef vector<SXFileBoneWeight> TXFileBoneWeights;
-
-	// Bone structure in an X-file
-	struct SXFileBone
-	{
-		// Container types used
-
-		string            sFrameName;   // Name of the frame that drives this bone
-		TUInt32           iFrame;       // Index of the frame that drives this bone
-		TXFileBoneWeights weights;
-		CMatrix4x4        offsetMatrix; // TODO: Would like aligned matrices - but vector can't do it
-
-	};
-	typedef vector<SXFileBone>       TXFileBones;
-
-
-	// Frame in an X-file hierarchy
-	struct SXFileFrame
-	{
-		string     sName;
-		TUInt32    iDepth;
-		TUInt32    iParentIndex;
-		TUInt32    iNumChildren;
-		CMatrix4x4 defaultMatrix; // TODO: Would like aligned matrices - but vector can't do it
-		CMatrix4x4 offsetMatrix;
-	};
-	typedef vector<SXFileFrame> TXFileFrames;
-
-
-	// A single mesh in an X-File
-	struct SXFileMesh
-	{
-		// Index of frame that holds this mesh
-		TUInt32           iParentFrame;
-
-		// Vertex data - lists of vertices, normals, texture coords (UVs) and colours. Vertex list
-		// is always present. The normal list may initially be a different length than the vertex
-		// list (see below), but the importer will adjust the data duplication to match them. 
-		// The vertex colours will be duplicated in a similar manner. The texture coord list must
-		// be same length as vertices unless empty
-		TXFileVectors     vertices;
-		TXFileVectors     normals; 
-		TXFileUVs         textureCoords; // Same number of texture cooords as vertices
-		TXFileRGBAColours vertexColours;
-
-		// Face data - each face is a triple of vertex indices representing a triangle (X-files may
-		// contain larger polygons, these are converted into triangles in this implementation).
-		// The face material list identifies the material used for each face, this list must be the
-		// same length as the face list, except for a special case of just one entry - meaning that
-		// all faces use the same material
-		TXFileFaces       faces;
-		TXFileInts        faceMaterials;
-
-		// The faces are converted to triangles - but the number of edges on each of the original
-		// faces is stored to help work with the normal face list and material list (each of which
-		// match the original face list)
-		TXFileInts        origFaceEdges;
-
-		// The original normal faces should match faces in terms of numbers of edges (see above).
-		// However, their indices may be different, especially if the normal duplication is not
-		// the same as that for vertices across faces (e.g. a cube with sharp edges has 8 vertices,
-		// but 6 normals - so the face indices would differ). The importer will remove these
-		// differences so there is exactly one normal for each vertex making the two face lists
-		// become identical
-		TXFileFaces       normalFaces;
-
-		// List of materials used in the face data above
-		TXFileMaterials   materials;
-
-		// Map from material indexes in the list above to material indexes in the global material
-		// list CImportXFile::m_Materials
-		TXFileInts        materialMap;
-
-		// Adjacency data - usage unknown - TODO
-		TXFileInts        adjacencyIndices;
-
-		// Vertex duplication list - a per-vertex list of integers - each one the index of the 
-		// vertex that this one is a duplicate of (i.e. in an identical position). This list must
-		// be the same length as the vertex list or empty. Duplication occurs from a need to have
-		// different normals, colours or UVs on different faces using the same vertex. The set of
-		// unique vertices are identified by having a duplication index referencing themselves.
-		// The total unique vertices is also stored here
-		TUInt32           iNumUniqueVertices;
-		TXFileInts        duplicateIndices;
-
-		// List of bones affecting this mesh, also stored is the maximum bones affecting a single
-		// vertex / face in this mesh
-		TUInt16           iMaxBonesPerVertex;
-		TUInt16           iMaxBonesPerFace;
-		TXFileBones       bones;
-	};
-	typedef vector<SXFileMesh> TXFileMeshes;
-
-
-	/////////////////////////////////////
-	// X-File API support
+	// Geometry processing
 
-	// Prepare and return an X-file object
-	// Possible return values:
-	//		kSuccess:			...
-	//		kOutOfSystemMemory:	...
-	//		kSystemFailure:		Problem registering X-file templates or other API error
-	EImportError PrepareXFileObject
+	// Match the face lists of vertices and normals, so there is exactly one normal per vertex
+	// See the comment to SXFileMesh::normalFaces in CXFileParser.h
+	void MatchFaceLists
 	(
-		ID3DXFile** ppXFile
+		const TUInt32  iMesh
 	);
 
-	// Prepare and return an X-file enumerator given a filename and an X-file object
-	// Possible return values:
-	//		kSuccess:			...
-	//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-	//		kSystemFailure:		X-file API error
-	EImportError GetXFileEnumerator
-	(
-		const string&         sFilename,
-		ID3DXFile*            pXFile,
-		ID3DXFileEnumObject** ppXFileEnumer
-	);
+	// Create a global list of materials used by all the meshes - removing any duplicates. Also 
+	// create a list for each mesh mapping local material indices to global ones
+	void MakeGlobalMaterialList();
 
 
 	/////////////////////////////////////
-	// X-File parsing
+	// Vertex data
 
-	// Create a single root frame and parse the X-File to add all the bottom level frames and
-	// meshes. Any frames and meshes found will be children of this root frame, child frames are
-	// recursively parsed to create a frame hierarchy
-	// Possible return values:
-	//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-	EImportError ParseXFile
+	// Set the vertex components and vertex size of a sub-mesh for the given mesh
+	static void SetVertexLayout
 	(
-		ID3DXFileEnumObject* pXFileEnumer
+		const SXFileMesh& mesh,
+		bool              bTangents,
+		SSubMesh*         pSubMesh
 	);
 
-	// Create a new frame and parse the X-File to add all the contained frames and meshes. Any
-	// frames and meshes found will become children of this new frame. Child frames are recursively
-	// parsed to create a frame hierarchy
-	// Possible return values:
-	//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
-	EImportError ParseXFileFrame
+	// Write the interleaved vertex data of a mesh with the layout and node of the given sub-mesh
+	static void WriteVertices
 	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iParentFrame
-	);
-
-
-	// X-File parsing - collect mesh data
-	EImportError ParseXFileMesh
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iCurrFrame
+		const SXFileMesh&    mesh,
+		const TXFileVectors& tangents,
+		const SSubMesh&      subMesh,
+		TUInt8*              pVertices
 	);
 
 
 	/////////////////////////////////////
-	// X-File template parsing
-
-	// Read vertex and face data from a mesh template
-	EImportError ReadMeshData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
-
-	// Read a normal data mesh template
-	EImportError ReadNormalData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
-
-	// Read a texture coordinate mesh template
-	EImportError ReadTextureUVData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
-
-	// Read a vertex colour mesh template
-	EImportError ReadVertexColourData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
-
-	// Read a vertex colour mesh template
-	EImportError ReadMaterialData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
-
-	// Read a vertex duplication mesh template
-	EImportError ReadDuplicationData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
-
-	// Read a adjacancy data mesh template
-	EImportError ReadAdjacencyData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
+	// Bone support functions
 
-	// Read skinning header mesh template
-	EImportError ReadSkinDefnData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh
-	);
+	// Add new bone weight/index to a vertex - maximum of 4, removes least signficant if necessary
+	static void AddBoneInfluence( TUInt32 bone, TFloat32 weight,
+	                              TFloat32* vertWeights, TUInt8* vertBones );
 
-	// Read a skinning weights mesh template
-	EImportError ReadSkinWeightsData
-	(
-		ID3DXFileData* pXFileData,
-		const TUInt32  iMesh,
-		const TUInt32  iBone
-	);
+	// Match the bones in each mesh to their frames
+	EImportError ProcessBones();
 
 
 	/////////////////////////////////////
-	// X-File parsing support
-
-	EImportError GetXFileNumChildren
-	(
-		ID3DXFileEnumObject* pXFileEnumer, 
-		TUInt32*             iNumChildren
-	);
-
-	EImportError GetXFileNumChildren
-	(
-		ID3DXFileData* pXFileData,
-		TUInt32*       iNumChildren
-	);
-
-
-	EImportError GetXFileChild
-	(
-		ID3DXFileEnumObject* pXFileEnumer,
-		const TUInt32        iChild, 
-		ID3DXFileData**      ppChildData, 
-		GUID*                pChildGUID
-	);
-
-	EImportError GetXFileChild
-	(
-		ID3DXFileData*  pXFileData,
-		const TUInt32   iChild, 
-		ID3DXFileData** ppChildData, 
-		GUID*           pChildGUID
-	);
-
-
-	EImportError GetXFileDataName
-	(
-		ID3DXFileData* pXFileData,
-		string&        sName
-	);
+	// Mesh processing
 
+	// Match normals, split each mesh into a set of meshes - each of which contains only a single
+	// material - and calculate tangents where needed. Meshes are processed in parallel
+	void ProcessMeshes();
 
-	EImportError LockXFileData
+	// Process a single mesh for ProcessMeshes, the split meshes are added to the given list along
+	// with their cache statistics if optimising. Adds the time taken by each phase and the
+	// welding statistics to the given structures
+	void ProcessMesh
 	(
-		ID3DXFileData* pXFileData,
-		const TUInt8** ppLockData,
-		TUInt32*       pSize = 0
+		const TUInt32             iMesh,
+		TXFileMeshes*             pSubMeshes,
+		vector<SXFileCacheStats>* pCacheStats,
+		SXFileWeldStats*          pWeldStats,
+		SXFileImportTimes*        pTimes
 	);
 
-	void UnlockXFileData
+	// Split a mesh into a set of meshes, each of which contains only a single material, added to
+	// the given list
+	void SplitMesh
 	(
-		ID3DXFileData* pXFileData
-	);
-
-	EImportError CopyXFileData
-	(
-		ID3DXFileData* pXFileData,
-		TUInt8*        pDest,
-		TUInt32*       pSize
-	);
+		const SXFileMesh& mesh,
+		TXFileMeshes*     pSubMeshes
+	) const;
 
-	void ReadXFileLockedData
+	// Return whether the render method of a split mesh uses tangents
+	static bool MeshUsesTangents
 	(
-		const   TUInt8*& pMeshData,
-		TUInt8*	         pDest,
-		const   TUInt32  iSize
+		const SXFileMesh& mesh
 	);
 
-	void ReadXFileLockedUInt
+	// Weld the vertices of a split mesh whose final vertex data is identical, or with an epsilon
+	// greater than 0 whose components round to the same multiple of the epsilon. Adds to the
+	// given statistics, sizes include tangents if requested
+	static void WeldMesh
 	(
-		const TUInt8*& pMeshData,
-		TUInt32*       piDest
+		SXFileMesh*      pMesh,
+		bool             bTangents,
+		TFloat32         fEpsilon,
+		SXFileWeldStats* pStats
 	);
 
-	void ReadXFileLockedUInt16
+	// Reorder the triangles of a mesh for the vertex cache, then its vertices into the order the
+	// triangles use them. Returns the cache efficiency before and after
+	static void OptimiseMesh
 	(
-		const TUInt8*& pMeshData,
-		TUInt16*       piDest
+		SXFileMesh*       pMesh,
+		SXFileCacheStats* pStats
 	);
 
-
-	/////////////////////////////////////
-	// Geometry processing
-
-	// Match the face lists of vertices and normals, so there is exactly one normal per vertex
-	// See the comment to SXFileMesh::normalFaces above
-	void MatchFaceLists
+	// Generate simplified levels of detail for a mesh, up to the given number of levels in total
+	// including the full detail level. Each level is simplified from the full detail faces, so
+	// errors don't accumulate, then reordered for the vertex cache
+	static void GenerateLODs
 	(
-		const TUInt32  iMesh
+		SXFileMesh* pMesh,
+		TUInt32     iNumLODs,
+		TFloat32    fReduction,
+		TFloat32    fMaxError
 	);
 
-	// Create a global list of materials used by all the meshes - removing any duplicates. Also 
-	// create a list for each mesh mapping local material indices to global ones
-	void MakeGlobalMaterialList();
-
-
-	/////////////////////////////////////
-	// Bone support functions
-
-	// Add new bone weight/index to a vertex - maximum of 4, removes least signficant if necessary
-	static void AddBoneInfluence( TUInt32 bone, TFloat32 weight,
-	                              TFloat32* vertWeights, TUInt8* vertBones );
-
-	// Match the bones in each mesh to their frames
-	EImportError ProcessBones();
-
-
-	/////////////////////////////////////
-	// Mesh processing
-
-	// Split each mesh into a set of meshes - each of which contains only a single material
-	void SplitMeshes();
-
 	// Create a list of tangent vectors for the given mesh. The tangent vector is the direction of
 	// a vertex's texture U axis in model-space. Returns true on success
-	bool CalculateTangents
+	static bool CalculateTangents
 	(
-		TUInt32 iMesh,
-		TXFileVectors* pTangents
-	) const;
+		const SXFileMesh& mesh,
+		TXFileVectors*    pTangents
+	);
 
 
 	/*---------------------------------------------------------------------------------------------
@@ -581,6 +372,9 @@ private:
 	// Has any data been loaded into the lists below
 	bool            m_bImported;
 
+	// Processing options of the last import
+	SXFileImportOptions m_Options;
+
 	// The list of frames forms a flattened depth-first hierarchy
 	TXFileFrames    m_Frames;
 
@@ -589,6 +383,18 @@ private:
 
 	// Global list of materials used by all the meshes
 	TXFileMaterials m_Materials;
+
+	// Vertex cache efficiency of each mesh, only if optimised
+	vector<SXFileCacheStats> m_CacheStats;
+
+	// Description of the last import error
+	string          m_sError;
+
+	// Time taken by each phase of the last import
+	SXFileImportTimes m_Times;
+
+	// Vertex counts before and after welding in the last import
+	SXFileWeldStats m_WeldStats;
 };
 
 
@@ -0,0 +1,1183 @@
+/*******************************************
+	CXFileParser.cpp
+
+	Parser for text format Microsoft .X
+	files, independent of DirectX
+********************************************/
+
+#include <string.h>
+#include <sstream>
+
+#include "CXFileParser.h"
+#include "NumberParser.h"
+
+namespace gen
+{
+
+namespace
+{
+
+// Maximum depth of the frame hierarchy
+const TUInt32 kiMaxFrameDepth = 256;
+
+// Names of the data object types understood by the parser, in the order of EObjectType
+const char* const kObjectTypeNames[] =
+{
+	"template",
+	"Frame",
+	"FrameTransformMatrix",
+	"Mesh",
+	"MeshNormals",
+	"MeshTextureCoords",
+	"MeshVertexColors",
+	"MeshMaterialList",
+	"Material",
+	"TextureFilename",
+	"VertexDuplicationIndices",
+	"FaceAdjacency",
+	"XSkinMeshHeader",
+	"SkinWeights",
+};
+
+// Characters that may be used in names and identifiers
+inline bool IsNameChar( char c )
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+	       c == '_' || c == '-' || c == '.' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+} // namespace
+
+
+/*-----------------------------------------------------------------------------------------
+	Public interface
+-----------------------------------------------------------------------------------------*/
+
+// Parse an X-file from the given memory, adding a root frame to the frames list followed by
+// the hierarchy from the file (depth-first). Meshes are added to the meshes list, with the
+// vertex, normal and material data exactly as stored in the file
+// Possible return values:
+//		kSuccess:			...
+//		kFileError:			Not a text X-file
+//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
+EImportError CXFileParser::Parse
+(
+	const char*   pText,
+	TUInt32       iSize,
+	TXFileFrames* pFrames,
+	TXFileMeshes* pMeshes
+)
+{
+	m_Error.clear();
+	m_NamedObjects.clear();
+
+	// Check the header - "xof 0303txt 0032", magic number, version, format and float size
+	if (iSize < 16 || memcmp( pText, "xof ", 4 ) != 0)
+	{
+		m_Error = "Not an X-file";
+		return kFileError;
+	}
+	if (memcmp( pText + 8, "txt ", 4 ) != 0)
+	{
+		m_Error = "Binary and compressed X-files are not supported";
+		return kFileError;
+	}
+
+	m_Text = pText;
+	m_End = pText + iSize;
+	m_Pos = pText + 16;
+	m_pFrames = pFrames;
+	m_pMeshes = pMeshes;
+
+	// Create new root frame
+	TUInt32 iRootFrame = static_cast<TUInt32>(m_pFrames->size());
+	m_pFrames->push_back( SXFileFrame() );
+
+	// Set root frame values
+	SXFileFrame& rootFrame = m_pFrames->back();
+	rootFrame.sName = "Root";
+	rootFrame.iDepth = 0;
+	rootFrame.iParentIndex = 0;
+	rootFrame.iNumChildren = 0;
+	rootFrame.defaultMatrix = CMatrix4x4::kIdentity;
+	rootFrame.offsetMatrix = CMatrix4x4::kIdentity;
+
+	// Top level frames and meshes become children of the root frame
+	EImportError eError = ParseFrameChildren( iRootFrame, true );
+
+	m_NamedObjects.clear();
+	return eError;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Data objects
+-----------------------------------------------------------------------------------------*/
+
+// Read the start of the next child data object, up to the start of its data. References
+// are followed by moving to the data of the referenced object. Sets bEnd instead at the end
+// of the containing object, consuming its closing brace, or at the end of file if bTopLevel
+EImportError CXFileParser::ReadObjectStart
+(
+	bool          bTopLevel,
+	bool*         pEnd,
+	SObjectStart* pObject
+)
+{
+	// Check for end of the containing object
+	*pEnd = false;
+	SkipSeparators();
+	if (m_Pos == m_End)
+	{
+		if (!bTopLevel)
+		{
+			return Error( "Unexpected end of file" );
+		}
+		*pEnd = true;
+		return kSuccess;
+	}
+	if (*m_Pos == '}')
+	{
+		if (bTopLevel)
+		{
+			return Error( "Unexpected '}'" );
+		}
+		++m_Pos;
+		*pEnd = true;
+		return kSuccess;
+	}
+
+	// Reference to a named object - "{ name }", possibly with a GUID
+	pObject->pReturn = 0;
+	if (*m_Pos == '{')
+	{
+		++m_Pos;
+		SkipSeparators();
+		ReadName( &pObject->sName );
+		SkipSeparators();
+		if (m_Pos < m_End && *m_Pos == '<')
+		{
+			const char* pGUIDEnd = static_cast<const char*>(memchr( m_Pos, '>', m_End - m_Pos ));
+			if (!pGUIDEnd)
+			{
+				return Error( "Unterminated GUID" );
+			}
+			m_Pos = pGUIDEnd;
+			++m_Pos;
+			SkipSeparators();
+		}
+		if (m_Pos == m_End || *m_Pos != '}')
+		{
+			return Error( "Expected '}' after reference" );
+		}
+		++m_Pos;
+
+		map<string, SNamedObject>::iterator namedObject = m_NamedObjects.find( pObject->sName );
+		if (namedObject == m_NamedObjects.end())
+		{
+			return Error( ("Reference to unknown object '" + pObject->sName + "'").c_str() );
+		}
+		pObject->type = namedObject->second.type;
+		pObject->pReturn = m_Pos;
+		m_Pos = namedObject->second.pData;
+		return kSuccess;
+	}
+
+	// Object type identifier
+	char c = *m_Pos;
+	if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'))
+	{
+		return Error( "Unexpected data" );
+	}
+	string sType;
+	ReadName( &sType );
+	pObject->type = kUnknownObject;
+	for (TUInt32 iType = 0; iType < kUnknownObject; ++iType)
+	{
+		if (sType == kObjectTypeNames[iType])
+		{
+			pObject->type = static_cast<EObjectType>(iType);
+			break;
+		}
+	}
+
+	// Optional name, then opening brace and optional GUID
+	SkipSeparators();
+	ReadName( &pObject->sName );
+	SkipSeparators();
+	if (m_Pos == m_End || *m_Pos != '{')
+	{
+		return Error( ("Expected '{' after " + sType).c_str() );
+	}
+	++m_Pos;
+	SkipSeparators();
+	if (m_Pos < m_End && *m_Pos == '<')
+	{
+		const char* pGUIDEnd = static_cast<const char*>(memchr( m_Pos, '>', m_End - m_Pos ));
+		if (!pGUIDEnd)
+		{
+			return Error( "Unterminated GUID" );
+		}
+		m_Pos = pGUIDEnd;
+		++m_Pos;
+	}
+
+	// Remember named objects so they can be referenced later
+	if (!pObject->sName.empty() && pObject->type != kTemplate)
+	{
+		SNamedObject namedObject = { pObject->type, m_Pos };
+		m_NamedObjects[pObject->sName] = namedObject;
+	}
+
+	return kSuccess;
+}
+
+
+// Skip the remaining child objects of the current data object and its closing brace. Any
+// other remaining data is an error
+EImportError CXFileParser::EndObject()
+{
+	while (true)
+	{
+		bool bEnd;
+		SObjectStart object;
+		EImportError eError = ReadObjectStart( false, &bEnd, &object );
+		if (eError != kSuccess || bEnd)
+		{
+			return eError;
+		}
+		if (object.pReturn)
+		{
+			m_Pos = object.pReturn; // Nothing to skip for a reference
+		}
+		else
+		{
+			eError = SkipObject();
+			if (eError != kSuccess)
+			{
+				return eError;
+			}
+		}
+	}
+}
+
+
+// Skip the rest of the current data object, whatever it contains
+EImportError CXFileParser::SkipObject()
+{
+	TUInt32 iDepth = 1;
+	while (m_Pos < m_End)
+	{
+		char c = *m_Pos++;
+		if (c == '{')
+		{
+			++iDepth;
+		}
+		else if (c == '}')
+		{
+			if (--iDepth == 0)
+			{
+				return kSuccess;
+			}
+		}
+		else if (c == '"')
+		{
+			const char* pStringEnd = static_cast<const char*>(memchr( m_Pos, '"', m_End - m_Pos ));
+			if (!pStringEnd)
+			{
+				return Error( "Unterminated string" );
+			}
+			m_Pos = pStringEnd + 1;
+		}
+		else if (c == '#' || (c == '/' && m_Pos < m_End && *m_Pos == '/'))
+		{
+			while (m_Pos < m_End && *m_Pos != '\n') ++m_Pos;
+		}
+	}
+	return Error( "Unexpected end of file" );
+}
+
+
+// Parse the child objects of a frame (or the whole file for the root frame)
+EImportError CXFileParser::ParseFrameChildren
+(
+	const TUInt32 iFrame,
+	bool          bTopLevel
+)
+{
+	while (true)
+	{
+		bool bEnd;
+		SObjectStart object;
+		EImportError eError = ReadObjectStart( bTopLevel, &bEnd, &object );
+		if (eError != kSuccess || bEnd)
+		{
+			return eError;
+		}
+
+		// Found child frame
+		if (object.type == kFrame)
+		{
+			++(*m_pFrames)[iFrame].iNumChildren;
+			eError = ParseFrame( object.sName, iFrame );
+		}
+
+		// Found child frame transformation matrix
+		else if (object.type == kFrameTransformMatrix)
+		{
+			eError = ReadFloats( &(*m_pFrames)[iFrame].defaultMatrix.e00, 16 );
+			if (eError == kSuccess)
+			{
+				eError = EndObject();
+			}
+		}
+
+		// Found child mesh
+		else if (object.type == kMesh)
+		{
+			eError = ParseMesh( iFrame );
+		}
+
+		// Skip templates, materials (read when referenced) and unknown data
+		else
+		{
+			eError = SkipObject();
+		}
+
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (object.pReturn)
+		{
+			m_Pos = object.pReturn;
+		}
+	}
+}
+
+
+// Parse a single frame and all its children, a new frame is added to the frame list. The
+// depth of the hierarchy is limited, so a frame referencing itself is an error
+EImportError CXFileParser::ParseFrame
+(
+	const string& sName,
+	const TUInt32 iParentFrame
+)
+{
+	// Create new frame
+	TUInt32 iCurrFrame = static_cast<TUInt32>(m_pFrames->size());
+	m_pFrames->push_back( SXFileFrame() );
+
+	// Initialise frame values
+	SXFileFrame& frame = m_pFrames->back();
+	frame.sName = sName;
+	frame.iDepth = (*m_pFrames)[iParentFrame].iDepth + 1;
+	frame.iParentIndex = iParentFrame;
+	frame.iNumChildren = 0;
+	frame.defaultMatrix = CMatrix4x4::kIdentity;
+	frame.offsetMatrix = CMatrix4x4::kIdentity;
+	if (frame.iDepth > kiMaxFrameDepth)
+	{
+		return Error( "Frames nested too deeply" );
+	}
+
+	return ParseFrameChildren( iCurrFrame, false );
+}
+
+
+// Parse a mesh and its child objects, a new mesh is added to the mesh list
+EImportError CXFileParser::ParseMesh
+(
+	const TUInt32 iFrame
+)
+{
+	// Create new mesh, set owner frame
+	m_pMeshes->push_back( SXFileMesh() );
+	SXFileMesh& mesh = m_pMeshes->back();
+	mesh.iParentFrame = iFrame;
+	mesh.iNumUniqueVertices = 0;
+	mesh.iMaxBonesPerVertex = 0;
+	mesh.iMaxBonesPerFace = 0;
+
+	// Read vertices
+	TUInt32 iNumVertices;
+	EImportError eError = ReadCount( &iNumVertices );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	mesh.vertices.resize( iNumVertices );
+	if (iNumVertices > 0)
+	{
+		eError = ReadFloats( &mesh.vertices[0].x, 3 * iNumVertices );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+
+	// Read faces - they can be general polygons - convert them all to triangles
+	eError = ReadFaces( iNumVertices, &mesh.faces, &mesh.origFaceEdges, false );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	// Counter for bones read from child data objects
+	TUInt32 iCurrBone = 0;
+
+	// For each child object
+	while (true)
+	{
+		bool bEnd;
+		SObjectStart object;
+		eError = ReadObjectStart( false, &bEnd, &object );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (bEnd)
+		{
+			break;
+		}
+
+		switch (object.type)
+		{
+			case kMeshNormals:              eError = ReadNormalData( mesh );                 break;
+			case kMeshTextureCoords:        eError = ReadTextureUVData( mesh );              break;
+			case kMeshVertexColors:         eError = ReadVertexColourData( mesh );           break;
+			case kMeshMaterialList:         eError = ReadMaterialData( mesh );               break;
+			case kVertexDuplicationIndices: eError = ReadDuplicationData( mesh );            break;
+			case kFaceAdjacency:            eError = ReadAdjacencyData( mesh );              break;
+			case kXSkinMeshHeader:          eError = ReadSkinDefnData( mesh );               break;
+			case kSkinWeights:              eError = ReadSkinWeightsData( mesh, iCurrBone++ ); break;
+			default:                        eError = SkipObject();                           break;
+		}
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (object.pReturn)
+		{
+			m_Pos = object.pReturn;
+		}
+	}
+
+	// Check if not enough bones
+	if (iCurrBone != mesh.bones.size())
+	{
+		return Error( "Fewer skin weights than bones in mesh" );
+	}
+
+	return kSuccess;
+}
+
+
+// Read a list of polygonal faces, converting them to triangles. Either store the original
+// number of edges in each face, or check the number of edges matches the existing list
+EImportError CXFileParser::ReadFaces
+(
+	const TUInt32 iNumVertices,
+	TXFileFaces*  pFaces,
+	TXFileInts*   pFaceEdges,
+	bool          bMatchEdges
+)
+{
+	TUInt32 iNumFaces;
+	EImportError eError = ReadCount( &iNumFaces );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	if (bMatchEdges)
+	{
+		if (iNumFaces != pFaceEdges->size())
+		{
+			return Error( "Face count does not match mesh" );
+		}
+	}
+	else
+	{
+		pFaceEdges->resize( iNumFaces );
+	}
+	pFaces->reserve( iNumFaces ); // Typically all triangles
+
+	for (TUInt32 iFace = 0; iFace < iNumFaces; ++iFace)
+	{
+		TUInt32 iNumEdges;
+		eError = ReadUInt( &iNumEdges );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (iNumEdges < 3)
+		{
+			return Error( "Face with fewer than three vertices" );
+		}
+		if (bMatchEdges)
+		{
+			if (iNumEdges != (*pFaceEdges)[iFace])
+			{
+				return Error( "Face does not match mesh" );
+			}
+		}
+		else
+		{
+			(*pFaceEdges)[iFace] = iNumEdges;
+		}
+
+		// Read first index of polygon, then use successive pairs of indices to form triangles
+		// with this first one
+		TUInt32 aiIndex[3];
+		eError = ReadUInts( aiIndex, 2 );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		for (TUInt32 iEdge = 2; iEdge < iNumEdges; ++iEdge)
+		{
+			eError = ReadUInts( &aiIndex[2], 1 );
+			if (eError != kSuccess)
+			{
+				return eError;
+			}
+			if (aiIndex[0] >= iNumVertices || aiIndex[1] >= iNumVertices || aiIndex[2] >= iNumVertices)
+			{
+				return Error( "Face index out of range" );
+			}
+			SXFileFace face = { aiIndex[0], aiIndex[1], aiIndex[2] };
+			pFaces->push_back( face );
+			aiIndex[1] = aiIndex[2];
+		}
+	}
+
+	return kSuccess;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Mesh child objects
+-----------------------------------------------------------------------------------------*/
+
+// Read a normal data mesh template
+EImportError CXFileParser::ReadNormalData( SXFileMesh& mesh )
+{
+	// Only allow one vertex normal list in a mesh
+	if (mesh.normals.size() > 0)
+	{
+		return Error( "More than one normal list in mesh" );
+	}
+
+	// Read normals
+	TUInt32 iNumNormals;
+	EImportError eError = ReadCount( &iNumNormals );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	mesh.normals.resize( iNumNormals );
+	if (iNumNormals > 0)
+	{
+		eError = ReadFloats( &mesh.normals[0].x, 3 * iNumNormals );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+
+	// Read normal faces, which must match the mesh faces
+	eError = ReadFaces( iNumNormals, &mesh.normalFaces, &mesh.origFaceEdges, true );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	return EndObject();
+}
+
+// Read a texture coordinate mesh template
+EImportError CXFileParser::ReadTextureUVData( SXFileMesh& mesh )
+{
+	// Only allow one texture coordinate list in a mesh
+	if (mesh.textureCoords.size() > 0)
+	{
+		return Error( "More than one texture coordinate list in mesh" );
+	}
+
+	// Read texture coordinates
+	TUInt32 iNumTextureCoords;
+	EImportError eError = ReadCount( &iNumTextureCoords );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	if (iNumTextureCoords != mesh.vertices.size())
+	{
+		return Error( "Texture coordinate count does not match vertex count" );
+	}
+	mesh.textureCoords.resize( iNumTextureCoords );
+	if (iNumTextureCoords > 0)
+	{
+		eError = ReadFloats( &mesh.textureCoords[0].fU, 2 * iNumTextureCoords );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+
+	return EndObject();
+}
+
+// Read a vertex colour mesh template, any vertices not assigned a colour will get white
+EImportError CXFileParser::ReadVertexColourData( SXFileMesh& mesh )
+{
+	// Only allow one vertex colour list in a mesh
+	if (mesh.vertexColours.size() > 0)
+	{
+		return Error( "More than one vertex colour list in mesh" );
+	}
+
+	// Read number of vertex colours
+	TUInt32 iNumVertexColours;
+	EImportError eError = ReadCount( &iNumVertexColours );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	// All colours default to white if not assigned
+	SXFileRGBAColour defaultColour = { 1.0f, 1.0f, 1.0f, 1.0f };
+	mesh.vertexColours.resize( mesh.vertices.size(), defaultColour );
+	for (TUInt32 iColour = 0; iColour < iNumVertexColours; ++iColour)
+	{
+		TUInt32 iVertexIndex;
+		eError = ReadUInt( &iVertexIndex );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (iVertexIndex >= mesh.vertices.size())
+		{
+			return Error( "Vertex colour index out of range" );
+		}
+		eError = ReadFloats( &mesh.vertexColours[iVertexIndex].fRed, 4 );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+
+	return EndObject();
+}
+
+// Read a material list mesh template and the materials it contains
+EImportError CXFileParser::ReadMaterialData( SXFileMesh& mesh )
+{
+	// Only allow one material list in a mesh
+	if (mesh.materials.size() > 0)
+	{
+		return Error( "More than one material list in mesh" );
+	}
+
+	// Read number of materials and initialise material list
+	TUInt32 iNumMaterials;
+	EImportError eError = ReadCount( &iNumMaterials );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	SXFileMaterial defaultMaterial =
+	{
+		"",
+		{ 1.0f, 1.0f, 1.0f, 1.0f },
+		20.0f, { 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f },
+		""
+	};
+	mesh.materials.resize( iNumMaterials, defaultMaterial );
+
+	// Read face materials - matching the original face list before it was split into triangles.
+	// Will convert to match the new (triangle-only) face list
+	TUInt32 iNumFaceMaterials;
+	eError = ReadCount( &iNumFaceMaterials );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	// Handle undocumented case with only one face material - all faces use same material
+	if (iNumFaceMaterials == 1 && mesh.origFaceEdges.size() != 1)
+	{
+		// Read the single face material
+		TUInt32 iFaceMaterial;
+		eError = ReadUInt( &iFaceMaterial );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (iFaceMaterial >= iNumMaterials)
+		{
+			return Error( "Face material out of range" );
+		}
+
+		// Create a full face material list from this value
+		mesh.faceMaterials.resize( mesh.faces.size(), iFaceMaterial );
+	}
+	else // Read standard face materials - one material reference for each face
+	{
+		if (iNumFaceMaterials != mesh.origFaceEdges.size())
+		{
+			return Error( "Face material count does not match face count" );
+		}
+		mesh.faceMaterials.resize( mesh.faces.size() );
+		TUInt32 iFace = 0;
+		for (TUInt32 iOrigFace = 0; iOrigFace < iNumFaceMaterials; ++iOrigFace)
+		{
+			TUInt32 iMaterial;
+			eError = ReadUInt( &iMaterial );
+			if (eError != kSuccess)
+			{
+				return eError;
+			}
+			if (iMaterial >= iNumMaterials)
+			{
+				return Error( "Face material out of range" );
+			}
+			for (TUInt32 iEdge = 2; iEdge < mesh.origFaceEdges[iOrigFace]; ++iEdge)
+			{
+				mesh.faceMaterials[iFace] = iMaterial;
+				++iFace;
+			}
+		}
+	}
+
+	// Read the materials from the child objects, which are often references to materials
+	// shared between meshes
+	TUInt32 iMaterialsRead = 0;
+	while (true)
+	{
+		bool bEnd;
+		SObjectStart object;
+		eError = ReadObjectStart( false, &bEnd, &object );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (bEnd)
+		{
+			break;
+		}
+
+		// Found material in material list
+		if (object.type == kMaterial)
+		{
+			// Check if too many materials
+			if (iMaterialsRead >= iNumMaterials)
+			{
+				return Error( "Too many materials in material list" );
+			}
+			mesh.materials[iMaterialsRead].sName = object.sName;
+			eError = ReadMaterial( mesh.materials[iMaterialsRead] );
+			++iMaterialsRead;
+		}
+
+		// Found unknown material list data
+		else
+		{
+			eError = SkipObject();
+		}
+
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (object.pReturn)
+		{
+			m_Pos = object.pReturn;
+		}
+	}
+
+	// Check if not enough materials
+	if (iMaterialsRead != iNumMaterials)
+	{
+		return Error( "Too few materials in material list" );
+	}
+
+	return kSuccess;
+}
+
+// Read a material template and its texture filename
+EImportError CXFileParser::ReadMaterial( SXFileMaterial& material )
+{
+	// Colours and specular power
+	EImportError eError = ReadFloats( &material.faceColour.fRed, 4 );
+	if (eError == kSuccess) eError = ReadFloats( &material.fSpecularPower, 1 );
+	if (eError == kSuccess) eError = ReadFloats( &material.specularColour.fRed, 3 );
+	if (eError == kSuccess) eError = ReadFloats( &material.emmisiveColour.fRed, 3 );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	// Child objects
+	while (true)
+	{
+		bool bEnd;
+		SObjectStart object;
+		eError = ReadObjectStart( false, &bEnd, &object );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (bEnd)
+		{
+			break;
+		}
+
+		// Found texture filename in material
+		if (object.type == kTextureFilename)
+		{
+			eError = ReadString( &material.sTextureName );
+			if (eError == kSuccess)
+			{
+				eError = EndObject();
+			}
+		}
+
+		// Found unknown material data
+		else
+		{
+			eError = SkipObject();
+		}
+
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (object.pReturn)
+		{
+			m_Pos = object.pReturn;
+		}
+	}
+
+	return kSuccess;
+}
+
+// Read a vertex duplication mesh template
+EImportError CXFileParser::ReadDuplicationData( SXFileMesh& mesh )
+{
+	// Only allow one vertex duplication list in a mesh
+	if (mesh.duplicateIndices.size() > 0)
+	{
+		return Error( "More than one vertex duplication list in mesh" );
+	}
+
+	// Read duplicaton indices, also fetch number of unique vertices
+	TUInt32 iNumDuplicationIndices;
+	EImportError eError = ReadCount( &iNumDuplicationIndices );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	if (iNumDuplicationIndices != mesh.vertices.size())
+	{
+		return Error( "Vertex duplication count does not match vertex count" );
+	}
+	eError = ReadUInt( &mesh.iNumUniqueVertices );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	mesh.duplicateIndices.resize( iNumDuplicationIndices );
+	if (iNumDuplicationIndices > 0)
+	{
+		eError = ReadUInts( &mesh.duplicateIndices[0], iNumDuplicationIndices );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+
+	return EndObject();
+}
+
+// Read a adjacancy data mesh template
+EImportError CXFileParser::ReadAdjacencyData( SXFileMesh& mesh )
+{
+	// Only allow one face adjacency list in a mesh
+	if (mesh.adjacencyIndices.size() > 0)
+	{
+		return Error( "More than one face adjacency list in mesh" );
+	}
+
+	// Read face adjacency list
+	TUInt32 iNumAdjacencyIndices;
+	EImportError eError = ReadCount( &iNumAdjacencyIndices );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	mesh.adjacencyIndices.resize( iNumAdjacencyIndices );
+	if (iNumAdjacencyIndices > 0)
+	{
+		eError = ReadUInts( &mesh.adjacencyIndices[0], iNumAdjacencyIndices );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+
+	return EndObject();
+}
+
+// Read skinning header mesh template
+EImportError CXFileParser::ReadSkinDefnData( SXFileMesh& mesh )
+{
+	// Only allow one skining definition in a mesh
+	if (mesh.bones.size() > 0)
+	{
+		return Error( "More than one skin mesh header in mesh" );
+	}
+
+	// Read maximum weights info and number of bones used (all WORDs)
+	TUInt32 aiValues[3];
+	EImportError eError = ReadUInts( aiValues, 3 );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	if (aiValues[0] > 0xffff || aiValues[1] > 0xffff || aiValues[2] > 0xffff)
+	{
+		return Error( "Skin mesh header value out of range" );
+	}
+	mesh.iMaxBonesPerVertex = static_cast<TUInt16>(aiValues[0]);
+	mesh.iMaxBonesPerFace = static_cast<TUInt16>(aiValues[1]);
+
+	// Initialise bone structures
+	SXFileBone bone;
+	bone.iFrame = 0;
+	bone.offsetMatrix = CMatrix4x4::kIdentity;
+	mesh.bones.resize( aiValues[2], bone );
+
+	return EndObject();
+}
+
+// Read a skinning weights mesh template
+EImportError CXFileParser::ReadSkinWeightsData( SXFileMesh& mesh, const TUInt32 iBone )
+{
+	// Check if no skinning definition or too many bones
+	if (iBone >= mesh.bones.size())
+	{
+		return Error( "More skin weights than bones in mesh" );
+	}
+	SXFileBone& bone = mesh.bones[iBone];
+
+	// Read name of bone
+	EImportError eError = ReadString( &bone.sFrameName );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	// Read number of weights
+	TUInt32 iNumWeights;
+	eError = ReadCount( &iNumWeights );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+	bone.weights.resize( iNumWeights );
+
+	// Read skinning indices, weights and offset matrix
+	for (TUInt32 iIndex = 0; iIndex < iNumWeights; ++iIndex)
+	{
+		eError = ReadUInt( &bone.weights[iIndex].iVertexIndex );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+		if (bone.weights[iIndex].iVertexIndex >= mesh.vertices.size())
+		{
+			return Error( "Skin weight vertex index out of range" );
+		}
+	}
+	for (TUInt32 iWeight = 0; iWeight < iNumWeights; ++iWeight)
+	{
+		eError = ReadFloats( &bone.weights[iWeight].fWeight, 1 );
+		if (eError != kSuccess)
+		{
+			return eError;
+		}
+	}
+	eError = ReadFloats( &bone.offsetMatrix.e00, 16 );
+	if (eError != kSuccess)
+	{
+		return eError;
+	}
+
+	return EndObject();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Tokens
+-----------------------------------------------------------------------------------------*/
+
+// Skip whitespace, comments and the separators ',' and ';' (which carry no information when
+// the templates are known)
+void CXFileParser::SkipSeparators()
+{
+	while (m_Pos < m_End)
+	{
+		char c = *m_Pos;
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ';')
+		{
+			++m_Pos;
+		}
+		else if (c == '#' || (c == '/' && m_Pos + 1 < m_End && m_Pos[1] == '/'))
+		{
+			while (m_Pos < m_End && *m_Pos != '\n') ++m_Pos;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+// Read values, separators before each value are skipped
+EImportError CXFileParser::ReadUInt( TUInt32* pValue )
+{
+	SkipSeparators();
+	const char* pNext = ParseUInt( m_Pos, m_End, pValue );
+	if (!pNext)
+	{
+		return Error( "Expected an integer" );
+	}
+	m_Pos = pNext;
+	return kSuccess;
+}
+
+EImportError CXFileParser::ReadUInts( TUInt32* pValues, TUInt32 iCount )
+{
+	for (TUInt32 i = 0; i < iCount; ++i)
+	{
+		SkipSeparators();
+		const char* pNext = ParseUInt( m_Pos, m_End, &pValues[i] );
+		if (!pNext)
+		{
+			return Error( "Expected an integer" );
+		}
+		m_Pos = pNext;
+	}
+	return kSuccess;
+}
+
+EImportError CXFileParser::ReadFloats( TFloat32* pValues, TUInt32 iCount )
+{
+	SkipSeparators();
+	const char* pNext = ParseFloatArray( m_Pos, m_End, pValues, iCount );
+	if (pNext)
+	{
+		m_Pos = pNext;
+		return kSuccess;
+	}
+
+	// Read a value at a time if the fast array parse fails, in case there are comments within
+	// the array. Also finds the position of any bad value for the error message
+	for (TUInt32 i = 0; i < iCount; ++i)
+	{
+		SkipSeparators();
+		pNext = ParseFloat( m_Pos, m_End, &pValues[i] );
+		if (!pNext)
+		{
+			return Error( "Expected a number" );
+		}
+		m_Pos = pNext;
+	}
+	return kSuccess;
+}
+
+EImportError CXFileParser::ReadString( string* pString )
+{
+	SkipSeparators();
+	if (m_Pos == m_End || *m_Pos != '"')
+	{
+		return Error( "Expected a string" );
+	}
+	++m_Pos;
+	const char* pStringEnd = static_cast<const char*>(memchr( m_Pos, '"', m_End - m_Pos ));
+	if (!pStringEnd)
+	{
+		return Error( "Unterminated string" );
+	}
+	pString->assign( m_Pos, pStringEnd );
+	m_Pos = pStringEnd + 1;
+	return kSuccess;
+}
+
+// Read the number of elements in an array, checking the remaining file is large enough to
+// hold them (so a corrupt count cannot cause a huge allocation)
+EImportError CXFileParser::ReadCount( TUInt32* pCount )
+{
+	EImportError eError = ReadUInt( pCount );
+	if (eError == kSuccess && *pCount > static_cast<TUInt32>(m_End - m_Pos) / 2) // Each element at least 2 characters
+	{
+		return Error( "Array larger than file" );
+	}
+	return eError;
+}
+
+// Read a name or identifier, returns an empty string if there is none at the current position
+void CXFileParser::ReadName( string* pName )
+{
+	const char* pStart = m_Pos;
+	while (m_Pos < m_End && IsNameChar( *m_Pos ))
+	{
+		++m_Pos;
+	}
+	pName->assign( pStart, m_Pos );
+}
+
+// Set the error message with the current line number, returns kInvalidData
+EImportError CXFileParser::Error( const char* szMessage )
+{
+	TUInt32 iLine = 1;
+	for (const char* p = m_Text; p < m_Pos && p < m_End; ++p)
+	{
+		if (*p == '\n') ++iLine;
+	}
+	ostringstream error;
+	error << "Line " << iLine << ": " << szMessage;
+	m_Error = error.str();
+	return kInvalidData;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	X-file type support
+-----------------------------------------------------------------------------------------*/
+
+// Equality operator for SXFileMaterial structure (needed for searching material lists)
+bool operator==
+(
+	const SXFileMaterial& cmp1,
+	const SXFileMaterial& cmp2
+)
+{
+	return cmp1.faceColour.fRed == cmp2.faceColour.fRed &&
+	       cmp1.faceColour.fGreen == cmp2.faceColour.fGreen &&
+	       cmp1.faceColour.fBlue == cmp2.faceColour.fBlue &&
+	       cmp1.faceColour.fAlpha == cmp2.faceColour.fAlpha &&
+	       cmp1.fSpecularPower == cmp2.fSpecularPower &&
+	       cmp1.specularColour.fRed == cmp2.specularColour.fRed &&
+	       cmp1.specularColour.fGreen == cmp2.specularColour.fGreen &&
+	       cmp1.specularColour.fBlue == cmp2.specularColour.fBlue &&
+	       cmp1.emmisiveColour.fRed == cmp2.emmisiveColour.fRed &&
+	       cmp1.emmisiveColour.fGreen == cmp2.emmisiveColour.fGreen &&
+	       cmp1.emmisiveColour.fBlue == cmp2.emmisiveColour.fBlue &&
+		   cmp1.sTextureName == cmp2.sTextureName;
+}
+
+
+} // namespace gen
@@ -0,0 +1,402 @@
+/*******************************************
+	CXFileParser.h
+
+	Parser for text format Microsoft .X
+	files, independent of DirectX
+********************************************/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+
+namespace gen
+{
+
+// List of errors returned from import functions
+enum EImportError
+{
+	kSuccess           = 0,
+	kSystemFailure     = 1,
+	kOutOfSystemMemory = 2,
+	kFileError         = 3,
+	kInvalidData       = 4,
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	X-File types
+-----------------------------------------------------------------------------------------*/
+// The data read from an X-file, before it is processed by CImportXFile into sub-meshes
+
+// Container types used
+typedef vector<TUInt32>  TXFileInts;
+typedef vector<TFloat32> TXFileFloats;
+typedef vector<CVector3> TXFileVectors;
+
+// Single face in an X-file - three vertex indices (will convert all faces to triangles)
+struct SXFileFace
+{
+	TUInt32 aiVertex[3];
+};
+typedef vector<SXFileFace> TXFileFaces;
+
+
+// 2D texture coordinate in an X-file
+struct SXFileUV
+{
+	TFloat32 fU;
+	TFloat32 fV;
+};
+typedef vector<SXFileUV> TXFileUVs;
+
+
+// RGB colour used in structures below
+struct SXFileRGBColour
+{
+	TFloat32 fRed;
+	TFloat32 fGreen;
+	TFloat32 fBlue;
+};
+
+// RGBA colour used in structures below
+struct SXFileRGBAColour
+{
+	TFloat32 fRed;
+	TFloat32 fGreen;
+	TFloat32 fBlue;
+	TFloat32 fAlpha;
+};
+typedef vector<SXFileRGBAColour> TXFileRGBAColours;
+
+
+// Material used in an X-file, material name, diffuse, specular and emmisive colours and a
+// single (diffuse) texture
+struct SXFileMaterial
+{
+	string           sName;
+	SXFileRGBAColour faceColour;
+	TFloat32         fSpecularPower;
+	SXFileRGBColour  specularColour;
+	SXFileRGBColour  emmisiveColour;
+	string           sTextureName;
+};
+typedef vector<SXFileMaterial> TXFileMaterials;
+
+// Equality operator for SXFileMaterial structure (needed for searching material lists)
+bool operator==
+(
+	const SXFileMaterial& cmp1,
+	const SXFileMaterial& cmp2
+);
+
+
+// Single bone weight as used in the bone structure below, contains the index of the affected
+// vertex and the weight that the bone applies to that vertex
+struct SXFileBoneWeight
+{
+	TUInt32  iVertexIndex;
+	TFloat32 fWeight;
+};
+typedef vector<SXFileBoneWeight> TXFileBoneWeights;
+
+// Bone structure in an X-file
+struct SXFileBone
+{
+	string            sFrameName;   // Name of the frame that drives this bone
+	TUInt32           iFrame;       // Index of the frame that drives this bone
+	TXFileBoneWeights weights;
+	CMatrix4x4        offsetMatrix; // TODO: Would like aligned matrices - but vector can't do it
+};
+typedef vector<SXFileBone> TXFileBones;
+
+
+// Frame in an X-file hierarchy
+struct SXFileFrame
+{
+	string     sName;
+	TUInt32    iDepth;
+	TUInt32    iParentIndex;
+	TUInt32    iNumChildren;
+	CMatrix4x4 defaultMatrix; // TODO: Would like aligned matrices - but vector can't do it
+	CMatrix4x4 offsetMatrix;
+};
+typedef vector<SXFileFrame> TXFileFrames;
+
+
+// A single mesh in an X-File
+struct SXFileMesh
+{
+	// Index of frame that holds this mesh
+	TUInt32           iParentFrame;
+
+	// Vertex data - lists of vertices, normals, texture coords (UVs) and colours. Vertex list
+	// is always present. The normal list may initially be a different length than the vertex
+	// list (see below), but the importer will adjust the data duplication to match them. 
+	// The vertex colours will be duplicated in a similar manner. The texture coord list must
+	// be same length as vertices unless empty
+	TXFileVectors     vertices;
+	TXFileVectors     normals; 
+	TXFileUVs         textureCoords; // Same number of texture cooords as vertices
+	TXFileRGBAColours vertexColours;
+
+	// Face data - each face is a triple of vertex indices representing a triangle (X-files may
+	// contain larger polygons, these are converted into triangles in this implementation).
+	// The face material list identifies the material used for each face, this list must be the
+	// same length as the face list, except for a special case of just one entry - meaning that
+	// all faces use the same material
+	TXFileFaces       faces;
+	TXFileInts        faceMaterials;
+
+	// The faces are converted to triangles - but the number of edges on each of the original
+	// faces is stored to help work with the normal face list and material list (each of which
+	// match the original face list)
+	TXFileInts        origFaceEdges;
+
+	// The original normal faces should match faces in terms of numbers of edges (see above).
+	// However, their indices may be different, especially if the normal duplication is not
+	// the same as that for vertices across faces (e.g. a cube with sharp edges has 8 vertices,
+	// but 6 normals - so the face indices would differ). The importer will remove these
+	// differences so there is exactly one normal for each vertex making the two face lists
+	// become identical
+	TXFileFaces       normalFaces;
+
+	// List of materials used in the face data above
+	TXFileMaterials   materials;
+
+	// Map from material indexes in the list above to material indexes in the global material
+	// list CImportXFile::m_Materials
+	TXFileInts        materialMap;
+
+	// Adjacency data - usage unknown - TODO
+	TXFileInts        adjacencyIndices;
+
+	// Vertex duplication list - a per-vertex list of integers - each one the index of the 
+	// vertex that this one is a duplicate of (i.e. in an identical position). This list must
+	// be the same length as the vertex list or empty. Duplication occurs from a need to have
+	// different normals, colours or UVs on different faces using the same vertex. The set of
+	// unique vertices are identified by having a duplication index referencing themselves.
+	// The total unique vertices is also stored here
+	TUInt32           iNumUniqueVertices;
+	TXFileInts        duplicateIndices;
+
+	// List of bones affecting this mesh, also stored is the maximum bones affecting a single
+	// vertex / face in this mesh
+	TUInt16           iMaxBonesPerVertex;
+	TUInt16           iMaxBonesPerFace;
+	TXFileBones       bones;
+
+	// Tangents, one per vertex. Not read from the file - calculated by the importer for meshes
+	// whose render method needs them, empty otherwise
+	TXFileVectors     tangents;
+
+	// Simplified levels of detail, each a face list using the vertices above along with the
+	// largest distance it moves the surface. Not read from the file - generated by the importer
+	// if requested, the faces above are the full detail level
+	vector<TXFileFaces> lodFaces;
+	TXFileFloats        lodErrors;
+};
+typedef vector<SXFileMesh> TXFileMeshes;
+
+
+/*-----------------------------------------------------------------------------------------
+	Parser
+-----------------------------------------------------------------------------------------*/
+
+// Reads the frame hierarchy and meshes from a text X-file held in memory (e.g. a memory
+// mapped file). The file is read in a single pass without building a token list. Only the
+// standard templates used for static and skinned meshes are understood, other data objects
+// (animation, templates etc.) are skipped. References to earlier named objects are followed,
+// e.g. materials shared between meshes. Binary and compressed X-files are not supported
+class CXFileParser
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CXFileParser() : m_Text( 0 ), m_End( 0 ), m_Pos( 0 ), m_pFrames( 0 ), m_pMeshes( 0 ) {}
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CXFileParser( const CXFileParser& );
+	CXFileParser& operator=( const CXFileParser& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Parse an X-file from the given memory, adding a root frame to the frames list followed by
+	// the hierarchy from the file (depth-first). Meshes are added to the meshes list, with the
+	// vertex, normal and material data exactly as stored in the file
+	// Possible return values:
+	//		kSuccess:			...
+	//		kFileError:			Not a text X-file
+	//		kInvalidData:		The file could not be parsed correctly, or contains invalid data
+	EImportError Parse
+	(
+		const char*   pText,
+		TUInt32       iSize,
+		TXFileFrames* pFrames,
+		TXFileMeshes* pMeshes
+	);
+
+	// Return a description of the last error, including the line it occured on
+	const string& GetError() const
+	{
+		return m_Error;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Data object types understood by the parser
+	enum EObjectType
+	{
+		kTemplate,
+		kFrame,
+		kFrameTransformMatrix,
+		kMesh,
+		kMeshNormals,
+		kMeshTextureCoords,
+		kMeshVertexColors,
+		kMeshMaterialList,
+		kMaterial,
+		kTextureFilename,
+		kVertexDuplicationIndices,
+		kFaceAdjacency,
+		kXSkinMeshHeader,
+		kSkinWeights,
+		kUnknownObject,
+	};
+
+	// Position of a named data object, used to follow references
+	struct SNamedObject
+	{
+		EObjectType type;
+		const char* pData; // Start of the object data, after the opening brace
+	};
+
+	// The start of a data object as returned by ReadObjectStart
+	struct SObjectStart
+	{
+		EObjectType type;
+		string      sName;   // Empty if unnamed
+		const char* pReturn; // Position to return to after a referenced object, 0 if not a reference
+	};
+
+
+	/////////////////////////////////////
+	// Data objects
+
+	// Read the start of the next child data object, up to the start of its data. References
+	// are followed by moving to the data of the referenced object. Sets bEnd instead at the end
+	// of the containing object, consuming its closing brace, or at the end of file if bTopLevel
+	EImportError ReadObjectStart
+	(
+		bool          bTopLevel,
+		bool*         pEnd,
+		SObjectStart* pObject
+	);
+
+	// Skip the remaining child objects of the current data object and its closing brace. Any
+	// other remaining data is an error
+	EImportError EndObject();
+
+	// Skip the rest of the current data object, whatever it contains
+	EImportError SkipObject();
+
+	// Parse the child objects of a frame (or the whole file for the root frame)
+	EImportError ParseFrameChildren
+	(
+		const TUInt32 iFrame,
+		bool          bTopLevel
+	);
+
+	// Parse a single frame and all its children, a new frame is added to the frame list. The
+	// depth of the hierarchy is limited, so a frame referencing itself is an error
+	EImportError ParseFrame
+	(
+		const string& sName,
+		const TUInt32 iParentFrame
+	);
+
+	// Parse a mesh and its child objects, a new mesh is added to the mesh list
+	EImportError ParseMesh
+	(
+		const TUInt32 iFrame
+	);
+
+	// Read a list of polygonal faces, converting them to triangles. Either store the original
+	// number of edges in each face, or check the number of edges matches the existing list
+	EImportError ReadFaces
+	(
+		const TUInt32 iNumVertices,
+		TXFileFaces*  pFaces,
+		TXFileInts*   pFaceEdges,
+		bool          bMatchEdges
+	);
+
+	// Read mesh child objects
+	EImportError ReadNormalData( SXFileMesh& mesh );
+	EImportError ReadTextureUVData( SXFileMesh& mesh );
+	EImportError ReadVertexColourData( SXFileMesh& mesh );
+	EImportError ReadMaterialData( SXFileMesh& mesh );
+	EImportError ReadMaterial( SXFileMaterial& material );
+	EImportError ReadDuplicationData( SXFileMesh& mesh );
+	EImportError ReadAdjacencyData( SXFileMesh& mesh );
+	EImportError ReadSkinDefnData( SXFileMesh& mesh );
+	EImportError ReadSkinWeightsData( SXFileMesh& mesh, const TUInt32 iBone );
+
+
+	/////////////////////////////////////
+	// Tokens
+
+	// Skip whitespace, comments and the separators ',' and ';' (which carry no information when
+	// the templates are known)
+	void SkipSeparators();
+
+	// Read values, separators before each value are skipped
+	EImportError ReadUInt( TUInt32* pValue );
+	EImportError ReadUInts( TUInt32* pValues, TUInt32 iCount );
+	EImportError ReadFloats( TFloat32* pValues, TUInt32 iCount );
+	EImportError ReadString( string* pString );
+
+	// Read the number of elements in an array, checking the remaining file is large enough to
+	// hold them (so a corrupt count cannot cause a huge allocation)
+	EImportError ReadCount( TUInt32* pCount );
+
+	// Read a name or identifier, returns an empty string if there is none at the current position
+	void ReadName( string* pName );
+
+	// Set the error message with the current line number, returns kInvalidData
+	EImportError Error( const char* szMessage );
+
+
+	/////////////////////////////////////
+	// Data
+
+	// Text being parsed and current position
+	const char* m_Text;
+	const char* m_End;
+	const char* m_Pos;
+
+	// Output lists
+	TXFileFrames* m_pFrames;
+	TXFileMeshes* m_pMeshes;
+
+	// Named data objects found so far
+	map<string, SNamedObject> m_NamedObjects;
+
+	string m_Error;
+};
+
+
+} // namespace gen
@@ -4,10 +4,12 @@
 	Mesh class implementation
 ********************************************/
 
+#include <sstream>
 #include <d3d10.h>
 #include <d3dx10.h>
 #include "Mesh.h"
 #include "CImportXFile.h"
+#include "MeshCompress.h"
 #include "RenderMethod.h"
 
 namespace gen
@@ -20,6 +22,28 @@ extern ID3D10Device* g_pd3dDevice;
 // Folder for all texture and mesh files
 extern const string MediaFolder;
 
+// Import option bits set when meshes are optimised or welded, above the render method bits,
+// followed by the vertex compression flags
+const TUInt32 kImportOptimised        = 1 << 16;
+const TUInt32 kImportWelded           = 1 << 17;
+const TUInt32 kImportCompressionShift = 18;
+
+// Import settings for all meshes
+bool     CMesh::m_OptimiseImport = true;
+bool     CMesh::m_WeldImport = true;
+TFloat32 CMesh::m_WeldEpsilon = 0.0f;
+TUInt32  CMesh::m_ImportLODs = kiMaxLODs;
+TFloat32 CMesh::m_LODReduction = 0.5f;
+TFloat32 CMesh::m_LODMaxError = 0.05f;
+TUInt32  CMesh::m_CompressImport = 0;
+
+// Geometry kept after creating buffers, for all meshes
+EMeshGeometryRetention CMesh::m_GeometryRetention = kRetainAllGeometry;
+
+// Level of detail selection settings for all meshes
+TFloat32 CMesh::m_LODPixelError = 1.0f;
+TFloat32 CMesh::m_LODHysteresis = 0.25f;
+
 
 //-----------------------------------------------------------------------------
 // Constructor / destructor
@@ -33,13 +57,20 @@ CMesh::CMesh()
 
 	m_NumNodes = 0;
 	m_Nodes = 0;
+	m_NodeBounds = 0;
 
 	m_NumSubMeshes = 0;
 	m_SubMeshes = 0;
 	m_SubMeshesDX = 0;
+	m_BVH = 0;
 
 	m_NumMaterials = 0;
 	m_Materials = 0;
+
+	m_NumImportedMaterials = 0;
+	m_ImportedMaterials = 0;
+
+	m_NumLODs = 0;
 }
 
 // Model destructor
@@ -63,109 +94,73 @@ void CMesh::ReleaseResources()
 	m_Materials = 0;
 	m_NumMaterials = 0;
 
-	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	delete[] m_ImportedMaterials;
+	m_ImportedMaterials = 0;
+	m_NumImportedMaterials = 0;
+
+	// DirectX sub-meshes only exist if CreateResources has been called
+	for (TUInt32 subMesh = 0; m_SubMeshesDX && subMesh < m_NumSubMeshes; ++subMesh)
 	{
 		if (m_SubMeshesDX[subMesh].indexBuffer)	 m_SubMeshesDX[subMesh].indexBuffer->Release();
 		if (m_SubMeshesDX[subMesh].vertexBuffer) m_SubMeshesDX[subMesh].vertexBuffer->Release();
 		if (m_SubMeshesDX[subMesh].vertexLayout) m_SubMeshesDX[subMesh].vertexLayout->Release();
 	}
 	delete[] m_SubMeshesDX;
+
+	// Sub-mesh data loaded from a binary mesh file belongs to the file mapping
+	if (m_Binary.IsOpen())
+	{
+		m_Binary.Close();
+	}
+	else
+	{
+		for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+		{
+			delete[] m_SubMeshes[subMesh].vertices;
+			delete[] m_SubMeshes[subMesh].faces;
+			delete[] m_SubMeshes[subMesh].largeFaces;
+		}
+	}
 	delete[] m_SubMeshes;
 	m_SubMeshesDX = 0;
 	m_SubMeshes = 0;
 	m_NumSubMeshes = 0;
 
+	delete m_BVH;
+	m_BVH = 0;
+
 	delete[] m_Nodes;
 	m_Nodes = 0;
+	delete[] m_NodeBounds;
+	m_NodeBounds = 0;
 	m_NumNodes = 0;
 
+	m_NumLODs = 0;
 	m_HasGeometry = false;
 }
 
 
 //-----------------------------------------------------------------------------
-// Geometry access / enumeration
+// Geometry access
 //-----------------------------------------------------------------------------
 
-// Return total number of triangles in the mesh
-TUInt32 CMesh::GetNumTriangles()
+// Return total number of triangles in the mesh at the given level of detail (see SelectLOD).
+// Counted from the DirectX sub-meshes once created, as the imported data may have been released
+TUInt32 CMesh::GetNumTriangles( TUInt32 lod /*= 0*/ )
 {
 	TUInt32 numTriangles = 0;
 
 	// Go through all submeshes ...
 	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
 	{
-		numTriangles += m_SubMeshes[subMesh].numFaces;
+		const SSubMeshLOD* lods = m_SubMeshesDX ? m_SubMeshesDX[subMesh].lods : m_SubMeshes[subMesh].lods;
+		TUInt32 numLODs = m_SubMeshesDX ? m_SubMeshesDX[subMesh].numLODs : m_SubMeshes[subMesh].numLODs;
+		numTriangles += lods[min( lod, numLODs - 1 )].numFaces;
 	}
 
 	return numTriangles;
 }
 
-// Request an enumeration of the triangles in the mesh. Get the individual triangles with
-// calls to GetTriangle, finish the enumeration with EndEnumTriangles
-void CMesh::BeginEnumTriangles()
-{
-	m_EnumTriMesh = 0;
-	m_EnumTri = 0;
-}
-
-// Get the next triangle in the mesh, used after BeginEnumTriangles. Fills the supplied
-// CVector3 pointers with the three vertex coordinates of the triangle. Returns true if a
-// triangle was successfully returned, false if there are no more triangles to enumerate
-bool CMesh::GetTriangle( CVector3* pVertex1, CVector3* pVertex2, CVector3* pVertex3 )
-{
-	// If enumerated all meshes then finished
-	if (m_EnumTriMesh >= m_NumSubMeshes)
-	{
-		return false;
-	}
-
-	// If enumerated all triangles in current mesh...
-	if (m_EnumTri >= m_SubMeshes[m_EnumTriMesh].numFaces)
-	{
-		// Move to next mesh - finished if no more meshes
-		++m_EnumTriMesh;
-		if (m_EnumTriMesh >= m_NumSubMeshes)
-		{
-			return false;
-		}
-		m_EnumTri = 0; // Start at first triangle of next mesh
-	}
-
-	// Get current face from submesh
-	SMeshFace face = m_SubMeshes[m_EnumTriMesh].faces[m_EnumTri];
-
-	// Get pointer to vertex refered to by first face index - deal with flexible vertex size
-	TUInt8* pVertexData = m_SubMeshes[m_EnumTriMesh].vertices + 
-	                      face.aiVertex[0] * m_SubMeshes[m_EnumTriMesh].vertexSize;
-
-	// Copy vertex coordinate to output pointer
-	// Assuming first three floats are the vertex coord x,y & z. See comment in CMesh::PreProcess
-	TFloat32* pVertexCoord = reinterpret_cast<TFloat32*>(pVertexData);
-	pVertex1->x = *pVertexCoord++;
-	pVertex1->y = *pVertexCoord++;
-	pVertex1->z = *pVertexCoord;
-
-	// Get second vertex coordinate
-	pVertexData = m_SubMeshes[m_EnumTriMesh].vertices +
-	              face.aiVertex[1] * m_SubMeshes[m_EnumTriMesh].vertexSize;
-	pVertexCoord = reinterpret_cast<TFloat32*>(pVertexData);
-	pVertex2->x = *pVertexCoord++;
-	pVertex2->y = *pVertexCoord++;
-	pVertex2->z = *pVertexCoord;
-
-	// Get third vertex coordinate
-	pVertexData = m_SubMeshes[m_EnumTriMesh].vertices +
-	              face.aiVertex[2] * m_SubMeshes[m_EnumTriMesh].vertexSize;
-	pVertexCoord = reinterpret_cast<TFloat32*>(pVertexData);
-	pVertex2->x = *pVertexCoord++;
-	pVertex2->y = *pVertexCoord++;
-	pVertex2->z = *pVertexCoord;
-
-	return true;
-}
-
-
 // Return total number of vertices in the mesh
 TUInt32 CMesh::GetNumVertices()
 {
@@ -174,55 +169,84 @@ TUInt32 CMesh::GetNumVertices()
 	// Go through all submeshes ...
 	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
 	{
-		numVertices += m_SubMeshes[subMesh].numVertices;
+		numVertices += m_SubMeshesDX ? m_SubMeshesDX[subMesh].numVertices : m_SubMeshes[subMesh].numVertices;
 	}
 
 	return numVertices;
 }
 
-// Request an enumeration of the vertices in the mesh. Get the individual vertices with calls
-// to GetVertex, finish the enumeration with EndEnumVertices
-void CMesh::BeginEnumVertices()
+// Return a view of the geometry of a sub-mesh with the triangles of the given level of detail
+// (see MeshView.h). Sub-meshes with fewer levels use their coarsest one
+SSubMeshView CMesh::GetSubMeshView( TUInt32 subMesh, TUInt32 lod /*= 0*/ ) const
 {
-	m_EnumVertMesh = 0;
-	m_EnumVert = 0;
+	return MakeSubMeshView( m_SubMeshes[subMesh], lod );
 }
 
-// Get the next vertex in the mesh, used after BeginEnumVertices. Fills the supplied CVector3
-// pointer with the next vertex. Returns true if a vertex was successfully returned, false if
-// there are no more vertices to enumerate
-bool CMesh::GetVertex( CVector3* pVertex )
+
+// Return the triangle BVH of the mesh for precise hit tests, building it on first request from
+// the full detail triangles of all sub-meshes
+const CMeshBVH& CMesh::GetBVH()
 {
-	// If enumerated all meshes then finished
-	if (m_EnumVertMesh >= m_NumSubMeshes)
+	if (!m_BVH)
 	{
-		return false;
+		vector<SSubMeshView> views( m_NumSubMeshes );
+		for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+		{
+			views[subMesh] = GetSubMeshView( subMesh );
+		}
+		m_BVH = new CMeshBVH;
+		m_BVH->Build( views.empty() ? 0 : &views[0], m_NumSubMeshes, m_NumNodes );
 	}
+	return *m_BVH;
+}
 
-	// If enumerated all vertices in current mesh...
-	if (m_EnumVert >= m_SubMeshes[m_EnumVertMesh].numVertices)
+
+// Get the memory used by the mesh in bytes, by category. Dynamically allocated strings in the
+// nodes are not counted
+void CMesh::GetMemoryUsage( SMeshMemoryUsage* pUsage )
+{
+	pUsage->cpuGeometry = 0;
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
 	{
-		// Move to next mesh - finished if no more meshes
-		++m_EnumVertMesh;
-		if (m_EnumVertMesh >= m_NumSubMeshes)
-		{
-			return false;
-		}
-		m_EnumVert = 0; // Start at first vertex of next mesh
+		pUsage->cpuGeometry += m_SubMeshes[subMesh].numVertices * m_SubMeshes[subMesh].vertexSize;
+		pUsage->cpuGeometry += SubMeshTotalFaces( m_SubMeshes[subMesh] ) * 3 * SubMeshIndexSize( m_SubMeshes[subMesh] );
 	}
 
-	// Get pointer to current vertex in current mesh - deal with flexible vertex size
-	TUInt8* pVertexData = m_SubMeshes[m_EnumVertMesh].vertices + 
-	                      m_EnumVert * m_SubMeshes[m_EnumVertMesh].vertexSize;
+	// DirectX sub-meshes only exist if CreateResources has been called
+	pUsage->gpuBuffers = 0;
+	for (TUInt32 subMesh = 0; m_SubMeshesDX && subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		pUsage->gpuBuffers += m_SubMeshesDX[subMesh].numVertices * m_SubMeshesDX[subMesh].vertexSize;
+		pUsage->gpuBuffers += m_SubMeshesDX[subMesh].numIndices * m_SubMeshesDX[subMesh].indexSize;
+	}
 
-	// Copy vertex coordinate to output pointer
-	// Assuming first three floats are the vertex coord x,y & z. See comment in CMesh::PreProcess
-	TFloat32* pVertexCoord = reinterpret_cast<TFloat32*>(pVertexData);
-	pVertex->x = *pVertexCoord++;
-	pVertex->y = *pVertexCoord++;
-	pVertex->z = *pVertexCoord;
+	pUsage->textures = 0;
+	for (TUInt32 material = 0; material < m_NumMaterials; ++material)
+	{
+		pUsage->textures += m_Materials[material].textureMemorySize;
+	}
 
-	return true;
+	pUsage->nodes = m_NumNodes * (sizeof(SMeshNode) + sizeof(SMeshNodeBounds)) +
+	                m_NumSubMeshes * (sizeof(SSubMesh) + (m_SubMeshesDX ? sizeof(SSubMeshDX) : 0)) +
+	                m_NumMaterials * sizeof(SMeshMaterialDX);
+
+	pUsage->bvh = m_BVH ? m_BVH->GetMemorySize() : 0;
+}
+
+// Return the system memory used by the mesh in bytes - hierarchy, sub-mesh data and the BVH
+TUInt32 CMesh::GetSystemMemorySize()
+{
+	SMeshMemoryUsage usage;
+	GetMemoryUsage( &usage );
+	return usage.cpuGeometry + usage.nodes + usage.bvh;
+}
+
+// Return the video memory used by the mesh vertex and index buffers and textures in bytes
+TUInt32 CMesh::GetVideoMemorySize()
+{
+	SMeshMemoryUsage usage;
+	GetMemoryUsage( &usage );
+	return usage.gpuBuffers + usage.textures;
 }
 
 
@@ -232,6 +256,13 @@ bool CMesh::GetVertex( CVector3* pVertex )
 
 // Create the model from an X-File, returns true on success
 bool CMesh::Load( const string& fileName )
+{
+	return Import( fileName ) && CreateResources();
+}
+
+// Import the geometry, hierarchy and materials from an X-File without creating any DirectX
+// resources. Can be called from any thread. Returns true on success
+bool CMesh::Import( const string& fileName, bool showErrors /*= true*/ )
 {
 	// Create a X-File import helper class
 	CImportXFile importFile;
@@ -245,23 +276,61 @@ bool CMesh::Load( const string& fileName )
 		return false;
 	}
 
+	// Use the binary mesh file if it is up to date
+	string binaryFileName = GetMeshBinaryName( fullFileName );
+	if (ImportBinary( binaryFileName, fullFileName ))
+	{
+		return true;
+	}
+
 	// Import the file, return on failure
-	EImportError error = importFile.ImportFile( fullFileName );
+	SXFileImportOptions options;
+	options.optimise = m_OptimiseImport;
+	options.weld = m_WeldImport;
+	options.weldEpsilon = m_WeldEpsilon;
+	options.numLODs = m_ImportLODs;
+	options.lodReduction = m_LODReduction;
+	options.lodMaxError = m_LODMaxError;
+	EImportError error = importFile.ImportFile( fullFileName, options );
 	if (error != kSuccess)
 	{
-		if (error == kFileError)
+		if (showErrors)
 		{
-			string errorMsg = "Error loading mesh " + fullFileName;
+			string errorMsg = "Error loading mesh " + fullFileName + "\n" + importFile.GetError();
 			SystemMessageBox( errorMsg.c_str(), "Mesh Error" );
 		}
 		return false;
 	}
 
-	// Release any existing geometry
-	if (m_HasGeometry)
+	// Report the time taken by each import phase to the debugger output
+	const SXFileImportTimes& times = importFile.GetImportTimes();
+	ostringstream report;
+	report << "Imported " << fileName << ": parse " << times.parseTime * 1000.0f << "ms, materials "
+	       << times.materialTime * 1000.0f << "ms, meshes " << times.meshTime * 1000.0f << "ms on "
+	       << times.numThreads << " threads (normals " << times.normalTime * 1000.0f << "ms, split "
+	       << times.splitTime * 1000.0f << "ms, weld " << times.weldTime * 1000.0f << "ms, optimise "
+	       << times.optimiseTime * 1000.0f << "ms, LODs " << times.lodTime * 1000.0f << "ms, tangents " << times.tangentTime * 1000.0f << "ms)\n";
+
+	// Report the vertex reduction from welding
+	if (m_WeldImport)
 	{
-		ReleaseResources();
+		const SXFileWeldStats& weldStats = importFile.GetWeldStats();
+		report << "  Welded " << weldStats.originalVertices << " -> " << weldStats.weldedVertices
+		       << " vertices, " << weldStats.originalBytes << " -> " << weldStats.weldedBytes << " bytes\n";
+	}
+
+	// Report the vertex cache efficiency of each sub-mesh before and after optimisation
+	SXFileCacheStats cacheStats;
+	for (TUInt32 subMesh = 0; importFile.GetSubMeshCacheStats( subMesh, &cacheStats ); ++subMesh)
+	{
+		report << "  Sub-mesh " << subMesh << ": ACMR " << cacheStats.original.acmr << " -> "
+		       << cacheStats.optimised.acmr << ", ATVR " << cacheStats.original.atvr << " -> "
+		       << cacheStats.optimised.atvr << "\n";
 	}
+	OutputDebugStringA( report.str().c_str() );
+
+	// Release any existing geometry
+	ReleaseResources();
 
 	// Get node data from import class
 	m_NumNodes = importFile.GetNumNodes();
@@ -275,31 +344,23 @@ bool CMesh::Load( const string& fileName )
 		importFile.GetNode( node, &m_Nodes[node] );
 	}
 
-	// Get material data from import class, also load textures
-	TUInt32 requiredMaterials = importFile.GetNumMaterials();
-	m_Materials = new SMeshMaterialDX[requiredMaterials];
-	if (!m_Materials)
+	// Get material data from import class, the DirectX materials and textures are created later
+	m_NumImportedMaterials = importFile.GetNumMaterials();
+	m_ImportedMaterials = new SMeshMaterial[m_NumImportedMaterials];
+	if (!m_ImportedMaterials)
 	{
 		ReleaseResources();
 		return false;
 	}
-	for (m_NumMaterials = 0; m_NumMaterials < requiredMaterials; ++m_NumMaterials)
+	for (TUInt32 material = 0; material < m_NumImportedMaterials; ++material)
 	{
-		SMeshMaterial importMaterial; 
-		importFile.GetMaterial( m_NumMaterials, &importMaterial );
-		if (!CreateMaterialDX( importMaterial, &m_Materials[m_NumMaterials] ))
-		{
-			ReleaseResources();
-			return false;
-		}
+		importFile.GetMaterial( material, &m_ImportedMaterials[material] );
 	}
 
-	// Get submesh data from import class - convert to DirectX data for rendering
-	// but retain original data for easy access to vertices / faces
+	// Get submesh data from import class, retained for easy access to vertices / faces
 	TUInt32 requiredSubMeshes = importFile.GetNumSubMeshes();
 	m_SubMeshes = new SSubMesh[requiredSubMeshes];
-	m_SubMeshesDX = new SSubMeshDX[requiredSubMeshes];
-	if (!m_SubMeshes || !m_SubMeshesDX)
+	if (!m_SubMeshes)
 	{
 		ReleaseResources();
 		return false;
@@ -311,11 +372,21 @@ bool CMesh::Load( const string& fileName )
 		bool needTangents = RenderMethodUsesTangents( meshMethod );
 
 		importFile.GetSubMesh( m_NumSubMeshes, &m_SubMeshes[m_NumSubMeshes], needTangents );
-		if (!CreateSubMeshDX( m_SubMeshes[m_NumSubMeshes], &m_SubMeshesDX[m_NumSubMeshes] ))
+	}
+
+	// Compress the vertices if requested and report the size reduction and largest errors
+	if (m_CompressImport != 0)
+	{
+		SVertexCompressStats compressStats = SVertexCompressStats();
+		for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
 		{
-			ReleaseResources();
-			return false;
+			CompressSubMesh( &m_SubMeshes[subMesh], m_CompressImport, &compressStats );
 		}
+		report.str( "" );
+		report << "  Compressed vertices " << compressStats.originalBytes << " -> " << compressStats.compressedBytes
+		       << " bytes, errors: position " << compressStats.positionError << ", normal "
+		       << ToDegrees( compressStats.normalError ) << " degrees, UV " << compressStats.uvError << "\n";
+		OutputDebugStringA( report.str().c_str() );
 	}
 
 	// Geometry pre-processing - just calculating bounding box in this example
@@ -324,8 +395,210 @@ bool CMesh::Load( const string& fileName )
 		ReleaseResources();
 		return false;
 	}
+	CalculateLODErrors();
+
+	// Report the triangles in each level of detail
+	report.str( "" );
+	report << "  Levels of detail:";
+	for (TUInt32 lod = 0; lod < m_NumLODs; ++lod)
+	{
+		report << " " << GetNumTriangles( lod ) << " triangles (error " << m_LODErrors[lod] << ")";
+	}
+	report << "\n";
+	OutputDebugStringA( report.str().c_str() );
+
+	// Write the binary mesh file for next time. Not an error if this fails (e.g. read-only
+	// media folder), the X-File will just be imported again
+	if (!WriteBinary( binaryFileName, fullFileName ))
+	{
+		OutputDebugStringA( ("Could not write binary mesh " + binaryFileName + "\n").c_str() );
+	}
+
+	return true;
+}
+
+
+// Find the number of levels of detail and the error of each level over all sub-meshes. A
+// sub-mesh with fewer levels renders its coarsest level in place of the missing ones. The errors
+// are made to never decrease with the level, as SelectLOD expects
+void CMesh::CalculateLODErrors()
+{
+	m_NumLODs = 1;
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		m_NumLODs = max( m_NumLODs, m_SubMeshes[subMesh].numLODs );
+	}
+	for (TUInt32 lod = 0; lod < m_NumLODs; ++lod)
+	{
+		m_LODErrors[lod] = (lod > 0) ? m_LODErrors[lod - 1] : 0.0f;
+		for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+		{
+			const SSubMesh& subMeshData = m_SubMeshes[subMesh];
+			m_LODErrors[lod] = max( m_LODErrors[lod], subMeshData.lods[min( lod, subMeshData.numLODs - 1 )].error );
+		}
+	}
+}
+
+// Return the import options that affect the imported mesh data, stored in binary mesh files.
+// Which render methods need tangents (one bit per method), whether meshes are optimised or
+// welded, and the weld and level of detail settings
+SMeshBinaryOptions CMesh::GetImportOptions()
+{
+	SMeshBinaryOptions options = SMeshBinaryOptions();
+	for (TUInt32 method = 0; method < NumRenderMethods; ++method)
+	{
+		if (RenderMethodUsesTangents( static_cast<ERenderMethod>(method) ))
+		{
+			options.flags |= 1 << method;
+		}
+	}
+	if (m_OptimiseImport)
+	{
+		options.flags |= kImportOptimised;
+	}
+	if (m_WeldImport)
+	{
+		options.flags |= kImportWelded;
+		options.weldEpsilon = m_WeldEpsilon;
+	}
+	options.numLODs = min( max( m_ImportLODs, 1u ), kiMaxLODs );
+	if (options.numLODs > 1)
+	{
+		options.lodReduction = m_LODReduction;
+		options.lodMaxError = m_LODMaxError;
+	}
+	options.flags |= m_CompressImport << kImportCompressionShift;
+	return options;
+}
+
+// Load the mesh from a binary mesh file, returns false if it is missing or out of date. The
+// sub-mesh data is used in place from the mapped file
+bool CMesh::ImportBinary( const string& binaryFileName, const string& sourceFileName )
+{
+	// Release any existing geometry first, the mesh can only hold one mapped file
+	ReleaseResources();
+
+	if (!m_Binary.Open( binaryFileName ))
+	{
+		return false;
+	}
+	if (!m_Binary.IsUpToDate( sourceFileName, GetImportOptions() ))
+	{
+		m_Binary.Close();
+		return false;
+	}
+
+	m_NumNodes = m_Binary.NumNodes();
+	m_Nodes = new SMeshNode[m_NumNodes];
+	m_NodeBounds = new SMeshNodeBounds[m_NumNodes];
+	for (TUInt32 node = 0; node < m_NumNodes; ++node)
+	{
+		m_Binary.GetNode( node, &m_Nodes[node] );
+		m_Binary.GetNodeBounds( node, &m_NodeBounds[node] );
+	}
+
+	m_NumImportedMaterials = m_Binary.NumMaterials();
+	m_ImportedMaterials = new SMeshMaterial[m_NumImportedMaterials];
+	for (TUInt32 material = 0; material < m_NumImportedMaterials; ++material)
+	{
+		m_Binary.GetMaterial( material, &m_ImportedMaterials[material] );
+	}
+
+	// Sub-meshes point into the mapped file, no vertex data is copied
+	m_NumSubMeshes = m_Binary.NumSubMeshes();
+	m_SubMeshes = new SSubMesh[m_NumSubMeshes];
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		m_Binary.GetSubMesh( subMesh, &m_SubMeshes[subMesh] );
+	}
+
+	// Mesh and node bounds were calculated when the file was written
+	const SMeshBinaryHeader& header = m_Binary.Header();
+	m_MinBounds = CVector3( header.minBounds[0], header.minBounds[1], header.minBounds[2] );
+	m_MaxBounds = CVector3( header.maxBounds[0], header.maxBounds[1], header.maxBounds[2] );
+	m_BoundingRadius = header.boundingRadius;
+	CalculateLODErrors();
+
+	return true;
+}
+
+// Write the imported mesh to a binary mesh file, returns false on failure
+bool CMesh::WriteBinary( const string& binaryFileName, const string& sourceFileName )
+{
+	CMeshBinaryWriter writer;
+	if (!writer.SetSource( sourceFileName ))
+	{
+		return false;
+	}
+	writer.SetOptions( GetImportOptions() );
+	writer.SetBounds( m_MinBounds, m_MaxBounds, m_BoundingRadius );
+	for (TUInt32 node = 0; node < m_NumNodes; ++node)
+	{
+		writer.AddNode( m_Nodes[node], m_NodeBounds[node] );
+	}
+	for (TUInt32 material = 0; material < m_NumImportedMaterials; ++material)
+	{
+		writer.AddMaterial( m_ImportedMaterials[material] );
+	}
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		writer.AddSubMesh( m_SubMeshes[subMesh] );
+	}
+	return writer.Write( binaryFileName );
+}
+
+// Create the DirectX materials, textures and buffers for an imported mesh. Must be called from
+// the rendering thread. Returns true on success
+bool CMesh::CreateResources()
+{
+	if (!m_ImportedMaterials || m_HasGeometry)
+	{
+		return false;
+	}
+
+	// Create DirectX materials from imported materials, also load textures
+	m_Materials = new SMeshMaterialDX[m_NumImportedMaterials];
+	if (!m_Materials)
+	{
+		ReleaseResources();
+		return false;
+	}
+	for (m_NumMaterials = 0; m_NumMaterials < m_NumImportedMaterials; ++m_NumMaterials)
+	{
+		if (!CreateMaterialDX( m_ImportedMaterials[m_NumMaterials], &m_Materials[m_NumMaterials] ))
+		{
+			ReleaseResources();
+			return false;
+		}
+	}
+	delete[] m_ImportedMaterials;
+	m_ImportedMaterials = 0;
+	m_NumImportedMaterials = 0;
+
+	// Convert submesh data to DirectX data for rendering. Zero initialised so a partly created
+	// sub-mesh can be released
+	m_SubMeshesDX = new SSubMeshDX[m_NumSubMeshes]();
+	if (!m_SubMeshesDX)
+	{
+		ReleaseResources();
+		return false;
+	}
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		if (!CreateSubMeshDX( m_SubMeshes[subMesh], &m_SubMeshesDX[subMesh] ))
+		{
+			ReleaseResources();
+			return false;
+		}
+	}
 
 	m_HasGeometry = true;
+
+	// Release CPU-side geometry that is not needed now the buffers exist
+	if (m_GeometryRetention != kRetainAllGeometry)
+	{
+		ReleaseGeometry( m_GeometryRetention );
+	}
 	return true;
 }
 
@@ -342,7 +615,21 @@ bool CMesh::CreateSubMeshDX
 
 	// Buffer sizes
 	subMeshDX->numVertices = subMesh.numVertices;
-	subMeshDX->numIndices = subMesh.numFaces * 3; // Using triangle lists, so always 3 indexes per face
+	subMeshDX->numIndices = SubMeshTotalFaces( subMesh ) * 3; // Using triangle lists, so always 3 indexes per face
+
+	// The index buffer holds all levels of detail
+	subMeshDX->numLODs = subMesh.numLODs;
+	for (TUInt32 lod = 0; lod < subMesh.numLODs; ++lod)
+	{
+		subMeshDX->lods[lod] = subMesh.lods[lod];
+	}
+
+	// Compressed vertices are decoded in the vertex shader with these settings, see MeshCompress.h
+	bool compressedAttributes = (subMesh.compression & kVertexCompressAttributes) != 0;
+	bool quantisedPositions = (subMesh.compression & kVertexQuantisePositions) != 0;
+	subMeshDX->positionScale = subMesh.positionScale;
+	subMeshDX->positionOffset = subMesh.positionOffset;
+	subMeshDX->octahedralNormals = compressedAttributes;
 
 	// Create vertex element list & layout.
 	unsigned int numElts = 0;
@@ -356,7 +643,15 @@ bool CMesh::CreateSubMeshDX
 	subMeshDX->vertexElts[numElts].InputSlot = 0;               // For when using multiple vertex buffers (e.g. instancing - an advanced topic)
 	subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA; // Use this value for most cases (only changed for instancing)
 	subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;                     // --"--
-	offset += 12;
+	if (quantisedPositions)
+	{
+		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R16G16B16A16_SNORM; // Four 16-bit values, -1 to 1
+		offset += 8;
+	}
+	else
+	{
+		offset += 12;
+	}
 	++numElts;
 
 	// Repeat for each kind of vertex data
@@ -385,48 +680,49 @@ bool CMesh::CreateSubMeshDX
 	{
 		subMeshDX->vertexElts[numElts].SemanticName = "NORMAL";
 		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+		subMeshDX->vertexElts[numElts].Format = compressedAttributes ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;
 		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
 		subMeshDX->vertexElts[numElts].InputSlot = 0;
 		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
 		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
-		offset += 12;
+		offset += compressedAttributes ? 4 : 12;
 		++numElts;
 	}
 	if (subMesh.hasTangents)
 	{
 		subMeshDX->vertexElts[numElts].SemanticName = "TANGENT";
 		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+		subMeshDX->vertexElts[numElts].Format = compressedAttributes ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;
 		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
 		subMeshDX->vertexElts[numElts].InputSlot = 0;
 		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
 		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
-		offset += 12;
+		offset += compressedAttributes ? 4 : 12;
 		++numElts;
 	}
 	if (subMesh.hasTextureCoords)
 	{
 		subMeshDX->vertexElts[numElts].SemanticName = "TEXCOORD";
 		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R32G32_FLOAT;
+		subMeshDX->vertexElts[numElts].Format = compressedAttributes ? DXGI_FORMAT_R16G16_FLOAT : DXGI_FORMAT_R32G32_FLOAT;
 		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
 		subMeshDX->vertexElts[numElts].InputSlot = 0;
 		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
 		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
-		offset += 8;
+		offset += compressedAttributes ? 4 : 8;
 		++numElts;
 	}
 	if (subMesh.hasVertexColours)
 	{
 		subMeshDX->vertexElts[numElts].SemanticName = "COLOR";
 		subMeshDX->vertexElts[numElts].SemanticIndex = 0;
-		subMeshDX->vertexElts[numElts].Format = DXGI_FORMAT_R8G8B8A8_UNORM; // A RGBA colour with 1 byte (0-255) per component
+		// Imported colours are four floats, compressed colours have 1 byte (0-255) per component
+		subMeshDX->vertexElts[numElts].Format = compressedAttributes ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R32G32B32A32_FLOAT;
 		subMeshDX->vertexElts[numElts].AlignedByteOffset = offset;
 		subMeshDX->vertexElts[numElts].InputSlot = 0;
 		subMeshDX->vertexElts[numElts].InputSlotClass = D3D10_INPUT_PER_VERTEX_DATA;
 		subMeshDX->vertexElts[numElts].InstanceDataStepRate = 0;
-		offset += 4;
+		offset += compressedAttributes ? 4 : 16;
 		++numElts;
 	}
 	subMeshDX->vertexSize = offset;
@@ -454,13 +750,15 @@ bool CMesh::CreateSubMeshDX
 	}
 
 
-	// Create the index buffer - assuming 2-byte (WORD) index data
+	// Create the index buffer - 2-byte (WORD) index data unless the sub-mesh has too many vertices
+	subMeshDX->indexSize = SubMeshIndexSize( subMesh );
+	subMeshDX->indexFormat = (subMeshDX->indexSize == sizeof(TUInt32)) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 	bufferDesc.BindFlags = D3D10_BIND_INDEX_BUFFER;
 	bufferDesc.Usage = D3D10_USAGE_DEFAULT;
-	bufferDesc.ByteWidth = subMeshDX->numIndices * sizeof(WORD);
+	bufferDesc.ByteWidth = subMeshDX->numIndices * subMeshDX->indexSize;
 	bufferDesc.CPUAccessFlags = 0;
 	bufferDesc.MiscFlags = 0;
-	initData.pSysMem = subMesh.faces;   
+	initData.pSysMem = SubMeshFaceData( subMesh );
 	if (FAILED( g_pd3dDevice->CreateBuffer( &bufferDesc, &initData, &subMeshDX->indexBuffer )))
 	{
 		return false;
@@ -469,6 +767,71 @@ bool CMesh::CreateSubMeshDX
 	return true;
 }
 
+// Return the bits per pixel of a texture format. Block compressed formats store 4x4 pixel blocks,
+// this is the average over a block
+static TUInt32 TextureFormatBits( DXGI_FORMAT format )
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS: case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS: case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+	case DXGI_FORMAT_BC2_TYPELESS: case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS: case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS: case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_R8_UNORM: case DXGI_FORMAT_A8_UNORM:
+		return 8;
+	case DXGI_FORMAT_R8G8_UNORM: case DXGI_FORMAT_R16_FLOAT: case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_B5G6R5_UNORM: case DXGI_FORMAT_B5G5R5A1_UNORM:
+		return 16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: case DXGI_FORMAT_R16G16B16A16_UNORM: case DXGI_FORMAT_R32G32_FLOAT:
+		return 64;
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+		return 96;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+	default: // 8-bit RGBA and other 32-bit formats
+		return 32;
+	}
+}
+
+// Return the video memory used by a texture in bytes, including mip-maps. Only 2D textures (as
+// loaded from image files) are counted
+static TUInt32 TextureMemorySize( ID3D10ShaderResourceView* texture )
+{
+	ID3D10Resource* resource = 0;
+	texture->GetResource( &resource );
+	if (!resource)
+	{
+		return 0;
+	}
+
+	TUInt32 size = 0;
+	D3D10_RESOURCE_DIMENSION dimension;
+	resource->GetType( &dimension );
+	if (dimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D)
+	{
+		D3D10_TEXTURE2D_DESC desc;
+		static_cast<ID3D10Texture2D*>(resource)->GetDesc( &desc );
+		bool blockCompressed = desc.Format >= DXGI_FORMAT_BC1_TYPELESS && desc.Format <= DXGI_FORMAT_BC5_SNORM;
+		TUInt32 bits = TextureFormatBits( desc.Format );
+		for (TUInt32 mip = 0; mip < desc.MipLevels; ++mip)
+		{
+			TUInt32 width = max( desc.Width >> mip, 1u );
+			TUInt32 height = max( desc.Height >> mip, 1u );
+			if (blockCompressed)
+			{
+				width = (width + 3) & ~3u;
+				height = (height + 3) & ~3u;
+			}
+			size += width * height * bits / 8;
+		}
+		size *= desc.ArraySize;
+	}
+	resource->Release();
+	return size;
+}
+
 // Creates a DirectX specific material from an imported material
 bool CMesh::CreateMaterialDX
 (
@@ -492,6 +855,7 @@ bool CMesh::CreateMaterialDX
 
 	// Load material textures
 	materialDX->numTextures = material.numTextures;
+	materialDX->textureMemorySize = 0;
 	for (TUInt32 texture = 0; texture < material.numTextures; ++texture)
 	{
 		string fullFileName = MediaFolder + material.textureFileNames[texture];
@@ -501,12 +865,84 @@ bool CMesh::CreateMaterialDX
 			SystemMessageBox( errorMsg.c_str(), "Mesh Error" );
 			return false;
 		}
+		materialDX->textureMemorySize += TextureMemorySize( materialDX->textures[texture] );
 	}
 	return true;
 }
 
 
-// Pre-processing after loading, returns true on success - just calculates bounding box here
+// Release the CPU-side sub-mesh data not needed for the given retention, once the vertex and
+// index buffers have been created. Collision geometry copies the positions (still quantised if
+// they were) and the full detail faces into new arrays - positions are first in each vertex.
+// Either way the binary mesh file the data may point into is no longer needed and is closed
+void CMesh::ReleaseGeometry( EMeshGeometryRetention retention )
+{
+	// Build the BVH while the sub-mesh data is still available
+	if (retention == kRetainBVHOnly)
+	{
+		GetBVH();
+	}
+
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		SSubMesh& subMeshData = m_SubMeshes[subMesh];
+
+		// Sub-mesh with only positions and one level of detail
+		SSubMesh collision = subMeshData;
+		collision.hasSkinningData = collision.hasNormals = collision.hasTangents = false;
+		collision.hasTextureCoords = collision.hasVertexColours = false;
+		collision.compression &= kVertexQuantisePositions;
+		collision.vertexSize = SubMeshVertexSize( collision );
+		collision.vertices = 0;
+		collision.faces = 0;
+		collision.largeFaces = 0;
+		collision.numLODs = 1;
+		collision.lods[0].firstFace = 0;
+		if (retention == kRetainCollisionGeometry)
+		{
+			collision.vertices = new TUInt8[collision.numVertices * collision.vertexSize];
+			for (TUInt32 vertex = 0; vertex < collision.numVertices; ++vertex)
+			{
+				memcpy( collision.vertices + vertex * collision.vertexSize,
+				        subMeshData.vertices + vertex * subMeshData.vertexSize, collision.vertexSize );
+			}
+			TUInt32 numFaces = subMeshData.lods[0].numFaces;
+			if (subMeshData.largeFaces)
+			{
+				collision.largeFaces = new SMeshLargeFace[numFaces];
+				memcpy( collision.largeFaces, subMeshData.largeFaces, numFaces * sizeof(SMeshLargeFace) );
+			}
+			else
+			{
+				collision.faces = new SMeshFace[numFaces];
+				memcpy( collision.faces, subMeshData.faces, numFaces * sizeof(SMeshFace) );
+			}
+		}
+		else
+		{
+			collision.numVertices = 0;
+			collision.numFaces = 0;
+			collision.lods[0].numFaces = 0;
+		}
+
+		// Sub-mesh data loaded from a binary mesh file belongs to the file mapping
+		if (!m_Binary.IsOpen())
+		{
+			delete[] subMeshData.vertices;
+			delete[] subMeshData.faces;
+			delete[] subMeshData.largeFaces;
+		}
+		subMeshData = collision;
+	}
+
+	if (m_Binary.IsOpen())
+	{
+		m_Binary.Close();
+	}
+}
+
+
+// Pre-processing after loading, returns true on success - just calculates mesh and node bounds here
 // Rejects mesh if no sub-meshes or any empty sub-meshes
 bool CMesh::PreProcess()
 {
@@ -516,13 +952,8 @@ bool CMesh::PreProcess()
 		return false;
 	}
 
-	// Set initial bounds from first vertex
-	// Assuming first three floats are the vertex coord x,y & z. Would be better to support
-	// a flexible data type system like DirectX vertex declarations (D3DVERTEXELEMENT9)
-	TFloat32* pVertexCoord = reinterpret_cast<TFloat32*>(m_SubMeshes[0].vertices);
-	m_MinBounds.x = m_MaxBounds.x = *pVertexCoord++;
-	m_MinBounds.y = m_MaxBounds.y = *pVertexCoord++;
-	m_MinBounds.z = m_MaxBounds.z = *pVertexCoord;
+	// Set initial bounds from first vertex, decoding compressed vertices
+	m_MinBounds = m_MaxBounds = GetSubMeshView( 0 ).positions[0];
 	m_BoundingRadius = m_MinBounds.Length();
 
 	// Go through all submeshes ...
@@ -535,15 +966,11 @@ bool CMesh::PreProcess()
 		}
 
 		// Go through all vertices
-		TUInt8* pVertex = m_SubMeshes[subMesh].vertices;
-		for (TUInt32 vert = 0; vert < m_SubMeshes[subMesh].numVertices; ++vert)
+		SMeshPositionView positions = GetSubMeshView( subMesh ).positions;
+		for (TUInt32 vert = 0; vert < positions.numVertices; ++vert)
 		{
 			// Get vertex coord as vector
-			pVertexCoord = reinterpret_cast<TFloat32*>(pVertex); // Assume float x,y,z coord again
-			CVector3 vertex;
-			vertex.x = *pVertexCoord++;
-			vertex.y = *pVertexCoord++;
-			vertex.z = *pVertexCoord;
+			CVector3 vertex = positions[vert];
 			
 			// Compare vertex against current bounds, updating bounds where necessary
 			if (vertex.x < m_MinBounds.x)
@@ -554,7 +981,6 @@ bool CMesh::PreProcess()
 			{
 				m_MaxBounds.x = vertex.x;
 			}
-			++pVertexCoord;
 
 			if (vertex.y < m_MinBounds.y)
 			{
@@ -564,7 +990,6 @@ bool CMesh::PreProcess()
 			{
 				m_MaxBounds.y = vertex.y;
 			}
-			++pVertexCoord;
 
 			if (vertex.z < m_MinBounds.z)
 			{
@@ -580,9 +1005,50 @@ bool CMesh::PreProcess()
 			{
 				m_BoundingRadius = length;
 			}
+		}
+	}
 
-			// Step to next vertex (flexible vertex size)
-			pVertex += m_SubMeshes[subMesh].vertexSize;
+	// Bounds of the geometry of each node, in the node's space. A node may control several
+	// sub-meshes, so find all the boxes first then the radius of each sphere about its box centre
+	delete[] m_NodeBounds;
+	m_NodeBounds = new SMeshNodeBounds[m_NumNodes];
+	for (TUInt32 node = 0; node < m_NumNodes; ++node)
+	{
+		SMeshNodeBounds& bounds = m_NodeBounds[node];
+		bounds.hasGeometry = false;
+		bounds.minBounds = bounds.maxBounds = bounds.centre = CVector3::kOrigin;
+		bounds.radius = 0.0f;
+	}
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		SMeshPositionView positions = GetSubMeshView( subMesh ).positions;
+		SMeshNodeBounds& bounds = m_NodeBounds[m_SubMeshes[subMesh].node];
+		if (!bounds.hasGeometry)
+		{
+			bounds.hasGeometry = true;
+			bounds.minBounds = bounds.maxBounds = positions[0];
+		}
+		for (TUInt32 vert = 0; vert < positions.numVertices; ++vert)
+		{
+			CVector3 vertex = positions[vert];
+			for (TUInt32 axis = 0; axis < 3; ++axis)
+			{
+				bounds.minBounds[axis] = Min( bounds.minBounds[axis], vertex[axis] );
+				bounds.maxBounds[axis] = Max( bounds.maxBounds[axis], vertex[axis] );
+			}
+		}
+	}
+	for (TUInt32 node = 0; node < m_NumNodes; ++node)
+	{
+		m_NodeBounds[node].centre = (m_NodeBounds[node].minBounds + m_NodeBounds[node].maxBounds) * 0.5f;
+	}
+	for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+	{
+		SMeshPositionView positions = GetSubMeshView( subMesh ).positions;
+		SMeshNodeBounds& bounds = m_NodeBounds[m_SubMeshes[subMesh].node];
+		for (TUInt32 vert = 0; vert < positions.numVertices; ++vert)
+		{
+			bounds.radius = Max( bounds.radius, Length( positions[vert] - bounds.centre ) );
 		}
 	}
 
@@ -590,12 +1056,45 @@ bool CMesh::PreProcess()
 }
 
 
+//-----------------------------------------------------------------------------
+// Level of detail
+//-----------------------------------------------------------------------------
+
+// Select the level of detail to render given the size on screen of one model space unit at
+// the mesh's distance, in pixels. Chooses the coarsest level whose error is within the pixel
+// error. To prevent flickering between levels, the current level is only left when a level's
+// error is a margin (the hysteresis) inside or outside the pixel error
+TUInt32 CMesh::SelectLOD( TFloat32 pixelsPerUnit, TUInt32 currentLOD )
+{
+	if (m_NumLODs == 0)
+	{
+		return 0;
+	}
+	TUInt32 lod = min( currentLOD, m_NumLODs - 1 );
+
+	// Move to coarser levels while their error is comfortably within the limit, otherwise move to
+	// finer levels while the current error is clearly over it. Errors increase with the level
+	TFloat32 coarserLimit = m_LODPixelError * (1.0f - m_LODHysteresis);
+	TFloat32 finerLimit = m_LODPixelError * (1.0f + m_LODHysteresis);
+	while (lod + 1 < m_NumLODs && m_LODErrors[lod + 1] * pixelsPerUnit <= coarserLimit)
+	{
+		++lod;
+	}
+	while (lod > 0 && m_LODErrors[lod] * pixelsPerUnit > finerLimit)
+	{
+		--lod;
+	}
+	return lod;
+}
+
+
 //-----------------------------------------------------------------------------
 // Rendering
 //-----------------------------------------------------------------------------
 
-// Render the model using the given matrix list as a hierarchy (must be one matrix per node)
-void CMesh::Render(	CMatrix4x4* matrices )
+// Render the model using the given matrix list as a hierarchy (must be one matrix per node).
+// Renders the given level of detail, sub-meshes with fewer levels use their coarsest one
+void CMesh::Render(	CAffine3x4* matrices, TUInt32 lod /*= 0*/ )
 {
 	if (!m_HasGeometry) return;
 
@@ -605,26 +1104,33 @@ void CMesh::Render(	CMatrix4x4* matrices )
 		SSubMeshDX& subMeshDX = m_SubMeshesDX[subMesh];
 		SMeshMaterialDX& material = m_Materials[subMeshDX.material];
 
+		// Expand the node's affine transform to the full world matrix needed by the shaders
+		CMatrix4x4 worldMatrix;
+		matrices[subMeshDX.node].GetMatrix( worldMatrix );
+
 		// Set up render method passing material colours & textures and the sub-mesh's world matrix, also get back the fx file technique to use
-		SetRenderMethod( material.renderMethod, &material.diffuseColour, &material.specularColour, material.specularPower, material.textures, &matrices[subMeshDX.node] );
+		SetRenderMethod( material.renderMethod, &material.diffuseColour, &material.specularColour, material.specularPower, material.textures, &worldMatrix );
+		SetVertexDecoding( subMeshDX.positionScale, subMeshDX.positionOffset, subMeshDX.octahedralNormals );
 		ID3D10EffectTechnique* technique = GetRenderMethodTechnique( material.renderMethod );
 
 		// Select vertex and index buffer for sub-mesh - assuming all geometry data is triangle lists
 		UINT offset = 0;
 		g_pd3dDevice->IASetVertexBuffers( 0, 1, &subMeshDX.vertexBuffer, &subMeshDX.vertexSize, &offset );
 		g_pd3dDevice->IASetInputLayout(subMeshDX.vertexLayout );
-		g_pd3dDevice->IASetIndexBuffer(subMeshDX.indexBuffer, DXGI_FORMAT_R16_UINT, 0 );
+		g_pd3dDevice->IASetIndexBuffer(subMeshDX.indexBuffer, subMeshDX.indexFormat, 0 );
 		g_pd3dDevice->IASetPrimitiveTopology( D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 
 		// Render the sub-mesh. Geometry buffers and shader variables, just select the technique for this method and draw.
+		// Only the faces of the selected level of detail are drawn
+		const SSubMeshLOD& lodFaces = subMeshDX.lods[min( lod, subMeshDX.numLODs - 1 )];
 		D3D10_TECHNIQUE_DESC techDesc;
 		technique->GetDesc( &techDesc );
 		for( UINT p = 0; p < techDesc.Passes; ++p )
 		{
 			technique->GetPassByIndex( p )->Apply( 0 );
-			g_pd3dDevice->DrawIndexed( subMeshDX.numIndices, 0, 0 );
+			g_pd3dDevice->DrawIndexed( lodFaces.numFaces * 3, lodFaces.firstFace * 3, 0 );
 		}
-		g_pd3dDevice->DrawIndexed( subMeshDX.numIndices, 0, 0 );
+		g_pd3dDevice->DrawIndexed( lodFaces.numFaces * 3, lodFaces.firstFace * 3, 0 );
 	}
 }
 
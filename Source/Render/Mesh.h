@@ -14,11 +14,33 @@ using namespace std;
 #include "Defines.h"
 #include "CVector3.h"
 #include "CMatrix4x4.h"
+#include "CAffine3x4.h"
 #include "MeshData.h"
+#include "MeshView.h"
+#include "MeshBVH.h"
+#include "MeshBinary.h"
 #include "Camera.h"
 
 namespace gen
 {
+
+// Memory used by a mesh in bytes, see CMesh::GetMemoryUsage
+struct SMeshMemoryUsage
+{
+	TUInt32 cpuGeometry; // Sub-mesh vertex & face data in system memory, owned or mapped from a binary mesh file
+	TUInt32 gpuBuffers;  // Vertex & index buffers
+	TUInt32 textures;    // Material textures, including mip-maps
+	TUInt32 nodes;       // Hierarchy, node bounds and the sub-mesh & material records
+	TUInt32 bvh;         // Triangle BVH, 0 if not built
+};
+
+// What CPU-side geometry a mesh keeps once its vertex and index buffers have been created
+enum EMeshGeometryRetention
+{
+	kRetainAllGeometry,       // Keep all imported sub-mesh data
+	kRetainCollisionGeometry, // Keep only positions and full detail faces, enough for views & the BVH
+	kRetainBVHOnly,           // Build the BVH then release all sub-mesh vertex & face data
+};
 	
 // Mesh class
 class CMesh
@@ -45,7 +67,7 @@ public:
 public:
 
 	/////////////////////////////////////
-	// Geometry access / enumeration
+	// Geometry access
 
 	// Get minimum and maximum bounds (axis-aligned)
 	const CVector3& MinBounds()
@@ -63,31 +85,102 @@ public:
 		return m_BoundingRadius;
 	}
 
+	// Get the bounds of the geometry controlled by a node, in the node's space. Combine with a
+	// node's world matrix for the bounds of that part of an entity (see CEntity::GetNodeWorldBounds)
+	const SMeshNodeBounds& GetNodeBounds( TUInt32 node ) const
+	{
+		return m_NodeBounds[node];
+	}
 
-	// Return total number of triangles in the mesh
-	TUInt32 GetNumTriangles();
-
-	// Request an enumeration of the triangles in the mesh. Get the individual triangles with
-	// calls to GetTriangle, finish the enumeration with EndEnumTriangles
-	void BeginEnumTriangles();
-
-	// Get the next triangle in the mesh, used after BeginEnumTriangles. Fills the supplied
-	// CVector3 pointers with the three vertex coordinates of the triangle. Returns true if a
-	// triangle was successfully returned, false if there are no more triangles to enumerate
-	bool GetTriangle( CVector3* pVertex1, CVector3* pVertex2, CVector3* pVertex3 );
 
+	// Return total number of triangles in the mesh at the given level of detail (see SelectLOD)
+	TUInt32 GetNumTriangles( TUInt32 lod = 0 );
 
 	// Return total number of vertices in the mesh
 	TUInt32 GetNumVertices();
 
-	// Request an enumeration of the vertices in the mesh. Get the individual vertices with calls
-	// to GetVertex, finish the enumeration with EndEnumVertices
-	void BeginEnumVertices();
+	// Return the number of sub-meshes, each is a block of geometry controlled by a single node
+	TUInt32 GetNumSubMeshes() const
+	{
+		return m_NumSubMeshes;
+	}
+
+	// Return a view of the geometry of a sub-mesh with the triangles of the given level of detail,
+	// sub-mesh positions are in the space of its node. Views read the mesh data in place and hold
+	// no state, so the geometry can be scanned by several users or threads at once (see MeshView.h)
+	SSubMeshView GetSubMeshView( TUInt32 subMesh, TUInt32 lod = 0 ) const;
+
+	// Call the given function for each triangle of the mesh at the given level of detail, as
+	// function( subMesh, corners ) where corners points to the three corner positions
+	template <class TFunction> void ForEachTriangle( TFunction function, TUInt32 lod = 0 ) const
+	{
+		CVector3 corners[3];
+		for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+		{
+			SSubMeshView view = GetSubMeshView( subMesh, lod );
+			for (TUInt32 triangle = 0; triangle < view.triangles.numTriangles; ++triangle)
+			{
+				view.GetTriangle( triangle, corners );
+				function( subMesh, corners );
+			}
+		}
+	}
+
+	// Call the given function for each vertex position in the mesh, as function( subMesh, position ).
+	// Positions are decoded in blocks
+	template <class TFunction> void ForEachVertex( TFunction function ) const
+	{
+		const TUInt32 BlockSize = 64;
+		CVector3 positions[BlockSize];
+		for (TUInt32 subMesh = 0; subMesh < m_NumSubMeshes; ++subMesh)
+		{
+			SMeshPositionView view = GetSubMeshView( subMesh ).positions;
+			for (TUInt32 first = 0; first < view.numVertices; first += BlockSize)
+			{
+				TUInt32 count = min( BlockSize, view.numVertices - first );
+				view.GetPositions( first, count, positions );
+				for (TUInt32 vertex = 0; vertex < count; ++vertex)
+				{
+					function( subMesh, positions[vertex] );
+				}
+			}
+		}
+	}
+
+
+	/////////////////////////////////////
+	// Collision
+
+	// Return the triangle BVH of the mesh for precise hit tests (see MeshBVH.h). It is built the
+	// first time it is requested, then shared by all users of the mesh. Building is not thread
+	// safe, so request it once from one thread before querying it from several
+	const CMeshBVH& GetBVH();
+
 
-	// Get the next vertex in the mesh, used after BeginEnumVertices. Fills the supplied CVector3
-	// pointer with the next vertex. Returns true if a vertex was successfully returned, false if
-	// there are no more vertices to enumerate
-	bool GetVertex( CVector3* pVertex );
+	/////////////////////////////////////
+	// Memory usage
+
+	// Get the memory used by the mesh in bytes, by category
+	void GetMemoryUsage( SMeshMemoryUsage* pUsage );
+
+	// Return the memory used by the mesh in bytes, split into system memory (hierarchy, sub-mesh
+	// data and the BVH) and video memory (vertex / index buffers and textures)
+	TUInt32 GetSystemMemorySize();
+	TUInt32 GetVideoMemorySize();
+
+	// What CPU-side geometry meshes keep after CreateResources (all geometry by default). The
+	// vertex buffers hold everything needed for rendering, so most meshes only need positions
+	// and faces for collision, or just the BVH. Once released, sub-mesh views only have positions
+	// and the full detail triangles, or are empty if only the BVH is kept. Not an import option,
+	// binary mesh files are unaffected
+	static EMeshGeometryRetention GetGeometryRetention()
+	{
+		return m_GeometryRetention;
+	}
+	static void SetGeometryRetention( EMeshGeometryRetention retention )
+	{
+		m_GeometryRetention = retention;
+	}
 
 
 	/////////////////////////////////////
@@ -110,12 +203,111 @@ public:
 	// Load the mesh from an X-File
 	bool Load( const string& fileName );
 
+	// Loading in two stages, as used to load several meshes in parallel. Import reads the X-File
+	// and prepares the geometry without using DirectX, so may be called from any thread - pass
+	// false to not display file errors. CreateResources then creates the DirectX materials and
+	// buffers for the imported mesh and must be called from the rendering thread.
+	// Import uses the binary mesh file next to the X-File (see MeshBinary.h) if it is up to date,
+	// otherwise the X-File is imported and the binary mesh file written for next time
+	bool Import( const string& fileName, bool showErrors = true );
+	bool CreateResources();
+
+	// Whether imported X-Files have their triangles and vertices reordered for the GPU vertex
+	// cache and vertex fetch (on by default). Part of the import options, so changing it causes
+	// binary mesh files to be rewritten
+	static bool GetOptimiseImport()
+	{
+		return m_OptimiseImport;
+	}
+	static void SetOptimiseImport( bool optimise )
+	{
+		m_OptimiseImport = optimise;
+	}
+
+	// Whether vertices of imported X-Files are welded (on by default). With an epsilon of 0 only
+	// vertices with identical vertex data are welded, otherwise those whose components all round
+	// to the same multiple of the epsilon. Changing these causes binary mesh files to be rewritten
+	static bool GetWeldImport()
+	{
+		return m_WeldImport;
+	}
+	static TFloat32 GetWeldEpsilon()
+	{
+		return m_WeldEpsilon;
+	}
+	static void SetWeldImport( bool weld, TFloat32 epsilon = 0.0f )
+	{
+		m_WeldImport = weld;
+		m_WeldEpsilon = epsilon;
+	}
+
+	// Number of levels of detail generated for imported X-Files, including the full detail level
+	// (4 by default, 1 for none). Each level aims for the given reduction of the triangles of the
+	// previous one, without moving the surface further than maxError times the size of each
+	// sub-mesh. Changing these causes binary mesh files to be rewritten
+	static TUInt32 GetImportLODs()
+	{
+		return m_ImportLODs;
+	}
+	static void SetImportLODs( TUInt32 numLODs, TFloat32 reduction = 0.5f, TFloat32 maxError = 0.05f )
+	{
+		m_ImportLODs = numLODs;
+		m_LODReduction = reduction;
+		m_LODMaxError = maxError;
+	}
+
+	// Compression of the vertices of imported X-Files, a combination of the flags in
+	// MeshCompress.h (0 by default for uncompressed vertices). Compressing normals, tangents and
+	// texture coordinates roughly halves the vertex data, and quantising positions saves a little
+	// more at the cost of some precision. Changing this causes binary mesh files to be rewritten
+	static TUInt32 GetCompressImport()
+	{
+		return m_CompressImport;
+	}
+	static void SetCompressImport( TUInt32 compression )
+	{
+		m_CompressImport = compression;
+	}
+
+
+	/////////////////////////////////////
+	// Level of detail
+
+	// Return the number of levels of detail in the mesh, level 0 is full detail
+	TUInt32 GetNumLODs()
+	{
+		return m_NumLODs;
+	}
+
+	// Select the level of detail to render given the size on screen of one model space unit at
+	// the mesh's distance, in pixels. Chooses the coarsest level whose error is within the pixel
+	// error (see SetLODSelection). To prevent flickering between levels, the current level is only
+	// left when a level's error is a margin (the hysteresis) inside or outside the pixel error
+	TUInt32 SelectLOD( TFloat32 pixelsPerUnit, TUInt32 currentLOD );
+
+	// Largest error on screen, in pixels, allowed when selecting a level of detail, and the
+	// fraction of this used as a margin before changing level (1 pixel and 0.25 by default)
+	static TFloat32 GetLODPixelError()
+	{
+		return m_LODPixelError;
+	}
+	static TFloat32 GetLODHysteresis()
+	{
+		return m_LODHysteresis;
+	}
+	static void SetLODSelection( TFloat32 pixelError, TFloat32 hysteresis )
+	{
+		m_LODPixelError = pixelError;
+		m_LODHysteresis = hysteresis;
+	}
+
 
 	/////////////////////////////////////
 	// Rendering
 
-	// Render the model using the given matrix list as a hierarchy (must be one matrix per node)
-	void Render( CMatrix4x4* matrices );
+	// Render the model using the given matrix list as a hierarchy (must be one matrix per node).
+	// Renders the given level of detail, sub-meshes with fewer levels use their coarsest one
+	void Render( CAffine3x4* matrices, TUInt32 lod = 0 );
 
 
 /*-----------------------------------------------------------------------------------------
@@ -147,6 +339,17 @@ private:
 		// Index data for the sub-mesh stored in a index buffer and the number of indices in the buffer
 		ID3D10Buffer*            indexBuffer;
 		TUInt32                  numIndices;
+		TUInt32                  indexSize;   // 2 or 4 bytes, 4 if the sub-mesh has too many vertices for 16-bit indices
+		DXGI_FORMAT              indexFormat; // Matching index buffer format
+
+		// Face range of each level of detail in the index buffer
+		TUInt32                  numLODs;
+		SSubMeshLOD              lods[kiMaxLODs];
+
+		// Decoding of compressed vertices in the vertex shader
+		CVector3                 positionScale;
+		CVector3                 positionOffset;
+		bool                     octahedralNormals;
 	};
 
 
@@ -161,6 +364,7 @@ private:
 
 		TUInt32       numTextures;
 		ID3D10ShaderResourceView* textures[kiMaxTextures];
+		TUInt32       textureMemorySize; // Bytes used by the textures above
 	};
 
 
@@ -188,6 +392,24 @@ private:
 	// Pre-processing after loading
 	bool PreProcess();
 
+	// Release the CPU-side sub-mesh data not needed for the given retention, once the vertex and
+	// index buffers have been created
+	void ReleaseGeometry( EMeshGeometryRetention retention );
+
+
+	// Find the number of levels of detail and the error of each level over all sub-meshes
+	void CalculateLODErrors();
+
+	// Return the import options that affect the imported mesh data, stored in binary mesh files
+	static SMeshBinaryOptions GetImportOptions();
+
+	// Load the mesh from a binary mesh file, returns false if it is missing or out of date. The
+	// sub-mesh data is used in place from the mapped file
+	bool ImportBinary( const string& binaryFileName, const string& sourceFileName );
+
+	// Write the imported mesh to a binary mesh file, returns false on failure
+	bool WriteBinary( const string& binaryFileName, const string& sourceFileName );
+
 
 	/*---------------------------------------------------------------------------------------------
 		Data
@@ -199,16 +421,28 @@ private:
 	// Hierarchy for mesh - stored as a depth-first list of nodes, see SMeshNode defn in MeshData.h
 	TUInt32          m_NumNodes;
 	SMeshNode*       m_Nodes;        // Dynamically allocated array
+	SMeshNodeBounds* m_NodeBounds;   // Bounds of each node's geometry, same size as above
 
 	// Sub-meshes for mesh - each uses a single material
 	TUInt32          m_NumSubMeshes;
 	SSubMesh*        m_SubMeshes;    // Original sub-mesh data (dynamically allocated array)
 	SSubMeshDX*      m_SubMeshesDX;  // DirectX sub-mesh data (vertex / index buffers)
 
+	// Triangle BVH for hit tests, 0 until first requested
+	CMeshBVH*        m_BVH;
+
+	// Binary mesh file the sub-mesh vertices and faces point into when loaded from one, otherwise
+	// the sub-mesh data is owned by the mesh
+	CMeshBinaryReader m_Binary;
+
 	// Materials used in mesh
 	TUInt32          m_NumMaterials;
 	SMeshMaterialDX* m_Materials;    // Dynamically allocated array
 
+	// Imported materials waiting for CreateResources, released once the DirectX materials exist
+	TUInt32          m_NumImportedMaterials;
+	SMeshMaterial*   m_ImportedMaterials;
+
 	// Mesh bounding volume - minimum and maximum x,y & z values stored in two vectors
 	CVector3         m_MinBounds;
 	CVector3         m_MaxBounds;
@@ -216,11 +450,25 @@ private:
 	// Bounding sphere radius (from (0,0,0) in model space)
 	TFloat32         m_BoundingRadius;
 
-	// Data to support vertex / triangle enumeration
-	TUInt32          m_EnumTriMesh;  // Current mesh being enumerated for triangles
-	TUInt32          m_EnumTri;      // Current triangle (within above mesh) being enumerated
-	TUInt32          m_EnumVertMesh; // Current mesh being enumerated for vertices
-	TUInt32          m_EnumVert;     // Current vertices (within above mesh) being enumerated
+	// Number of levels of detail over all sub-meshes and the largest error of each level
+	TUInt32          m_NumLODs;
+	TFloat32         m_LODErrors[kiMaxLODs];
+
+	// Import settings for all meshes
+	static bool      m_OptimiseImport;
+	static bool      m_WeldImport;
+	static TFloat32  m_WeldEpsilon;
+	static TUInt32   m_ImportLODs;
+	static TFloat32  m_LODReduction;
+	static TFloat32  m_LODMaxError;
+	static TUInt32   m_CompressImport;
+
+	// Geometry kept by all meshes after creating their buffers
+	static EMeshGeometryRetention m_GeometryRetention;
+
+	// Level of detail selection settings for all meshes
+	static TFloat32  m_LODPixelError;
+	static TFloat32  m_LODHysteresis;
 };
 
 
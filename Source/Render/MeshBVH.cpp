@@ -0,0 +1,586 @@
+/*******************************************
+	MeshBVH.cpp
+
+	Bounding volume hierarchy over the
+	triangles of a mesh, for precise ray,
+	segment and sphere hit tests
+********************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include "MeshBVH.h"
+
+namespace gen
+{
+
+// Number of bins the triangle centres are sorted into along each axis when searching for the
+// best split of a tree node
+const TUInt32 kBVHBins = 16;
+
+// Cost of visiting a tree node relative to testing a triangle, used by the surface area heuristic
+const TFloat32 kBVHTraversalCost = 1.0f;
+
+// A node with more triangles than this is always split, fewer are only split if cheaper
+const TUInt32 kMaxLeafTriangles = 8;
+
+// Below this depth nodes are split at the median, which limits the depth of the tree whatever
+// the heuristic chooses. Query stacks are sized from the greatest depth
+const TUInt32 kMedianSplitDepth = 32;
+const TUInt32 kMaxBVHDepth = 64;
+
+// Replaces the inverse of a zero ray direction, so box tests stay finite
+const TFloat32 kLargeInverse = 1e30f;
+
+
+/*-----------------------------------------------------------------------------------------
+	Building
+-----------------------------------------------------------------------------------------*/
+
+// An axis-aligned box used while building, empty when min > max
+struct SBVHBox
+{
+	CVector3 minBounds;
+	CVector3 maxBounds;
+};
+
+static void ClearBox( SBVHBox* pBox )
+{
+	pBox->minBounds = CVector3( 1e30f, 1e30f, 1e30f );
+	pBox->maxBounds = CVector3( -1e30f, -1e30f, -1e30f );
+}
+
+static void AddToBox( SBVHBox* pBox, const CVector3& point )
+{
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		pBox->minBounds[axis] = Min( pBox->minBounds[axis], point[axis] );
+		pBox->maxBounds[axis] = Max( pBox->maxBounds[axis], point[axis] );
+	}
+}
+
+static void AddToBox( SBVHBox* pBox, const SBVHBox& box )
+{
+	AddToBox( pBox, box.minBounds );
+	AddToBox( pBox, box.maxBounds );
+}
+
+// Half the surface area of a box, the heuristic only compares areas
+static TFloat32 BoxArea( const SBVHBox& box )
+{
+	if (box.minBounds.x > box.maxBounds.x)
+	{
+		return 0.0f;
+	}
+	CVector3 size = box.maxBounds - box.minBounds;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Working data for building the trees
+struct SBVHBuild
+{
+	vector<SMeshBVHNode>* pNodes;
+	vector<SBVHBox>       boxes;     // Box of each triangle
+	vector<CVector3>      centres;   // Centre of each triangle's box
+	vector<TUInt32>       triangles; // Triangle order, partitioned as the trees are built
+};
+
+// Return the bin of a triangle centre along an axis
+static TUInt32 CentreBin( TFloat32 centre, TFloat32 minCentre, TFloat32 binScale )
+{
+	TUInt32 bin = static_cast<TUInt32>((centre - minCentre) * binScale);
+	return Min( bin, kBVHBins - 1 );
+}
+
+// Build the tree node at the given index over a range of the build triangles, splitting it
+// into two children where the surface area heuristic predicts cheaper queries
+static void BuildNode( SBVHBuild* pBuild, TUInt32 nodeIndex, TUInt32 first, TUInt32 numTriangles,
+                       TUInt32 depth )
+{
+	// Bounds of the triangles and of their centres
+	SBVHBox box, centreBox;
+	ClearBox( &box );
+	ClearBox( &centreBox );
+	for (TUInt32 i = first; i < first + numTriangles; ++i)
+	{
+		TUInt32 triangle = pBuild->triangles[i];
+		AddToBox( &box, pBuild->boxes[triangle] );
+		AddToBox( &centreBox, pBuild->centres[triangle] );
+	}
+	SMeshBVHNode& node = (*pBuild->pNodes)[nodeIndex];
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		node.minBounds[axis] = box.minBounds[axis];
+		node.maxBounds[axis] = box.maxBounds[axis];
+	}
+	node.first = first;
+	node.numTriangles = numTriangles;
+	if (numTriangles <= 1)
+	{
+		return;
+	}
+
+	// Find the cheapest split between bins of triangle centres on any axis. The cost of a split
+	// is the traversal cost plus the triangles each side weighted by the chance of entering that
+	// side, in proportion to its area. The cost of a leaf is its number of triangles
+	TFloat32 bestCost = static_cast<TFloat32>(numTriangles);
+	TUInt32 bestAxis = 0;
+	TUInt32 bestSplit = kBVHBins; // Last bin on the left side, kBVHBins if no split found
+	TFloat32 parentArea = BoxArea( box );
+	for (TUInt32 axis = 0; axis < 3 && depth < kMedianSplitDepth && parentArea > 0.0f; ++axis)
+	{
+		TFloat32 extent = centreBox.maxBounds[axis] - centreBox.minBounds[axis];
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+		TFloat32 binScale = kBVHBins / extent;
+
+		SBVHBox binBoxes[kBVHBins];
+		TUInt32 binCounts[kBVHBins];
+		for (TUInt32 bin = 0; bin < kBVHBins; ++bin)
+		{
+			ClearBox( &binBoxes[bin] );
+			binCounts[bin] = 0;
+		}
+		for (TUInt32 i = first; i < first + numTriangles; ++i)
+		{
+			TUInt32 triangle = pBuild->triangles[i];
+			TUInt32 bin = CentreBin( pBuild->centres[triangle][axis], centreBox.minBounds[axis], binScale );
+			AddToBox( &binBoxes[bin], pBuild->boxes[triangle] );
+			++binCounts[bin];
+		}
+
+		// Sweep from the right to find the area & count right of each split, then from the left
+		TFloat32 rightAreas[kBVHBins];
+		TUInt32 rightCounts[kBVHBins];
+		SBVHBox sideBox;
+		ClearBox( &sideBox );
+		TUInt32 sideCount = 0;
+		for (TUInt32 bin = kBVHBins - 1; bin > 0; --bin)
+		{
+			AddToBox( &sideBox, binBoxes[bin] );
+			sideCount += binCounts[bin];
+			rightAreas[bin - 1] = BoxArea( sideBox );
+			rightCounts[bin - 1] = sideCount;
+		}
+		ClearBox( &sideBox );
+		sideCount = 0;
+		for (TUInt32 split = 0; split < kBVHBins - 1; ++split)
+		{
+			AddToBox( &sideBox, binBoxes[split] );
+			sideCount += binCounts[split];
+			if (sideCount == 0 || rightCounts[split] == 0)
+			{
+				continue;
+			}
+			TFloat32 cost = kBVHTraversalCost + (BoxArea( sideBox ) * sideCount +
+			                                     rightAreas[split] * rightCounts[split]) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	// Keep small nodes as leaves unless a split is cheaper
+	if (bestSplit == kBVHBins && numTriangles <= kMaxLeafTriangles)
+	{
+		return;
+	}
+
+	// Partition the triangles about the chosen split, or at the median on the longest axis if no
+	// useful split was found (e.g. all the centres are in one place)
+	vector<TUInt32>::iterator begin = pBuild->triangles.begin() + first;
+	vector<TUInt32>::iterator end = begin + numTriangles;
+	TUInt32 numLeft = 0;
+	if (bestSplit < kBVHBins)
+	{
+		TFloat32 minCentre = centreBox.minBounds[bestAxis];
+		TFloat32 binScale = kBVHBins / (centreBox.maxBounds[bestAxis] - minCentre);
+		const vector<CVector3>& centres = pBuild->centres;
+		numLeft = static_cast<TUInt32>(partition( begin, end, [&]( TUInt32 triangle )
+		{
+			return CentreBin( centres[triangle][bestAxis], minCentre, binScale ) <= bestSplit;
+		} ) - begin);
+	}
+	else
+	{
+		CVector3 extent = centreBox.maxBounds - centreBox.minBounds;
+		TUInt32 axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+		const vector<CVector3>& centres = pBuild->centres;
+		numLeft = numTriangles / 2;
+		nth_element( begin, begin + numLeft, end, [&]( TUInt32 a, TUInt32 b )
+		{
+			return centres[a][axis] < centres[b][axis];
+		} );
+	}
+
+	// Children are added as a pair, this node's reference is invalid after resizing the array
+	TUInt32 firstChild = static_cast<TUInt32>(pBuild->pNodes->size());
+	(*pBuild->pNodes)[nodeIndex].first = firstChild;
+	(*pBuild->pNodes)[nodeIndex].numTriangles = 0;
+	pBuild->pNodes->resize( firstChild + 2 );
+	BuildNode( pBuild, firstChild, first, numLeft, depth + 1 );
+	BuildNode( pBuild, firstChild + 1, first + numLeft, numTriangles - numLeft, depth + 1 );
+}
+
+
+// Build the trees for a mesh with the given number of nodes from views of all its sub-meshes
+// (the full level of detail). Replaces any existing trees
+void CMeshBVH::Build( const SSubMeshView* pSubMeshes, TUInt32 numSubMeshes, TUInt32 numNodes )
+{
+	m_Nodes.clear();
+	m_Triangles.clear();
+	m_Sources.clear();
+	m_Roots.assign( numNodes, kNoRoot );
+
+	// Gather the triangles of all sub-meshes, grouped by mesh node
+	vector<TUInt32> nodeStarts( numNodes + 1, 0 );
+	for (TUInt32 subMesh = 0; subMesh < numSubMeshes; ++subMesh)
+	{
+		nodeStarts[pSubMeshes[subMesh].node + 1] += pSubMeshes[subMesh].triangles.numTriangles;
+	}
+	for (TUInt32 node = 0; node < numNodes; ++node)
+	{
+		nodeStarts[node + 1] += nodeStarts[node];
+	}
+	TUInt32 totalTriangles = nodeStarts[numNodes];
+
+	SBVHBuild build;
+	build.pNodes = &m_Nodes;
+	build.boxes.resize( totalTriangles );
+	build.centres.resize( totalTriangles );
+	build.triangles.resize( totalTriangles );
+	vector<STriangle> triangles( totalTriangles );
+	vector<STriangleSource> sources( totalTriangles );
+	vector<TUInt32> nodeEnds( nodeStarts.begin(), nodeStarts.end() - 1 );
+	for (TUInt32 subMesh = 0; subMesh < numSubMeshes; ++subMesh)
+	{
+		const SSubMeshView& view = pSubMeshes[subMesh];
+		for (TUInt32 triangle = 0; triangle < view.triangles.numTriangles; ++triangle)
+		{
+			TUInt32 index = nodeEnds[view.node]++;
+			CVector3 corners[3];
+			view.GetTriangle( triangle, corners );
+			triangles[index].corner = corners[0];
+			triangles[index].edge1 = corners[1] - corners[0];
+			triangles[index].edge2 = corners[2] - corners[0];
+			sources[index].subMesh = subMesh;
+			sources[index].triangle = triangle;
+
+			ClearBox( &build.boxes[index] );
+			AddToBox( &build.boxes[index], corners[0] );
+			AddToBox( &build.boxes[index], corners[1] );
+			AddToBox( &build.boxes[index], corners[2] );
+			build.centres[index] = (build.boxes[index].minBounds + build.boxes[index].maxBounds) * 0.5f;
+			build.triangles[index] = index;
+		}
+	}
+
+	// Build a tree for each mesh node with triangles
+	for (TUInt32 node = 0; node < numNodes; ++node)
+	{
+		if (nodeStarts[node + 1] > nodeStarts[node])
+		{
+			m_Roots[node] = static_cast<TUInt32>(m_Nodes.size());
+			m_Nodes.resize( m_Nodes.size() + 1 );
+			BuildNode( &build, m_Roots[node], nodeStarts[node], nodeStarts[node + 1] - nodeStarts[node], 0 );
+		}
+	}
+
+	// Store the triangles in the order of the leaves
+	m_Triangles.resize( totalTriangles );
+	m_Sources.resize( totalTriangles );
+	for (TUInt32 i = 0; i < totalTriangles; ++i)
+	{
+		m_Triangles[i] = triangles[build.triangles[i]];
+		m_Sources[i] = sources[build.triangles[i]];
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Queries
+-----------------------------------------------------------------------------------------*/
+
+// Test a ray against a tree node's box, returning the fraction along the ray where it enters
+static bool RayHitsBox( const SMeshBVHNode& node, const CVector3& origin, const CVector3& invDirection,
+                        TFloat32 maxFraction, TFloat32* pEntry )
+{
+	TFloat32 entry = 0.0f;
+	TFloat32 exit = maxFraction;
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		TFloat32 slabEntry = (node.minBounds[axis] - origin[axis]) * invDirection[axis];
+		TFloat32 slabExit = (node.maxBounds[axis] - origin[axis]) * invDirection[axis];
+		if (slabEntry > slabExit)
+		{
+			swap( slabEntry, slabExit );
+		}
+		entry = Max( entry, slabEntry );
+		exit = Min( exit, slabExit );
+	}
+	*pEntry = entry;
+	return entry <= exit;
+}
+
+// Return the squared distance from a point to a tree node's box, 0 if inside
+static TFloat32 BoxDistanceSquared( const SMeshBVHNode& node, const CVector3& point )
+{
+	TFloat32 distanceSq = 0.0f;
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		TFloat32 outside = Max( node.minBounds[axis] - point[axis], point[axis] - node.maxBounds[axis] );
+		if (outside > 0.0f)
+		{
+			distanceSq += outside * outside;
+		}
+	}
+	return distanceSq;
+}
+
+// Return the point on a triangle closest to the given point (from Ericson, Real-Time Collision
+// Detection) - finds which corner, edge or the face region of the triangle the point lies in
+static CVector3 ClosestPointOnTriangle( const CVector3& point, const CVector3& corner,
+                                        const CVector3& edge1, const CVector3& edge2 )
+{
+	CVector3 toPoint = point - corner;
+	TFloat32 d1 = Dot( edge1, toPoint );
+	TFloat32 d2 = Dot( edge2, toPoint );
+	if (d1 <= 0.0f && d2 <= 0.0f)
+	{
+		return corner;
+	}
+
+	CVector3 toPoint1 = toPoint - edge1;
+	TFloat32 d3 = Dot( edge1, toPoint1 );
+	TFloat32 d4 = Dot( edge2, toPoint1 );
+	if (d3 >= 0.0f && d4 <= d3)
+	{
+		return corner + edge1;
+	}
+
+	TFloat32 vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		return corner + edge1 * (d1 / (d1 - d3));
+	}
+
+	CVector3 toPoint2 = toPoint - edge2;
+	TFloat32 d5 = Dot( edge1, toPoint2 );
+	TFloat32 d6 = Dot( edge2, toPoint2 );
+	if (d6 >= 0.0f && d5 <= d6)
+	{
+		return corner + edge2;
+	}
+
+	TFloat32 vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		return corner + edge2 * (d2 / (d2 - d6));
+	}
+
+	TFloat32 va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		return corner + edge1 + (edge2 - edge1) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	TFloat32 denominator = 1.0f / (va + vb + vc);
+	return corner + edge1 * (vb * denominator) + edge2 * (vc * denominator);
+}
+
+// Test the ray origin + t * direction for 0 <= t <= maxFraction against the node's triangles
+// (both sides), finding the nearest hit. Children are visited nearest first, so once a hit is
+// found more distant boxes are skipped
+bool CMeshBVH::IntersectRay( TUInt32 node, const CVector3& origin, const CVector3& direction,
+                             TFloat32 maxFraction, SMeshBVHHit* pHit ) const
+{
+	if (!HasTriangles( node ))
+	{
+		return false;
+	}
+	CVector3 invDirection;
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		invDirection[axis] = (direction[axis] != 0.0f) ? 1.0f / direction[axis] :
+		                     ((direction[axis] < 0.0f) ? -kLargeInverse : kLargeInverse);
+	}
+
+	// Tree nodes still to visit and the fraction along the ray where they are entered
+	TUInt32  stackNodes[kMaxBVHDepth + 1];
+	TFloat32 stackEntries[kMaxBVHDepth + 1];
+	TUInt32  stackSize = 0;
+
+	TFloat32 nearest = maxFraction;
+	TUInt32  nearestTriangle = kNoRoot;
+	TUInt32  current = m_Roots[node];
+	TFloat32 entry;
+	if (!RayHitsBox( m_Nodes[current], origin, invDirection, nearest, &entry ))
+	{
+		return false;
+	}
+	while (true)
+	{
+		const SMeshBVHNode& bvhNode = m_Nodes[current];
+		if (bvhNode.numTriangles > 0)
+		{
+			// Moller-Trumbore ray-triangle test
+			for (TUInt32 triangle = bvhNode.first; triangle < bvhNode.first + bvhNode.numTriangles; ++triangle)
+			{
+				const STriangle& tri = m_Triangles[triangle];
+				CVector3 p = Cross( direction, tri.edge2 );
+				TFloat32 determinant = Dot( tri.edge1, p );
+				if (determinant == 0.0f)
+				{
+					continue;
+				}
+				TFloat32 invDeterminant = 1.0f / determinant;
+				CVector3 s = origin - tri.corner;
+				TFloat32 u = Dot( s, p ) * invDeterminant;
+				if (u < 0.0f || u > 1.0f)
+				{
+					continue;
+				}
+				CVector3 q = Cross( s, tri.edge1 );
+				TFloat32 v = Dot( direction, q ) * invDeterminant;
+				if (v < 0.0f || u + v > 1.0f)
+				{
+					continue;
+				}
+				TFloat32 t = Dot( tri.edge2, q ) * invDeterminant;
+				if (t >= 0.0f && t <= nearest)
+				{
+					if (!pHit)
+					{
+						return true;
+					}
+					nearest = t;
+					nearestTriangle = triangle;
+				}
+			}
+		}
+		else
+		{
+			// Visit the nearer child next and stack the other
+			TFloat32 entry0, entry1;
+			bool hit0 = RayHitsBox( m_Nodes[bvhNode.first], origin, invDirection, nearest, &entry0 );
+			bool hit1 = RayHitsBox( m_Nodes[bvhNode.first + 1], origin, invDirection, nearest, &entry1 );
+			if (hit0 && hit1)
+			{
+				TUInt32 nearChild = (entry0 <= entry1) ? 0 : 1;
+				stackNodes[stackSize] = bvhNode.first + 1 - nearChild;
+				stackEntries[stackSize] = Max( entry0, entry1 );
+				++stackSize;
+				current = bvhNode.first + nearChild;
+				continue;
+			}
+			if (hit0 || hit1)
+			{
+				current = bvhNode.first + (hit0 ? 0 : 1);
+				continue;
+			}
+		}
+
+		// Take the next stacked node that is nearer than the nearest hit
+		do
+		{
+			if (stackSize == 0)
+			{
+				if (nearestTriangle == kNoRoot)
+				{
+					return false;
+				}
+				SetHit( nearestTriangle, nearest, origin + direction * nearest, pHit );
+				return true;
+			}
+			--stackSize;
+		} while (stackEntries[stackSize] > nearest);
+		current = stackNodes[stackSize];
+	}
+}
+
+// Test a sphere against the node's triangles, finding the triangle closest to the centre. Once
+// a triangle is found the search radius shrinks to its distance
+bool CMeshBVH::IntersectSphere( TUInt32 node, const CVector3& centre, TFloat32 radius,
+                                SMeshBVHHit* pHit ) const
+{
+	if (!HasTriangles( node ))
+	{
+		return false;
+	}
+
+	TUInt32 stackNodes[kMaxBVHDepth + 1];
+	TUInt32 stackSize = 0;
+	stackNodes[stackSize++] = m_Roots[node];
+
+	TFloat32 nearestSq = radius * radius;
+	TUInt32  nearestTriangle = kNoRoot;
+	CVector3 nearestPoint;
+	while (stackSize > 0)
+	{
+		const SMeshBVHNode& bvhNode = m_Nodes[stackNodes[--stackSize]];
+		if (BoxDistanceSquared( bvhNode, centre ) > nearestSq)
+		{
+			continue;
+		}
+		if (bvhNode.numTriangles > 0)
+		{
+			for (TUInt32 triangle = bvhNode.first; triangle < bvhNode.first + bvhNode.numTriangles; ++triangle)
+			{
+				const STriangle& tri = m_Triangles[triangle];
+				CVector3 point = ClosestPointOnTriangle( centre, tri.corner, tri.edge1, tri.edge2 );
+				TFloat32 distanceSq = LengthSquared( point - centre );
+				if (distanceSq <= nearestSq)
+				{
+					if (!pHit)
+					{
+						return true;
+					}
+					nearestSq = distanceSq;
+					nearestTriangle = triangle;
+					nearestPoint = point;
+				}
+			}
+		}
+		else
+		{
+			stackNodes[stackSize++] = bvhNode.first;
+			stackNodes[stackSize++] = bvhNode.first + 1;
+		}
+	}
+
+	if (nearestTriangle == kNoRoot)
+	{
+		return false;
+	}
+	SetHit( nearestTriangle, 0.0f, nearestPoint, pHit );
+	return true;
+}
+
+// Fill in a hit for the given triangle
+void CMeshBVH::SetHit( TUInt32 triangle, TFloat32 fraction, const CVector3& position, SMeshBVHHit* pHit ) const
+{
+	const STriangle& tri = m_Triangles[triangle];
+	CVector3 normal = Cross( tri.edge1, tri.edge2 );
+	TFloat32 length = normal.Length();
+	pHit->fraction = fraction;
+	pHit->position = position;
+	pHit->normal = (length > 0.0f) ? normal * (1.0f / length) : CVector3::kOrigin;
+	pHit->subMesh = m_Sources[triangle].subMesh;
+	pHit->triangle = m_Sources[triangle].triangle;
+}
+
+
+// Return the memory used by the BVH in bytes
+TUInt32 CMeshBVH::GetMemorySize() const
+{
+	return static_cast<TUInt32>(m_Nodes.size() * sizeof(SMeshBVHNode) + m_Roots.size() * sizeof(TUInt32) +
+	                            m_Triangles.size() * (sizeof(STriangle) + sizeof(STriangleSource)));
+}
+
+
+} // namespace gen
@@ -0,0 +1,151 @@
+/*******************************************
+	MeshBVH.h
+
+	Bounding volume hierarchy over the
+	triangles of a mesh, for precise ray,
+	segment and sphere hit tests
+********************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "MeshView.h"
+
+namespace gen
+{
+
+// A tree of boxes over the triangles of a mesh, so a hit test only visits the few triangles near
+// the query. The tree is split where the surface area heuristic (SAH) predicts the cheapest
+// queries - boxes that are small for the triangles they hold are least likely to be entered.
+// Sub-mesh positions are in the space of their node and the nodes of each entity move
+// independently (e.g. a turret on a hull), so there is a separate tree for each mesh node and
+// queries are made in that node's space. Transform the query by the inverse of the node's world
+// matrix, see CEntity::IntersectSegment.
+// The triangle corners are copied when the BVH is built, so it does not need the sub-mesh data
+// afterwards. A mesh builds its BVH once and it is shared by all entities using the mesh (see
+// CMesh::GetBVH). Queries do not change the BVH, so may be made from any thread
+
+// A node of the tree, 32 bytes. The two children of an interior node are stored together
+struct SMeshBVHNode
+{
+	TFloat32 minBounds[3];
+	TUInt32  first;        // Interior node: index of first child. Leaf: index of first triangle
+	TFloat32 maxBounds[3];
+	TUInt32  numTriangles; // 0 for an interior node
+};
+
+// Triangle found by a query
+struct SMeshBVHHit
+{
+	TFloat32 fraction; // Ray queries: distance to the hit as a fraction of the ray direction
+	CVector3 position; // Hit point, or for sphere queries the closest point to the sphere centre
+	CVector3 normal;   // Unit normal of the triangle, from its winding
+	TUInt32  subMesh;
+	TUInt32  triangle; // Index of the triangle in the sub-mesh's full level of detail
+};
+
+class CMeshBVH
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	// Constructor creates an empty BVH, with no nodes
+	CMeshBVH() {}
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CMeshBVH( const CMeshBVH& );
+	CMeshBVH& operator=( const CMeshBVH& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Build the trees for a mesh with the given number of nodes from views of all its sub-meshes
+	// (the full level of detail). Replaces any existing trees
+	void Build( const SSubMeshView* pSubMeshes, TUInt32 numSubMeshes, TUInt32 numNodes );
+
+	// Return true if the given mesh node has any triangles
+	bool HasTriangles( TUInt32 node ) const
+	{
+		return node < m_Roots.size() && m_Roots[node] != kNoRoot;
+	}
+
+
+	/////////////////////////////////////
+	// Queries - all in the space of the given mesh node. Without a hit pointer the query stops at
+	// the first triangle found, which is quicker when only a yes/no answer is needed
+
+	// Test the ray origin + t * direction for 0 <= t <= maxFraction against the node's triangles
+	// (both sides), finding the nearest hit
+	bool IntersectRay( TUInt32 node, const CVector3& origin, const CVector3& direction,
+	                   TFloat32 maxFraction, SMeshBVHHit* pHit = 0 ) const;
+
+	// Test the line segment from start to end, the hit fraction is the distance along it
+	bool IntersectSegment( TUInt32 node, const CVector3& start, const CVector3& end,
+	                       SMeshBVHHit* pHit = 0 ) const
+	{
+		return IntersectRay( node, start, end - start, 1.0f, pHit );
+	}
+
+	// Test a sphere against the node's triangles, finding the triangle closest to the centre
+	bool IntersectSphere( TUInt32 node, const CVector3& centre, TFloat32 radius,
+	                      SMeshBVHHit* pHit = 0 ) const;
+
+
+	/////////////////////////////////////
+	// Statistics
+
+	TUInt32 GetNumTriangles() const
+	{
+		return static_cast<TUInt32>(m_Triangles.size());
+	}
+	TUInt32 GetNumBVHNodes() const
+	{
+		return static_cast<TUInt32>(m_Nodes.size());
+	}
+
+	// Return the memory used by the BVH in bytes
+	TUInt32 GetMemorySize() const;
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Root of a mesh node with no triangles
+	static const TUInt32 kNoRoot = 0xffffffff;
+
+	// Triangle in the form used for ray tests, a corner and the two edges from it
+	struct STriangle
+	{
+		CVector3 corner;
+		CVector3 edge1;
+		CVector3 edge2;
+	};
+
+	// Where a triangle came from, for reporting hits
+	struct STriangleSource
+	{
+		TUInt32 subMesh;
+		TUInt32 triangle;
+	};
+
+	// Fill in a hit for the given triangle
+	void SetHit( TUInt32 triangle, TFloat32 fraction, const CVector3& position, SMeshBVHHit* pHit ) const;
+
+	// Tree nodes, the trees of all mesh nodes are stored together. The triangles of each leaf are
+	// stored together in the order of the leaves
+	vector<SMeshBVHNode>    m_Nodes;
+	vector<TUInt32>         m_Roots; // Root tree node for each mesh node, or kNoRoot
+	vector<STriangle>       m_Triangles;
+	vector<STriangleSource> m_Sources;
+};
+
+
+} // namespace gen
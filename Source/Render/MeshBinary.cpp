@@ -0,0 +1,484 @@
+/*******************************************
+	MeshBinary.cpp
+
+	Binary mesh cache format - an imported
+	X-file stored as ready to use nodes,
+	materials and vertex / index data
+********************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+#include "MeshBinary.h"
+#include "MeshCompress.h"
+
+namespace gen
+{
+
+// Return the vertex size in bytes of a sub-mesh with the given components and compression,
+// matches the layouts used by CImportXFile::GetSubMesh and CompressSubMesh
+static TUInt32 MeshBinaryVertexSize( TUInt32 components )
+{
+	SSubMesh subMesh;
+	subMesh.hasSkinningData = (components & kMeshBinarySkinningData) != 0;
+	subMesh.hasNormals = (components & kMeshBinaryNormals) != 0;
+	subMesh.hasTangents = (components & kMeshBinaryTangents) != 0;
+	subMesh.hasTextureCoords = (components & kMeshBinaryTextureCoords) != 0;
+	subMesh.hasVertexColours = (components & kMeshBinaryVertexColours) != 0;
+	subMesh.compression = ((components & kMeshBinaryCompressed) ? kVertexCompressAttributes : 0) |
+	                      ((components & kMeshBinaryQuantisedPositions) ? kVertexQuantisePositions : 0);
+	return SubMeshVertexSize( subMesh );
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Writer
+-----------------------------------------------------------------------------------------*/
+
+CMeshBinaryWriter::CMeshBinaryWriter()
+{
+	memset( &m_Header, 0, sizeof(m_Header) );
+	m_Header.magic = kMeshBinaryMagic;
+	m_Header.version = kMeshBinaryVersion;
+}
+
+// Record the X-file the mesh was imported from, reads the file to calculate its hash.
+// Returns false if the file cannot be read
+bool CMeshBinaryWriter::SetSource( const string& sourceFileName )
+{
+	CMappedFile source;
+	if (!CMappedFile::GetFileStamp( sourceFileName, &m_Header.sourceWriteTime, &m_Header.sourceSize ) ||
+	    !source.Open( sourceFileName ) || source.GetSize() != m_Header.sourceSize)
+	{
+		return false;
+	}
+	m_Header.sourceHash = HashMeshSource( source.GetData(), source.GetSize() );
+	return true;
+}
+
+void CMeshBinaryWriter::SetBounds( const CVector3& minBounds, const CVector3& maxBounds,
+                                   TFloat32 boundingRadius )
+{
+	m_Header.minBounds[0] = minBounds.x;
+	m_Header.minBounds[1] = minBounds.y;
+	m_Header.minBounds[2] = minBounds.z;
+	m_Header.maxBounds[0] = maxBounds.x;
+	m_Header.maxBounds[1] = maxBounds.y;
+	m_Header.maxBounds[2] = maxBounds.z;
+	m_Header.boundingRadius = boundingRadius;
+}
+
+// Add mesh data, nodes must be added in depth-first order with the bounds of their geometry
+void CMeshBinaryWriter::AddNode( const SMeshNode& node, const SMeshNodeBounds& bounds )
+{
+	SMeshBinaryNode binaryNode;
+	binaryNode.name = AddString( node.name );
+	binaryNode.depth = node.depth;
+	binaryNode.parent = node.parent;
+	binaryNode.numChildren = node.numChildren;
+	memcpy( binaryNode.positionMatrix, &node.positionMatrix.e00, sizeof(binaryNode.positionMatrix) );
+	memcpy( binaryNode.invMeshOffset, &node.invMeshOffset.e00, sizeof(binaryNode.invMeshOffset) );
+	binaryNode.hasGeometry = bounds.hasGeometry ? 1 : 0;
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		binaryNode.minBounds[axis] = bounds.minBounds[axis];
+		binaryNode.maxBounds[axis] = bounds.maxBounds[axis];
+		binaryNode.centre[axis] = bounds.centre[axis];
+	}
+	binaryNode.radius = bounds.radius;
+	m_Nodes.push_back( binaryNode );
+}
+
+void CMeshBinaryWriter::AddMaterial( const SMeshMaterial& material )
+{
+	SMeshBinaryMaterial binaryMaterial;
+	binaryMaterial.renderMethod = material.renderMethod;
+	binaryMaterial.diffuseColour[0] = material.diffuseColour.r;
+	binaryMaterial.diffuseColour[1] = material.diffuseColour.g;
+	binaryMaterial.diffuseColour[2] = material.diffuseColour.b;
+	binaryMaterial.diffuseColour[3] = material.diffuseColour.a;
+	binaryMaterial.specularColour[0] = material.specularColour.r;
+	binaryMaterial.specularColour[1] = material.specularColour.g;
+	binaryMaterial.specularColour[2] = material.specularColour.b;
+	binaryMaterial.specularColour[3] = material.specularColour.a;
+	binaryMaterial.specularPower = material.specularPower;
+	binaryMaterial.numTextures = material.numTextures;
+	for (TUInt32 texture = 0; texture < kiMaxTextures; ++texture)
+	{
+		binaryMaterial.textureFileNames[texture] = AddString( material.textureFileNames[texture] );
+	}
+	m_Materials.push_back( binaryMaterial );
+}
+
+void CMeshBinaryWriter::AddSubMesh( const SSubMesh& subMesh )
+{
+	SMeshBinarySubMesh binarySubMesh;
+	binarySubMesh.node = subMesh.node;
+	binarySubMesh.material = subMesh.material;
+	binarySubMesh.components = (subMesh.hasSkinningData  ? kMeshBinarySkinningData : 0) |
+	                           (subMesh.hasNormals       ? kMeshBinaryNormals : 0) |
+	                           (subMesh.hasTangents      ? kMeshBinaryTangents : 0) |
+	                           (subMesh.hasTextureCoords ? kMeshBinaryTextureCoords : 0) |
+	                           (subMesh.hasVertexColours ? kMeshBinaryVertexColours : 0) |
+	                           ((subMesh.compression & kVertexCompressAttributes) ? kMeshBinaryCompressed : 0) |
+	                           ((subMesh.compression & kVertexQuantisePositions) ? kMeshBinaryQuantisedPositions : 0) |
+	                           (subMesh.largeFaces ? kMeshBinaryLargeIndices : 0);
+	binarySubMesh.vertexSize = subMesh.vertexSize;
+	binarySubMesh.numVertices = subMesh.numVertices;
+	binarySubMesh.firstVertexByte = static_cast<TUInt32>(m_Vertices.size());
+	binarySubMesh.numFaces = SubMeshTotalFaces( subMesh );
+	binarySubMesh.firstFace = static_cast<TUInt32>(subMesh.largeFaces ? m_LargeFaces.size() : m_Faces.size());
+	binarySubMesh.numLODs = subMesh.numLODs;
+	for (TUInt32 lod = 0; lod < kiMaxLODs; ++lod)
+	{
+		binarySubMesh.lods[lod] = (lod < subMesh.numLODs) ? subMesh.lods[lod] : SSubMeshLOD();
+	}
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		binarySubMesh.positionOffset[axis] = subMesh.positionOffset[axis];
+		binarySubMesh.positionScale[axis] = subMesh.positionScale[axis];
+	}
+	m_SubMeshes.push_back( binarySubMesh );
+
+	m_Vertices.insert( m_Vertices.end(), subMesh.vertices,
+	                   subMesh.vertices + subMesh.numVertices * subMesh.vertexSize );
+	if (subMesh.largeFaces)
+	{
+		m_LargeFaces.insert( m_LargeFaces.end(), subMesh.largeFaces, subMesh.largeFaces + binarySubMesh.numFaces );
+	}
+	else
+	{
+		m_Faces.insert( m_Faces.end(), subMesh.faces, subMesh.faces + binarySubMesh.numFaces );
+	}
+}
+
+// Add a string to the string table (identical strings are shared), returns its offset
+TUInt32 CMeshBinaryWriter::AddString( const string& s )
+{
+	map<string, TUInt32>::iterator existing = m_StringOffsets.find( s );
+	if (existing != m_StringOffsets.end())
+	{
+		return existing->second;
+	}
+
+	TUInt32 offset = static_cast<TUInt32>(m_Strings.size());
+	m_Strings.insert( m_Strings.end(), s.begin(), s.end() );
+	m_Strings.push_back( '\0' );
+	m_StringOffsets[s] = offset;
+	return offset;
+}
+
+
+// Helper for Write - place an array of records in the file layout, aligned to 8 bytes. Returns
+// the section and updates the current file offset
+template <class T> SMeshBinarySection LayoutMeshSection( const vector<T>& records, TUInt32& offset )
+{
+	offset = (offset + 7) & ~7u;
+
+	SMeshBinarySection section;
+	section.offset = offset;
+	section.count = static_cast<TUInt32>(records.size());
+	offset += section.count * sizeof(T);
+	return section;
+}
+
+// Helper for Write - write an array of records at the position given by its section
+template <class T> void WriteMeshSection( ofstream& file, const vector<T>& records,
+                                          const SMeshBinarySection& section )
+{
+	// Pad up to the section start
+	static const char padding[8] = { 0 };
+	TUInt32 position = static_cast<TUInt32>(file.tellp());
+	file.write( padding, section.offset - position );
+
+	if (!records.empty())
+	{
+		file.write( reinterpret_cast<const char*>(&records[0]), records.size() * sizeof(T) );
+	}
+}
+
+// Write the binary mesh to the given file, returns false on failure
+bool CMeshBinaryWriter::Write( const string& fileName )
+{
+	// Lay out the file
+	TUInt32 offset = sizeof(SMeshBinaryHeader);
+	m_Header.nodes = LayoutMeshSection( m_Nodes, offset );
+	m_Header.materials = LayoutMeshSection( m_Materials, offset );
+	m_Header.subMeshes = LayoutMeshSection( m_SubMeshes, offset );
+	m_Header.vertices = LayoutMeshSection( m_Vertices, offset );
+	m_Header.faces = LayoutMeshSection( m_Faces, offset );
+	m_Header.largeFaces = LayoutMeshSection( m_LargeFaces, offset );
+	m_Header.strings = LayoutMeshSection( m_Strings, offset );
+	m_Header.fileSize = offset;
+
+	// Write to a temporary file and rename when complete, so a partly written file is never seen
+	string tempFileName = fileName + ".tmp";
+	{
+		ofstream file( tempFileName.c_str(), ios::binary | ios::trunc );
+		if (!file)
+		{
+			return false;
+		}
+		file.write( reinterpret_cast<const char*>(&m_Header), sizeof(m_Header) );
+		WriteMeshSection( file, m_Nodes, m_Header.nodes );
+		WriteMeshSection( file, m_Materials, m_Header.materials );
+		WriteMeshSection( file, m_SubMeshes, m_Header.subMeshes );
+		WriteMeshSection( file, m_Vertices, m_Header.vertices );
+		WriteMeshSection( file, m_Faces, m_Header.faces );
+		WriteMeshSection( file, m_LargeFaces, m_Header.largeFaces );
+		WriteMeshSection( file, m_Strings, m_Header.strings );
+		if (!file)
+		{
+			file.close();
+			remove( tempFileName.c_str() );
+			return false;
+		}
+	}
+
+	remove( fileName.c_str() );
+	return rename( tempFileName.c_str(), fileName.c_str() ) == 0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Reader
+-----------------------------------------------------------------------------------------*/
+
+// Open and validate a binary mesh file, returns false if the file is missing, is the
+// wrong version or is corrupt. Face indices are not checked
+bool CMeshBinaryReader::Open( const string& fileName )
+{
+	m_Header = 0;
+	if (!m_File.Open( fileName ))
+	{
+		return false;
+	}
+
+	// Check header
+	if (m_File.GetSize() < sizeof(SMeshBinaryHeader))
+	{
+		m_File.Close();
+		return false;
+	}
+	m_Header = reinterpret_cast<const SMeshBinaryHeader*>(m_File.GetData());
+	if (m_Header->magic != kMeshBinaryMagic || m_Header->version != kMeshBinaryVersion ||
+	    m_Header->fileSize != m_File.GetSize())
+	{
+		Close();
+		return false;
+	}
+
+	// Check sections are within the file and the string table is terminated
+	bool valid =
+		ValidSection( m_Header->nodes, sizeof(SMeshBinaryNode) ) &&
+		ValidSection( m_Header->materials, sizeof(SMeshBinaryMaterial) ) &&
+		ValidSection( m_Header->subMeshes, sizeof(SMeshBinarySubMesh) ) &&
+		ValidSection( m_Header->vertices, sizeof(TUInt8) ) &&
+		ValidSection( m_Header->faces, sizeof(SMeshFace) ) &&
+		ValidSection( m_Header->largeFaces, sizeof(SMeshLargeFace) ) &&
+		ValidSection( m_Header->strings, sizeof(char) ) &&
+		(m_Header->vertices.offset & 3) == 0 &&
+		(m_Header->strings.count == 0 || String( m_Header->strings.count - 1 )[0] == '\0');
+
+	// Check all references between records
+	const SMeshBinaryNode* nodes = Section<SMeshBinaryNode>( m_Header->nodes );
+	for (TUInt32 i = 0; valid && i < NumNodes(); ++i)
+	{
+		valid = ValidString( nodes[i].name ) && (i == 0 || nodes[i].parent < i);
+	}
+	const SMeshBinaryMaterial* materials = Section<SMeshBinaryMaterial>( m_Header->materials );
+	for (TUInt32 i = 0; valid && i < NumMaterials(); ++i)
+	{
+		valid = materials[i].renderMethod < NumRenderMethods && materials[i].numTextures <= kiMaxTextures;
+		for (TUInt32 texture = 0; valid && texture < kiMaxTextures; ++texture)
+		{
+			valid = ValidString( materials[i].textureFileNames[texture] );
+		}
+	}
+	const SMeshBinarySubMesh* subMeshes = Section<SMeshBinarySubMesh>( m_Header->subMeshes );
+	for (TUInt32 i = 0; valid && i < NumSubMeshes(); ++i)
+	{
+		const SMeshBinarySubMesh& subMesh = subMeshes[i];
+		const SMeshBinarySection& faces = (subMesh.components & kMeshBinaryLargeIndices) ? m_Header->largeFaces : m_Header->faces;
+		TUInt64 vertexEnd = static_cast<TUInt64>(subMesh.firstVertexByte) +
+		                    static_cast<TUInt64>(subMesh.numVertices) * subMesh.vertexSize;
+		valid = subMesh.node < NumNodes() && subMesh.material < NumMaterials() &&
+		        subMesh.vertexSize == MeshBinaryVertexSize( subMesh.components ) &&
+		        subMesh.numVertices > 0 && (subMesh.firstVertexByte & 3) == 0 &&
+		        vertexEnd <= m_Header->vertices.count &&
+		        subMesh.firstFace <= faces.count && subMesh.numFaces <= faces.count - subMesh.firstFace &&
+		        subMesh.numLODs > 0 && subMesh.numLODs <= kiMaxLODs && subMesh.lods[0].firstFace == 0;
+		for (TUInt32 lod = 0; valid && lod < subMesh.numLODs; ++lod)
+		{
+			valid = subMesh.lods[lod].firstFace <= subMesh.numFaces &&
+			        subMesh.lods[lod].numFaces <= subMesh.numFaces - subMesh.lods[lod].firstFace;
+		}
+	}
+	valid = valid && NumNodes() > 0 && NumSubMeshes() > 0;
+
+	if (!valid)
+	{
+		Close();
+	}
+	return valid;
+}
+
+// Return true if the file was written with the given import options from the current content
+// of the given X-file. The X-file is only read if its timestamp has changed
+bool CMeshBinaryReader::IsUpToDate( const string& sourceFileName, const SMeshBinaryOptions& options )
+{
+	const SMeshBinaryOptions& fileOptions = m_Header->options;
+	if (fileOptions.flags != options.flags || fileOptions.numLODs != options.numLODs ||
+	    fileOptions.weldEpsilon != options.weldEpsilon || fileOptions.lodReduction != options.lodReduction ||
+	    fileOptions.lodMaxError != options.lodMaxError)
+	{
+		return false;
+	}
+
+	TUInt64 writeTime, size;
+	if (!CMappedFile::GetFileStamp( sourceFileName, &writeTime, &size ) || size != m_Header->sourceSize)
+	{
+		return false;
+	}
+	if (writeTime == m_Header->sourceWriteTime)
+	{
+		return true;
+	}
+
+	// Timestamp changed but not the size (e.g. file touched or checked out again), compare content
+	CMappedFile source;
+	return source.Open( sourceFileName ) && source.GetSize() == size &&
+	       HashMeshSource( source.GetData(), source.GetSize() ) == m_Header->sourceHash;
+}
+
+
+// Fill mesh structures from the file. String data is copied, sub-mesh vertices and faces
+// point into the mapped file
+void CMeshBinaryReader::GetNode( TUInt32 i, SMeshNode* pNode )
+{
+	const SMeshBinaryNode& node = Section<SMeshBinaryNode>( m_Header->nodes )[i];
+	pNode->name = String( node.name );
+	pNode->depth = node.depth;
+	pNode->parent = node.parent;
+	pNode->numChildren = node.numChildren;
+	pNode->positionMatrix = CMatrix4x4( node.positionMatrix );
+	pNode->invMeshOffset = CMatrix4x4( node.invMeshOffset );
+}
+
+void CMeshBinaryReader::GetNodeBounds( TUInt32 i, SMeshNodeBounds* pBounds )
+{
+	const SMeshBinaryNode& node = Section<SMeshBinaryNode>( m_Header->nodes )[i];
+	pBounds->hasGeometry = node.hasGeometry != 0;
+	pBounds->minBounds = CVector3( node.minBounds[0], node.minBounds[1], node.minBounds[2] );
+	pBounds->maxBounds = CVector3( node.maxBounds[0], node.maxBounds[1], node.maxBounds[2] );
+	pBounds->centre = CVector3( node.centre[0], node.centre[1], node.centre[2] );
+	pBounds->radius = node.radius;
+}
+
+void CMeshBinaryReader::GetMaterial( TUInt32 i, SMeshMaterial* pMaterial )
+{
+	const SMeshBinaryMaterial& material = Section<SMeshBinaryMaterial>( m_Header->materials )[i];
+	pMaterial->renderMethod = static_cast<ERenderMethod>(material.renderMethod);
+	pMaterial->diffuseColour = SColourRGBA( material.diffuseColour[0], material.diffuseColour[1],
+	                                        material.diffuseColour[2], material.diffuseColour[3] );
+	pMaterial->specularColour = SColourRGBA( material.specularColour[0], material.specularColour[1],
+	                                         material.specularColour[2], material.specularColour[3] );
+	pMaterial->specularPower = material.specularPower;
+	pMaterial->numTextures = material.numTextures;
+	for (TUInt32 texture = 0; texture < kiMaxTextures; ++texture)
+	{
+		pMaterial->textureFileNames[texture] = String( material.textureFileNames[texture] );
+	}
+}
+
+void CMeshBinaryReader::GetSubMesh( TUInt32 i, SSubMesh* pSubMesh )
+{
+	const SMeshBinarySubMesh& subMesh = Section<SMeshBinarySubMesh>( m_Header->subMeshes )[i];
+	pSubMesh->node = subMesh.node;
+	pSubMesh->material = subMesh.material;
+	pSubMesh->hasSkinningData = (subMesh.components & kMeshBinarySkinningData) != 0;
+	pSubMesh->hasNormals = (subMesh.components & kMeshBinaryNormals) != 0;
+	pSubMesh->hasTangents = (subMesh.components & kMeshBinaryTangents) != 0;
+	pSubMesh->hasTextureCoords = (subMesh.components & kMeshBinaryTextureCoords) != 0;
+	pSubMesh->hasVertexColours = (subMesh.components & kMeshBinaryVertexColours) != 0;
+	pSubMesh->vertexSize = subMesh.vertexSize;
+	pSubMesh->compression = ((subMesh.components & kMeshBinaryCompressed) ? kVertexCompressAttributes : 0) |
+	                        ((subMesh.components & kMeshBinaryQuantisedPositions) ? kVertexQuantisePositions : 0);
+	pSubMesh->positionOffset = CVector3( subMesh.positionOffset );
+	pSubMesh->positionScale = CVector3( subMesh.positionScale );
+	pSubMesh->numVertices = subMesh.numVertices;
+	pSubMesh->numFaces = subMesh.lods[0].numFaces;
+	pSubMesh->numLODs = subMesh.numLODs;
+	for (TUInt32 lod = 0; lod < subMesh.numLODs; ++lod)
+	{
+		pSubMesh->lods[lod] = subMesh.lods[lod];
+	}
+
+	// The mapping is read-only, the mesh never writes to sub-mesh data after import
+	pSubMesh->vertices = const_cast<TUInt8*>(Section<TUInt8>( m_Header->vertices ) + subMesh.firstVertexByte);
+	if (subMesh.components & kMeshBinaryLargeIndices)
+	{
+		pSubMesh->faces = 0;
+		pSubMesh->largeFaces = const_cast<SMeshLargeFace*>(Section<SMeshLargeFace>( m_Header->largeFaces ) + subMesh.firstFace);
+	}
+	else
+	{
+		pSubMesh->faces = const_cast<SMeshFace*>(Section<SMeshFace>( m_Header->faces ) + subMesh.firstFace);
+		pSubMesh->largeFaces = 0;
+	}
+}
+
+
+// Check a section lies within the file
+bool CMeshBinaryReader::ValidSection( const SMeshBinarySection& section, TUInt32 recordSize )
+{
+	TUInt64 end = static_cast<TUInt64>(section.offset) + static_cast<TUInt64>(section.count) * recordSize;
+	return section.offset >= sizeof(SMeshBinaryHeader) && end <= m_File.GetSize();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Support functions
+-----------------------------------------------------------------------------------------*/
+
+// Return the name of the binary mesh file used for an X-file - the same name with the extension
+// replaced by .meshbin
+string GetMeshBinaryName( const string& fileName )
+{
+	string::size_type dot = fileName.find_last_of( '.' );
+	string::size_type slash = fileName.find_last_of( "/\\" );
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+	{
+		return fileName + ".meshbin";
+	}
+	return fileName.substr( 0, dot ) + ".meshbin";
+}
+
+// Return a 64-bit hash of a block of data, used to detect changes to source files. Processes
+// 8 bytes at a time with a multiply / xor-shift mix, much faster than a byte at a time hash
+TUInt64 HashMeshSource( const TUInt8* pData, TUInt32 size )
+{
+	const TUInt64 kMultiplier = 0x9E3779B97F4A7C15ULL;
+	TUInt64 hash = 0xCBF29CE484222325ULL ^ size;
+
+	const TUInt8* pEnd = pData + (size & ~7u);
+	while (pData != pEnd)
+	{
+		TUInt64 word;
+		memcpy( &word, pData, sizeof(word) );
+		hash = (hash ^ word) * kMultiplier;
+		hash ^= hash >> 32;
+		pData += sizeof(word);
+	}
+
+	// Remaining bytes
+	TUInt64 word = 0;
+	memcpy( &word, pData, size & 7 );
+	hash = (hash ^ word) * kMultiplier;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+
+} // namespace gen
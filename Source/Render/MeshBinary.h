@@ -0,0 +1,301 @@
+/*******************************************
+	MeshBinary.h
+
+	Binary mesh cache format - an imported
+	X-file stored as ready to use nodes,
+	materials and vertex / index data
+********************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "MeshData.h"
+#include "CMappedFile.h"
+
+namespace gen
+{
+
+/*-----------------------------------------------------------------------------------------
+	File format
+-----------------------------------------------------------------------------------------*/
+// The file is a header followed by sections of fixed-size records, the raw vertex and face data
+// of all sub-meshes and a string table. All offsets are in bytes from the start of the file,
+// strings are referenced by offset into the string table and are null-terminated. Sections are
+// 8-byte aligned and written in the native (little-endian) layout, so the vertex and face data
+// can be used in place from a memory mapped file.
+// The header records the size, timestamp and a hash of the X-file the mesh was imported from,
+// and the import options used. The file is stale if these differ or the X-file content has
+// changed. The timestamp is only used to skip hashing the X-file when it is unchanged
+
+const TUInt32 kMeshBinaryMagic = 0x484D5354; // "TSMH" in file
+const TUInt32 kMeshBinaryVersion = 6;
+
+// Location of an array of records in the file
+struct SMeshBinarySection
+{
+	TUInt32 offset;
+	TUInt32 count;
+};
+
+// Import options that affect the imported mesh data, see CMesh::Import
+struct SMeshBinaryOptions
+{
+	TUInt32  flags;        // Render methods using tangents, welding and optimisation
+	TUInt32  numLODs;      // Levels of detail requested, including the full detail level
+	TFloat32 weldEpsilon;  // Epsilon used when welding vertices, 0 if not welded
+	TFloat32 lodReduction; // Level of detail settings, 0 if there are no levels of detail
+	TFloat32 lodMaxError;
+};
+
+struct SMeshBinaryHeader
+{
+	TUInt32 magic;
+	TUInt32 version;
+	TUInt32 fileSize;
+	SMeshBinaryOptions options;
+
+	// Source X-file
+	TUInt64 sourceWriteTime;
+	TUInt64 sourceSize;
+	TUInt64 sourceHash;
+
+	// Mesh bounds, as calculated by CMesh::PreProcess
+	TFloat32 minBounds[3];
+	TFloat32 maxBounds[3];
+	TFloat32 boundingRadius;
+
+	SMeshBinarySection nodes;     // SMeshBinaryNode, depth-first order
+	SMeshBinarySection materials; // SMeshBinaryMaterial
+	SMeshBinarySection subMeshes; // SMeshBinarySubMesh
+	SMeshBinarySection vertices;  // TUInt8 - count is size of all vertex data in bytes
+	SMeshBinarySection faces;     // SMeshFace
+	SMeshBinarySection largeFaces; // SMeshLargeFace
+	SMeshBinarySection strings;   // char - count is size of string table in bytes
+};
+
+struct SMeshBinaryNode
+{
+	TUInt32  name;
+	TUInt32  depth;
+	TUInt32  parent;
+	TUInt32  numChildren;
+	TFloat32 positionMatrix[16];
+	TFloat32 invMeshOffset[16];
+
+	// Bounds of the node's geometry, see SMeshNodeBounds
+	TUInt32  hasGeometry;
+	TFloat32 minBounds[3];
+	TFloat32 maxBounds[3];
+	TFloat32 centre[3];
+	TFloat32 radius;
+};
+
+struct SMeshBinaryMaterial
+{
+	TUInt32  renderMethod;
+	TFloat32 diffuseColour[4];
+	TFloat32 specularColour[4];
+	TFloat32 specularPower;
+	TUInt32  numTextures;
+	TUInt32  textureFileNames[kiMaxTextures];
+};
+
+// Vertex components present in a sub-mesh
+const TUInt32 kMeshBinarySkinningData  = 1;
+const TUInt32 kMeshBinaryNormals       = 2;
+const TUInt32 kMeshBinaryTangents      = 4;
+const TUInt32 kMeshBinaryTextureCoords = 8;
+const TUInt32 kMeshBinaryVertexColours = 16;
+
+// Vertex compression of a sub-mesh, see MeshCompress.h
+const TUInt32 kMeshBinaryCompressed        = 32; // Octahedral normals & tangents, 16-bit UVs
+const TUInt32 kMeshBinaryQuantisedPositions = 64; // 16-bit positions, decoded with the scale & offset
+
+// Sub-mesh faces use 32-bit vertex indices, stored in the large faces section
+const TUInt32 kMeshBinaryLargeIndices = 128;
+
+// A sub-mesh, its vertices start at a byte offset into the vertices section and its faces at
+// an index into the faces or large faces section. The faces of all levels of detail are stored, the face range
+// of each level is relative to the sub-mesh's first face
+struct SMeshBinarySubMesh
+{
+	TUInt32 node;
+	TUInt32 material;
+	TUInt32 components; // Combination of the component and compression flags above
+	TUInt32 vertexSize;
+	TUInt32 numVertices;
+	TUInt32 firstVertexByte;
+	TUInt32 numFaces;   // Faces of all levels of detail
+	TUInt32 firstFace;
+	TUInt32 numLODs;
+	SSubMeshLOD lods[kiMaxLODs];
+	TFloat32 positionOffset[3];
+	TFloat32 positionScale[3];
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Writer
+-----------------------------------------------------------------------------------------*/
+
+// Collects an imported mesh in memory then writes a binary mesh file
+class CMeshBinaryWriter
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CMeshBinaryWriter();
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Record the X-file the mesh was imported from, reads the file to calculate its hash.
+	// Returns false if the file cannot be read
+	bool SetSource( const string& sourceFileName );
+
+	// Set the import options and mesh bounds stored in the header
+	void SetOptions( const SMeshBinaryOptions& options )
+	{
+		m_Header.options = options;
+	}
+	void SetBounds( const CVector3& minBounds, const CVector3& maxBounds, TFloat32 boundingRadius );
+
+	// Add mesh data, nodes must be added in depth-first order with the bounds of their geometry
+	void AddNode( const SMeshNode& node, const SMeshNodeBounds& bounds );
+	void AddMaterial( const SMeshMaterial& material );
+	void AddSubMesh( const SSubMesh& subMesh );
+
+	// Write the binary mesh to the given file, returns false on failure
+	bool Write( const string& fileName );
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Add a string to the string table (identical strings are shared), returns its offset
+	TUInt32 AddString( const string& s );
+
+	// Header being built, sections are set by Write
+	SMeshBinaryHeader m_Header;
+
+	vector<SMeshBinaryNode>     m_Nodes;
+	vector<SMeshBinaryMaterial> m_Materials;
+	vector<SMeshBinarySubMesh>  m_SubMeshes;
+	vector<TUInt8>              m_Vertices;
+	vector<SMeshFace>           m_Faces;
+	vector<SMeshLargeFace>      m_LargeFaces;
+
+	// String table and map from string to offset for sharing
+	vector<char>           m_Strings;
+	map<string, TUInt32>   m_StringOffsets;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Reader
+-----------------------------------------------------------------------------------------*/
+
+// Memory maps a binary mesh file and gives direct access to its records. The vertex and face
+// data can be used in place for as long as the file is open
+class CMeshBinaryReader
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CMeshBinaryReader() : m_Header( 0 ) {}
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Open and validate a binary mesh file, returns false if the file is missing, is the
+	// wrong version or is corrupt. Face indices are not checked
+	bool Open( const string& fileName );
+
+	// Unmap and close the file
+	void Close()
+	{
+		m_Header = 0;
+		m_File.Close();
+	}
+
+	// Return whether a file is currently open
+	bool IsOpen()
+	{
+		return m_Header != 0;
+	}
+
+	// Return true if the file was written with the given import options from the current content
+	// of the given X-file. The X-file is only read if its timestamp has changed
+	bool IsUpToDate( const string& sourceFileName, const SMeshBinaryOptions& options );
+
+
+	/////////////////////////////////////
+	// Record access - only valid after a successful Open
+
+	const SMeshBinaryHeader& Header()
+	{
+		return *m_Header;
+	}
+
+	TUInt32 NumNodes()     { return m_Header->nodes.count; }
+	TUInt32 NumMaterials() { return m_Header->materials.count; }
+	TUInt32 NumSubMeshes() { return m_Header->subMeshes.count; }
+
+	// Fill mesh structures from the file. String data is copied, sub-mesh vertices and faces
+	// point into the mapped file
+	void GetNode( TUInt32 i, SMeshNode* pNode );
+	void GetNodeBounds( TUInt32 i, SMeshNodeBounds* pBounds );
+	void GetMaterial( TUInt32 i, SMeshMaterial* pMaterial );
+	void GetSubMesh( TUInt32 i, SSubMesh* pSubMesh );
+
+	// Return a string from the string table
+	const char* String( TUInt32 offset )
+	{
+		return Section<char>( m_Header->strings ) + offset;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Return pointer to the start of a section
+	template <class T> const T* Section( const SMeshBinarySection& section )
+	{
+		return reinterpret_cast<const T*>(m_File.GetData() + section.offset);
+	}
+
+	// Check a section lies within the file
+	bool ValidSection( const SMeshBinarySection& section, TUInt32 recordSize );
+
+	// Check a string offset lies within the string table
+	bool ValidString( TUInt32 offset )
+	{
+		return offset < m_Header->strings.count;
+	}
+
+	CMappedFile              m_File;
+	const SMeshBinaryHeader* m_Header;
+};
+
+
+// Return the name of the binary mesh file used for an X-file - the same name with the extension
+// replaced by .meshbin
+string GetMeshBinaryName( const string& fileName );
+
+// Return a 64-bit hash of a block of data, used to detect changes to source files
+TUInt64 HashMeshSource( const TUInt8* pData, TUInt32 size );
+
+
+} // namespace gen
@@ -0,0 +1,198 @@
+/*******************************************
+	MeshCache.cpp
+
+	Reference counted cache of loaded meshes
+********************************************/
+
+#include <ctype.h>
+#include <sstream>
+
+#include "MeshCache.h"
+#include "Error.h"
+
+namespace gen
+{
+
+CMeshCache::CMeshCache()
+{
+}
+
+// Destructor deletes all meshes, referenced or not
+CMeshCache::~CMeshCache()
+{
+	Clear();
+}
+
+
+// Return the mesh for the given file, loading it if it is not already cached, and add a
+// reference to it. Returns 0 if the mesh could not be loaded
+CMesh* CMeshCache::Acquire( const string& fileName )
+{
+	string name = CanonicalName( fileName );
+	TMeshIter cached = m_Meshes.find( name );
+	if (cached != m_Meshes.end())
+	{
+		++cached->second.numReferences;
+		return cached->second.mesh;
+	}
+
+	CMesh* mesh = new CMesh();
+	if (!mesh->Load( fileName ))
+	{
+		delete mesh;
+		return 0;
+	}
+	SCachedMesh& entry = AddEntry( name, mesh );
+	entry.numReferences = 1;
+	return mesh;
+}
+
+// Return true if the mesh for the given file is in the cache
+bool CMeshCache::IsCached( const string& fileName )
+{
+	return m_Meshes.find( CanonicalName( fileName ) ) != m_Meshes.end();
+}
+
+// Add a mesh that has been loaded elsewhere to the cache, with no references. The cache takes
+// ownership. Returns false and deletes the mesh if the file is already cached
+bool CMeshCache::Add( const string& fileName, CMesh* mesh )
+{
+	string name = CanonicalName( fileName );
+	if (m_Meshes.find( name ) != m_Meshes.end())
+	{
+		delete mesh;
+		return false;
+	}
+	AddEntry( name, mesh );
+	return true;
+}
+
+// Remove a reference to a mesh returned by Acquire
+void CMeshCache::Release( CMesh* mesh )
+{
+	map<CMesh*, string>::iterator name = m_MeshNames.find( mesh );
+	GEN_ASSERT( name != m_MeshNames.end(), "Releasing mesh not in cache" );
+
+	SCachedMesh& entry = m_Meshes[name->second];
+	GEN_ASSERT( entry.numReferences > 0, "Mesh released too many times" );
+	--entry.numReferences;
+}
+
+// Delete all meshes that have no references, returns the number of meshes deleted
+TUInt32 CMeshCache::UnloadUnused()
+{
+	TUInt32 numUnloaded = 0;
+	TMeshIter cached = m_Meshes.begin();
+	while (cached != m_Meshes.end())
+	{
+		if (cached->second.numReferences == 0)
+		{
+			DeleteEntry( cached->second );
+			cached = m_Meshes.erase( cached );
+			++numUnloaded;
+		}
+		else
+		{
+			++cached;
+		}
+	}
+	return numUnloaded;
+}
+
+// Delete all meshes, only call when no meshes are in use
+void CMeshCache::Clear()
+{
+	for (TMeshIter cached = m_Meshes.begin(); cached != m_Meshes.end(); ++cached)
+	{
+		DeleteEntry( cached->second );
+	}
+	m_Meshes.clear();
+}
+
+
+// Total memory used by cached meshes in bytes
+TUInt32 CMeshCache::GetSystemMemorySize()
+{
+	TUInt32 size = 0;
+	for (TMeshIter cached = m_Meshes.begin(); cached != m_Meshes.end(); ++cached)
+	{
+		size += cached->second.mesh->GetSystemMemorySize();
+	}
+	return size;
+}
+TUInt32 CMeshCache::GetVideoMemorySize()
+{
+	TUInt32 size = 0;
+	for (TMeshIter cached = m_Meshes.begin(); cached != m_Meshes.end(); ++cached)
+	{
+		size += cached->second.mesh->GetVideoMemorySize();
+	}
+	return size;
+}
+
+// Return a report of the memory used by each cached mesh, sizes in KB
+string CMeshCache::GetMemoryReport()
+{
+	ostringstream report;
+	report << "Mesh memory (KB): refs, CPU geometry, GPU buffers, textures, nodes, BVH\n";
+
+	SMeshMemoryUsage total = { 0, 0, 0, 0, 0 };
+	for (TMeshIter cached = m_Meshes.begin(); cached != m_Meshes.end(); ++cached)
+	{
+		SMeshMemoryUsage usage;
+		cached->second.mesh->GetMemoryUsage( &usage );
+		report << "  " << cached->first << ": " << cached->second.numReferences
+		       << ", " << usage.cpuGeometry / 1024 << ", " << usage.gpuBuffers / 1024
+		       << ", " << usage.textures / 1024 << ", " << usage.nodes / 1024
+		       << ", " << usage.bvh / 1024 << "\n";
+		total.cpuGeometry += usage.cpuGeometry;
+		total.gpuBuffers += usage.gpuBuffers;
+		total.textures += usage.textures;
+		total.nodes += usage.nodes;
+		total.bvh += usage.bvh;
+	}
+
+	report << "  Total (" << m_Meshes.size() << " meshes): "
+	       << total.cpuGeometry / 1024 << ", " << total.gpuBuffers / 1024
+	       << ", " << total.textures / 1024 << ", " << total.nodes / 1024
+	       << ", " << total.bvh / 1024 << "\n";
+	return report.str();
+}
+
+
+// Return the canonical form of a mesh file name used as the cache key
+string CMeshCache::CanonicalName( const string& fileName )
+{
+	string name = fileName;
+	for (string::size_type c = 0; c < name.length(); ++c)
+	{
+		name[c] = (name[c] == '/') ? '\\' : static_cast<char>(tolower( static_cast<unsigned char>(name[c]) ));
+	}
+	while (name.compare( 0, 2, ".\\" ) == 0)
+	{
+		name.erase( 0, 2 );
+	}
+	return name;
+}
+
+
+// Add a mesh entry
+CMeshCache::SCachedMesh& CMeshCache::AddEntry( const string& name, CMesh* mesh )
+{
+	SCachedMesh& entry = m_Meshes[name];
+	entry.mesh = mesh;
+	entry.numReferences = 0;
+	m_MeshNames[mesh] = name;
+	return entry;
+}
+
+// Delete the mesh of an entry (entry is not removed)
+void CMeshCache::DeleteEntry( SCachedMesh& entry )
+{
+	m_MeshNames.erase( entry.mesh );
+	delete entry.mesh;
+	entry.mesh = 0;
+}
+
+
+} // namespace gen
@@ -0,0 +1,112 @@
+/*******************************************
+	MeshCache.h
+
+	Reference counted cache of loaded meshes
+********************************************/
+
+#pragma once
+
+#include <string>
+#include <map>
+using namespace std;
+
+#include "Defines.h"
+#include "Mesh.h"
+
+namespace gen
+{
+
+// Loaded meshes shared between templates. Each mesh file is loaded once and kept while it is
+// referenced, entries are keyed by canonical file name so different spellings of the same file
+// (case, slashes) share one mesh. Unreferenced meshes stay loaded until UnloadUnused is called
+// so templates can be destroyed and recreated cheaply
+class CMeshCache
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CMeshCache();
+
+	// Destructor deletes all meshes, referenced or not
+	~CMeshCache();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CMeshCache( const CMeshCache& );
+	CMeshCache& operator=( const CMeshCache& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Return the mesh for the given file, loading it if it is not already cached, and add a
+	// reference to it. Returns 0 if the mesh could not be loaded
+	CMesh* Acquire( const string& fileName );
+
+	// Return true if the mesh for the given file is in the cache
+	bool IsCached( const string& fileName );
+
+	// Add a mesh that has been loaded elsewhere (e.g. on a worker thread) to the cache, with no
+	// references. The cache takes ownership. Returns false and deletes the mesh if the file is
+	// already cached
+	bool Add( const string& fileName, CMesh* mesh );
+
+	// Remove a reference to a mesh returned by Acquire
+	void Release( CMesh* mesh );
+
+	// Delete all meshes that have no references, returns the number of meshes deleted
+	TUInt32 UnloadUnused();
+
+	// Delete all meshes, only call when no meshes are in use
+	void Clear();
+
+
+	/////////////////////////////////////
+	// Memory accounting
+
+	TUInt32 GetNumMeshes()
+	{
+		return static_cast<TUInt32>(m_Meshes.size());
+	}
+
+	// Total memory used by cached meshes in bytes, see CMesh::GetSystemMemorySize/GetVideoMemorySize.
+	// Summed on each call as mesh sizes change after loading (BVH built, geometry released)
+	TUInt32 GetSystemMemorySize();
+	TUInt32 GetVideoMemorySize();
+
+	// Return a report of the memory used by each cached mesh, one line per mesh with totals at the
+	// end, see CMesh::GetMemoryUsage
+	string GetMemoryReport();
+
+
+	// Return the canonical form of a mesh file name used as the cache key - lower case with
+	// forward slashes converted to back slashes and any leading ".\" removed
+	static string CanonicalName( const string& fileName );
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	struct SCachedMesh
+	{
+		CMesh*  mesh;
+		TUInt32 numReferences;
+	};
+	typedef map<string, SCachedMesh> TMeshes;
+	typedef TMeshes::iterator TMeshIter;
+
+	// Add a mesh entry
+	SCachedMesh& AddEntry( const string& name, CMesh* mesh );
+
+	// Delete the mesh of an entry (entry is not removed)
+	void DeleteEntry( SCachedMesh& entry );
+
+	// Meshes indexed by canonical name, and the canonical name of each mesh for Release
+	TMeshes              m_Meshes;
+	map<CMesh*, string>  m_MeshNames;
+};
+
+
+} // namespace gen
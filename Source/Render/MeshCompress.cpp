@@ -0,0 +1,390 @@
+/*******************************************
+	MeshCompress.cpp
+
+	Compressed vertex formats for sub-mesh
+	storage - quantised positions, octahedral
+	normals and 16-bit texture coordinates
+********************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "MeshCompress.h"
+
+namespace gen
+{
+
+// Largest value of a 16-bit signed normalised component
+const TFloat32 kSNorm16Max = 32767.0f;
+
+// Largest finite 16-bit float
+const TFloat32 kHalfMax = 65504.0f;
+
+
+/*-----------------------------------------------------------------------------------------
+	Vertex layout
+-----------------------------------------------------------------------------------------*/
+
+// Byte offsets of the components of a vertex and the vertex size for a given compression.
+// Components not present in the sub-mesh take no space
+struct SVertexOffsets
+{
+	TUInt32 skinning;
+	TUInt32 normal;
+	TUInt32 tangent;
+	TUInt32 uv;
+	TUInt32 colour;
+	TUInt32 size;
+};
+
+static void GetVertexOffsets( const SSubMesh& subMesh, TUInt32 compression, SVertexOffsets* pOffsets )
+{
+	bool attributes = (compression & kVertexCompressAttributes) != 0;
+	TUInt32 offset = (compression & kVertexQuantisePositions) ? 4 * sizeof(TInt16) : 3 * sizeof(TFloat32);
+
+	pOffsets->skinning = offset;
+	offset += subMesh.hasSkinningData ? 4 * sizeof(TFloat32) + sizeof(TUInt32) : 0;
+	pOffsets->normal = offset;
+	offset += subMesh.hasNormals ? (attributes ? 2 * sizeof(TInt16) : 3 * sizeof(TFloat32)) : 0;
+	pOffsets->tangent = offset;
+	offset += subMesh.hasTangents ? (attributes ? 2 * sizeof(TInt16) : 3 * sizeof(TFloat32)) : 0;
+	pOffsets->uv = offset;
+	offset += subMesh.hasTextureCoords ? (attributes ? 2 * sizeof(TUInt16) : 2 * sizeof(TFloat32)) : 0;
+	pOffsets->colour = offset;
+	offset += subMesh.hasVertexColours ? (attributes ? sizeof(TUInt32) : 4 * sizeof(TFloat32)) : 0;
+	pOffsets->size = offset;
+}
+
+// Return the size of a vertex with the components and compression of the given sub-mesh
+TUInt32 SubMeshVertexSize( const SSubMesh& subMesh )
+{
+	SVertexOffsets offsets;
+	GetVertexOffsets( subMesh, subMesh.compression, &offsets );
+	return offsets.size;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Component encoding
+-----------------------------------------------------------------------------------------*/
+
+// Convert a value in the range -1 to 1 to a 16-bit signed normalised value and back, matching the
+// GPU's conversion of the DXGI SNORM formats
+static TInt16 EncodeSNorm16( TFloat32 value )
+{
+	value = (value < -1.0f) ? -1.0f : (value > 1.0f) ? 1.0f : value;
+	return static_cast<TInt16>(floorf( value * kSNorm16Max + 0.5f ));
+}
+
+static TFloat32 DecodeSNorm16( TInt16 value )
+{
+	TFloat32 decoded = static_cast<TFloat32>(value) / kSNorm16Max;
+	return (decoded < -1.0f) ? -1.0f : decoded;
+}
+
+
+// Convert a float to a 16-bit float (1 sign, 5 exponent, 10 mantissa bits) rounding to nearest,
+// and back. Values too large for a 16-bit float are clamped to the largest finite value
+static TUInt16 EncodeHalf( TFloat32 value )
+{
+	value = (value < -kHalfMax) ? -kHalfMax : (value > kHalfMax) ? kHalfMax : value;
+
+	TUInt32 bits;
+	memcpy( &bits, &value, sizeof(bits) );
+	TUInt16 sign = static_cast<TUInt16>((bits >> 16) & 0x8000);
+	TInt32 exponent = static_cast<TInt32>((bits >> 23) & 0xff) - 127 + 15;
+	TUInt32 mantissa = bits & 0x7fffff;
+
+	if (exponent <= 0)
+	{
+		// Denormal or zero - shift in the implicit bit and round
+		if (exponent < -10)
+		{
+			return sign;
+		}
+		mantissa |= 0x800000;
+		TUInt32 shift = 14 - exponent;
+		TUInt32 rounded = (mantissa + (1 << (shift - 1))) >> shift;
+		return static_cast<TUInt16>(sign | rounded);
+	}
+
+	// Round the mantissa to 10 bits, a carry correctly moves into the exponent
+	TUInt32 half = (static_cast<TUInt32>(exponent) << 10) | (mantissa >> 13);
+	half += (mantissa >> 12) & 1;
+	return static_cast<TUInt16>(sign | half);
+}
+
+static TFloat32 DecodeHalf( TUInt16 half )
+{
+	TFloat32 sign = (half & 0x8000) ? -1.0f : 1.0f;
+	TInt32 exponent = (half >> 10) & 0x1f;
+	TFloat32 mantissa = static_cast<TFloat32>(half & 0x3ff);
+	if (exponent == 0)
+	{
+		return sign * mantissa * ldexpf( 1.0f, -24 );
+	}
+	return sign * (1.0f + mantissa / 1024.0f) * ldexpf( 1.0f, exponent - 15 );
+}
+
+
+// Decode an octahedral encoded unit vector from two values in the range -1 to 1. The vector is
+// the point on an octahedron, with the lower half folded out to the corners of the square
+static CVector3 DecodeOctahedral( TFloat32 x, TFloat32 y )
+{
+	CVector3 v( x, y, 1.0f - fabsf( x ) - fabsf( y ) );
+	TFloat32 fold = (v.z < 0.0f) ? -v.z : 0.0f;
+	v.x += (v.x >= 0.0f) ? -fold : fold;
+	v.y += (v.y >= 0.0f) ? -fold : fold;
+	return Normalise( v );
+}
+
+// Octahedral encode a vector to two 16-bit signed normalised values. Of the four nearest encoded
+// values, chooses the one that decodes closest to the vector
+static void EncodeOctahedral( const CVector3& vector, TInt16* pEncoded )
+{
+	TFloat32 length = fabsf( vector.x ) + fabsf( vector.y ) + fabsf( vector.z );
+	if (length == 0.0f)
+	{
+		pEncoded[0] = pEncoded[1] = 0; // Zero vectors are given +Z
+		return;
+	}
+	TFloat32 x = vector.x / length;
+	TFloat32 y = vector.y / length;
+	if (vector.z < 0.0f)
+	{
+		TFloat32 foldX = (1.0f - fabsf( y )) * ((x >= 0.0f) ? 1.0f : -1.0f);
+		TFloat32 foldY = (1.0f - fabsf( x )) * ((y >= 0.0f) ? 1.0f : -1.0f);
+		x = foldX;
+		y = foldY;
+	}
+
+	CVector3 unit = Normalise( vector );
+	TFloat32 floorX = floorf( x * kSNorm16Max );
+	TFloat32 floorY = floorf( y * kSNorm16Max );
+	TFloat32 bestDot = -2.0f;
+	for (TUInt32 corner = 0; corner < 4; ++corner)
+	{
+		TFloat32 encodedX = floorX + (corner & 1);
+		TFloat32 encodedY = floorY + (corner >> 1);
+		if (fabsf( encodedX ) > kSNorm16Max || fabsf( encodedY ) > kSNorm16Max)
+		{
+			continue;
+		}
+		TFloat32 dot = Dot( unit, DecodeOctahedral( encodedX / kSNorm16Max, encodedY / kSNorm16Max ) );
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			pEncoded[0] = static_cast<TInt16>(encodedX);
+			pEncoded[1] = static_cast<TInt16>(encodedY);
+		}
+	}
+}
+
+// Return the angle in radians between two vectors, zero if the original is zero length
+static TFloat32 AngleBetween( const CVector3& original, const CVector3& decoded )
+{
+	TFloat32 lengthSquared = original.LengthSquared();
+	if (lengthSquared == 0.0f)
+	{
+		return 0.0f;
+	}
+	TFloat32 cosAngle = Dot( original, decoded ) / sqrtf( lengthSquared * decoded.LengthSquared() );
+	cosAngle = (cosAngle > 1.0f) ? 1.0f : (cosAngle < -1.0f) ? -1.0f : cosAngle;
+	return acosf( cosAngle );
+}
+
+
+// Read and write components of vertex data, which need not be aligned
+static CVector3 ReadVector3( const TUInt8* pData )
+{
+	TFloat32 v[3];
+	memcpy( v, pData, sizeof(v) );
+	return CVector3( v[0], v[1], v[2] );
+}
+
+template <class T> static T ReadValue( const TUInt8* pData )
+{
+	T value;
+	memcpy( &value, pData, sizeof(value) );
+	return value;
+}
+
+template <class T> static void WriteValue( TUInt8* pData, const T& value )
+{
+	memcpy( pData, &value, sizeof(value) );
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Compression
+-----------------------------------------------------------------------------------------*/
+
+// Compress the vertices of an uncompressed sub-mesh, replacing its vertex data with a new array
+// allocated with new[] (the original is deleted). Sets the position scale and offset when
+// quantising positions. Adds the sizes to the given statistics and raises the errors to the
+// largest found
+void CompressSubMesh( SSubMesh* pSubMesh, TUInt32 compression, SVertexCompressStats* pStats )
+{
+	SVertexOffsets original, compressed;
+	GetVertexOffsets( *pSubMesh, 0, &original );
+	GetVertexOffsets( *pSubMesh, compression, &compressed );
+	pStats->originalBytes += pSubMesh->numVertices * original.size;
+	if (compression == 0 || pSubMesh->compression != 0 || pSubMesh->numVertices == 0)
+	{
+		pStats->compressedBytes += pSubMesh->numVertices * SubMeshVertexSize( *pSubMesh );
+		return;
+	}
+	pStats->compressedBytes += pSubMesh->numVertices * compressed.size;
+
+	// Quantised positions cover the bounds of the sub-mesh, flat axes are given a scale of 1 to
+	// keep the decode well defined
+	CVector3 positionOffset( 0.0f, 0.0f, 0.0f );
+	CVector3 positionScale( 1.0f, 1.0f, 1.0f );
+	if (compression & kVertexQuantisePositions)
+	{
+		CVector3 minBounds = ReadVector3( pSubMesh->vertices );
+		CVector3 maxBounds = minBounds;
+		for (TUInt32 vertex = 1; vertex < pSubMesh->numVertices; ++vertex)
+		{
+			CVector3 position = ReadVector3( pSubMesh->vertices + vertex * original.size );
+			for (TUInt32 axis = 0; axis < 3; ++axis)
+			{
+				if (position[axis] < minBounds[axis]) minBounds[axis] = position[axis];
+				if (position[axis] > maxBounds[axis]) maxBounds[axis] = position[axis];
+			}
+		}
+		for (TUInt32 axis = 0; axis < 3; ++axis)
+		{
+			positionOffset[axis] = (minBounds[axis] + maxBounds[axis]) * 0.5f;
+			positionScale[axis] = (maxBounds[axis] - minBounds[axis]) * 0.5f;
+			if (positionScale[axis] <= 0.0f)
+			{
+				positionScale[axis] = 1.0f;
+			}
+		}
+	}
+
+	bool attributes = (compression & kVertexCompressAttributes) != 0;
+	TUInt8* pCompressed = new TUInt8[pSubMesh->numVertices * compressed.size];
+	for (TUInt32 vertex = 0; vertex < pSubMesh->numVertices; ++vertex)
+	{
+		const TUInt8* pIn = pSubMesh->vertices + vertex * original.size;
+		TUInt8* pOut = pCompressed + vertex * compressed.size;
+
+		// Position
+		CVector3 position = ReadVector3( pIn );
+		if (compression & kVertexQuantisePositions)
+		{
+			TInt16 encoded[4];
+			CVector3 decoded;
+			for (TUInt32 axis = 0; axis < 3; ++axis)
+			{
+				encoded[axis] = EncodeSNorm16( (position[axis] - positionOffset[axis]) / positionScale[axis] );
+				decoded[axis] = DecodeSNorm16( encoded[axis] ) * positionScale[axis] + positionOffset[axis];
+			}
+			encoded[3] = 0;
+			memcpy( pOut, encoded, sizeof(encoded) );
+
+			TFloat32 error = Distance( position, decoded );
+			if (error > pStats->positionError)
+			{
+				pStats->positionError = error;
+			}
+		}
+		else
+		{
+			memcpy( pOut, pIn, 3 * sizeof(TFloat32) );
+		}
+
+		// Skinning data is unchanged
+		if (pSubMesh->hasSkinningData)
+		{
+			memcpy( pOut + compressed.skinning, pIn + original.skinning, 4 * sizeof(TFloat32) + sizeof(TUInt32) );
+		}
+
+		// Normals and tangents
+		TUInt32 vectorOffsets[2][2] = { { original.normal, compressed.normal }, { original.tangent, compressed.tangent } };
+		bool hasVectors[2] = { pSubMesh->hasNormals, pSubMesh->hasTangents };
+		for (TUInt32 vector = 0; vector < 2; ++vector)
+		{
+			if (!hasVectors[vector])
+			{
+				continue;
+			}
+			const TUInt8* pVectorIn = pIn + vectorOffsets[vector][0];
+			TUInt8* pVectorOut = pOut + vectorOffsets[vector][1];
+			if (attributes)
+			{
+				CVector3 value = ReadVector3( pVectorIn );
+				TInt16 encoded[2];
+				EncodeOctahedral( value, encoded );
+				memcpy( pVectorOut, encoded, sizeof(encoded) );
+
+				CVector3 decoded = DecodeOctahedral( DecodeSNorm16( encoded[0] ), DecodeSNorm16( encoded[1] ) );
+				TFloat32 error = AngleBetween( value, decoded );
+				if (error > pStats->normalError)
+				{
+					pStats->normalError = error;
+				}
+			}
+			else
+			{
+				memcpy( pVectorOut, pVectorIn, 3 * sizeof(TFloat32) );
+			}
+		}
+
+		// Texture coordinates
+		if (pSubMesh->hasTextureCoords)
+		{
+			if (attributes)
+			{
+				for (TUInt32 coord = 0; coord < 2; ++coord)
+				{
+					TFloat32 value = ReadValue<TFloat32>( pIn + original.uv + coord * sizeof(TFloat32) );
+					TUInt16 encoded = EncodeHalf( value );
+					WriteValue( pOut + compressed.uv + coord * sizeof(TUInt16), encoded );
+
+					TFloat32 error = fabsf( DecodeHalf( encoded ) - value );
+					if (error > pStats->uvError)
+					{
+						pStats->uvError = error;
+					}
+				}
+			}
+			else
+			{
+				memcpy( pOut + compressed.uv, pIn + original.uv, 2 * sizeof(TFloat32) );
+			}
+		}
+
+		// Vertex colours are packed to a byte per channel, as read by the GPU
+		if (pSubMesh->hasVertexColours)
+		{
+			if (attributes)
+			{
+				TUInt8 packed[4];
+				for (TUInt32 channel = 0; channel < 4; ++channel)
+				{
+					TFloat32 value = ReadValue<TFloat32>( pIn + original.colour + channel * sizeof(TFloat32) );
+					value = (value < 0.0f) ? 0.0f : (value > 1.0f) ? 1.0f : value;
+					packed[channel] = static_cast<TUInt8>(value * 255.0f + 0.5f);
+				}
+				memcpy( pOut + compressed.colour, packed, sizeof(packed) );
+			}
+			else
+			{
+				memcpy( pOut + compressed.colour, pIn + original.colour, 4 * sizeof(TFloat32) );
+			}
+		}
+	}
+
+	delete[] pSubMesh->vertices;
+	pSubMesh->vertices = pCompressed;
+	pSubMesh->vertexSize = compressed.size;
+	pSubMesh->compression = compression;
+	pSubMesh->positionOffset = positionOffset;
+	pSubMesh->positionScale = positionScale;
+}
+
+
+} // namespace gen
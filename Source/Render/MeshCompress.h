@@ -0,0 +1,73 @@
+/*******************************************
+	MeshCompress.h
+
+	Compressed vertex formats for sub-mesh
+	storage - quantised positions, octahedral
+	normals and 16-bit texture coordinates
+********************************************/
+
+#pragma once
+
+#include <string.h>
+
+#include "Defines.h"
+#include "CVector2.h"
+#include "CVector3.h"
+#include "MeshData.h"
+
+namespace gen
+{
+
+// A sub-mesh's vertices are normally stored as 32-bit floats. CompressSubMesh converts them to a
+// smaller layout, with the same components in the same order:
+//   - Normals and tangents are octahedral encoded - the unit vector is projected onto an
+//     octahedron, which is unfolded into a square and stored as two 16-bit signed normalised
+//     values (4 bytes instead of 12). Decoded in the vertex shader
+//   - Texture coordinates are stored as 16-bit floats (4 bytes instead of 8), which keeps UVs
+//     outside 0->1 for wrapped textures. Converted by the GPU when read
+//   - Optionally, positions are stored as four 16-bit signed normalised values relative to the
+//     sub-mesh bounds (8 bytes instead of 12). The position is q * positionScale + positionOffset
+//     where q is the stored value, decoded in the vertex shader
+// Skinning data and vertex colours are unchanged. A typical lit, textured vertex is halved from
+// 32 to 16 bytes. The CPU copy of the vertices is compressed too, use the decode functions below
+// to read it
+
+// Compression flags for SSubMesh::compression
+const TUInt32 kVertexCompressAttributes = 1; // Octahedral normals & tangents, 16-bit float UVs
+const TUInt32 kVertexQuantisePositions  = 2; // 16-bit positions relative to the sub-mesh bounds
+
+// Largest errors introduced by compression and the vertex data size before and after
+struct SVertexCompressStats
+{
+	TUInt32  originalBytes;
+	TUInt32  compressedBytes;
+	TFloat32 positionError; // Distance in model space
+	TFloat32 normalError;   // Angle in radians, over normals and tangents
+	TFloat32 uvError;       // Difference in either texture coordinate
+};
+
+// Return the size of a vertex with the components and compression of the given sub-mesh
+TUInt32 SubMeshVertexSize( const SSubMesh& subMesh );
+
+// Compress the vertices of an uncompressed sub-mesh, replacing its vertex data with a new array
+// allocated with new[] (the original is deleted). Sets the position scale and offset when
+// quantising positions. Adds the sizes to the given statistics and raises the errors to the
+// largest found
+void CompressSubMesh( SSubMesh* pSubMesh, TUInt32 compression, SVertexCompressStats* pStats );
+
+// Decode a quantised position - three 16-bit signed normalised values, scaled and offset
+inline CVector3 DecodeQuantisedPosition( const TUInt8* pPosition, const CVector3& scale, const CVector3& offset )
+{
+	TInt16 encoded[3];
+	memcpy( encoded, pPosition, sizeof(encoded) );
+	CVector3 position;
+	for (TUInt32 axis = 0; axis < 3; ++axis)
+	{
+		TFloat32 value = static_cast<TFloat32>(encoded[axis]) / 32767.0f;
+		position[axis] = ((value < -1.0f) ? -1.0f : value) * scale[axis] + offset[axis];
+	}
+	return position;
+}
+
+
+} // namespace gen
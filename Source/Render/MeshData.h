@@ -14,6 +14,7 @@ using namespace std;
 
 #include "Defines.h"
 #include "Colour.h"
+#include "CVector3.h"
 #include "CMatrix4x4.h"
 #include "RenderMethod.h"
 
@@ -35,14 +36,46 @@ struct SMeshNode
 	CMatrix4x4 invMeshOffset;  // Inverse of the matrix of this node in mesh's root space
 };
 
+// Bounding volumes of the geometry controlled by a node (its sub-meshes, not its children), in
+// the node's space. Calculated by CMesh::PreProcess
+struct SMeshNodeBounds
+{
+	bool     hasGeometry; // False if no sub-mesh uses the node, the bounds are then all zero
+	CVector3 minBounds;   // Axis-aligned box
+	CVector3 maxBounds;
+	CVector3 centre;      // Sphere, centred on the box
+	TFloat32 radius;
+};
+
 
-// A single face in a mesh - all faces are triangles
+// A single face in a mesh - all faces are triangles. Faces use 16-bit vertex indices unless the
+// sub-mesh has more vertices than they can address, when SMeshLargeFace is used instead
 struct SMeshFace
 {
 	TUInt16 aiVertex[3];
 };
 typedef vector<SMeshFace> TMeshFaces;
 
+struct SMeshLargeFace
+{
+	TUInt32 aiVertex[3];
+};
+
+// Most vertices in a sub-mesh using 16-bit vertex indices
+const TUInt32 kiMaxSmallIndexVertices = 0x10000;
+
+// Maximum levels of detail in a sub-mesh, including the full detail level
+const TUInt32 kiMaxLODs = 4;
+
+// A level of detail of a sub-mesh - a range of its faces using the same vertices as the full
+// detail mesh, and the largest distance (in model space) the level moves the surface
+struct SSubMeshLOD
+{
+	TUInt32  firstFace;
+	TUInt32  numFaces;
+	TFloat32 error;
+};
+
 // A sub-mesh is a single block of geometry that uses the same material. It contains a set of faces
 // and vertices and is controlled by a single node. The vertices are pointed to as raw bytes,
 // because of the flexibility of vertex data
@@ -53,12 +86,36 @@ struct SSubMesh
 	TUInt32    numVertices;
 	TUInt8*    vertices;    // Pointer to raw vertex data as a byte stream
 	TUInt32    vertexSize;  // Size in bytes of a single vertex
+	TUInt32    compression; // Compressed vertex format flags, 0 for none - see MeshCompress.h
+	CVector3   positionOffset, positionScale; // Decode of quantised positions, 0 and 1 if not quantised
 	bool       hasSkinningData, hasNormals, hasTangents, // Components of each vertex
 	           hasTextureCoords, hasVertexColours;       // (Vertex coordinate assumed)
-	TUInt32    numFaces;
-	SMeshFace* faces;
+	TUInt32    numFaces;    // Faces of the full detail level
+	SMeshFace* faces;       // Faces of all levels of detail, the full detail level first. Either
+	SMeshLargeFace* largeFaces; // the 16-bit faces or the 32-bit large faces are used, other is 0
+	TUInt32    numLODs;     // Levels of detail, at least 1 - level 0 is the full detail faces
+	SSubMeshLOD lods[kiMaxLODs];
 };
 
+// Return the number of faces in a sub-mesh over all its levels of detail
+inline TUInt32 SubMeshTotalFaces( const SSubMesh& subMesh )
+{
+	const SSubMeshLOD& lastLOD = subMesh.lods[subMesh.numLODs - 1];
+	return lastLOD.firstFace + lastLOD.numFaces;
+}
+
+// Return the size in bytes of the vertex indices of a sub-mesh, 2 or 4
+inline TUInt32 SubMeshIndexSize( const SSubMesh& subMesh )
+{
+	return subMesh.largeFaces ? sizeof(TUInt32) : sizeof(TUInt16);
+}
+
+// Return a pointer to the face data of a sub-mesh, whichever index size it uses
+inline const void* SubMeshFaceData( const SSubMesh& subMesh )
+{
+	return subMesh.largeFaces ? static_cast<const void*>(subMesh.largeFaces) : subMesh.faces;
+}
+
 
 
 const TUInt32 kiMaxTextures = 4;
@@ -0,0 +1,354 @@
+/*******************************************
+	MeshOptimise.cpp
+
+	Triangle and vertex reordering for GPU
+	vertex cache and fetch efficiency, and
+	welding of identical vertices
+********************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "MeshOptimise.h"
+
+namespace gen
+{
+
+// Scoring used by OptimiseVertexCache, values from Forsyth's article. Vertices score highly if
+// they are near the front of a modelled LRU cache, and if they have few triangles left to output
+// so that isolated triangles are finished off rather than left for later
+const TUInt32  kOptimiseCacheSize = 32;
+const TFloat32 kCacheDecayPower = 1.5f;
+const TFloat32 kLastTriangleScore = 0.75f;
+const TFloat32 kValenceBoostScale = 2.0f;
+const TFloat32 kValenceBoostPower = 0.5f;
+const TUInt32  kMaxValenceScore = 64; // Valence scores are tabulated below this valence
+
+// Marks an unused entry in index lists
+const TUInt32 kNoIndex = 0xffffffff;
+
+
+// Score tables for OptimiseVertexCache
+struct SVertexScores
+{
+	TFloat32 cache[kOptimiseCacheSize];
+	TFloat32 valence[kMaxValenceScore];
+};
+
+static void InitVertexScores( SVertexScores* pScores )
+{
+	for (TUInt32 position = 0; position < kOptimiseCacheSize; ++position)
+	{
+		if (position < 3)
+		{
+			// Vertices of the last triangle have a fixed score, so the next triangle doesn't
+			// favour any particular edge of it
+			pScores->cache[position] = kLastTriangleScore;
+		}
+		else
+		{
+			TFloat32 scale = 1.0f / (kOptimiseCacheSize - 3);
+			pScores->cache[position] = powf( 1.0f - (position - 3) * scale, kCacheDecayPower );
+		}
+	}
+	pScores->valence[0] = 0.0f;
+	for (TUInt32 valence = 1; valence < kMaxValenceScore; ++valence)
+	{
+		pScores->valence[valence] = kValenceBoostScale * powf( static_cast<TFloat32>(valence), -kValenceBoostPower );
+	}
+}
+
+// Score of a vertex given its position in the modelled cache (-1 if not in the cache) and the
+// number of triangles still to output that use it
+static TFloat32 VertexScore( const SVertexScores& scores, TInt32 cachePosition, TUInt32 valence )
+{
+	if (valence == 0)
+	{
+		return -1.0f; // No triangles left to use this vertex
+	}
+
+	TFloat32 score = (cachePosition >= 0) ? scores.cache[cachePosition] : 0.0f;
+	if (valence < kMaxValenceScore)
+	{
+		score += scores.valence[valence];
+	}
+	else
+	{
+		score += kValenceBoostScale * powf( static_cast<TFloat32>(valence), -kValenceBoostPower );
+	}
+	return score;
+}
+
+
+// Simulate a FIFO vertex cache of the given size processing the triangles, return the ACMR and
+// ATVR. The ATVR counts the vertices referenced by the triangles, not all numVertices
+SVertexCacheStats AnalyseVertexCache( const TUInt32* pIndices, TUInt32 numTriangles, TUInt32 numVertices,
+                                      TUInt32 cacheSize /*= kVertexCacheAnalyseSize*/ )
+{
+	// A vertex entered the cache at the miss count stored for it (0 if never used), it is still
+	// in the cache until cacheSize more vertices have entered
+	vector<TUInt32> cacheEntry( numVertices, 0 );
+	TUInt32 numMisses = 0;
+	TUInt32 numUsed = 0;
+	for (TUInt32 index = 0; index < numTriangles * 3; ++index)
+	{
+		TUInt32 vertex = pIndices[index];
+		if (cacheEntry[vertex] == 0)
+		{
+			++numUsed;
+		}
+		if (cacheEntry[vertex] == 0 || numMisses - cacheEntry[vertex] >= cacheSize)
+		{
+			++numMisses;
+			cacheEntry[vertex] = numMisses;
+		}
+	}
+
+	SVertexCacheStats stats;
+	stats.acmr = numTriangles ? static_cast<TFloat32>(numMisses) / numTriangles : 0.0f;
+	stats.atvr = numUsed ? static_cast<TFloat32>(numMisses) / numUsed : 0.0f;
+	return stats;
+}
+
+
+// Reorder the triangles in place for vertex cache reuse. The order of the vertices within each
+// triangle is kept, so the winding is unchanged
+void OptimiseVertexCache( TUInt32* pIndices, TUInt32 numTriangles, TUInt32 numVertices )
+{
+	if (numTriangles == 0)
+	{
+		return;
+	}
+	TUInt32 numIndices = numTriangles * 3;
+
+	SVertexScores scores;
+	InitVertexScores( &scores );
+
+	// List the triangles using each vertex. The list for a vertex starts at triangleStart, the
+	// first 'valence' entries are the triangles not yet output
+	vector<TUInt32> valence( numVertices, 0 );
+	for (TUInt32 index = 0; index < numIndices; ++index)
+	{
+		++valence[pIndices[index]];
+	}
+	vector<TUInt32> triangleStart( numVertices );
+	TUInt32 start = 0;
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		triangleStart[vertex] = start;
+		start += valence[vertex];
+	}
+	vector<TUInt32> vertexTriangles( numIndices );
+	vector<TUInt32> numListed( numVertices, 0 );
+	for (TUInt32 index = 0; index < numIndices; ++index)
+	{
+		TUInt32 vertex = pIndices[index];
+		vertexTriangles[triangleStart[vertex] + numListed[vertex]++] = index / 3;
+	}
+
+	// Initial scores, all vertices are out of the cache
+	vector<TFloat32> vertexScore( numVertices );
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		vertexScore[vertex] = VertexScore( scores, -1, valence[vertex] );
+	}
+	TUInt32 bestTriangle = 0;
+	TFloat32 bestScore = -1.0f;
+	for (TUInt32 triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		const TUInt32* pTriangle = pIndices + triangle * 3;
+		TFloat32 score = vertexScore[pTriangle[0]] + vertexScore[pTriangle[1]] + vertexScore[pTriangle[2]];
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestTriangle = triangle;
+		}
+	}
+
+	// Output triangles one at a time, each time choosing the best scoring triangle that uses a
+	// vertex in the cache
+	vector<TUInt32> output( numIndices );
+	vector<TUInt8> triangleAdded( numTriangles, 0 );
+	TUInt32 cache[kOptimiseCacheSize + 3];
+	TUInt32 cacheCount = 0;
+	TUInt32 nextUnadded = 0;
+	for (TUInt32 outTriangle = 0; outTriangle < numTriangles; ++outTriangle)
+	{
+		// If no cached vertex has triangles left, continue with the next triangle in the
+		// original order
+		if (bestTriangle == kNoIndex)
+		{
+			while (triangleAdded[nextUnadded])
+			{
+				++nextUnadded;
+			}
+			bestTriangle = nextUnadded;
+		}
+
+		// Output the triangle and remove it from the remaining triangles of its vertices
+		const TUInt32* pTriangle = pIndices + bestTriangle * 3;
+		triangleAdded[bestTriangle] = 1;
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			TUInt32 vertex = pTriangle[corner];
+			output[outTriangle * 3 + corner] = vertex;
+
+			TUInt32* pList = &vertexTriangles[triangleStart[vertex]];
+			TUInt32 last = valence[vertex] - 1;
+			for (TUInt32 entry = 0; entry <= last; ++entry)
+			{
+				if (pList[entry] == bestTriangle)
+				{
+					pList[entry] = pList[last];
+					pList[last] = bestTriangle;
+					break;
+				}
+			}
+			--valence[vertex];
+		}
+
+		// Move the triangle's vertices to the front of the cache, the others move back
+		TUInt32 newCache[kOptimiseCacheSize + 3];
+		TUInt32 newCount = 0;
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			TUInt32 vertex = pTriangle[corner];
+			if ((corner < 1 || vertex != pTriangle[0]) && (corner < 2 || vertex != pTriangle[1]))
+			{
+				newCache[newCount++] = vertex;
+			}
+		}
+		for (TUInt32 entry = 0; entry < cacheCount; ++entry)
+		{
+			TUInt32 vertex = cache[entry];
+			if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2])
+			{
+				newCache[newCount++] = vertex;
+			}
+		}
+
+		// Update scores of all vertices that moved, including those pushed out of the cache
+		for (TUInt32 entry = 0; entry < newCount; ++entry)
+		{
+			TUInt32 vertex = newCache[entry];
+			TInt32 position = (entry < kOptimiseCacheSize) ? static_cast<TInt32>(entry) : -1;
+			vertexScore[vertex] = VertexScore( scores, position, valence[vertex] );
+		}
+
+		// Rescore the remaining triangles of those vertices and choose the best for next time
+		bestTriangle = kNoIndex;
+		bestScore = -1.0f;
+		for (TUInt32 entry = 0; entry < newCount; ++entry)
+		{
+			TUInt32 vertex = newCache[entry];
+			const TUInt32* pList = &vertexTriangles[triangleStart[vertex]];
+			for (TUInt32 listEntry = 0; listEntry < valence[vertex]; ++listEntry)
+			{
+				TUInt32 triangle = pList[listEntry];
+				const TUInt32* pScored = pIndices + triangle * 3;
+				TFloat32 score = vertexScore[pScored[0]] + vertexScore[pScored[1]] + vertexScore[pScored[2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangle;
+				}
+			}
+		}
+
+		cacheCount = (newCount < kOptimiseCacheSize) ? newCount : kOptimiseCacheSize;
+		for (TUInt32 entry = 0; entry < cacheCount; ++entry)
+		{
+			cache[entry] = newCache[entry];
+		}
+	}
+
+	for (TUInt32 index = 0; index < numIndices; ++index)
+	{
+		pIndices[index] = output[index];
+	}
+}
+
+
+// Renumber the vertices in the order they are first used by the triangles, updating the indices
+// in place. Fills pRemap with the new index of each original vertex, used to reorder the vertex
+// data with RemapVertices. Unused vertices are kept, after all the used ones
+void OptimiseVertexFetch( TUInt32* pIndices, TUInt32 numTriangles, TUInt32 numVertices,
+                          vector<TUInt32>* pRemap )
+{
+	pRemap->assign( numVertices, kNoIndex );
+	TUInt32 nextVertex = 0;
+	for (TUInt32 index = 0; index < numTriangles * 3; ++index)
+	{
+		TUInt32& remap = (*pRemap)[pIndices[index]];
+		if (remap == kNoIndex)
+		{
+			remap = nextVertex++;
+		}
+		pIndices[index] = remap;
+	}
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		if ((*pRemap)[vertex] == kNoIndex)
+		{
+			(*pRemap)[vertex] = nextVertex++;
+		}
+	}
+}
+
+
+// Hash of the data of a single vertex for WeldVertices
+static TUInt32 HashVertex( const TUInt32* pWords, TUInt32 numWords )
+{
+	TUInt32 hash = 0x811c9dc5;
+	for (TUInt32 word = 0; word < numWords; ++word)
+	{
+		hash = (hash ^ pWords[word]) * 0x9e3779b1;
+		hash ^= hash >> 15;
+	}
+	return hash;
+}
+
+// Find vertices with identical data in an interleaved vertex stream of 32-bit words (e.g. the
+// final vertex data of a mesh). Fills pRemap with the new index of each vertex - identical
+// vertices share the index of the first of them and the unique vertices keep their original
+// order. Returns the number of unique vertices
+TUInt32 WeldVertices( const TUInt32* pVertexWords, TUInt32 numVertices, TUInt32 vertexWords,
+                      vector<TUInt32>* pRemap )
+{
+	pRemap->resize( numVertices );
+
+	// Open addressing hash table of the first vertex with each distinct data, at most half full
+	TUInt32 tableSize = 1;
+	while (tableSize < numVertices * 2)
+	{
+		tableSize *= 2;
+	}
+	vector<TUInt32> table( tableSize, kNoIndex );
+
+	TUInt32 numUnique = 0;
+	size_t vertexBytes = vertexWords * sizeof(TUInt32);
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		const TUInt32* pVertex = pVertexWords + vertex * vertexWords;
+		TUInt32 slot = HashVertex( pVertex, vertexWords ) & (tableSize - 1);
+		while (table[slot] != kNoIndex &&
+		       memcmp( pVertexWords + table[slot] * vertexWords, pVertex, vertexBytes ) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] == kNoIndex)
+		{
+			table[slot] = vertex;
+			(*pRemap)[vertex] = numUnique++;
+		}
+		else
+		{
+			(*pRemap)[vertex] = (*pRemap)[table[slot]];
+		}
+	}
+	return numUnique;
+}
+
+
+} // namespace gen
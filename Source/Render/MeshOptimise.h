@@ -0,0 +1,96 @@
+/*******************************************
+	MeshOptimise.h
+
+	Triangle and vertex reordering for GPU
+	vertex cache and fetch efficiency, and
+	welding of identical vertices
+********************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+
+namespace gen
+{
+
+// The functions work on triangle lists given as an array of vertex indices, three per triangle.
+// OptimiseVertexCache reorders the triangles so recently used vertices are reused while they
+// are still in the GPU's post-transform vertex cache (Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation"). OptimiseVertexFetch then renumbers the vertices in the order the triangles
+// first use them, so vertex data is read from memory mostly sequentially. Run in that order, the
+// second doesn't change the triangle order so keeps the cache efficiency of the first
+
+// Efficiency of a triangle list with a simulated FIFO vertex cache
+struct SVertexCacheStats
+{
+	TFloat32 acmr; // Average cache miss ratio - vertices transformed per triangle, 0.5 to 3
+	TFloat32 atvr; // Average transformed vertex ratio - vertices transformed per vertex used, 1 is ideal
+};
+
+// Size of the FIFO cache simulated by AnalyseVertexCache, a conservative size for older GPUs
+const TUInt32 kVertexCacheAnalyseSize = 16;
+
+// Simulate a FIFO vertex cache of the given size processing the triangles, return the ACMR and
+// ATVR. The ATVR counts the vertices referenced by the triangles, not all numVertices
+SVertexCacheStats AnalyseVertexCache( const TUInt32* pIndices, TUInt32 numTriangles, TUInt32 numVertices,
+                                      TUInt32 cacheSize = kVertexCacheAnalyseSize );
+
+// Reorder the triangles in place for vertex cache reuse. The order of the vertices within each
+// triangle is kept, so the winding is unchanged
+void OptimiseVertexCache( TUInt32* pIndices, TUInt32 numTriangles, TUInt32 numVertices );
+
+// Renumber the vertices in the order they are first used by the triangles, updating the indices
+// in place. Fills pRemap with the new index of each original vertex, used to reorder the vertex
+// data with RemapVertices. Unused vertices are kept, after all the used ones
+void OptimiseVertexFetch( TUInt32* pIndices, TUInt32 numTriangles, TUInt32 numVertices,
+                          vector<TUInt32>* pRemap );
+
+// Reorder a list of per-vertex data with a remap from OptimiseVertexFetch. Empty lists are left
+// empty, so can be used for optional vertex components
+template <class T> void RemapVertices( vector<T>* pData, const vector<TUInt32>& remap )
+{
+	if (pData->empty())
+	{
+		return;
+	}
+	vector<T> remapped( pData->size() );
+	for (TUInt32 vertex = 0; vertex < remap.size(); ++vertex)
+	{
+		remapped[remap[vertex]] = (*pData)[vertex];
+	}
+	pData->swap( remapped );
+}
+
+
+// Find vertices with identical data in an interleaved vertex stream of 32-bit words (e.g. the
+// final vertex data of a mesh). Fills pRemap with the new index of each vertex - identical
+// vertices share the index of the first of them and the unique vertices keep their original
+// order. Returns the number of unique vertices. The indices of the triangles using the vertices
+// can then be updated through the remap
+TUInt32 WeldVertices( const TUInt32* pVertexWords, TUInt32 numVertices, TUInt32 vertexWords,
+                      vector<TUInt32>* pRemap );
+
+// Compact a list of per-vertex data with a remap from WeldVertices, keeping the data of the
+// first vertex of each welded set. Empty lists are left empty
+template <class T> void WeldVertexData( vector<T>* pData, const vector<TUInt32>& remap, TUInt32 numUnique )
+{
+	if (pData->empty())
+	{
+		return;
+	}
+	TUInt32 numWritten = 0;
+	for (TUInt32 vertex = 0; vertex < remap.size(); ++vertex)
+	{
+		if (remap[vertex] == numWritten)
+		{
+			(*pData)[numWritten++] = (*pData)[vertex];
+		}
+	}
+	pData->resize( numUnique );
+}
+
+
+} // namespace gen
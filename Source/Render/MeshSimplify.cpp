@@ -0,0 +1,492 @@
+/*******************************************
+	MeshSimplify.cpp
+
+	Mesh simplification by quadric error
+	edge collapse, for levels of detail
+********************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include "MeshOptimise.h"
+#include "MeshSimplify.h"
+
+namespace gen
+{
+
+// Weight of the planes added along open borders, relative to the faces. Keeps the outline of
+// the mesh in place
+const TFloat64 kBorderWeight = 10.0;
+
+// A collapse is rejected if it rotates a remaining triangle's normal by more than this much
+// (cosine of about 75 degrees)
+const TFloat64 kMaxNormalChange = 0.25;
+
+// Marks an unused entry in index lists
+const TUInt32 kNoIndex = 0xffffffff;
+
+
+/*-----------------------------------------------------------------------------------------
+	Quadrics
+-----------------------------------------------------------------------------------------*/
+
+// Sum of squared distances to a set of weighted planes, stored as the symmetric matrix form
+// x'Ax + 2b.x + c. The total weight is kept to return an average squared distance
+struct SQuadric
+{
+	TFloat64 a00, a01, a02, a11, a12, a22;
+	TFloat64 b0, b1, b2;
+	TFloat64 c;
+	TFloat64 weight;
+};
+
+// Add the plane n.x + d = 0 with the given weight, n must be unit length
+static void AddPlane( SQuadric* pQuadric, TFloat64 nx, TFloat64 ny, TFloat64 nz, TFloat64 d,
+                      TFloat64 weight )
+{
+	pQuadric->a00 += weight * nx * nx;
+	pQuadric->a01 += weight * nx * ny;
+	pQuadric->a02 += weight * nx * nz;
+	pQuadric->a11 += weight * ny * ny;
+	pQuadric->a12 += weight * ny * nz;
+	pQuadric->a22 += weight * nz * nz;
+	pQuadric->b0 += weight * nx * d;
+	pQuadric->b1 += weight * ny * d;
+	pQuadric->b2 += weight * nz * d;
+	pQuadric->c += weight * d * d;
+	pQuadric->weight += weight;
+}
+
+static void AddQuadric( SQuadric* pQuadric, const SQuadric& other )
+{
+	pQuadric->a00 += other.a00;
+	pQuadric->a01 += other.a01;
+	pQuadric->a02 += other.a02;
+	pQuadric->a11 += other.a11;
+	pQuadric->a12 += other.a12;
+	pQuadric->a22 += other.a22;
+	pQuadric->b0 += other.b0;
+	pQuadric->b1 += other.b1;
+	pQuadric->b2 += other.b2;
+	pQuadric->c += other.c;
+	pQuadric->weight += other.weight;
+}
+
+// Average squared distance of a point from the planes of a quadric
+static TFloat64 QuadricError( const SQuadric& q, const CVector3& point )
+{
+	TFloat64 x = point.x, y = point.y, z = point.z;
+	TFloat64 error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+	                 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+	                 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+	return (q.weight > 0.0 && error > 0.0) ? error / q.weight : 0.0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Simplification
+-----------------------------------------------------------------------------------------*/
+
+// Triangle connectivity of the current mesh, rebuilt for each pass
+struct SSimplifyMesh
+{
+	const CVector3*  pPositions;
+	vector<TUInt32>  position;       // Position of each vertex - the first vertex at that position
+	vector<TUInt32>  wedgeStart;     // Vertices at each position are wedges[wedgeStart[p]] onwards
+	vector<TUInt32>  wedges;
+	vector<TUInt32>  indices;        // Current triangles
+	vector<TUInt32>  triangleStart;  // Triangles using each vertex are vertexTriangles[triangleStart[v]] onwards
+	vector<TUInt32>  vertexTriangles;
+	vector<TUInt64>  edges;          // Sorted directed edges between positions, as (from << 32) | to
+};
+
+// Vertices are classified by the open (unmatched) edges at their position
+enum EVertexKind
+{
+	kManifold, // Surrounded by triangles, can collapse onto any neighbour
+	kBorder,   // On a simple open border, can only collapse along the border
+	kLocked,   // Complex or non-manifold connectivity, never moved
+};
+
+static TUInt64 EdgeKey( TUInt32 from, TUInt32 to )
+{
+	return (static_cast<TUInt64>(from) << 32) | to;
+}
+
+static bool HasEdge( const SSimplifyMesh& mesh, TUInt32 from, TUInt32 to )
+{
+	return binary_search( mesh.edges.begin(), mesh.edges.end(), EdgeKey( from, to ) );
+}
+
+// Build the triangle lists of each vertex and the edge list for the current triangles
+static void BuildConnectivity( SSimplifyMesh* pMesh, TUInt32 numVertices )
+{
+	TUInt32 numIndices = static_cast<TUInt32>(pMesh->indices.size());
+
+	pMesh->triangleStart.assign( numVertices + 1, 0 );
+	for (TUInt32 index = 0; index < numIndices; ++index)
+	{
+		++pMesh->triangleStart[pMesh->indices[index] + 1];
+	}
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		pMesh->triangleStart[vertex + 1] += pMesh->triangleStart[vertex];
+	}
+	pMesh->vertexTriangles.resize( numIndices );
+	vector<TUInt32> insertPos( pMesh->triangleStart.begin(), pMesh->triangleStart.end() - 1 );
+	for (TUInt32 index = 0; index < numIndices; ++index)
+	{
+		pMesh->vertexTriangles[insertPos[pMesh->indices[index]]++] = index / 3;
+	}
+
+	pMesh->edges.resize( numIndices );
+	for (TUInt32 index = 0; index < numIndices; ++index)
+	{
+		TUInt32 next = (index % 3 == 2) ? index - 2 : index + 1;
+		pMesh->edges[index] = EdgeKey( pMesh->position[pMesh->indices[index]],
+		                               pMesh->position[pMesh->indices[next]] );
+	}
+	sort( pMesh->edges.begin(), pMesh->edges.end() );
+}
+
+// Find the vertex each wedge at position p moves to when p collapses onto position q - a vertex
+// at q sharing a triangle with the wedge. Returns false if a wedge in use has no such vertex, e.g.
+// when collapsing across a texture seam
+static bool FindCollapseTargets( const SSimplifyMesh& mesh, TUInt32 p, TUInt32 q, TUInt32* pTargets )
+{
+	for (TUInt32 wedge = mesh.wedgeStart[p]; wedge < mesh.wedgeStart[p + 1]; ++wedge)
+	{
+		TUInt32 vertex = mesh.wedges[wedge];
+		TUInt32 target = kNoIndex;
+		for (TUInt32 entry = mesh.triangleStart[vertex];
+		     entry < mesh.triangleStart[vertex + 1] && target == kNoIndex; ++entry)
+		{
+			const TUInt32* pTriangle = &mesh.indices[mesh.vertexTriangles[entry] * 3];
+			for (TUInt32 corner = 0; corner < 3; ++corner)
+			{
+				if (mesh.position[pTriangle[corner]] == q)
+				{
+					target = pTriangle[corner];
+				}
+			}
+		}
+		if (target == kNoIndex && mesh.triangleStart[vertex] != mesh.triangleStart[vertex + 1])
+		{
+			return false;
+		}
+		pTargets[wedge - mesh.wedgeStart[p]] = target;
+	}
+	return true;
+}
+
+// Return true if moving position p onto position q would flip or badly distort any of the
+// triangles that remain after the collapse
+static bool CollapseFlips( const SSimplifyMesh& mesh, TUInt32 p, TUInt32 q )
+{
+	const CVector3& target = mesh.pPositions[q];
+	for (TUInt32 wedge = mesh.wedgeStart[p]; wedge < mesh.wedgeStart[p + 1]; ++wedge)
+	{
+		TUInt32 vertex = mesh.wedges[wedge];
+		for (TUInt32 entry = mesh.triangleStart[vertex]; entry < mesh.triangleStart[vertex + 1]; ++entry)
+		{
+			const TUInt32* pTriangle = &mesh.indices[mesh.vertexTriangles[entry] * 3];
+			TUInt32 corners[3] = { mesh.position[pTriangle[0]], mesh.position[pTriangle[1]],
+			                       mesh.position[pTriangle[2]] };
+			if (corners[0] == q || corners[1] == q || corners[2] == q)
+			{
+				continue; // Removed by the collapse
+			}
+
+			// Rotate so the moving corner is first
+			TUInt32 first = (corners[0] == p) ? 0 : (corners[1] == p) ? 1 : 2;
+			const CVector3& b = mesh.pPositions[corners[(first + 1) % 3]];
+			const CVector3& c = mesh.pPositions[corners[(first + 2) % 3]];
+			CVector3 before = (b - mesh.pPositions[p]).Cross( c - mesh.pPositions[p] );
+			CVector3 after = (b - target).Cross( c - target );
+			TFloat64 dot = before.Dot( after );
+			if (dot <= kMaxNormalChange * before.Length() * after.Length())
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// A possible collapse of position 'from' onto neighbouring position 'to'
+struct SCollapse
+{
+	TUInt32  from;
+	TUInt32  to;
+	TFloat64 error; // Average squared distance
+};
+
+static bool CollapseLess( const SCollapse& a, const SCollapse& b )
+{
+	return a.error < b.error;
+}
+
+
+// Simplify a triangle list towards the given number of triangles, without exceeding the given
+// error (a distance in model space). The simplified triangles are returned in pResult, using the
+// original vertices, and the largest error of the collapses made in pError. Stops above the
+// target if no more collapses are within the error
+void SimplifyMesh( const TUInt32* pIndices, TUInt32 numTriangles, const CVector3* pPositions,
+                   TUInt32 numVertices, TUInt32 targetTriangles, TFloat32 maxError,
+                   vector<TUInt32>* pResult, TFloat32* pError )
+{
+	*pError = 0.0f;
+	pResult->assign( pIndices, pIndices + numTriangles * 3 );
+	if (numTriangles <= targetTriangles || numVertices == 0)
+	{
+		return;
+	}
+
+	// Group vertices with identical positions, each group is represented by its first vertex
+	SSimplifyMesh mesh;
+	mesh.pPositions = pPositions;
+	vector<TUInt32> positionRemap;
+	TUInt32 numPositions = WeldVertices( reinterpret_cast<const TUInt32*>(pPositions), numVertices,
+	                                     sizeof(CVector3) / sizeof(TUInt32), &positionRemap );
+	vector<TUInt32> firstVertex( numPositions, kNoIndex );
+	mesh.position.resize( numVertices );
+	mesh.wedgeStart.assign( numVertices + 1, 0 );
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		TUInt32& first = firstVertex[positionRemap[vertex]];
+		if (first == kNoIndex)
+		{
+			first = vertex;
+		}
+		mesh.position[vertex] = first;
+		++mesh.wedgeStart[first + 1];
+	}
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		mesh.wedgeStart[vertex + 1] += mesh.wedgeStart[vertex];
+	}
+	mesh.wedges.resize( numVertices );
+	vector<TUInt32> insertPos( mesh.wedgeStart.begin(), mesh.wedgeStart.end() - 1 );
+	TUInt32 maxWedges = 0;
+	for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+	{
+		TUInt32 p = mesh.position[vertex];
+		mesh.wedges[insertPos[p]++] = vertex;
+		maxWedges = max( maxWedges, mesh.wedgeStart[p + 1] - mesh.wedgeStart[p] );
+	}
+	mesh.indices.swap( *pResult );
+	BuildConnectivity( &mesh, numVertices );
+
+	// Quadric of each position - the planes of the triangles around it, plus planes at right
+	// angles to any open border edges
+	vector<SQuadric> quadrics( numVertices, SQuadric() );
+	for (TUInt32 triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		TUInt32 corners[3];
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			corners[corner] = mesh.position[mesh.indices[triangle * 3 + corner]];
+		}
+		const CVector3& a = pPositions[corners[0]];
+		CVector3 normal = (pPositions[corners[1]] - a).Cross( pPositions[corners[2]] - a );
+		TFloat64 length = normal.Length();
+		if (length == 0.0)
+		{
+			continue;
+		}
+		TFloat64 nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+		TFloat64 d = -(nx * a.x + ny * a.y + nz * a.z);
+		for (TUInt32 corner = 0; corner < 3; ++corner)
+		{
+			AddPlane( &quadrics[corners[corner]], nx, ny, nz, d, length * 0.5 );
+		}
+
+		for (TUInt32 edge = 0; edge < 3; ++edge)
+		{
+			TUInt32 from = corners[edge], to = corners[(edge + 1) % 3];
+			if (HasEdge( mesh, to, from ))
+			{
+				continue;
+			}
+			CVector3 edgeVector = pPositions[to] - pPositions[from];
+			CVector3 borderNormal = edgeVector.Cross( normal );
+			TFloat64 borderLength = borderNormal.Length();
+			if (borderLength == 0.0)
+			{
+				continue;
+			}
+			TFloat64 bx = borderNormal.x / borderLength, by = borderNormal.y / borderLength,
+			         bz = borderNormal.z / borderLength;
+			TFloat64 bd = -(bx * pPositions[from].x + by * pPositions[from].y + bz * pPositions[from].z);
+			TFloat64 weight = edgeVector.LengthSquared() * kBorderWeight;
+			AddPlane( &quadrics[from], bx, by, bz, bd, weight );
+			AddPlane( &quadrics[to], bx, by, bz, bd, weight );
+		}
+	}
+
+	TFloat64 maxErrorSquared = static_cast<TFloat64>(maxError) * maxError;
+	TFloat64 largestError = 0.0;
+	vector<TUInt8> kind( numVertices );
+	vector<TUInt8> changed( numVertices );
+	vector<TUInt32> openOut( numVertices ), openIn( numVertices );
+	vector<TUInt32> vertexTarget( numVertices );
+	vector<TUInt32> neighbours;
+	vector<TUInt32> targets( maxWedges );
+	vector<SCollapse> collapses;
+
+	// Each pass chooses the best collapse for every position, then makes the cheapest ones that
+	// don't touch each other. Stops when the target is reached or no collapse is possible
+	TUInt32 currentTriangles = numTriangles;
+	while (currentTriangles > targetTriangles)
+	{
+		// Classify positions by the open edges around them
+		fill( openOut.begin(), openOut.end(), 0 );
+		fill( openIn.begin(), openIn.end(), 0 );
+		for (TUInt32 edge = 0; edge < mesh.edges.size(); ++edge)
+		{
+			TUInt32 from = static_cast<TUInt32>(mesh.edges[edge] >> 32);
+			TUInt32 to = static_cast<TUInt32>(mesh.edges[edge]);
+			if (!HasEdge( mesh, to, from ))
+			{
+				++openOut[from];
+				++openIn[to];
+			}
+		}
+		for (TUInt32 p = 0; p < numVertices; ++p)
+		{
+			kind[p] = (openOut[p] == 0 && openIn[p] == 0) ? kManifold :
+			          (openOut[p] == 1 && openIn[p] == 1) ? kBorder : kLocked;
+		}
+
+		// Find the cheapest valid collapse of each position that is still in use
+		collapses.clear();
+		for (TUInt32 p = 0; p < numVertices; ++p)
+		{
+			if (mesh.position[p] != p || kind[p] == kLocked)
+			{
+				continue;
+			}
+
+			// List the neighbouring positions
+			neighbours.clear();
+			for (TUInt32 wedge = mesh.wedgeStart[p]; wedge < mesh.wedgeStart[p + 1]; ++wedge)
+			{
+				TUInt32 vertex = mesh.wedges[wedge];
+				for (TUInt32 entry = mesh.triangleStart[vertex]; entry < mesh.triangleStart[vertex + 1]; ++entry)
+				{
+					const TUInt32* pTriangle = &mesh.indices[mesh.vertexTriangles[entry] * 3];
+					for (TUInt32 corner = 0; corner < 3; ++corner)
+					{
+						TUInt32 q = mesh.position[pTriangle[corner]];
+						if (q != p && find( neighbours.begin(), neighbours.end(), q ) == neighbours.end())
+						{
+							neighbours.push_back( q );
+						}
+					}
+				}
+			}
+
+			SCollapse best = { p, kNoIndex, maxErrorSquared };
+			for (TUInt32 neighbour = 0; neighbour < neighbours.size(); ++neighbour)
+			{
+				TUInt32 q = neighbours[neighbour];
+				if (kind[p] == kBorder && HasEdge( mesh, p, q ) == HasEdge( mesh, q, p ))
+				{
+					continue; // Border positions only move along the border
+				}
+				TFloat64 error = QuadricError( quadrics[p], pPositions[q] );
+				if (error <= best.error && FindCollapseTargets( mesh, p, q, &targets[0] ) &&
+				    !CollapseFlips( mesh, p, q ))
+				{
+					best.to = q;
+					best.error = error;
+				}
+			}
+			if (best.to != kNoIndex)
+			{
+				collapses.push_back( best );
+			}
+		}
+		if (collapses.empty())
+		{
+			break;
+		}
+		sort( collapses.begin(), collapses.end(), CollapseLess );
+
+		// Make the cheapest collapses, skipping any near an earlier collapse in this pass as its
+		// triangles and error have changed
+		for (TUInt32 vertex = 0; vertex < numVertices; ++vertex)
+		{
+			vertexTarget[vertex] = vertex;
+		}
+		fill( changed.begin(), changed.end(), 0 );
+		TUInt32 numCollapsed = 0;
+		for (TUInt32 collapse = 0; collapse < collapses.size() && currentTriangles > targetTriangles; ++collapse)
+		{
+			TUInt32 p = collapses[collapse].from, q = collapses[collapse].to;
+			if (changed[p] || changed[q])
+			{
+				continue;
+			}
+			FindCollapseTargets( mesh, p, q, &targets[0] );
+
+			// Move each wedge and mark the neighbourhood, counting the triangles that collapse
+			for (TUInt32 wedge = mesh.wedgeStart[p]; wedge < mesh.wedgeStart[p + 1]; ++wedge)
+			{
+				TUInt32 vertex = mesh.wedges[wedge];
+				if (targets[wedge - mesh.wedgeStart[p]] != kNoIndex)
+				{
+					vertexTarget[vertex] = targets[wedge - mesh.wedgeStart[p]];
+				}
+				for (TUInt32 entry = mesh.triangleStart[vertex]; entry < mesh.triangleStart[vertex + 1]; ++entry)
+				{
+					const TUInt32* pTriangle = &mesh.indices[mesh.vertexTriangles[entry] * 3];
+					bool removed = false;
+					for (TUInt32 corner = 0; corner < 3; ++corner)
+					{
+						TUInt32 cornerPosition = mesh.position[pTriangle[corner]];
+						changed[cornerPosition] = 1;
+						removed = removed || cornerPosition == q;
+					}
+					if (removed)
+					{
+						--currentTriangles;
+					}
+				}
+			}
+			AddQuadric( &quadrics[q], quadrics[p] );
+			largestError = max( largestError, collapses[collapse].error );
+			++numCollapsed;
+		}
+		if (numCollapsed == 0)
+		{
+			break;
+		}
+
+		// Move the collapsed vertices and remove the triangles that have become degenerate
+		TUInt32 numIndices = 0;
+		for (TUInt32 index = 0; index < mesh.indices.size(); index += 3)
+		{
+			TUInt32 a = vertexTarget[mesh.indices[index]];
+			TUInt32 b = vertexTarget[mesh.indices[index + 1]];
+			TUInt32 c = vertexTarget[mesh.indices[index + 2]];
+			TUInt32 pa = mesh.position[a], pb = mesh.position[b], pc = mesh.position[c];
+			if (pa != pb && pb != pc && pc != pa)
+			{
+				mesh.indices[numIndices++] = a;
+				mesh.indices[numIndices++] = b;
+				mesh.indices[numIndices++] = c;
+			}
+		}
+		mesh.indices.resize( numIndices );
+		currentTriangles = numIndices / 3;
+		BuildConnectivity( &mesh, numVertices );
+	}
+
+	// Collapsed positions have no triangles so are never referenced again. Return the result
+	mesh.indices.swap( *pResult );
+	*pError = static_cast<TFloat32>(sqrt( largestError ));
+}
+
+
+} // namespace gen
@@ -0,0 +1,36 @@
+/*******************************************
+	MeshSimplify.h
+
+	Mesh simplification by quadric error
+	edge collapse, for levels of detail
+********************************************/
+
+#pragma once
+
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+
+namespace gen
+{
+
+// SimplifyMesh reduces a triangle list by repeatedly collapsing an edge - moving one vertex onto
+// a neighbour - choosing the collapses that least change the shape (Garland & Heckbert's quadric
+// error metric). A vertex is only ever moved onto an existing vertex, so the simplified triangles
+// use the original vertex data and a level of detail only needs its own index list.
+// Vertices in the same position but with different attributes (at texture seams or hard edges)
+// are moved together onto matching vertices along the seam, or not at all. Open borders only
+// collapse along the border. So the simplified mesh keeps its texture mapping and outline
+
+// Simplify a triangle list towards the given number of triangles, without exceeding the given
+// error (a distance in model space). The simplified triangles are returned in pResult, using the
+// original vertices, and the largest error of the collapses made in pError. Stops above the
+// target if no more collapses are within the error
+void SimplifyMesh( const TUInt32* pIndices, TUInt32 numTriangles, const CVector3* pPositions,
+                   TUInt32 numVertices, TUInt32 targetTriangles, TFloat32 maxError,
+                   vector<TUInt32>* pResult, TFloat32* pError );
+
+
+} // namespace gen
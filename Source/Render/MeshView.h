@@ -0,0 +1,127 @@
+/*******************************************
+	MeshView.h
+
+	Read-only views of the geometry of a
+	sub-mesh, used in place without copying
+********************************************/
+
+#pragma once
+
+#include <string.h>
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "MeshData.h"
+#include "MeshCompress.h"
+
+namespace gen
+{
+
+// The views point into the sub-mesh data and hold no other state, so any number may be used at
+// once, from any thread, for as long as the mesh is loaded. Geometry scans such as building
+// bounds, collision data or a BVH can split the sub-meshes, or ranges of vertices and triangles,
+// between threads with no locking
+
+// The positions of the vertices of a sub-mesh - a strided stream into the vertex data, decoding
+// quantised positions
+struct SMeshPositionView
+{
+	const TUInt8* data;        // Position of the first vertex
+	TUInt32       stride;      // Bytes from one vertex to the next
+	TUInt32       numVertices;
+	bool          quantised;   // 16-bit positions decoded with the scale and offset, see MeshCompress.h
+	CVector3      scale;
+	CVector3      offset;
+
+	// Return the position of a vertex
+	CVector3 operator[]( TUInt32 vertex ) const
+	{
+		const TUInt8* pPosition = data + vertex * stride;
+		if (quantised)
+		{
+			return DecodeQuantisedPosition( pPosition, scale, offset );
+		}
+		TFloat32 position[3];
+		memcpy( position, pPosition, sizeof(position) );
+		return CVector3( position[0], position[1], position[2] );
+	}
+
+	// Get the positions of a range of vertices, for scanning in blocks
+	void GetPositions( TUInt32 firstVertex, TUInt32 numPositions, CVector3* pPositions ) const
+	{
+		for (TUInt32 vertex = 0; vertex < numPositions; ++vertex)
+		{
+			pPositions[vertex] = (*this)[firstVertex + vertex];
+		}
+	}
+};
+
+// The triangles of one level of detail of a sub-mesh - a span of 16 or 32-bit vertex indices,
+// three per triangle
+struct SMeshTriangleView
+{
+	const TUInt16* indices16;   // One of these is used, the other is 0
+	const TUInt32* indices32;
+	TUInt32        numTriangles;
+
+	// Get the three vertex indices of a triangle
+	void GetTriangle( TUInt32 triangle, TUInt32* pIndices ) const
+	{
+		if (indices32)
+		{
+			const TUInt32* pTriangle = indices32 + triangle * 3;
+			pIndices[0] = pTriangle[0];
+			pIndices[1] = pTriangle[1];
+			pIndices[2] = pTriangle[2];
+		}
+		else
+		{
+			const TUInt16* pTriangle = indices16 + triangle * 3;
+			pIndices[0] = pTriangle[0];
+			pIndices[1] = pTriangle[1];
+			pIndices[2] = pTriangle[2];
+		}
+	}
+};
+
+// The geometry of a sub-mesh, its positions and the triangles of one level of detail
+struct SSubMeshView
+{
+	TUInt32           node; // Node controlling the sub-mesh, the positions are in this node's space
+	SMeshPositionView positions;
+	SMeshTriangleView triangles;
+
+	// Get the three corner positions of a triangle
+	void GetTriangle( TUInt32 triangle, CVector3* pCorners ) const
+	{
+		TUInt32 indices[3];
+		triangles.GetTriangle( triangle, indices );
+		pCorners[0] = positions[indices[0]];
+		pCorners[1] = positions[indices[1]];
+		pCorners[2] = positions[indices[2]];
+	}
+};
+
+// Make a view of a sub-mesh with the triangles of the given level of detail, sub-meshes with
+// fewer levels use their coarsest one
+inline SSubMeshView MakeSubMeshView( const SSubMesh& subMesh, TUInt32 lod = 0 )
+{
+	SSubMeshView view;
+	view.node = subMesh.node;
+
+	view.positions.data = subMesh.vertices;
+	view.positions.stride = subMesh.vertexSize;
+	view.positions.numVertices = subMesh.numVertices;
+	view.positions.quantised = (subMesh.compression & kVertexQuantisePositions) != 0;
+	view.positions.scale = subMesh.positionScale;
+	view.positions.offset = subMesh.positionOffset;
+
+	const SSubMeshLOD& lodFaces = subMesh.lods[(lod < subMesh.numLODs) ? lod : subMesh.numLODs - 1];
+	view.triangles.indices16 = subMesh.faces ? subMesh.faces[lodFaces.firstFace].aiVertex : 0;
+	view.triangles.indices32 = subMesh.largeFaces ? subMesh.largeFaces[lodFaces.firstFace].aiVertex : 0;
+	view.triangles.numTriangles = lodFaces.numFaces;
+	return view;
+}
+
+
+} // namespace gen
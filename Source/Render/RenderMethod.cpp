@@ -157,6 +157,11 @@ ID3D10EffectVectorVariable* DiffuseColourVar = NULL;
 ID3D10EffectVectorVariable* SpecularColourVar = NULL;
 ID3D10EffectScalarVariable* SpecularPowerVar = NULL;
 
+// Vertex decoding
+ID3D10EffectVectorVariable* PositionScaleVar = NULL;
+ID3D10EffectVectorVariable* PositionOffsetVar = NULL;
+ID3D10EffectScalarVariable* OctahedralNormalsVar = NULL;
+
 // Textures
 ID3D10EffectShaderResourceVariable* DiffuseMapVar = NULL;
 ID3D10EffectShaderResourceVariable* DiffuseMap2Var = NULL; // Second diffuse map for special techniques
@@ -201,6 +206,11 @@ bool InitialiseMethods()
 	SpecularColourVar = Effect->GetVariableByName( "SpecularColour" )->AsVector();
 	SpecularPowerVar  = Effect->GetVariableByName( "SpecularPower" )->AsScalar();
 
+	// Access vertex decoding shader variables
+	PositionScaleVar     = Effect->GetVariableByName( "PositionScale"     )->AsVector();
+	PositionOffsetVar    = Effect->GetVariableByName( "PositionOffset"    )->AsVector();
+	OctahedralNormalsVar = Effect->GetVariableByName( "OctahedralNormals" )->AsScalar();
+
 	// Access texture shader variables (not referred to as textures - any GPU memory accessed in a shader is a "Shader Resource")
 	DiffuseMapVar  = Effect->GetVariableByName( "DiffuseMap" )->AsShaderResource();
 	DiffuseMap2Var = Effect->GetVariableByName( "DiffuseMap2" )->AsShaderResource();
@@ -268,6 +278,15 @@ void SetCamera( CCamera* camera )
 	CameraPosVar->SetRawValue( &camera->Position(), 0, 12 );
 }
 
+// Set the decoding of compressed vertices for the following geometry (see MeshCompress.h)
+void SetVertexDecoding( const CVector3& positionScale, const CVector3& positionOffset, bool octahedralNormals )
+{
+	CVector3 scale = positionScale, offset = positionOffset; // Can't pass constant parameter to SetRawValue function
+	PositionScaleVar->SetRawValue( &scale, 0, 12 );
+	PositionOffsetVar->SetRawValue( &offset, 0, 12 );
+	OctahedralNormalsVar->SetBool( octahedralNormals );
+}
+
 
 //-----------------------------------------------------------------------------
 // Specific render method setup functions
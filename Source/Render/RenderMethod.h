@@ -14,6 +14,7 @@ using namespace std;
 #include <d3dx10.h>
 
 #include "Defines.h"
+#include "CVector3.h"
 #include "CMatrix4x4.h"
 #include "Camera.h"
 #include "Light.h"
@@ -114,5 +115,9 @@ void SetLights( CLight** lights );
 // Set the camera to use for all methods
 void SetCamera( CCamera* camera );
 
+// Set the decoding of compressed vertices for the following geometry (see MeshCompress.h), a
+// scale of 1, offset of 0 and no octahedral normals for uncompressed vertices
+void SetVertexDecoding( const CVector3& positionScale, const CVector3& positionOffset, bool octahedralNormals );
+
 
 } // namespace gen
\ No newline at end of file
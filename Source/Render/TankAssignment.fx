@@ -29,6 +29,12 @@ float4 DiffuseColour;
 float4 SpecularColour;
 float  SpecularPower;
 
+// Decoding of compressed vertices (see MeshCompress.h). Quantised positions are scaled and
+// offset from -1->1 to the sub-mesh bounds, octahedral normals are unfolded from two values
+float3 PositionScale = { 1.0f, 1.0f, 1.0f };
+float3 PositionOffset = { 0.0f, 0.0f, 0.0f };
+bool   OctahedralNormals = false;
+
 // Texture maps
 Texture2D DiffuseMap;
 Texture2D DiffuseMap2; // Second diffuse map for special techniques (currently unused)
@@ -87,6 +93,32 @@ struct VS_LIGHTINGTEX_OUTPUT
 };
 
 
+//--------------------------------------------------------------------------------------
+// Vertex Decoding
+//--------------------------------------------------------------------------------------
+
+// Return the model space position of a vertex, uncompressed positions have a scale of 1 and
+// offset of 0
+float3 DecodePosition( float3 pos )
+{
+	return pos * PositionScale + PositionOffset;
+}
+
+// Return the model space normal of a vertex. An octahedral normal is a point on the octahedron
+// |x|+|y|+|z| = 1, with the lower half folded out to the corners of the square
+float3 DecodeNormal( float3 normal )
+{
+	if (OctahedralNormals)
+	{
+		float3 n = float3( normal.xy, 1.0f - abs( normal.x ) - abs( normal.y ) );
+		float fold = saturate( -n.z );
+		n.xy += (n.xy >= 0.0f) ? -fold : fold;
+		return normalize( n );
+	}
+	return normal;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Vertex Shaders
 //--------------------------------------------------------------------------------------
@@ -98,7 +130,7 @@ VS_BASIC_OUTPUT VSTransformOnly( VS_INPUT vIn )
 	VS_BASIC_OUTPUT vOut;
 	
 	// Transform the input model vertex position into world space, then view space, then 2D projection space
-	float4 modelPos = float4(vIn.Pos, 1.0f); // Promote to 1x4 so we can multiply by 4x4 matrix, put 1.0 in 4th element for a point (0.0 for a vector)
+	float4 modelPos = float4(DecodePosition( vIn.Pos ), 1.0f); // Promote to 1x4 so we can multiply by 4x4 matrix, put 1.0 in 4th element for a point (0.0 for a vector)
 	float4 worldPos = mul( modelPos, WorldMatrix );
 	float4 viewPos  = mul( worldPos, ViewMatrix );
 	vOut.ProjPos    = mul( viewPos,  ProjMatrix );
@@ -114,7 +146,7 @@ VS_TEX_OUTPUT VSTransformTex( VS_INPUT vIn )
 	VS_TEX_OUTPUT vOut;
 	
 	// Transform the input model vertex position into world space, then view space, then 2D projection space
-	float4 modelPos = float4(vIn.Pos, 1.0f); // Promote to 1x4 so we can multiply by 4x4 matrix, put 1.0 in 4th element for a point (0.0 for a vector)
+	float4 modelPos = float4(DecodePosition( vIn.Pos ), 1.0f); // Promote to 1x4 so we can multiply by 4x4 matrix, put 1.0 in 4th element for a point (0.0 for a vector)
 	float4 worldPos = mul( modelPos, WorldMatrix );
 	float4 viewPos  = mul( worldPos, ViewMatrix );
 	vOut.ProjPos    = mul( viewPos,  ProjMatrix );
@@ -133,8 +165,8 @@ VS_LIGHTING_OUTPUT VSPixelLit( VS_INPUT vIn )
 	VS_LIGHTING_OUTPUT vOut;
 
 	// Add 4th element to position and normal (needed to multiply by 4x4 matrix. Recall lectures - set 1 for position, 0 for vector)
-	float4 modelPos = float4(vIn.Pos, 1.0f);
-	float4 modelNormal = float4(vIn.Normal, 0.0f);
+	float4 modelPos = float4(DecodePosition( vIn.Pos ), 1.0f);
+	float4 modelNormal = float4(DecodeNormal( vIn.Normal ), 0.0f);
 
 	// Transform model vertex position and normal to world space
 	float4 worldPos    = mul( modelPos,    WorldMatrix );
@@ -158,8 +190,8 @@ VS_LIGHTINGTEX_OUTPUT VSPixelLitTex( VS_INPUT vIn )
 	VS_LIGHTINGTEX_OUTPUT vOut;
 
 	// Add 4th element to position and normal (needed to multiply by 4x4 matrix. Recall lectures - set 1 for position, 0 for vector)
-	float4 modelPos = float4(vIn.Pos, 1.0f);
-	float4 modelNormal = float4(vIn.Normal, 0.0f);
+	float4 modelPos = float4(DecodePosition( vIn.Pos ), 1.0f);
+	float4 modelNormal = float4(DecodeNormal( vIn.Normal ), 0.0f);
 
 	// Transform model vertex position and normal to world space
 	float4 worldPos    = mul( modelPos,    WorldMatrix );
@@ -62,7 +62,7 @@ bool CAmmoEntity::Update(TFloat32 updateTime)
 	{
 		Position().y -= m_FallSpeed * updateTime;
 
-		if (Position().y < m_Height)
+		if (GetPosition().y < m_Height)
 		{
 			landed = true;
 		}
@@ -83,7 +83,7 @@ bool CAmmoEntity::Update(TFloat32 updateTime)
 	while (theTank)
 	{
 		float radius = Template()->Mesh()->BoundingRadius();
-		if (Length(Position() - theTank->Position()) < (theTank->GetRadius() + radius))	//If distance between the ammo and the tank is less than the tank's radius
+		if (Length(GetPosition() - theTank->GetPosition()) < (theTank->GetRadius() + radius))	//If distance between the ammo and the tank is less than the tank's radius
 		{
 			EntityManager.EndEnumEntities(enumID);
 			// Hit the tank, send the hit message and destroy the bullet
@@ -30,41 +30,346 @@ CEntity::CEntity
 	m_Template = entityTemplate;
 	m_UID = UID;
 	m_Name = name;
+	m_IsStatic = false;
+	m_LOD = 0;
 
 	// Allocate space for matrices
 	TUInt32 numNodes = m_Template->Mesh()->GetNumNodes();
-	m_RelMatrices = new CMatrix4x4[numNodes];
-	m_Matrices = new CMatrix4x4[numNodes];
+	m_RelMatrices = new CAffine3x4[numNodes];
+	m_Matrices = new CAffine3x4[numNodes];
+	m_RelTRS = new SNodeTRS[numNodes];
+	m_WorldTRS = new SNodeTRS[numNodes];
+	m_NodeFlags = new TUInt8[numNodes];
 
-	// Set initial matrices from mesh defaults
+	// Set initial matrices from mesh defaults, nothing decomposed or calculated yet
 	for (TUInt32 node = 0; node < numNodes; ++node)
 	{
-		m_RelMatrices[node] = m_Template->Mesh()->GetNode( node ).positionMatrix;
+		m_RelMatrices[node].SetMatrix( m_Template->Mesh()->GetNode( node ).positionMatrix );
+		m_NodeFlags[node] = kWorldMatrixStale;
 	}
 
 	// Override root matrix with constructor parameters
-	m_RelMatrices[0] = CMatrix4x4( position, rotation, kZXY, scale );
+	m_RelMatrices[0].MakeAffineEuler( position, rotation, kZXY, scale );
 }
 
 
-// Render the model
-void CEntity::Render()
+// Render the model, returns the number of node world matrices recalculated. The mesh's level of
+// detail is selected from the entity's distance to the camera, pass the camera position and the
+// pixels covered by one world unit at a distance of one unit
+TUInt32 CEntity::Render( const CVector3& cameraPosition, TFloat32 pixelsPerUnit )
 {
 	// Get pointer to mesh to simplify code
 	CMesh* Mesh = m_Template->Mesh();
 
-	// Calculate absolute matrices from relative node matrices & node heirarchy
-	m_Matrices[0] = m_RelMatrices[0];
+	// Calculate absolute matrices from relative node matrices & node heirarchy. Only nodes that
+	// have been marked stale need recalculating. A stale node always has stale descendants and
+	// nodes are stored depth-first, so parents are up to date before their children are visited
+	TUInt32 numRecalculated = 0;
 	TUInt32 numNodes = Mesh->GetNumNodes();
-	for (TUInt32 node = 1; node < numNodes; ++node)
+	for (TUInt32 node = 0; node < numNodes; ++node)
 	{
-		m_Matrices[node] = m_RelMatrices[node] * m_Matrices[Mesh->GetNode( node ).parent];
+		if (m_NodeFlags[node] & kWorldMatrixStale)
+		{
+			GetWorldMatrix( node );
+			++numRecalculated;
+		}
 	}
 	// Incorporate any bone<->mesh offsets (only relevant for skinning)
 	// Don't need this step for this exercise
 
+	// Select the level of detail from the size of a model space unit on screen, using the root's
+	// position and largest scale for the whole mesh
+	TFloat32 distance = Length( m_Matrices[0].GetPosition() - cameraPosition );
+	CVector3 scale = m_Matrices[0].GetScale();
+	TFloat32 maxScale = Max( scale.x, Max( scale.y, scale.z ) );
+	if (distance > 0.0f)
+	{
+		m_LOD = Mesh->SelectLOD( pixelsPerUnit * maxScale / distance, m_LOD );
+	}
+	else
+	{
+		m_LOD = 0;
+	}
+
 	// Render with absolute matrices
-	Mesh->Render( m_Matrices );
+	Mesh->Render( m_Matrices, m_LOD );
+
+	return numRecalculated;
+}
+
+
+/////////////////////////////////////
+// Matrix access
+
+// World matrix of a node, from the current relative matrices of the node and its ancestors.
+// Only recalculated if the node or an ancestor has changed since the matrix was last used - a
+// stale node always has stale descendants, so if the node is up to date so are its ancestors
+const CAffine3x4& CEntity::GetWorldMatrix( TUInt32 node )
+{
+	if (m_NodeFlags[node] & kWorldMatrixStale)
+	{
+		// Bring relative matrix up to date if set by position/rotation/scale
+		if (m_NodeFlags[node] & kRelMatrixStale)
+		{
+			RecomposeNode( node );
+		}
+
+		if (node == 0)
+		{
+			m_Matrices[0] = m_RelMatrices[0];
+		}
+		else
+		{
+			TUInt32 parent = m_Template->Mesh()->GetNode( node ).parent;
+			Concatenate( m_RelMatrices[node], GetWorldMatrix( parent ), m_Matrices[node] );
+		}
+		m_NodeFlags[node] &= ~kWorldMatrixStale;
+	}
+	return m_Matrices[node];
+}
+
+// Get the bounds of the geometry controlled by a node in world space. The box is axis-aligned in
+// world space, enclosing the node's box as rotated by its world matrix. Returns false if the node
+// has no geometry
+bool CEntity::GetNodeWorldBounds( TUInt32 node, SMeshNodeBounds* pBounds )
+{
+	const SMeshNodeBounds& localBounds = m_Template->Mesh()->GetNodeBounds( node );
+	if (!localBounds.hasGeometry)
+	{
+		return false;
+	}
+	const CAffine3x4& matrix = GetWorldMatrix( node );
+
+	// Transform the box centre, the extent along each world axis is the sum of the box's
+	// half-sizes projected onto it by the matrix rows
+	CVector3 boxCentre = matrix.TransformPoint( (localBounds.minBounds + localBounds.maxBounds) * 0.5f );
+	CVector3 halfSize = (localBounds.maxBounds - localBounds.minBounds) * 0.5f;
+	CVector3 extent = CVector3::kOrigin;
+	for (TUInt32 row = 0; row < 3; ++row)
+	{
+		CVector3 axis = matrix.GetRow( row );
+		for (TUInt32 world = 0; world < 3; ++world)
+		{
+			extent[world] += halfSize[row] * Abs( axis[world] );
+		}
+	}
+	pBounds->hasGeometry = true;
+	pBounds->minBounds = boxCentre - extent;
+	pBounds->maxBounds = boxCentre + extent;
+
+	// Sphere radius scales with the largest scale of the matrix
+	CVector3 scale = matrix.GetScale();
+	pBounds->centre = matrix.TransformPoint( localBounds.centre );
+	pBounds->radius = localBounds.radius * Max( scale.x, Max( scale.y, scale.z ) );
+	return true;
+}
+
+
+/////////////////////////////////////
+// Hit tests
+
+// Return true if the line segment from start to end passes within the given sphere
+static bool SegmentTouchesSphere( const CVector3& start, const CVector3& end, const CVector3& centre,
+                                  TFloat32 radius )
+{
+	// Find the nearest point on the segment to the sphere centre
+	CVector3 direction = end - start;
+	TFloat32 lengthSq = LengthSquared( direction );
+	TFloat32 t = (lengthSq > 0.0f) ? Dot( centre - start, direction ) / lengthSq : 0.0f;
+	t = Max( 0.0f, Min( t, 1.0f ) );
+	return LengthSquared( start + direction * t - centre ) <= radius * radius;
+}
+
+// Test a world space line segment against the triangles of the entity's mesh. Nodes whose world
+// bounding sphere the segment misses (up to the nearest hit so far) are rejected first, otherwise
+// the segment is transformed into the space of the node for the BVH query. Affine transforms keep
+// fractions along the segment so the nearest hit of all nodes can be found directly
+bool CEntity::IntersectSegment( const CVector3& start, const CVector3& end, TFloat32* pFraction,
+                                TUInt32* pNode )
+{
+	const CMeshBVH& bvh = m_Template->Mesh()->GetBVH();
+	bool findNearest = pFraction || pNode;
+	bool hit = false;
+	SMeshBVHHit nearestHit;
+	nearestHit.fraction = 1.0f;
+	TUInt32 numNodes = m_Template->Mesh()->GetNumNodes();
+	for (TUInt32 node = 0; node < numNodes; ++node)
+	{
+		SMeshNodeBounds bounds;
+		if (!bvh.HasTriangles( node ) || !GetNodeWorldBounds( node, &bounds ) ||
+		    !SegmentTouchesSphere( start, start + (end - start) * nearestHit.fraction, bounds.centre, bounds.radius ))
+		{
+			continue;
+		}
+		CAffine3x4 invMatrix = Inverse( GetWorldMatrix( node ) );
+		CVector3 nodeStart = invMatrix.TransformPoint( start );
+		CVector3 nodeEnd = invMatrix.TransformPoint( end );
+		if (!findNearest)
+		{
+			if (bvh.IntersectSegment( node, nodeStart, nodeEnd ))
+			{
+				return true;
+			}
+			continue;
+		}
+
+		// Only look for hits nearer than the nearest so far
+		SMeshBVHHit nodeHit;
+		if (bvh.IntersectRay( node, nodeStart, nodeEnd - nodeStart, nearestHit.fraction, &nodeHit ))
+		{
+			nearestHit = nodeHit;
+			hit = true;
+			if (pNode) *pNode = node;
+		}
+	}
+	if (hit && pFraction)
+	{
+		*pFraction = nearestHit.fraction;
+	}
+	return hit;
+}
+
+// Test a world space sphere against the triangles of the entity's mesh. Nodes whose world
+// bounding sphere does not touch the sphere are rejected first, otherwise the sphere is moved
+// into the node's space with its radius divided by the node's smallest scale
+bool CEntity::IntersectSphere( const CVector3& centre, TFloat32 radius, TUInt32* pNode )
+{
+	const CMeshBVH& bvh = m_Template->Mesh()->GetBVH();
+	TUInt32 numNodes = m_Template->Mesh()->GetNumNodes();
+	for (TUInt32 node = 0; node < numNodes; ++node)
+	{
+		SMeshNodeBounds bounds;
+		if (!bvh.HasTriangles( node ) || !GetNodeWorldBounds( node, &bounds ) ||
+		    LengthSquared( centre - bounds.centre ) > (radius + bounds.radius) * (radius + bounds.radius))
+		{
+			continue;
+		}
+		const CAffine3x4& matrix = GetWorldMatrix( node );
+		CVector3 scale = matrix.GetScale();
+		TFloat32 minScale = Min( scale.x, Min( scale.y, scale.z ) );
+		if (minScale > 0.0f &&
+		    bvh.IntersectSphere( node, Inverse( matrix ).TransformPoint( centre ), radius / minScale ))
+		{
+			if (pNode) *pNode = node;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/////////////////////////////////////
+// Position / rotation / scale access
+
+// Cache statistics over all entities
+TUInt32 CEntity::m_TRSCacheHits = 0;
+TUInt32 CEntity::m_TRSCacheMisses = 0;
+
+// Get the position, Euler angles (ZXY order) and scale of a node relative to its parent.
+// Decomposition is cached until the node is next written. Pass NULL for unneeded parameters
+void CEntity::GetRelativeTRS( TUInt32 node, CVector3* pPosition, CVector3* pRotation, CVector3* pScale )
+{
+	SNodeTRS& trs = m_RelTRS[node];
+	if (m_NodeFlags[node] & kRelTRSValid)
+	{
+		++m_TRSCacheHits;
+	}
+	else
+	{
+		++m_TRSCacheMisses;
+		m_RelMatrices[node].DecomposeAffineEuler( &trs.position, &trs.rotation, &trs.scale );
+		m_NodeFlags[node] |= kRelTRSValid;
+	}
+
+	if (pPosition) *pPosition = trs.position;
+	if (pRotation) *pRotation = trs.rotation;
+	if (pScale)    *pScale    = trs.scale;
+}
+
+// Set the position, Euler angles (ZXY order) and scale of a node relative to its parent. The
+// node matrix is only rebuilt when next needed
+void CEntity::SetRelativeTRS( TUInt32 node, const CVector3& position, const CVector3& rotation,
+                              const CVector3& scale /*= CVector3( 1.0f, 1.0f, 1.0f )*/ )
+{
+	NodeChanged( node );
+
+	SNodeTRS& trs = m_RelTRS[node];
+	trs.position = position;
+	trs.rotation = rotation;
+	trs.scale = scale;
+	m_NodeFlags[node] |= kRelTRSValid | kRelMatrixStale;
+}
+
+// Get the world position, Euler angles (ZXY order) and scale of a node, using the current
+// relative matrices of the node and its ancestors. Decomposition is cached until the node or
+// one of its ancestors is next written. Pass NULL for unneeded parameters
+void CEntity::GetWorldTRS( TUInt32 node, CVector3* pPosition, CVector3* pRotation, CVector3* pScale )
+{
+	SNodeTRS& trs = m_WorldTRS[node];
+	if (m_NodeFlags[node] & kWorldTRSValid)
+	{
+		++m_TRSCacheHits;
+	}
+	else
+	{
+		++m_TRSCacheMisses;
+
+		// Concatenate relative matrices up to the root - don't use m_Matrices, which are only
+		// updated during rendering
+		CMesh* Mesh = m_Template->Mesh();
+		if (m_NodeFlags[node] & kRelMatrixStale)
+		{
+			RecomposeNode( node );
+		}
+		CAffine3x4 worldMatrix = m_RelMatrices[node];
+		for (TUInt32 parent = node; parent != 0; )
+		{
+			parent = Mesh->GetNode( parent ).parent;
+			if (m_NodeFlags[parent] & kRelMatrixStale)
+			{
+				RecomposeNode( parent );
+			}
+			worldMatrix *= m_RelMatrices[parent];
+		}
+		worldMatrix.DecomposeAffineEuler( &trs.position, &trs.rotation, &trs.scale );
+		m_NodeFlags[node] |= kWorldTRSValid;
+	}
+
+	if (pPosition) *pPosition = trs.position;
+	if (pRotation) *pRotation = trs.rotation;
+	if (pScale)    *pScale    = trs.scale;
+}
+
+
+/////////////////////////////////////
+// Cache support
+
+// Rebuild a node's relative matrix from its stored position, rotation & scale
+void CEntity::RecomposeNode( TUInt32 node )
+{
+	const SNodeTRS& trs = m_RelTRS[node];
+	m_RelMatrices[node].MakeAffineEuler( trs.position, trs.rotation, kZXY, trs.scale );
+	m_NodeFlags[node] &= ~kRelMatrixStale;
+}
+
+// A node's relative matrix has (or may have) been changed - discard its cached relative
+// decomposition and mark the world matrix & decomposition of the node and all its
+// descendants as out of date
+void CEntity::NodeChanged( TUInt32 node )
+{
+	m_NodeFlags[node] &= ~(kRelTRSValid | kWorldTRSValid);
+	m_NodeFlags[node] |= kWorldMatrixStale;
+
+	// Nodes are stored depth-first, so the descendants are the nodes immediately following this
+	// one that are deeper in the hierarchy
+	CMesh* Mesh = m_Template->Mesh();
+	TUInt32 numNodes = Mesh->GetNumNodes();
+	TUInt32 depth = Mesh->GetNode( node ).depth;
+	for (TUInt32 child = node + 1; child < numNodes && Mesh->GetNode( child ).depth > depth; ++child)
+	{
+		m_NodeFlags[child] &= ~kWorldTRSValid;
+		m_NodeFlags[child] |= kWorldMatrixStale;
+	}
 }
 
 
@@ -10,8 +10,10 @@
 using namespace std;
 
 #include "Defines.h"
+#include "Error.h"
 #include "CVector3.h"
 #include "CMatrix4x4.h"
+#include "CAffine3x4.h"
 #include "Camera.h"
 #include "Mesh.h"
 
@@ -41,27 +43,19 @@ class CEntityTemplate
 //	Constructors/Destructors
 public:
 	// Base entity template constructor needs template type (e.g. "Car"), name (e.g. "Fiat Panda")
-	// and the associated mesh (e.g. "panda.x")
-	CEntityTemplate( const string& type, const string& name, const string& meshFilename, const string& replacementTemplate="" )
+	// and the associated mesh (loaded from e.g. "panda.x"). The mesh is not owned by the template,
+	// it is shared with other templates through the entity manager's mesh cache
+	CEntityTemplate( const string& type, const string& name, CMesh* mesh, const string& replacementTemplate="" )
 	{
 		m_Type = type;
 		m_Name = name;
 		m_ReplacementTemplate = replacementTemplate;
-
-		// Load mesh
-		m_Mesh = new CMesh();
-		if (!m_Mesh->Load( meshFilename ))
-		{
-			string errorMsg = "Error loading mesh " + meshFilename;
-			SystemMessageBox( errorMsg.c_str(), "Mesh Error" );
-			throw; // failure in constructor can only be signalled with exception 
-		}
+		m_Mesh = mesh;
 	}
 
 	// Destructor - base class destructors should always be virtual
 	virtual ~CEntityTemplate()
 	{
-		delete m_Mesh;
 	}
 
 private:
@@ -142,6 +136,9 @@ public:
 	// Destructor - base class destructors should always be virtual
 	virtual ~CEntity()
 	{
+		delete[] m_NodeFlags;
+		delete[] m_WorldTRS;
+		delete[] m_RelTRS;
 		delete[] m_Matrices;
 		delete[] m_RelMatrices;
 	}
@@ -174,20 +171,120 @@ public:
 		return m_Name;
 	}
 
+	// Static entities have no behaviour and their matrices never change after creation, so
+	// spatial structures or render caches may rely on their world matrices
+	bool IsStatic()
+	{
+		return m_IsStatic;
+	}
+
+	// Mark this entity as static (see above), cannot be undone
+	void MarkStatic()
+	{
+		m_IsStatic = true;
+	}
+
 
 	/////////////////////////////////////
 	// Matrix access
 
-	// Direct access to position and matrix
+	// Write access to position and matrix - only use these to change the node, read with
+	// GetPosition / GetMatrix below. The caller may write through the returned reference so every
+	// call discards any cached decomposition of this node and marks the world transforms of the
+	// node and its descendants for recalculation, even if nothing is written
 	CVector3& Position( TUInt32 node = 0 )
 	{
-		return m_RelMatrices[node].Position();
+		return Matrix( node ).Position();
+	}
+	CAffine3x4& Matrix( TUInt32 node = 0 )
+	{
+		GEN_ASSERT_OPT( !m_IsStatic, "Static entity matrices cannot be changed" );
+		if (m_NodeFlags[node] & kRelMatrixStale)
+		{
+			RecomposeNode( node );
+		}
+		NodeChanged( node );
+		return m_RelMatrices[node];
+	}
+
+
+	// Read-only access to position and matrix, does not affect any cached data
+	const CVector3& GetPosition( TUInt32 node = 0 )
+	{
+		return GetMatrix( node ).Position();
 	}
-	CMatrix4x4& Matrix( TUInt32 node = 0 )
+	const CAffine3x4& GetMatrix( TUInt32 node = 0 )
 	{
+		if (m_NodeFlags[node] & kRelMatrixStale)
+		{
+			RecomposeNode( node );
+		}
 		return m_RelMatrices[node];
 	}
 
+	// World matrix of a node, from the current relative matrices of the node and its ancestors.
+	// Only recalculated if the node or an ancestor has changed since the matrix was last used
+	const CAffine3x4& GetWorldMatrix( TUInt32 node = 0 );
+
+	// Get the bounds of the geometry controlled by a node in world space (see SMeshNodeBounds).
+	// The box is axis-aligned in world space, enclosing the node's box as rotated by its world
+	// matrix. Returns false if the node has no geometry
+	bool GetNodeWorldBounds( TUInt32 node, SMeshNodeBounds* pBounds );
+
+
+	/////////////////////////////////////
+	// Hit tests
+
+	// Test a world space line segment against the triangles of the entity's mesh, using the
+	// mesh's BVH and the current world matrix of each node, skipping nodes whose bounding sphere
+	// is missed (see GetNodeWorldBounds). Returns true if the segment hits, with the fraction
+	// along the segment of the nearest hit and the node hit if pointers are given
+	bool IntersectSegment( const CVector3& start, const CVector3& end, TFloat32* pFraction = 0,
+	                       TUInt32* pNode = 0 );
+
+	// Test a world space sphere against the triangles of the entity's mesh, returns true if any
+	// triangle is within the sphere, with the node of one such triangle if a pointer is given.
+	// Nodes whose bounding sphere does not touch the sphere are skipped.
+	// Conservative for nodes with non-uniform scaling, which turn the sphere into an ellipsoid
+	bool IntersectSphere( const CVector3& centre, TFloat32 radius, TUInt32* pNode = 0 );
+
+
+	/////////////////////////////////////
+	// Position / rotation / scale access
+
+	// Get the position, Euler angles (ZXY order) and scale of a node relative to its parent.
+	// Decomposition is cached until the node is next written. Pass NULL for unneeded parameters
+	void GetRelativeTRS( TUInt32 node, CVector3* pPosition, CVector3* pRotation, CVector3* pScale );
+
+	// Set the position, Euler angles (ZXY order) and scale of a node relative to its parent. The
+	// node matrix is only rebuilt when next needed
+	void SetRelativeTRS( TUInt32 node, const CVector3& position, const CVector3& rotation,
+	                     const CVector3& scale = CVector3( 1.0f, 1.0f, 1.0f ) );
+
+	// Get the world position, Euler angles (ZXY order) and scale of a node, using the current
+	// relative matrices of the node and its ancestors. Decomposition is cached until the node or
+	// one of its ancestors is next written. Pass NULL for unneeded parameters
+	void GetWorldTRS( TUInt32 node, CVector3* pPosition, CVector3* pRotation, CVector3* pScale );
+
+
+	/////////////////////////////////////
+	// Statistics
+
+	// Number of decompositions served from / missing the cache, summed over all entities
+	static TUInt32 GetTRSCacheHits()
+	{
+		return m_TRSCacheHits;
+	}
+	static TUInt32 GetTRSCacheMisses()
+	{
+		return m_TRSCacheMisses;
+	}
+	static void ResetTRSCacheStats()
+	{
+		m_TRSCacheHits = 0;
+		m_TRSCacheMisses = 0;
+	}
+
 
 	/////////////////////////////////////
 	// Update / Render
@@ -197,8 +294,18 @@ public:
 	// Virtual function, base version does nothing
 	virtual bool Update( TFloat32 updateTime ) { return true; }
 	
-	// Render the entity
-	void Render();
+	// Render the entity. World matrices are only recalculated for nodes that have changed (or
+	// have an ancestor that changed) since the last render or GetWorldMatrix call. Returns the
+	// number recalculated.
+	// The mesh's level of detail is selected from the entity's distance to the camera, pass the
+	// camera position and the pixels covered by one world unit at a distance of one unit
+	TUInt32 Render( const CVector3& cameraPosition, TFloat32 pixelsPerUnit );
+
+	// Return the mesh level of detail selected in the last render
+	TUInt32 GetLOD()
+	{
+		return m_LOD;
+	}
 
 
 /////////////////////////////////////
@@ -212,9 +319,55 @@ private:
 	TEntityUID  m_UID;
 	string      m_Name;
 
-	// Relative and absolute world matrices for each node in the template's mesh
-	CMatrix4x4* m_RelMatrices; // Dynamically allocated arrays
-	CMatrix4x4* m_Matrices;
+	// Whether this entity is static (see IsStatic)
+	bool        m_IsStatic;
+
+	// Mesh level of detail used in the last render, kept to select the next with hysteresis
+	TUInt32     m_LOD;
+
+	// Relative and absolute world matrices for each node in the template's mesh. Stored as
+	// 3x4 affine transforms - converted to full matrices only when passed to the renderer
+	CAffine3x4* m_RelMatrices; // Dynamically allocated arrays
+	CAffine3x4* m_Matrices;
+
+	// Decomposed form of a node transform
+	struct SNodeTRS
+	{
+		CVector3 position;
+		CVector3 rotation; // Euler angles, ZXY order
+		CVector3 scale;
+	};
+
+	// Cached decompositions of the relative and world transforms for each node, validity of each
+	// is held in the node flags below
+	SNodeTRS* m_RelTRS; // Dynamically allocated arrays
+	SNodeTRS* m_WorldTRS;
+
+	// State of the cached data for each node
+	enum ENodeFlags
+	{
+		kRelTRSValid      = 1, // m_RelTRS matches m_RelMatrices
+		kRelMatrixStale   = 2, // m_RelTRS has been set, m_RelMatrices needs rebuilding from it
+		kWorldTRSValid    = 4, // m_WorldTRS matches the relative matrices of the node & ancestors
+		kWorldMatrixStale = 8, // m_Matrices needs recalculating from the node & ancestors
+	};
+	TUInt8* m_NodeFlags;
+
+	// Cache statistics over all entities
+	static TUInt32 m_TRSCacheHits;
+	static TUInt32 m_TRSCacheMisses;
+
+
+	/////////////////////////////////////
+	// Cache support
+
+	// Rebuild a node's relative matrix from its stored position, rotation & scale
+	void RecomposeNode( TUInt32 node );
+
+	// A node's relative matrix has (or may have) been changed - discard its cached relative
+	// decomposition and mark the world matrix & decomposition of the node and all its
+	// descendants as out of date
+	void NodeChanged( TUInt32 node );
 };
 
 
@@ -5,6 +5,8 @@
 	destruction
 ********************************************/
 
+#include <set>
+
 #include "EntityManager.h"
 
 namespace gen
@@ -22,6 +24,9 @@ CEntityManager::CEntityManager()
 
 	// Set first entity UID that will be used
 	m_NextUID = 0;
+	m_NumStaticEntities = 0;
+	m_NumNodesRecalculated = 0;
+	m_NumTrianglesRendered = 0;
 
 	m_XMLReader.SetFilePath(".\\Source\\Resources\\");
 }
@@ -42,12 +47,25 @@ void CEntityManager::CreateScene(const string& file)
 	m_XMLReader.LoadScene(file);
 }
 
+// Get the mesh for a new template from the mesh cache, loading it if necessary. Failure is fatal
+CMesh* CEntityManager::AcquireTemplateMesh( const string& meshFilename )
+{
+	CMesh* mesh = m_MeshCache.Acquire( meshFilename );
+	if (!mesh)
+	{
+		string errorMsg = "Error loading mesh " + meshFilename;
+		SystemMessageBox( errorMsg.c_str(), "Mesh Error" );
+		throw; // failure in template creation can only be signalled with exception
+	}
+	return mesh;
+}
+
 // Create a base entity template with the given type, name and mesh. Returns the new entity
 // template pointer
 CEntityTemplate* CEntityManager::CreateTemplate( const string& type, const string& name, const string& mesh, const string& replacementTemplate )
 {
-	// Create new entity template
-	CEntityTemplate* newTemplate = new CEntityTemplate( type, name, mesh, replacementTemplate);
+	// Create new entity template, sharing the mesh with any other templates using the same file
+	CEntityTemplate* newTemplate = new CEntityTemplate( type, name, AcquireTemplateMesh( mesh ), replacementTemplate);
 
 	// Add the template name / template pointer pair to the map
 	m_Templates[name] = newTemplate;
@@ -69,8 +87,8 @@ CTankTemplate* CEntityManager::CreateTankTemplate(const string& type, const stri
 	float acceleration, float turnSpeed,
 	float turretTurnSpeed, int maxHP, int shellDamage, float shellSpeed, float shellLifetime, float radius, int ammoCapacity)
 {
-	// Create new tank template
-	CTankTemplate* newTemplate = new CTankTemplate(type, name, mesh, replacementTemplate, maxSpeed, acceleration,
+	// Create new tank template, sharing the mesh with any other templates using the same file
+	CTankTemplate* newTemplate = new CTankTemplate(type, name, AcquireTemplateMesh(mesh), replacementTemplate, maxSpeed, acceleration,
 		turnSpeed, turretTurnSpeed, maxHP, shellDamage, shellSpeed, shellLifetime, radius, ammoCapacity);
 
 	// Add the template name / template pointer pair to the map
@@ -86,6 +104,84 @@ CTankTemplate * CEntityManager::CreateTankTemplate(const string & file)
 }
 
 
+// Declare a template without creating it, it is created when first used or prefetched
+void CEntityManager::DeclareTemplate( const SEntityTemplateDesc& desc )
+{
+	STemplateDecl& decl = m_TemplateDecls[desc.name];
+	decl.isTank = false;
+	static_cast<SEntityTemplateDesc&>(decl.desc) = desc;
+}
+
+// Declare a tank template without creating it, it is created when first used or prefetched
+void CEntityManager::DeclareTankTemplate( const STankTemplateDesc& desc )
+{
+	STemplateDecl& decl = m_TemplateDecls[desc.name];
+	decl.isTank = true;
+	decl.desc = desc;
+}
+
+// Create the declared templates with the given names that have not been created yet, along
+// with their replacement templates. Meshes are loaded in parallel. Unknown names are ignored
+void CEntityManager::PrefetchTemplates( const vector<string>& names )
+{
+	// Collect each template to create once, following replacement templates (e.g. wreckage)
+	// so they are ready when an entity is replaced
+	vector<STemplateLoad> templates;
+	set<string> added;
+	vector<string> pending( names );
+	while (!pending.empty())
+	{
+		string name = pending.back();
+		pending.pop_back();
+
+		TTemplateDecls::iterator decl = m_TemplateDecls.find( name );
+		if (decl == m_TemplateDecls.end() || m_Templates.find( name ) != m_Templates.end() ||
+		    !added.insert( name ).second)
+		{
+			continue;
+		}
+
+		templates.push_back( STemplateLoad() );
+		templates.back().isTank = decl->second.isTank;
+		templates.back().desc = decl->second.desc;
+		if (!decl->second.desc.replacementTemplate.empty())
+		{
+			pending.push_back( decl->second.desc.replacementTemplate );
+		}
+	}
+
+	m_XMLReader.LoadTemplates( templates );
+}
+
+// Return the names of declared templates that have not been created
+vector<string> CEntityManager::GetUnusedTemplates()
+{
+	vector<string> unused;
+	for (TTemplateDecls::iterator decl = m_TemplateDecls.begin(); decl != m_TemplateDecls.end(); ++decl)
+	{
+		if (m_Templates.find( decl->first ) == m_Templates.end())
+		{
+			unused.push_back( decl->first );
+		}
+	}
+	return unused;
+}
+
+// Create a declared template, returns 0 if the name has not been declared
+CEntityTemplate* CEntityManager::CreateDeclaredTemplate( const string& name )
+{
+	if (m_TemplateDecls.find( name ) == m_TemplateDecls.end())
+	{
+		return 0;
+	}
+
+	// Created through the prefetch so load timings are recorded as usual
+	PrefetchTemplates( vector<string>( 1, name ) );
+	TTemplateIter entityTemplate = m_Templates.find( name );
+	return (entityTemplate != m_Templates.end()) ? entityTemplate->second : 0;
+}
+
+
 
 // Destroy the given template (name) - returns true if the template existed and was destroyed
 bool CEntityManager::DestroyTemplate( const string& name )
@@ -98,25 +194,39 @@ bool CEntityManager::DestroyTemplate( const string& name )
 		return false;
 	}
 
-	// Delete the template and remove the map entry
+	// Delete the template and remove the map entry. The mesh stays cached for reuse
+	m_MeshCache.Release( entityTemplate->second->Mesh() );
 	delete entityTemplate->second;
 	m_Templates.erase( entityTemplate );
 	return true;
 }
 
-// Destroy all templates held by the manager
+// Destroy all templates held by the manager and forget all template declarations. Declared
+// templates that were never used are reported to the debugger output
 void CEntityManager::DestroyAllTemplates()
 {
+	vector<string> unused = GetUnusedTemplates();
+	for (TUInt32 i = 0; i < unused.size(); ++i)
+	{
+		string report = "Template " + unused[i] + " was declared but never used\n";
+		OutputDebugStringA( report.c_str() );
+	}
+	m_TemplateDecls.clear();
+
 	while (m_Templates.size())
 	{
 		TTemplateIter entityTemplate = m_Templates.begin();
 		while (entityTemplate != m_Templates.end())
 		{
+			m_MeshCache.Release( entityTemplate->second->Mesh() );
 			delete entityTemplate->second;
 			++entityTemplate;
 		};
 		m_Templates.clear();
 	}
+
+	// Unload the meshes now no template uses them
+	m_MeshCache.UnloadUnused();
 }
 
 
@@ -137,12 +247,25 @@ TEntityUID CEntityManager::CreateEntity
 	// Get template associated with the template name
 	CEntityTemplate* entityTemplate = GetTemplate( templateName );
 
-	// Create new entity with next UID
+	// Create new entity with next UID. Base class entities have no behaviour, so the entity is
+	// static - it is never updated and its matrices must not change after creation
 	CEntity* newEntity = new CEntity( entityTemplate, m_NextUID, name, position, rotation, scale );
+	newEntity->MarkStatic();
 
-	// Get vector index for new entity and add it to vector
-	TUInt32 entityIndex = static_cast<TUInt32>(m_Entities.size());
-	m_Entities.push_back( newEntity );
+	// Static entities are kept at the start of the vector. Make space at the end of the static
+	// partition by moving the first dynamic entity (if any) to the end of the vector
+	TUInt32 entityIndex = m_NumStaticEntities;
+	if (entityIndex < m_Entities.size())
+	{
+		m_Entities.push_back( m_Entities[entityIndex] );
+		m_EntityUIDMap->SetKeyValue( m_Entities.back()->GetUID(), static_cast<TUInt32>(m_Entities.size()) - 1 );
+		m_Entities[entityIndex] = newEntity;
+	}
+	else
+	{
+		m_Entities.push_back( newEntity );
+	}
+	++m_NumStaticEntities;
 
 	// Add mapping from UID to entity index into hash map
 	m_EntityUIDMap->SetKeyValue( m_NextUID, entityIndex );
@@ -160,7 +283,7 @@ TEntityUID CEntityManager::CreateTank
 (
 	const string&			templateName,
 	TUInt32					team,
-	const vector<CVector3>&	patrolPath,
+	const CPatrolRoute*		patrolRoute,
 	const string&			name /*= ""*/,
 	const CVector3&			position /*= CVector3::kOrigin*/,
 	const CVector3&			rotation /*= CVector3( 0.0f, 0.0f, 0.0f )*/,
@@ -172,7 +295,7 @@ TEntityUID CEntityManager::CreateTank
 	CTankTemplate* tankTemplate = static_cast<CTankTemplate*>(GetTemplate(templateName));
 
 	// Create new tank entity with next UID
-	CEntity* newEntity = new CTankEntity(tankTemplate, m_NextUID, team, patrolPath, name, position, rotation, scale);
+	CEntity* newEntity = new CTankEntity(tankTemplate, m_NextUID, team, patrolRoute, name, position, rotation, scale);
 
 	// Get vector index for new entity and add it to vector
 	TUInt32 entityIndex = static_cast<int>(m_Entities.size());
@@ -262,6 +385,19 @@ bool CEntityManager::DestroyEntity( TEntityUID UID )
 	delete m_Entities[entityIndex];
 	m_EntityUIDMap->RemoveKey( UID );
 
+	// If removing a static entity, keep the static partition packed by moving the last static
+	// entity into the empty slot. This leaves the empty slot at the end of the static partition
+	if (entityIndex < m_NumStaticEntities)
+	{
+		--m_NumStaticEntities;
+		if (entityIndex != m_NumStaticEntities)
+		{
+			m_Entities[entityIndex] = m_Entities[m_NumStaticEntities];
+			m_EntityUIDMap->SetKeyValue( m_Entities[entityIndex]->GetUID(), entityIndex );
+			entityIndex = m_NumStaticEntities;
+		}
+	}
+
 	// If not removing last entity...
 	if (entityIndex != m_Entities.size() - 1)
 	{
@@ -284,6 +420,10 @@ void CEntityManager::DestroyAllEntities()
 		delete m_Entities.back();
 		m_Entities.pop_back();
 	}
+	m_NumStaticEntities = 0;
+
+	// No tanks are left using the patrol routes
+	m_XMLReader.ClearPatrolRoutes();
 
 	m_Enumeration.clear(); // Cancel any entity enumeration (entity list has changed)
 }
@@ -292,10 +432,21 @@ void CEntityManager::DestroyAllEntities()
 /////////////////////////////////////
 // Update / Rendering
 
-// Call all entity update functions. Pass the time since last update
+// Call all entity update functions. Pass the time since last update. Static entities (at the
+// start of the entity vector) have nothing to update and are skipped
 void CEntityManager::UpdateAllEntities( float updateTime )
 {
-	TUInt32 entity = 0;
+	// Replacement entities are static, creating them reorders the dynamic entities, so they are
+	// created once the update pass is complete
+	struct SReplacement
+	{
+		string   templateName;
+		string   name;
+		CVector3 position, rotation, scale;
+	};
+	vector<SReplacement> replacements;
+
+	TUInt32 entity = m_NumStaticEntities;
 	while (entity < m_Entities.size())
 	{
 		// Update entity, if it returns false, then destroy it
@@ -305,27 +456,49 @@ void CEntityManager::UpdateAllEntities( float updateTime )
 			string replacementString = thisEntity->Template()->GetReplacementTemplate();
 			if (replacementString != "")
 			{
-				CEntityTemplate* replacement = GetTemplate(thisEntity->Template()->GetReplacementTemplate());
-				CVector3 position, rotation, scale;
-				thisEntity->Matrix().DecomposeAffineEuler(&position, &rotation, &scale);
-				CreateEntity(replacement->GetName(), m_Entities[entity]->GetName() + " Wreckage", position, rotation, scale);
+				// Skip replacement if its template does not exist (e.g. template file missing)
+				CEntityTemplate* replacementTemplate = GetTemplate(replacementString);
+				if (replacementTemplate)
+				{
+					SReplacement replacement;
+					replacement.templateName = replacementTemplate->GetName();
+					replacement.name = thisEntity->GetName() + " Wreckage";
+					thisEntity->GetRelativeTRS(0, &replacement.position, &replacement.rotation, &replacement.scale);
+					replacements.push_back(replacement);
+				}
 			}
-			DestroyEntity(m_Entities[entity]->GetUID());
+			DestroyEntity(thisEntity->GetUID());
 		}
 		else
 		{
 			++entity;
 		}
 	}
+
+	for (TUInt32 i = 0; i < replacements.size(); ++i)
+	{
+		const SReplacement& replacement = replacements[i];
+		CreateEntity(replacement.templateName, replacement.name, replacement.position, replacement.rotation, replacement.scale);
+	}
 }
 
-// Render all entities
-void CEntityManager::RenderAllEntities()
+// Render all entities. Pass the camera and the viewport height in pixels, used to select the
+// level of detail of each entity's mesh
+void CEntityManager::RenderAllEntities( CCamera* camera, TUInt32 viewportHeight )
 {
+	// Pixels covered by one world unit at a distance of one unit from the camera. The camera stores
+	// the horizontal FOV, the vertical one has tan(fovY / 2) = tan(fovX / 2) / aspect (see CCamera)
+	TFloat32 tanHalfFOVY = Tan( camera->GetFOV() * 0.5f ) / camera->GetAspect();
+	TFloat32 pixelsPerUnit = viewportHeight / (2.0f * tanHalfFOVY);
+	CVector3 cameraPosition = camera->Position();
+
+	m_NumNodesRecalculated = 0;
+	m_NumTrianglesRendered = 0;
 	TEntityIter entity = m_Entities.begin();
 	while (entity != m_Entities.end())
 	{
-		(*entity)->Render();
+		m_NumNodesRecalculated += (*entity)->Render( cameraPosition, pixelsPerUnit );
+		m_NumTrianglesRendered += (*entity)->Template()->Mesh()->GetNumTriangles( (*entity)->GetLOD() );
 		++entity;
 	}
 }
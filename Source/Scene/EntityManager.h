@@ -17,6 +17,7 @@ using namespace std;
 #include "ShellEntity.h"
 #include "AmmoEntity.h"
 #include "Camera.h"
+#include "MeshCache.h"
 #include "XMLReader.h"
 
 namespace gen
@@ -70,10 +71,34 @@ public:
 	
 	CTankTemplate* CEntityManager::CreateTankTemplate(const string& file);
 
+	// Declare a template without creating it. The template is created, and its mesh loaded, the
+	// first time an entity is created from it or when it is prefetched. A declaration with the
+	// same name as an earlier one replaces it
+	void DeclareTemplate( const SEntityTemplateDesc& desc );
+	void DeclareTankTemplate( const STankTemplateDesc& desc );
+
+	// Create the declared templates with the given names that have not been created yet, along
+	// with their replacement templates. Meshes are loaded in parallel. Unknown names are ignored
+	void PrefetchTemplates( const vector<string>& names );
+
+	// Return the names of declared templates that have not been created
+	vector<string> GetUnusedTemplates();
+
+	// Return the number of templates declared and the number created
+	TUInt32 GetNumDeclaredTemplates()
+	{
+		return static_cast<TUInt32>(m_TemplateDecls.size());
+	}
+	TUInt32 GetNumTemplates()
+	{
+		return static_cast<TUInt32>(m_Templates.size());
+	}
+
 	// Destroy the given template (name) - returns true if the template existed and was destroyed
 	bool DestroyTemplate( const string& name );
 
-	// Destroy all templates held by the manager
+	// Destroy all templates held by the manager and forget all template declarations. Declared
+	// templates that were never used are reported to the debugger output
 	void DestroyAllTemplates();
 
 
@@ -91,13 +116,13 @@ public:
 		const CVector3&  scale = CVector3( 1.0f, 1.0f, 1.0f )
 	);
 
-	// Create a tank, requires a tank template name and team number, may supply entity name and
-	// position. Returns the UID of the new entity
+	// Create a tank, requires a tank template name, team number and patrol route (shared, not
+	// copied), may supply entity name and position. Returns the UID of the new entity
 	TEntityUID CreateTank
 	(
 		const string&			templateName,
 		TUInt32					team,
-		const vector<CVector3>&	patrolPath,
+		const CPatrolRoute*		patrolRoute,
 		const string&			name = "",
 		const CVector3&			position = CVector3::kOrigin,
 		const CVector3&			rotation = CVector3(0.0f, 0.0f, 0.0f),
@@ -139,15 +164,15 @@ public:
 	/////////////////////////////////////
 	// Template / Entity access
 
-	// Return the template with the given name
+	// Return the template with the given name, creating it if it has only been declared
 	CEntityTemplate* GetTemplate( const string& name )
 	{
 		// Find the template name in the template map
 		TTemplateIter entityTemplate = m_Templates.find( name );
 		if (entityTemplate == m_Templates.end())
 		{
-			// Template name not found
-			return 0;
+			// Template not created yet, returns 0 if it is not declared either
+			return CreateDeclaredTemplate( name );
 		}
 		return (*entityTemplate).second;
 	}
@@ -159,6 +184,12 @@ public:
 		return static_cast<TUInt32>(m_Entities.size());
 	}
 
+	// Return the number of static entities - these occupy the first indexes of the entity list
+	TUInt32 NumStaticEntities()
+	{
+		return m_NumStaticEntities;
+	}
+
 	// Return the entities at the given array index
 	CEntity* GetEntityAtIndex( TUInt32 index )
 	{
@@ -259,8 +290,34 @@ public:
 	// Pass the time since last update
 	void UpdateAllEntities( float updateTime );
 
-	// Render all entities - not the ideal method, OK for this example
-	void RenderAllEntities();
+	// Render all entities - not the ideal method, OK for this example. Pass the camera and the
+	// viewport height in pixels, used to select the level of detail of each entity's mesh
+	void RenderAllEntities( CCamera* camera, TUInt32 viewportHeight );
+
+	// Return the number of entity node world matrices recalculated in the last render
+	TUInt32 GetNumNodesRecalculated()
+	{
+		return m_NumNodesRecalculated;
+	}
+
+	// Return the number of triangles rendered in the last render, at the selected levels of detail
+	TUInt32 GetNumTrianglesRendered()
+	{
+		return m_NumTrianglesRendered;
+	}
+
+	// Return the total time (seconds) spent loading templates, per-template times are written to
+	// the debugger output as they load
+	float GetTemplateLoadTime()
+	{
+		return m_XMLReader.GetTemplateLoadTotal();
+	}
+
+	// Access the cache of meshes shared by the templates
+	CMeshCache& GetMeshCache()
+	{
+		return m_MeshCache;
+	}
 		
 /////////////////////////////////////
 //	Private interface
@@ -289,14 +346,34 @@ private:
 	// The map of template names / templates
 	TTemplates m_Templates;
 
+	// Declared templates by name, created on first use (see DeclareTemplate)
+	struct STemplateDecl
+	{
+		bool              isTank;
+		STankTemplateDesc desc; // Tank values unused for entity templates
+	};
+	typedef map<string, STemplateDecl> TTemplateDecls;
+	TTemplateDecls m_TemplateDecls;
+
+	// Create a declared template, returns 0 if the name has not been declared
+	CEntityTemplate* CreateDeclaredTemplate( const string& name );
+
+	// Meshes used by the templates, shared between templates using the same mesh file
+	CMeshCache m_MeshCache;
+
+	// Get the mesh for a new template from the mesh cache, loading it if necessary. Failure is fatal
+	CMesh* AcquireTemplateMesh( const string& meshFilename );
+
 
 	/////////////////////////////////////
 	// Entity Data
 
 	// The main list of entities. This vector is kept packed - i.e. with no gaps. If an
 	// entity is removed from the middle of the list, the last entity is moved down to
-	// fill its space
+	// fill its space. Static entities (no behaviour, never updated) are partitioned at the
+	// start of the list so the update pass only visits the dynamic entities after them
 	TEntities m_Entities;
+	TUInt32   m_NumStaticEntities;
 
 	// A mapping from UIDs to indexes into the above array
 	CHashTable<TEntityUID, TUInt32>* m_EntityUIDMap;
@@ -304,6 +381,10 @@ private:
 	// Entity IDs are provided using a single increasing integer
 	TEntityUID m_NextUID;
 
+	// Number of entity node world matrices recalculated and triangles drawn in the last render
+	TUInt32 m_NumNodesRecalculated;
+	TUInt32 m_NumTrianglesRendered;
+
 	//A structure to help with multiple enumerations simultaneously
 	struct SEnumerationDetails
 	{
@@ -0,0 +1,61 @@
+/*******************************************
+	PatrolRoute.cpp
+
+	Patrol route class implementation
+********************************************/
+
+#include "PatrolRoute.h"
+
+namespace gen
+{
+
+// Construct from a list of waypoints, the route loops from the last waypoint to the first
+CPatrolRoute::CPatrolRoute( const string& name, const vector<CVector3>& waypoints )
+	: m_Name( name ), m_Waypoints( waypoints ), m_Length( 0.0f ),
+	  m_MinBounds( CVector3::kZero ), m_MaxBounds( CVector3::kZero )
+{
+	if (m_Waypoints.empty())
+	{
+		return;
+	}
+
+	// Segment lengths and bounds
+	m_SegmentLengths.resize( m_Waypoints.size() );
+	m_MinBounds = m_MaxBounds = m_Waypoints[0];
+	for (TUInt32 waypoint = 0; waypoint < m_Waypoints.size(); ++waypoint)
+	{
+		const CVector3& point = m_Waypoints[waypoint];
+		m_SegmentLengths[waypoint] = Length( m_Waypoints[NextWaypoint( waypoint )] - point );
+		m_Length += m_SegmentLengths[waypoint];
+
+		m_MinBounds.x = Min( m_MinBounds.x, point.x );
+		m_MinBounds.y = Min( m_MinBounds.y, point.y );
+		m_MinBounds.z = Min( m_MinBounds.z, point.z );
+		m_MaxBounds.x = Max( m_MaxBounds.x, point.x );
+		m_MaxBounds.y = Max( m_MaxBounds.y, point.y );
+		m_MaxBounds.z = Max( m_MaxBounds.z, point.z );
+	}
+}
+
+// Return the index of the waypoint nearest to the given point, the route must not be empty
+TUInt32 CPatrolRoute::FindNearestWaypoint( const CVector3& point ) const
+{
+	GEN_ASSERT( !m_Waypoints.empty(), "Empty patrol route" );
+
+	// Compare squared distances, no need for square roots
+	TUInt32 nearest = 0;
+	TFloat32 nearestDistanceSq = LengthSquared( m_Waypoints[0] - point );
+	for (TUInt32 waypoint = 1; waypoint < m_Waypoints.size(); ++waypoint)
+	{
+		TFloat32 distanceSq = LengthSquared( m_Waypoints[waypoint] - point );
+		if (distanceSq < nearestDistanceSq)
+		{
+			nearest = waypoint;
+			nearestDistanceSq = distanceSq;
+		}
+	}
+	return nearest;
+}
+
+
+} // namespace gen
@@ -0,0 +1,117 @@
+/*******************************************
+	PatrolRoute.h
+
+	Shared, immutable patrol route data
+********************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Defines.h"
+#include "Error.h"
+#include "CVector3.h"
+
+namespace gen
+{
+
+// A closed loop of waypoints read from a patrol route file. Routes are created once per file
+// by the XMLReader and shared by all the tanks that use them, so they cannot be changed after
+// construction. Segment lengths and bounds are calculated up front for the route users
+class CPatrolRoute
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	// Construct from a list of waypoints, the route loops from the last waypoint to the first
+	CPatrolRoute( const string& name, const vector<CVector3>& waypoints );
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CPatrolRoute( const CPatrolRoute& );
+	CPatrolRoute& operator=( const CPatrolRoute& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	/////////////////////////////////////
+	// Getters
+
+	// Name of the file the route was read from
+	const string& GetName() const
+	{
+		return m_Name;
+	}
+
+	TUInt32 NumWaypoints() const
+	{
+		return static_cast<TUInt32>(m_Waypoints.size());
+	}
+
+	bool IsEmpty() const
+	{
+		return m_Waypoints.empty();
+	}
+
+	const CVector3& Waypoint( TUInt32 waypoint ) const
+	{
+		GEN_ASSERT_OPT( waypoint < m_Waypoints.size(), "Invalid waypoint" );
+		return m_Waypoints[waypoint];
+	}
+
+	// Return the index of the waypoint following the given one, wrapping to the start
+	TUInt32 NextWaypoint( TUInt32 waypoint ) const
+	{
+		++waypoint;
+		return (waypoint < m_Waypoints.size()) ? waypoint : 0;
+	}
+
+	// Length of the segment from the given waypoint to the next one
+	TFloat32 SegmentLength( TUInt32 waypoint ) const
+	{
+		GEN_ASSERT_OPT( waypoint < m_SegmentLengths.size(), "Invalid waypoint" );
+		return m_SegmentLengths[waypoint];
+	}
+
+	// Total length of the route loop
+	TFloat32 GetLength() const
+	{
+		return m_Length;
+	}
+
+	// Axis aligned bounds of the waypoints
+	const CVector3& GetMinBounds() const
+	{
+		return m_MinBounds;
+	}
+	const CVector3& GetMaxBounds() const
+	{
+		return m_MaxBounds;
+	}
+
+
+	/////////////////////////////////////
+	// Queries
+
+	// Return the index of the waypoint nearest to the given point, the route must not be empty
+	TUInt32 FindNearestWaypoint( const CVector3& point ) const;
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	string           m_Name;
+	vector<CVector3> m_Waypoints;
+	vector<TFloat32> m_SegmentLengths;
+	TFloat32         m_Length;
+	CVector3         m_MinBounds;
+	CVector3         m_MaxBounds;
+};
+
+
+} // namespace gen
@@ -68,9 +68,11 @@ bool CShellEntity::Update( TFloat32 updateTime )
 	}
 
 	// Move along local Z axis scaled by update time
+	CVector3 lastPosition = GetPosition();
 	Matrix().MoveLocalZ( m_Speed * updateTime );
 
-	//TODO: Collision detection
+	// Collision detection - the shell hits if its path this update passes through any triangle of
+	// the tank (tested with the mesh's BVH, which rejects distant tanks by bounding sphere)
 	TInt32 enumID;
 	EntityManager.BeginEnumEntities(enumID, "", "", "Tank");
 	CTankEntity* theTank = dynamic_cast<CTankEntity*> (EntityManager.EnumEntity(enumID));
@@ -79,7 +81,7 @@ bool CShellEntity::Update( TFloat32 updateTime )
 		if(theTank->GetUID() != m_FiredBy)
 		{
 
-			if (Length(Position() - theTank->Position()) < theTank->GetRadius())	//If distance between the shell and the tank is less than the tank's radius
+			if (theTank->IntersectSegment(lastPosition, GetPosition()))	//If the shell's path crossed the tank's mesh
 			{
 				EntityManager.EndEnumEntities(enumID);
 				// Hit the tank, send the hit message and destroy the bullet
@@ -11,8 +11,10 @@
 //   the UID of the tank on a given team. This can be used to get the enemy tank UID
 // - Tanks have three parts: the root, the body and the turret. Each part has its own matrix, which
 //   can be accessed with the Matrix function - root: Matrix(), body: Matrix(1), turret: Matrix(2)
+//   Matrix marks the part as changed, use GetMatrix / GetPosition when only reading it
 //   However, the body and turret matrix are relative to the root's matrix - so to get the actual 
-//   world matrix of the body, for example, we must multiply: Matrix(1) * Matrix()
+//   world matrix of the body, for example, we must multiply: GetMatrix(1) * GetMatrix(), or use
+//   GetWorldMatrix(1), which is cached until the body or root next changes
 // - Vector facing work similar to the car tag lab will be needed for the turret->enemy facing 
 //   requirements for the Patrol and Aim states
 // - The CMatrix4x4 function DecomposeAffineEuler allows you to extract the x,y & z rotations
@@ -83,7 +85,7 @@ CTankEntity::CTankEntity
 	CTankTemplate*			tankTemplate,
 	TEntityUID				UID,
 	TUInt32					team,
-	const vector<CVector3>&	patrolPath,
+	const CPatrolRoute*		patrolRoute,
 	const string&			name /*=""*/,
 	const CVector3&			position /*= CVector3::kOrigin*/, 
 	const CVector3&			rotation /*= CVector3( 0.0f, 0.0f, 0.0f )*/,
@@ -102,9 +104,10 @@ CTankEntity::CTankEntity
 	m_State = State_Inactive;
 	m_Timer = 0.0f;
 	
-	//Create a patrol point 10 units in front and 10 units behind starting position
-	m_PatrolWaypoints = patrolPath;
-	m_CurrentWaypoint = m_PatrolWaypoints.begin();
+	//The patrol route is shared between tanks, only the current waypoint is per-tank
+	GEN_ASSERT( patrolRoute, "Tank has no patrol route" );
+	m_PatrolRoute = patrolRoute;
+	m_CurrentWaypoint = 0;
 
 	m_Target = -1;
 	m_EvasionTarget = CVector3(0.0f, 0.0f, 0.0f);	
@@ -201,21 +204,20 @@ bool CTankEntity::Update( TFloat32 updateTime )
 		//When turret points within 15 of an enemy (either side) - go to aim state
 		
 		
-		// Test if within radius distance of the waypoint (Reached the waypoint)
-		if (Length(Position() - *m_CurrentWaypoint) < m_TankTemplate->GetRadius())
+		//A tank with an empty route (e.g. missing route file) stays where it is
+		if (!m_PatrolRoute->IsEmpty())
 		{
-			// Move to next waypoint
-			m_CurrentWaypoint++;
-			//If the next waypoint iterator is the end of the list then set it to the start instead
-			if (m_CurrentWaypoint == m_PatrolWaypoints.end())
+			// Test if within radius distance of the waypoint (Reached the waypoint)
+			if (Length(GetPosition() - m_PatrolRoute->Waypoint(m_CurrentWaypoint)) < m_TankTemplate->GetRadius())
 			{
-				m_CurrentWaypoint = m_PatrolWaypoints.begin();
+				// Move to next waypoint, wrapping to the start of the route
+				m_CurrentWaypoint = m_PatrolRoute->NextWaypoint(m_CurrentWaypoint);
 			}
-		}
 
-		// Determine whether to turn (and in which direction)
-		CVector3 vectorToWaypoint = Normalise(*m_CurrentWaypoint - Position()); //Make a unit vector for dot product
-		DetermineMovementFlags(vectorToWaypoint, updateTime);
+			// Determine whether to turn (and in which direction)
+			CVector3 vectorToWaypoint = Normalise(m_PatrolRoute->Waypoint(m_CurrentWaypoint) - GetPosition()); //Make a unit vector for dot product
+			DetermineMovementFlags(vectorToWaypoint, updateTime);
+		}
 
 
 		// Rotate the turret
@@ -247,14 +249,14 @@ bool CTankEntity::Update( TFloat32 updateTime )
 		if (targetTank)	//Aim only if the target still exists
 		{
 
-			CVector3 rightVector = CVector3((Matrix(2) * Matrix()).GetRow(0));	//Extract right vector from this turret
-			CVector3 vecToTarget = Normalise(targetTank->Position() - Matrix().TransformPoint(Position(2))); //Get vector from turret to target
+			CVector3 rightVector = CVector3(GetWorldMatrix(2).GetRow(0));	//Extract right vector from this turret
+			CVector3 vecToTarget = Normalise(targetTank->GetPosition() - GetWorldMatrix(2).GetPosition()); //Get vector from turret to target
 		
 			// If angle between vectors is > 90 then need to turn left, if = 90 dont turn, if < 90 turn right		
 			
 			if (Dot(rightVector, vecToTarget)> 0)	//< 90 // Turn right (positive)
 			{
-				CVector3 facing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));	//Extract right vector from this turret
+				CVector3 facing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));	//Extract right vector from this turret
 				
 				float angle = acosf(floatClamp(-1.0f, 1.0f, Dot(facing, vecToTarget)));
 				if (angle > m_TankTemplate->GetTurretTurnSpeed() * updateTime)
@@ -269,7 +271,7 @@ bool CTankEntity::Update( TFloat32 updateTime )
 			}
 			else 	//> 90 //Turn left (negative)	//This also deals with facing the directly wrong direction
 			{
-				CVector3 facing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));	//Extract right vector from this turret
+				CVector3 facing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));	//Extract right vector from this turret
 				
 				float angle = acosf(floatClamp(-1.0f, 1.0f, Dot(facing, vecToTarget)));
 				if (angle > m_TankTemplate->GetTurretTurnSpeed() * updateTime)
@@ -310,7 +312,7 @@ bool CTankEntity::Update( TFloat32 updateTime )
 		// Tank control
 
 		// Determine whether to turn (and in which direction)
-		CVector3 vectorToTarget = Normalise(m_EvasionTarget - Position()); //Make a unit vector for dot product
+		CVector3 vectorToTarget = Normalise(m_EvasionTarget - GetPosition()); //Make a unit vector for dot product
 		DetermineMovementFlags(vectorToTarget, updateTime);
 
 		////////////////////////
@@ -318,13 +320,13 @@ bool CTankEntity::Update( TFloat32 updateTime )
 
 		// Determine whether to turn turret (and in which direction)
 		//Using less expensive calculation, only need to move the turret to it's local z direction, dont need to do matrix multiplication
-		CVector3 rightVector = CVector3(Matrix(2).GetRow(0));	//Extract (local) right vector from turret
+		CVector3 rightVector = CVector3(GetMatrix(2).GetRow(0));	//Extract (local) right vector from turret
 		CVector3 forwardVector = CVector3(0.0f, 0.0f, 1.0f);	//Forward vector (turret's local space z axis)
 
 		// If angle between vectors is > 90 then tank is pointing in the forward half
 		if (Dot(rightVector, forwardVector) > 0)	//< 90 // Turn right (positive)
 		{
-			CVector3 facing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));	//Extract right vector from this turret
+			CVector3 facing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));	//Extract right vector from this turret
 			
 			float angle = acosf(floatClamp(-1.0f, 1.0f, Dot(facing, forwardVector)));
 			if (angle > m_TankTemplate->GetTurretTurnSpeed() * updateTime)
@@ -339,7 +341,7 @@ bool CTankEntity::Update( TFloat32 updateTime )
 		}
 		else 	//> 90 //Turn left (negative)	//This also deals with facing the directly wrong direction
 		{
-			CVector3 facing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));	//Extract right vector from this turret
+			CVector3 facing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));	//Extract right vector from this turret
 			float angle = acosf(floatClamp(-1.0f, 1.0f, Dot(facing, forwardVector)));
 			if (angle > m_TankTemplate->GetTurretTurnSpeed() * updateTime)
 			{
@@ -358,7 +360,7 @@ bool CTankEntity::Update( TFloat32 updateTime )
 		// State Exit condition check
 
 		//If reached evasion target
-		if (Length(Position() - m_EvasionTarget) < m_TankTemplate->GetRadius())
+		if (Length(GetPosition() - m_EvasionTarget) < m_TankTemplate->GetRadius())
 		{
 			//Go to patrol state
 			MoveToState(State_Patrol);
@@ -381,12 +383,12 @@ bool CTankEntity::Update( TFloat32 updateTime )
 			if (!nearestCrate)
 			{
 				nearestCrate = ammoCrate;
-				distanceToNearestCrate = Length(ammoCrate->Position() - Position());
+				distanceToNearestCrate = Length(ammoCrate->GetPosition() - GetPosition());
 			}
-			else if (Length(Position() - ammoCrate->Position()) < distanceToNearestCrate)
+			else if (Length(GetPosition() - ammoCrate->GetPosition()) < distanceToNearestCrate)
 			{
 				nearestCrate = ammoCrate;
-				distanceToNearestCrate = Length(ammoCrate->Position() - Position());
+				distanceToNearestCrate = Length(ammoCrate->GetPosition() - GetPosition());
 			}
 
 			ammoCrate = EntityManager.EnumEntity(enumID);
@@ -395,24 +397,22 @@ bool CTankEntity::Update( TFloat32 updateTime )
 
 		if(nearestCrate)
 		{
-			m_AmmoTarget = nearestCrate->Position();
+			m_AmmoTarget = nearestCrate->GetPosition();
 		}
-		else	//Just go on patrol - go to the waypoint after the nearest one (this allows patrolling without moving to the state or tracking patrol)
+		else if (!m_PatrolRoute->IsEmpty())	//Just go on patrol - go to the waypoint after the nearest one (this allows patrolling without moving to the state or tracking patrol)
 		{
-			vector<CVector3>::iterator waypoint = FindNearestWaypoint();
-			waypoint++;
-			if (waypoint == m_PatrolWaypoints.end())
-			{
-				waypoint = m_PatrolWaypoints.begin();
-			}
-			m_AmmoTarget = *waypoint;
+			m_AmmoTarget = m_PatrolRoute->Waypoint(m_PatrolRoute->NextWaypoint(FindNearestWaypoint()));
+		}
+		else
+		{
+			m_AmmoTarget = GetPosition();
 		}
 
 		///////////////////
 		// Tank control
 
 		// Determine whether to turn (and in which direction)
-		CVector3 vectorToTarget = Normalise(m_AmmoTarget - Position()); //Make a unit vector for dot product
+		CVector3 vectorToTarget = Normalise(m_AmmoTarget - GetPosition()); //Make a unit vector for dot product
 
 		DetermineMovementFlags(vectorToTarget, updateTime);
 
@@ -477,30 +477,26 @@ bool CTankEntity::Update( TFloat32 updateTime )
 	return IsAlive(); // Return the 'alive' pseudostate - true if alive (dont destroy this entity), false if dead (destroy this entity)
 }
 
-vector<CVector3>::iterator CTankEntity::FindNearestWaypoint()
+TUInt32 CTankEntity::FindNearestWaypoint()
 {
-	//Select nearest patrol point
-	vector<CVector3>::iterator currentWaypoint = m_PatrolWaypoints.begin();
-	for (vector<CVector3>::iterator waypoint = m_PatrolWaypoints.begin(); waypoint != m_PatrolWaypoints.end(); waypoint++)
+	//Select nearest patrol point, an empty route just returns the first index
+	if (m_PatrolRoute->IsEmpty())
 	{
-		if (Length(Position() - *waypoint) < Length(Position() - *currentWaypoint))
-		{
-			currentWaypoint = waypoint;
-		}
+		return 0;
 	}
-	return currentWaypoint;
+	return m_PatrolRoute->FindNearestWaypoint(GetPosition());
 }
 
 void CTankEntity::DetermineMovementFlags(CVector3 vectorToTarget, float updateTime)
 {
 	vectorToTarget.Normalise();
-	CVector3 rightVector = CVector3(Matrix().GetRow(0));	//Extract right vector from tank
+	CVector3 rightVector = CVector3(GetMatrix().GetRow(0));	//Extract right vector from tank
 	rightVector.Normalise();
 
 	// If angle between vectors is > 90 then need to turn left, if = 90 dont turn, if < 90 turn right
 	if (Dot(rightVector, vectorToTarget) > 0)	//< 90 // Turn right (positive)
 	{
-		CVector3 facing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));	//Extract facing vector from this turret
+		CVector3 facing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));	//Extract facing vector from this turret
 		float angle = acosf(floatClamp(-1.0f, 1.0f, Dot(facing, vectorToTarget)));
 		if (angle > m_TankTemplate->GetTurnSpeed() * updateTime)
 		{
@@ -514,7 +510,7 @@ void CTankEntity::DetermineMovementFlags(CVector3 vectorToTarget, float updateTi
 	}
 	else 	//> 90 //Turn left (negative)	//This also deals with facing the directly wrong direction
 	{
-		CVector3 facing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));	//Extract right vector from this turret
+		CVector3 facing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));	//Extract right vector from this turret
 		float angle = acosf(floatClamp(-1.0f, 1.0f, Dot(facing, vectorToTarget)));
 		if (angle > m_TankTemplate->GetTurnSpeed() * updateTime)
 		{
@@ -533,7 +529,7 @@ void CTankEntity::DetermineMovementFlags(CVector3 vectorToTarget, float updateTi
 		(m_Speed / 2);								//Stopping distance = speed^2 / 2 * maxdeceleration - speed / 2
 
 													// If stopping distance is less than the distance to the target, accelerate, otherwise decelerate
-	if (stoppingDistance < Length(*m_CurrentWaypoint - Position()))
+	if (!m_PatrolRoute->IsEmpty() && stoppingDistance < Length(m_PatrolRoute->Waypoint(m_CurrentWaypoint) - GetPosition()))
 	{
 		m_AccelerateFlag = true;
 	}
@@ -603,7 +599,7 @@ void CTankEntity::MoveToState(EState newState, CVector3* position)
 
 			rotationMatrix.TransformVector(direction);	//Rotate the vector to point at the random angle
 
-			m_EvasionTarget = direction + Position();	//Add the tanks Position to the calculated direction to get the randomised evasion position
+			m_EvasionTarget = direction + GetPosition();	//Add the tanks Position to the calculated direction to get the randomised evasion position
 		}
 		else
 		{
@@ -631,9 +627,7 @@ void CTankEntity::FireShell()
 		stringstream nameStream;
 		nameStream << GetName() << "_Shell_" << m_ShellsFired;
 		CVector3 rotation, position, scale;
-		(Matrix(2) * Matrix()).DecomposeAffineEuler(NULL, &rotation, &scale);
-
-		position = Matrix().TransformPoint(Position(2));
+		GetWorldTRS(2, &position, &rotation, &scale);	//Shell starts at the turret, facing the same way
 
 		EntityManager.CreateShell("Shell Type 1", GetUID(), m_TankTemplate->GetShellSpeed(), m_TankTemplate->GetShellLifeTime(), m_TankTemplate->GetShellDamage(),
 			nameStream.str(), position, rotation, scale);
@@ -664,10 +658,10 @@ bool CTankEntity::TurretFacingEnemy(TFloat32 angle, TEntityUID& entityFacing)
 		if (theOtherTank->m_Team != this->m_Team)
 		{
 			//Determine if the other tank is close enough to be shot before the bullet 'dies'
-			if(Length(theOtherTank->Position() - Matrix().TransformPoint(Position(2))) < m_TankTemplate->GetShotDistance())
+			if(Length(theOtherTank->GetPosition() - GetWorldMatrix(2).GetPosition()) < m_TankTemplate->GetShotDistance())
 			{
-				CVector3 unitVecToOther = Normalise(theOtherTank->Position() - Matrix().TransformPoint(Position(2)));
-				CVector3 turretFacing = Normalise(CVector3((Matrix(2) * Matrix()).GetRow(2)));
+				CVector3 unitVecToOther = Normalise(theOtherTank->GetPosition() - GetWorldMatrix(2).GetPosition());
+				CVector3 turretFacing = Normalise(CVector3(GetWorldMatrix(2).GetRow(2)));
 
 				//determine if the turret points within "angle" of the enemy tank
 				if (Dot(unitVecToOther, turretFacing) > cosAngle)
@@ -679,24 +673,14 @@ bool CTankEntity::TurretFacingEnemy(TFloat32 angle, TEntityUID& entityFacing)
 					CEntity* building = EntityManager.EnumEntity(obstacleEnumID);
 					while (building)
 					{
-						//Test for collision with this building
+						//Test for collision with the triangles of this building (using its mesh's BVH)
 						//If the ray and building intersect then return false, not looking (obstructed)
-						CVector3 intersectionPoint;
-						if (CheckLineBox(
-							building->Matrix().TransformPoint(building->Template()->Mesh()->MinBounds()),	//The min bound of the mesh (moved to the correct position by the matrix)
-							building->Matrix().TransformPoint(building->Template()->Mesh()->MaxBounds()),										//The max bound of the mesh (moved to the correct position by the matrix)
-							theOtherTank->Position(),
-							Matrix().TransformPoint(Position(2)), intersectionPoint))
+						if (building->IntersectSegment(theOtherTank->GetPosition(), GetWorldMatrix(2).GetPosition()))
 						{
 							EntityManager.EndEnumEntities(obstacleEnumID);
 							EntityManager.EndEnumEntities(tankEnumID);
 							return false;
 						}
-						else
-						{
-							int q = 6;
-							q++;
-						}
 
 						//Enumerate the next building
 						building = EntityManager.EnumEntity(obstacleEnumID);
@@ -12,6 +12,7 @@ using namespace std;
 #include "Defines.h"
 #include "CVector3.h"
 #include "Entity.h"
+#include "PatrolRoute.h"
 
 namespace gen
 {
@@ -33,11 +34,11 @@ public:
 	// turn speed and passes the other parameters to construct the base class
 	CTankTemplate
 	(
-		const string& type, const string& name, const string& meshFilename, const string& replacementTemplate,
+		const string& type, const string& name, CMesh* mesh, const string& replacementTemplate,
 		TFloat32 maxSpeed, TFloat32 acceleration, TFloat32 turnSpeed,
 		TFloat32 turretTurnSpeed, TUInt32 maxHP, 
 		TInt32 shellDamage, TFloat32 shellSpeed, TFloat32 shellLifeTime, TFloat32 radius, TInt32 ammoCapacity
-	) : CEntityTemplate( type, name, meshFilename, replacementTemplate )
+	) : CEntityTemplate( type, name, mesh, replacementTemplate )
 	{
 		// Set tank template values
 		m_MaxSpeed = maxSpeed;
@@ -164,7 +165,7 @@ public:
 		CTankTemplate*			tankTemplate,
 		TEntityUID				UID,
 		TUInt32					team,
-		const vector<CVector3>&	patrolPath,
+		const CPatrolRoute*		patrolRoute,
 		const string&			name = "",
 		const CVector3&			position = CVector3::kOrigin, 
 		const CVector3&			rotation = CVector3( 0.0f, 0.0f, 0.0f ),
@@ -277,8 +278,8 @@ private:
 	TFloat32 m_Timer; // A timer used in the example update function   
 	
 	// Patrol state data
-	vector<CVector3> m_PatrolWaypoints;
-	vector<CVector3>::iterator m_CurrentWaypoint;
+	const CPatrolRoute* m_PatrolRoute;     // Shared with other tanks on the same route
+	TUInt32             m_CurrentWaypoint; // Index into patrol route
 
 	// Aim state data
 	TEntityUID m_Target;
@@ -292,7 +293,7 @@ private:
 	/////////////////////////////////////
 	// State Modifications - Private
 
-	vector<CVector3>::iterator FindNearestWaypoint();
+	TUInt32 FindNearestWaypoint();
 	
 	void DetermineMovementFlags(CVector3 vectorToTarget, float updateTime);
 
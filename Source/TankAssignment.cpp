@@ -110,6 +110,11 @@ bool SceneSetup()
 	// Load Scene from file
 	EntityManager.CreateScene("Scene.xml");
 
+	// Templates are only created when first used. Create those used by entities created in code
+	// or during the game now, so their meshes load together at startup rather than mid-game
+	const string gameTemplates[] = { "Tree", "Shell Type 1", "AmmoCrate" };
+	EntityManager.PrefetchTemplates( vector<string>( gameTemplates, gameTemplates + 3 ) );
+
 	//////////////////////////////////////////
 	// Create scenery templates and entities
 
@@ -216,7 +221,7 @@ void RenderScene( float updateTime )
 	SetLights(&Lights[0]);
 
 	// Render entities and draw on-screen text
-	EntityManager.RenderAllEntities();
+	EntityManager.RenderAllEntities( SelectedCamera, ViewportHeight );
 	RenderEntityText(EntityManager);
 	RenderSceneText( updateTime );
 
@@ -276,6 +281,32 @@ void RenderSceneText( float updateTime )
 	RenderText(outText.str(), 0, 70, 1.0f, 1.0f, 0.0f);
 	outText.str("");
 
+	if (DisplayExtendedInfo)
+	{
+		TUInt32 trsLookups = CEntity::GetTRSCacheHits() + CEntity::GetTRSCacheMisses();
+		outText << "TRS cache hit rate: ";
+		if (trsLookups > 0)
+		{
+			outText << 100.0f * CEntity::GetTRSCacheHits() / trsLookups << "% of " << trsLookups;
+		}
+		else
+		{
+			outText << "-";
+		}
+		outText << endl << "Node matrices recalculated: " << EntityManager.GetNumNodesRecalculated();
+		outText << endl << "Triangles rendered: " << EntityManager.GetNumTrianglesRendered();
+		outText << endl << "Templates: " << EntityManager.GetNumTemplates() << " of "
+		        << EntityManager.GetNumDeclaredTemplates() << " declared, load time "
+		        << EntityManager.GetTemplateLoadTime() * 1000.0f << "ms";
+		CMeshCache& meshCache = EntityManager.GetMeshCache();
+		outText << endl << "Meshes: " << meshCache.GetNumMeshes() << " using "
+		        << meshCache.GetSystemMemorySize() / 1024 << "KB system, "
+		        << meshCache.GetVideoMemorySize() / 1024 << "KB video";
+		RenderText(outText.str(), 2, 92, 0.0f, 0.0f, 0.0f);
+		RenderText(outText.str(), 0, 90, 1.0f, 1.0f, 0.0f);
+		outText.str("");
+	}
+
 
 }
 
@@ -306,7 +337,7 @@ void RenderEntityText(CEntityManager& EntityManager)
 			theFontColour = unselectedTankColour;
 		}
 
-		CVector3 thePosition = theEntity->Position();
+		CVector3 thePosition = theEntity->GetPosition();
 		TInt32 x, y;
 		if (SelectedCamera->PixelFromWorldPt(thePosition, ViewportWidth, ViewportHeight, &x, &y))
 		{
@@ -366,7 +397,7 @@ void RenderEntityText(CEntityManager& EntityManager)
 	theEntity = EntityManager.EnumEntity(enumID);
 	while (theEntity)
 	{
-		CVector3 thePosition = theEntity->Position();
+		CVector3 thePosition = theEntity->GetPosition();
 		TInt32 x, y;
 		if (SelectedCamera->PixelFromWorldPt(thePosition, ViewportWidth, ViewportHeight, &x, &y))
 		{
@@ -411,6 +442,11 @@ void UpdateScene( float updateTime )
 	{
 		DisplayExtendedInfo = !DisplayExtendedInfo;
 	}
+	// Write the memory used by each mesh to the debugger output
+	if (KeyHit(Key_M))
+	{
+		OutputDebugStringA(EntityManager.GetMeshCache().GetMemoryReport().c_str());
+	}
 	// Start all tanks
 	if (KeyHit(Key_1))
 	{
@@ -483,12 +519,12 @@ void UpdateScene( float updateTime )
 			{
 				//The first tank is initially the nearest
 				nearestTank = thisEntity;
-				distanceToNearestTank = (thisEntity->Position() - mouseWorldPos).Length();
+				distanceToNearestTank = (thisEntity->GetPosition() - mouseWorldPos).Length();
 			}
-			else if ((thisEntity->Position() - mouseWorldPos).Length() < distanceToNearestTank)	//The new tank is nearer than current nearest
+			else if ((thisEntity->GetPosition() - mouseWorldPos).Length() < distanceToNearestTank)	//The new tank is nearer than current nearest
 			{
 				nearestTank = thisEntity;
-				distanceToNearestTank = (thisEntity->Position() - mouseWorldPos).Length();
+				distanceToNearestTank = (thisEntity->GetPosition() - mouseWorldPos).Length();
 			}
 
 			//Enumerate entity for next iteration
@@ -537,7 +573,7 @@ void UpdateScene( float updateTime )
 		{
 			CVector3 movement = CVector3(0.0f, 4.0f, 0.0f);
 			
-			ChaseCamera->Position() = tank->Position();
+			ChaseCamera->Position() = tank->GetPosition();
 			ChaseCamera->Matrix().Move(movement);
 
 		}
@@ -558,7 +594,7 @@ void UpdateScene( float updateTime )
 				CEntity* tank = EntityManager.GetEntity(SelectedTankUID);
 				if (tank)
 				{
-					CMatrix4x4 tankMatrix = tank->Matrix();
+					CMatrix4x4 tankMatrix = tank->GetMatrix().GetMatrix();
 					ChaseCamera->Matrix() = tankMatrix;
 
 					CVector3 movement = CVector3(0.0f, 4.0f, 0.0f);
@@ -0,0 +1,286 @@
+/*******************************************
+	SceneBinary.cpp
+
+	Compiled binary scene format - a scene
+	XML file with its templates and patrol
+	routes flattened into a single file
+********************************************/
+
+#include <stdio.h>
+#include <fstream>
+
+#include "SceneBinary.h"
+
+namespace gen
+{
+
+/*-----------------------------------------------------------------------------------------
+	Writer
+-----------------------------------------------------------------------------------------*/
+
+// Add a string to the string table (identical strings are shared), returns its offset
+TUInt32 CSceneBinaryWriter::AddString( const string& s )
+{
+	map<string, TUInt32>::iterator existing = m_StringOffsets.find( s );
+	if (existing != m_StringOffsets.end())
+	{
+		return existing->second;
+	}
+
+	TUInt32 offset = static_cast<TUInt32>(m_Strings.size());
+	m_Strings.insert( m_Strings.end(), s.begin(), s.end() );
+	m_Strings.push_back( '\0' );
+	m_StringOffsets[s] = offset;
+	return offset;
+}
+
+// Record a source file used to build the scene. fullPath is used to read the timestamp,
+// fileName (relative to the resource folder) is stored
+void CSceneBinaryWriter::AddSource( const string& fullPath, const string& fileName )
+{
+	// Each file only needs to be listed once
+	TUInt32 name = AddString( fileName );
+	for (TUInt32 i = 0; i < m_Sources.size(); ++i)
+	{
+		if (m_Sources[i].fileName == name) return;
+	}
+
+	SSceneBinarySource source;
+	source.fileName = name;
+	source.padding = 0;
+	if (!CMappedFile::GetFileStamp( fullPath, &source.writeTime, &source.size ))
+	{
+		source.writeTime = 0;
+		source.size = kSceneBinaryMissing;
+	}
+	m_Sources.push_back( source );
+}
+
+// Add a patrol route, returns its index. Routes are shared by file name
+TUInt32 CSceneBinaryWriter::AddRoute( const string& fileName, const vector<CVector3>& waypoints )
+{
+	TUInt32 existing = FindRoute( fileName );
+	if (existing != kSceneBinaryNone)
+	{
+		return existing;
+	}
+
+	SSceneBinaryRoute route;
+	route.fileName = AddString( fileName );
+	route.firstFloat = static_cast<TUInt32>(m_Floats.size());
+	route.numWaypoints = static_cast<TUInt32>(waypoints.size());
+	for (TUInt32 i = 0; i < waypoints.size(); ++i)
+	{
+		m_Floats.push_back( waypoints[i].x );
+		m_Floats.push_back( waypoints[i].y );
+		m_Floats.push_back( waypoints[i].z );
+	}
+	m_Routes.push_back( route );
+	return static_cast<TUInt32>(m_Routes.size()) - 1;
+}
+
+// Return the index of a route previously added with the given file name or kSceneBinaryNone
+TUInt32 CSceneBinaryWriter::FindRoute( const string& fileName )
+{
+	map<string, TUInt32>::iterator name = m_StringOffsets.find( fileName );
+	if (name != m_StringOffsets.end())
+	{
+		for (TUInt32 i = 0; i < m_Routes.size(); ++i)
+		{
+			if (m_Routes[i].fileName == name->second) return i;
+		}
+	}
+	return kSceneBinaryNone;
+}
+
+
+// Helper for Write - place an array of records in the file layout, aligned to 8 bytes. Returns
+// the section and updates the current file offset
+template <class T> SSceneBinarySection LayoutSection( const vector<T>& records, TUInt32& offset )
+{
+	offset = (offset + 7) & ~7u;
+
+	SSceneBinarySection section;
+	section.offset = offset;
+	section.count = static_cast<TUInt32>(records.size());
+	offset += section.count * sizeof(T);
+	return section;
+}
+
+// Helper for Write - write an array of records at the position given by its section
+template <class T> void WriteSection( ofstream& file, const vector<T>& records,
+                                      const SSceneBinarySection& section )
+{
+	// Pad up to the section start
+	static const char padding[8] = { 0 };
+	TUInt32 position = static_cast<TUInt32>(file.tellp());
+	file.write( padding, section.offset - position );
+
+	if (!records.empty())
+	{
+		file.write( reinterpret_cast<const char*>(&records[0]), records.size() * sizeof(T) );
+	}
+}
+
+// Write the compiled scene to the given file, returns false on failure
+bool CSceneBinaryWriter::Write( const string& fileName )
+{
+	// Lay out the file
+	SSceneBinaryHeader header;
+	TUInt32 offset = sizeof(SSceneBinaryHeader);
+	header.magic = kSceneBinaryMagic;
+	header.version = kSceneBinaryVersion;
+	header.sources = LayoutSection( m_Sources, offset );
+	header.entityTemplates = LayoutSection( m_EntityTemplates, offset );
+	header.tankTemplates = LayoutSection( m_TankTemplates, offset );
+	header.entities = LayoutSection( m_Entities, offset );
+	header.tanks = LayoutSection( m_Tanks, offset );
+	header.routes = LayoutSection( m_Routes, offset );
+	header.floats = LayoutSection( m_Floats, offset );
+	header.strings = LayoutSection( m_Strings, offset );
+	header.fileSize = offset;
+
+	// Write to a temporary file and rename when complete, so a partly written file is never seen
+	string tempFileName = fileName + ".tmp";
+	{
+		ofstream file( tempFileName.c_str(), ios::binary | ios::trunc );
+		if (!file)
+		{
+			return false;
+		}
+		file.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+		WriteSection( file, m_Sources, header.sources );
+		WriteSection( file, m_EntityTemplates, header.entityTemplates );
+		WriteSection( file, m_TankTemplates, header.tankTemplates );
+		WriteSection( file, m_Entities, header.entities );
+		WriteSection( file, m_Tanks, header.tanks );
+		WriteSection( file, m_Routes, header.routes );
+		WriteSection( file, m_Floats, header.floats );
+		WriteSection( file, m_Strings, header.strings );
+		if (!file)
+		{
+			file.close();
+			remove( tempFileName.c_str() );
+			return false;
+		}
+	}
+
+	remove( fileName.c_str() );
+	return rename( tempFileName.c_str(), fileName.c_str() ) == 0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Reader
+-----------------------------------------------------------------------------------------*/
+
+// Open and validate a compiled scene file, returns false if the file is missing, is the
+// wrong version or is corrupt
+bool CSceneBinaryReader::Open( const string& fileName )
+{
+	m_Header = 0;
+	if (!m_File.Open( fileName ))
+	{
+		return false;
+	}
+
+	// Check header
+	if (m_File.GetSize() < sizeof(SSceneBinaryHeader))
+	{
+		m_File.Close();
+		return false;
+	}
+	m_Header = reinterpret_cast<const SSceneBinaryHeader*>(m_File.GetData());
+	if (m_Header->magic != kSceneBinaryMagic || m_Header->version != kSceneBinaryVersion ||
+	    m_Header->fileSize != m_File.GetSize())
+	{
+		m_Header = 0;
+		m_File.Close();
+		return false;
+	}
+
+	// Check sections are within the file and the string table is terminated
+	bool valid =
+		ValidSection( m_Header->sources, sizeof(SSceneBinarySource) ) &&
+		ValidSection( m_Header->entityTemplates, sizeof(SSceneBinaryEntityTemplate) ) &&
+		ValidSection( m_Header->tankTemplates, sizeof(SSceneBinaryTankTemplate) ) &&
+		ValidSection( m_Header->entities, sizeof(SSceneBinaryEntity) ) &&
+		ValidSection( m_Header->tanks, sizeof(SSceneBinaryTank) ) &&
+		ValidSection( m_Header->routes, sizeof(SSceneBinaryRoute) ) &&
+		ValidSection( m_Header->floats, sizeof(TFloat32) ) &&
+		ValidSection( m_Header->strings, sizeof(char) ) &&
+		(m_Header->strings.count == 0 || String( m_Header->strings.count - 1 )[0] == '\0');
+
+	// Check all references between records
+	const SSceneBinarySource* sources = Section<SSceneBinarySource>( m_Header->sources );
+	for (TUInt32 i = 0; valid && i < m_Header->sources.count; ++i)
+	{
+		valid = ValidString( sources[i].fileName );
+	}
+	for (TUInt32 i = 0; valid && i < NumEntityTemplates(); ++i)
+	{
+		const SSceneBinaryEntityTemplate& t = EntityTemplate( i );
+		valid = ValidString( t.type ) && ValidString( t.name ) && ValidString( t.mesh ) &&
+		        ValidString( t.replacementTemplate );
+	}
+	for (TUInt32 i = 0; valid && i < NumTankTemplates(); ++i)
+	{
+		const SSceneBinaryTankTemplate& t = TankTemplate( i );
+		valid = ValidString( t.type ) && ValidString( t.name ) && ValidString( t.mesh ) &&
+		        ValidString( t.replacementTemplate );
+	}
+	for (TUInt32 i = 0; valid && i < NumEntities(); ++i)
+	{
+		valid = ValidString( Entity( i ).templateName ) && ValidString( Entity( i ).name );
+	}
+	for (TUInt32 i = 0; valid && i < NumTanks(); ++i)
+	{
+		valid = ValidString( Tank( i ).templateName ) && ValidString( Tank( i ).name ) &&
+		        (Tank( i ).route == kSceneBinaryNone || Tank( i ).route < NumRoutes()) &&
+		        Tank( i ).entitiesBefore <= NumEntities();
+	}
+	for (TUInt32 i = 0; valid && i < NumRoutes(); ++i)
+	{
+		const SSceneBinaryRoute& route = Route( i );
+		valid = ValidString( route.fileName ) && route.firstFloat <= m_Header->floats.count &&
+		        route.numWaypoints <= (m_Header->floats.count - route.firstFloat) / 3;
+	}
+
+	if (!valid)
+	{
+		m_Header = 0;
+		m_File.Close();
+	}
+	return valid;
+}
+
+// Return true if all the source files listed in the compiled scene are unchanged. Pass the
+// folder that source file names are relative to
+bool CSceneBinaryReader::IsUpToDate( const string& sourcePath )
+{
+	const SSceneBinarySource* sources = Section<SSceneBinarySource>( m_Header->sources );
+	for (TUInt32 i = 0; i < m_Header->sources.count; ++i)
+	{
+		TUInt64 writeTime, size;
+		bool exists = CMappedFile::GetFileStamp( sourcePath + String( sources[i].fileName ), &writeTime, &size );
+		if (sources[i].size == kSceneBinaryMissing)
+		{
+			if (exists) return false;
+		}
+		else if (!exists || writeTime != sources[i].writeTime || size != sources[i].size)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Check a section lies within the file
+bool CSceneBinaryReader::ValidSection( const SSceneBinarySection& section, TUInt32 recordSize )
+{
+	TUInt64 end = static_cast<TUInt64>(section.offset) + static_cast<TUInt64>(section.count) * recordSize;
+	return section.offset >= sizeof(SSceneBinaryHeader) && end <= m_File.GetSize();
+}
+
+
+} // namespace gen
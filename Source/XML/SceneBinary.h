@@ -0,0 +1,293 @@
+/*******************************************
+	SceneBinary.h
+
+	Compiled binary scene format - a scene
+	XML file with its templates and patrol
+	routes flattened into a single file
+********************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+#include "Defines.h"
+#include "CVector3.h"
+#include "CMappedFile.h"
+
+namespace gen
+{
+
+/*-----------------------------------------------------------------------------------------
+	File format
+-----------------------------------------------------------------------------------------*/
+// The file is a header followed by sections of fixed-size records, a float array and a string
+// table. All offsets are in bytes from the start of the file, strings are referenced by offset
+// into the string table and are null-terminated. Records are 4-byte aligned and written in the
+// native (little-endian) layout so can be used directly from a memory mapped file.
+// The source files used to build the scene are listed with their timestamps so the loader can
+// detect when the compiled file is stale and the XML must be read again
+
+const TUInt32 kSceneBinaryMagic = 0x4E435354; // "TSCN" in file
+const TUInt32 kSceneBinaryVersion = 2;
+
+// Index value used for "none" (e.g. a tank with no patrol route)
+const TUInt32 kSceneBinaryNone = 0xffffffff;
+
+// Location of an array of records in the file
+struct SSceneBinarySection
+{
+	TUInt32 offset;
+	TUInt32 count;
+};
+
+struct SSceneBinaryHeader
+{
+	TUInt32 magic;
+	TUInt32 version;
+	TUInt32 fileSize;
+
+	SSceneBinarySection sources;         // SSceneBinarySource
+	SSceneBinarySection entityTemplates; // SSceneBinaryEntityTemplate, in creation order
+	SSceneBinarySection tankTemplates;   // SSceneBinaryTankTemplate, in creation order
+	SSceneBinarySection entities;        // SSceneBinaryEntity, in file order
+	SSceneBinarySection tanks;           // SSceneBinaryTank, in file order
+	SSceneBinarySection routes;          // SSceneBinaryRoute
+	SSceneBinarySection floats;          // TFloat32 - waypoint data
+	SSceneBinarySection strings;         // char - count is size of string table in bytes
+};
+
+// A source file the scene was built from. A size of kSceneBinaryMissing indicates the file did
+// not exist when compiled (the compiled file is stale if it is later created)
+const TUInt64 kSceneBinaryMissing = 0xffffffffffffffffULL;
+struct SSceneBinarySource
+{
+	TUInt32 fileName; // Relative to the resource folder
+	TUInt32 padding;
+	TUInt64 writeTime;
+	TUInt64 size;
+};
+
+struct SSceneBinaryEntityTemplate
+{
+	TUInt32 type;
+	TUInt32 name;
+	TUInt32 mesh;
+	TUInt32 replacementTemplate;
+};
+
+struct SSceneBinaryTankTemplate
+{
+	TUInt32  type;
+	TUInt32  name;
+	TUInt32  mesh;
+	TUInt32  replacementTemplate;
+	TFloat32 maxSpeed;
+	TFloat32 acceleration;
+	TFloat32 turnSpeed;
+	TFloat32 turretTurnSpeed;
+	TFloat32 shellSpeed;
+	TFloat32 shellLifetime;
+	TFloat32 radius;
+	TInt32   maxHP;
+	TInt32   shellDamage;
+	TInt32   ammoCapacity;
+};
+
+struct SSceneBinaryEntity
+{
+	TUInt32  templateName;
+	TUInt32  name;
+	TFloat32 position[3];
+	TFloat32 rotation[3];
+	TFloat32 scale[3];
+};
+
+struct SSceneBinaryTank
+{
+	TUInt32  templateName;
+	TUInt32  name;
+	TInt32   team;
+	TUInt32  route;          // Index into routes section or kSceneBinaryNone
+	TUInt32  entitiesBefore; // Number of entities before this tank in the scene file
+	TFloat32 position[3];
+	TFloat32 rotation[3];
+	TFloat32 scale[3];
+};
+
+// A patrol route, the waypoints are stored as x,y,z triples in the floats section
+struct SSceneBinaryRoute
+{
+	TUInt32 fileName;
+	TUInt32 firstFloat;
+	TUInt32 numWaypoints;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Writer
+-----------------------------------------------------------------------------------------*/
+
+// Collects scene records in memory then writes a compiled scene file
+class CSceneBinaryWriter
+{
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Add a string to the string table (identical strings are shared), returns its offset
+	TUInt32 AddString( const string& s );
+
+	// Record a source file used to build the scene. fullPath is used to read the timestamp,
+	// fileName (relative to the resource folder) is stored
+	void AddSource( const string& fullPath, const string& fileName );
+
+	// Add a patrol route, returns its index. Routes are shared by file name
+	TUInt32 AddRoute( const string& fileName, const vector<CVector3>& waypoints );
+
+	// Return the index of a route previously added with the given file name or kSceneBinaryNone
+	TUInt32 FindRoute( const string& fileName );
+
+	// Add records, strings in the records must have been added with AddString. Entities and
+	// tanks must be added in file order, the entities before each tank are counted here
+	void AddEntityTemplate( const SSceneBinaryEntityTemplate& entityTemplate )
+	{
+		m_EntityTemplates.push_back( entityTemplate );
+	}
+	void AddTankTemplate( const SSceneBinaryTankTemplate& tankTemplate )
+	{
+		m_TankTemplates.push_back( tankTemplate );
+	}
+	void AddEntity( const SSceneBinaryEntity& entity )
+	{
+		m_Entities.push_back( entity );
+	}
+	void AddTank( const SSceneBinaryTank& tank )
+	{
+		m_Tanks.push_back( tank );
+		m_Tanks.back().entitiesBefore = static_cast<TUInt32>(m_Entities.size());
+	}
+
+	// Write the compiled scene to the given file, returns false on failure
+	bool Write( const string& fileName );
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	vector<SSceneBinarySource>         m_Sources;
+	vector<SSceneBinaryEntityTemplate> m_EntityTemplates;
+	vector<SSceneBinaryTankTemplate>   m_TankTemplates;
+	vector<SSceneBinaryEntity>         m_Entities;
+	vector<SSceneBinaryTank>           m_Tanks;
+	vector<SSceneBinaryRoute>          m_Routes;
+	vector<TFloat32>                   m_Floats;
+
+	// String table and map from string to offset for sharing
+	vector<char>           m_Strings;
+	map<string, TUInt32>   m_StringOffsets;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Reader
+-----------------------------------------------------------------------------------------*/
+
+// Memory maps a compiled scene file and gives direct access to its records. No data is copied
+class CSceneBinaryReader
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CSceneBinaryReader() : m_Header( 0 ) {}
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Open and validate a compiled scene file, returns false if the file is missing, is the
+	// wrong version or is corrupt
+	bool Open( const string& fileName );
+
+	// Return true if all the source files listed in the compiled scene are unchanged. Pass the
+	// folder that source file names are relative to
+	bool IsUpToDate( const string& sourcePath );
+
+
+	/////////////////////////////////////
+	// Record access - only valid after a successful Open
+
+	TUInt32 NumSources()         { return m_Header->sources.count; }
+	TUInt32 NumEntityTemplates() { return m_Header->entityTemplates.count; }
+	TUInt32 NumTankTemplates()   { return m_Header->tankTemplates.count; }
+	TUInt32 NumEntities()        { return m_Header->entities.count; }
+	TUInt32 NumTanks()           { return m_Header->tanks.count; }
+	TUInt32 NumRoutes()          { return m_Header->routes.count; }
+
+	const SSceneBinarySource& Source( TUInt32 i )
+	{
+		return Section<SSceneBinarySource>( m_Header->sources )[i];
+	}
+	const SSceneBinaryEntityTemplate& EntityTemplate( TUInt32 i )
+	{
+		return Section<SSceneBinaryEntityTemplate>( m_Header->entityTemplates )[i];
+	}
+	const SSceneBinaryTankTemplate& TankTemplate( TUInt32 i )
+	{
+		return Section<SSceneBinaryTankTemplate>( m_Header->tankTemplates )[i];
+	}
+	const SSceneBinaryEntity& Entity( TUInt32 i )
+	{
+		return Section<SSceneBinaryEntity>( m_Header->entities )[i];
+	}
+	const SSceneBinaryTank& Tank( TUInt32 i )
+	{
+		return Section<SSceneBinaryTank>( m_Header->tanks )[i];
+	}
+	const SSceneBinaryRoute& Route( TUInt32 i )
+	{
+		return Section<SSceneBinaryRoute>( m_Header->routes )[i];
+	}
+
+	// Return pointer to the waypoint data of a route, x,y,z triples
+	const TFloat32* RouteWaypoints( TUInt32 i )
+	{
+		return Section<TFloat32>( m_Header->floats ) + Route( i ).firstFloat;
+	}
+
+	// Return a string from the string table
+	const char* String( TUInt32 offset )
+	{
+		return Section<char>( m_Header->strings ) + offset;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Return pointer to the start of a section
+	template <class T> const T* Section( const SSceneBinarySection& section )
+	{
+		return reinterpret_cast<const T*>(m_File.GetData() + section.offset);
+	}
+
+	// Check a section lies within the file
+	bool ValidSection( const SSceneBinarySection& section, TUInt32 recordSize );
+
+	// Check a string offset lies within the string table
+	bool ValidString( TUInt32 offset )
+	{
+		return offset < m_Header->strings.count;
+	}
+
+	CMappedFile               m_File;
+	const SSceneBinaryHeader* m_Header;
+};
+
+
+} // namespace gen
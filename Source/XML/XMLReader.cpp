@@ -1,240 +1,771 @@
 #include "XMLReader.h"
 
+#include <sstream>
+#include <algorithm>
+#include <set>
+
 #include "EntityManager.h"
+#include "XMLStream.h"
+#include "CWorkerPool.h"
+#include "CTimer.h"
+#include "NumberParser.h"
 
 namespace gen {
 
 extern CEntityManager EntityManager;
 
-CEntityTemplate* XMLReader::LoadEntityTemplate(const string& fileName)
+//Return an attribute of an element, or an empty string if it is missing
+static const char* GetAttribute(const TiXmlElement* element, const char* name)
 {
-	string file = filePath + fileName;
+	const char* value = element->Attribute(name);
+	return value ? value : "";
+}
 
-	TiXmlDocument doc = TiXmlDocument(file.c_str());
-	bool loadSuccess = doc.LoadFile();
+//Report an attribute that is not a valid number to the debugger output, with its file and line
+//where known
+static void ReportInvalidNumber(const TiXmlElement* element, const char* name, const char* value)
+{
+	ostringstream report;
+	const TiXmlDocument* doc = element->GetDocument();
+	if (doc && doc->Value() && doc->Value()[0])
+	{
+		report << doc->Value() << "(" << element->Row() << "): ";
+	}
+	report << "Invalid number \"" << value << "\" for attribute " << name << " of " << element->Value() << "\n";
+	OutputDebugStringA(report.str().c_str());
+}
 
-	if (loadSuccess)
+//Read a number attribute of an element. Numbers are parsed strictly and independently of the
+//locale. A missing attribute gives 0, an invalid number is reported and also gives 0
+static float ReadFloat(const TiXmlElement* element, const char* name)
+{
+	const char* value = element->Attribute(name);
+	TFloat32 f = 0.0f;
+	if (value && !ParseFloat(value, &f))
 	{
-		//Define data types to extract
-		string type, name, mesh, replacementTemplate;
+		ReportInvalidNumber(element, name, value);
+	}
+	return f;
+}
+static int ReadInt(const TiXmlElement* element, const char* name)
+{
+	const char* value = element->Attribute(name);
+	TInt32 i = 0;
+	if (value && !ParseInt(value, &i))
+	{
+		ReportInvalidNumber(element, name, value);
+	}
+	return i;
+}
 
-		TiXmlElement* rootElement = doc.RootElement();
+//Read a vector from the x, y and z attributes of an element
+static CVector3 ReadVector3(const TiXmlElement* vector3Elt)
+{
+	return CVector3(ReadFloat(vector3Elt, "x"), ReadFloat(vector3Elt, "y"), ReadFloat(vector3Elt, "z"));
+}
 
-		if (rootElement)
+//Store a vector in a compiled scene record
+static void StoreVector3(const CVector3& v, TFloat32* out)
+{
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Streaming scene parsing
+-----------------------------------------------------------------------------------------*/
+
+//An entity or tank read from a scene file
+struct SSceneEntityDesc
+{
+	string templateName, name;
+	int team;				//Tanks only
+	string patrolRoute;		//Tanks only
+	CVector3 position, rotation, scale;
+};
+
+//Receives the contents of a scene file from CSceneVisitor as each element closes
+class CSceneBuilder
+{
+public:
+	virtual ~CSceneBuilder() {}
+	virtual void AddEntityTemplate(const string& file) = 0;
+	virtual void AddTankTemplate(const string& file) = 0;
+	virtual void AddEntity(const SSceneEntityDesc& entity) = 0;
+	virtual void AddTank(const SSceneEntityDesc& tank) = 0;
+};
+
+//Visitor used with CXMLStreamParser to read a scene file. Only the current element of each level
+//is held, so templates and entities are passed on to the builder as soon as they are complete.
+//Items are passed in file order, so templates must come before the entities that use them
+class CSceneVisitor : public TiXmlVisitor
+{
+public:
+	CSceneVisitor(CSceneBuilder* builder) : m_Builder(builder), m_Depth(0), m_Section(Section_None), m_Item(Item_None) {}
+
+	virtual bool VisitEnter(const TiXmlElement& element, const TiXmlAttribute* /*firstAttribute*/)
+	{
+		++m_Depth;
+		const char* name = element.Value();
+		if (m_Depth == 1)
+		{
+			//Scene root
+			return true;
+		}
+		if (m_Depth == 2)
+		{
+			//Section - skip unknown sections entirely
+			m_Section = !strcmp(name, "Templates") ? Section_Templates :
+			            !strcmp(name, "Entities")  ? Section_Entities :
+			            !strcmp(name, "Tanks")     ? Section_Tanks : Section_None;
+			return m_Section != Section_None;
+		}
+		if (m_Depth == 3)
 		{
-			type = rootElement->Attribute("Type");
-			name = rootElement->Attribute("Name");
-			mesh = rootElement->Attribute("Mesh");
-			replacementTemplate = rootElement->Attribute("ReplacementTemplate");
+			//Item in a section
+			m_Item = Item_None;
+			if (m_Section == Section_Templates)
+			{
+				m_Item = !strcmp(name, "EntityTemplate") ? Item_EntityTemplate :
+				         !strcmp(name, "TankTemplate")   ? Item_TankTemplate : Item_None;
+				m_TemplateFile = GetAttribute(&element, "file");
+				return false;
+			}
+			if ((m_Section == Section_Entities && !strcmp(name, "Entity")) ||
+			    (m_Section == Section_Tanks && !strcmp(name, "Tank")))
+			{
+				m_Item = (m_Section == Section_Entities) ? Item_Entity : Item_Tank;
+				m_Entity.templateName = GetAttribute(&element, "templateName");
+				m_Entity.name = GetAttribute(&element, "name");
+				m_Entity.team = ReadInt(&element, "team");
+				m_Entity.patrolRoute = GetAttribute(&element, "patrolRoute");
+
+				//Defaults for missing position, rotation and scale elements
+				m_Entity.position = CVector3::kOrigin;
+				m_Entity.rotation = CVector3::kZero;
+				m_Entity.scale = CVector3::kOne;
+				return true;
+			}
+			return false;
+		}
+		if (m_Depth == 4 && m_Item != Item_None)
+		{
+			//Entity position, rotation and scale values
+			if      (!strcmp(name, "Position")) m_Entity.position = ReadVector3(&element);
+			else if (!strcmp(name, "Rotation")) m_Entity.rotation = ReadVector3(&element);
+			else if (!strcmp(name, "Scale"))    m_Entity.scale = ReadVector3(&element);
+		}
+		return false;
+	}
 
-			return EntityManager.CreateTemplate(type, name, mesh, replacementTemplate);
+	virtual bool VisitExit(const TiXmlElement& /*element*/)
+	{
+		if (m_Depth == 3)
+		{
+			switch (m_Item)
+			{
+				case Item_EntityTemplate: m_Builder->AddEntityTemplate(m_TemplateFile); break;
+				case Item_TankTemplate:   m_Builder->AddTankTemplate(m_TemplateFile);   break;
+				case Item_Entity:         m_Builder->AddEntity(m_Entity);               break;
+				case Item_Tank:           m_Builder->AddTank(m_Entity);                 break;
+				default: break;
+			}
+			m_Item = Item_None;
 		}
+		--m_Depth;
+		return true;
 	}
-	return nullptr;
+
+private:
+	enum ESection { Section_None, Section_Templates, Section_Entities, Section_Tanks };
+	enum EItem { Item_None, Item_EntityTemplate, Item_TankTemplate, Item_Entity, Item_Tank };
+
+	CSceneBuilder*   m_Builder;
+	int              m_Depth;
+	ESection         m_Section;
+	EItem            m_Item;
+	string           m_TemplateFile;
+	SSceneEntityDesc m_Entity;
+};
+
+//Report a template file listed in a scene that could not be read to the debugger output
+static void ReportMissingTemplate(const string& file)
+{
+	string report = "Template file " + file + " could not be read\n";
+	OutputDebugStringA(report.c_str());
 }
 
-CTankTemplate* XMLReader::LoadTankTemplate(const string& fileName)
+//Scene builder for the first pass over a scene file, declares the templates and collects the
+//names of the templates used by entities and tanks, so they can be prefetched together (loading
+//the meshes in parallel) before the entities are created. Only the names are held
+class CSceneTemplateCollector : public CSceneBuilder
+{
+public:
+	CSceneTemplateCollector(XMLReader* reader) : m_Reader(reader) {}
+
+	virtual void AddEntityTemplate(const string& file)
+	{
+		SEntityTemplateDesc desc;
+		if (m_Reader->ReadEntityTemplate(file, desc))
+		{
+			EntityManager.DeclareTemplate(desc);
+		}
+		else
+		{
+			ReportMissingTemplate(file);
+		}
+	}
+	virtual void AddTankTemplate(const string& file)
+	{
+		STankTemplateDesc desc;
+		if (m_Reader->ReadTankTemplate(file, desc))
+		{
+			EntityManager.DeclareTankTemplate(desc);
+		}
+		else
+		{
+			ReportMissingTemplate(file);
+		}
+	}
+	virtual void AddEntity(const SSceneEntityDesc& entity)
+	{
+		m_TemplateNames.insert(entity.templateName);
+	}
+	virtual void AddTank(const SSceneEntityDesc& tank)
+	{
+		m_TemplateNames.insert(tank.templateName);
+	}
+
+	//Create the templates used by the scene
+	void PrefetchTemplates()
+	{
+		EntityManager.PrefetchTemplates(vector<string>(m_TemplateNames.begin(), m_TemplateNames.end()));
+	}
+
+private:
+	XMLReader*  m_Reader;
+	set<string> m_TemplateNames;
+};
+
+//Scene builder for the second pass over a scene file, creates each entity and tank as it is read
+//(in file order). The templates were declared in the first pass
+class CSceneCreator : public CSceneBuilder
+{
+public:
+	CSceneCreator(XMLReader* reader) : m_Reader(reader) {}
+
+	virtual void AddEntityTemplate(const string& /*file*/) {}
+	virtual void AddTankTemplate(const string& /*file*/) {}
+
+	virtual void AddEntity(const SSceneEntityDesc& entity)
+	{
+		EntityManager.CreateEntity(entity.templateName, entity.name, entity.position, entity.rotation, entity.scale);
+	}
+	virtual void AddTank(const SSceneEntityDesc& tank)
+	{
+		EntityManager.CreateTank(tank.templateName, tank.team, m_Reader->LoadPatrolRoute(tank.patrolRoute),
+		                         tank.name, tank.position, tank.rotation, tank.scale);
+	}
+
+private:
+	XMLReader* m_Reader;
+};
+
+//Scene builder that adds the templates and entities to a compiled scene, reading the template
+//and patrol route files they refer to
+class CSceneCompiler : public CSceneBuilder
+{
+public:
+	CSceneCompiler(XMLReader* reader, CSceneBinaryWriter* writer) : m_Reader(reader), m_Writer(writer) {}
+
+	//A template file that cannot be read is recorded as a source so the scene is recompiled when
+	//it appears, but creates no template (as with the XML loader)
+	virtual void AddEntityTemplate(const string& file)
+	{
+		m_Writer->AddSource(m_Reader->filePath + file, file);
+
+		SEntityTemplateDesc desc;
+		if (!m_Reader->ReadEntityTemplate(file, desc))
+		{
+			ReportMissingTemplate(file);
+		}
+		else
+		{
+			SSceneBinaryEntityTemplate record;
+			record.type = m_Writer->AddString(desc.type);
+			record.name = m_Writer->AddString(desc.name);
+			record.mesh = m_Writer->AddString(desc.mesh);
+			record.replacementTemplate = m_Writer->AddString(desc.replacementTemplate);
+			m_Writer->AddEntityTemplate(record);
+		}
+	}
+
+	virtual void AddTankTemplate(const string& file)
+	{
+		m_Writer->AddSource(m_Reader->filePath + file, file);
+
+		STankTemplateDesc desc;
+		if (!m_Reader->ReadTankTemplate(file, desc))
+		{
+			ReportMissingTemplate(file);
+		}
+		else
+		{
+			SSceneBinaryTankTemplate record;
+			record.type = m_Writer->AddString(desc.type);
+			record.name = m_Writer->AddString(desc.name);
+			record.mesh = m_Writer->AddString(desc.mesh);
+			record.replacementTemplate = m_Writer->AddString(desc.replacementTemplate);
+			record.maxSpeed = desc.maxSpeed;
+			record.acceleration = desc.acceleration;
+			record.turnSpeed = desc.turnSpeed;
+			record.turretTurnSpeed = desc.turretTurnSpeed;
+			record.shellSpeed = desc.shellSpeed;
+			record.shellLifetime = desc.shellLifetime;
+			record.radius = desc.radius;
+			record.maxHP = desc.maxHP;
+			record.shellDamage = desc.shellDamage;
+			record.ammoCapacity = desc.ammoCapacity;
+			m_Writer->AddTankTemplate(record);
+		}
+	}
+
+	virtual void AddEntity(const SSceneEntityDesc& entity)
+	{
+		SSceneBinaryEntity record;
+		record.templateName = m_Writer->AddString(entity.templateName);
+		record.name = m_Writer->AddString(entity.name);
+		StoreVector3(entity.position, record.position);
+		StoreVector3(entity.rotation, record.rotation);
+		StoreVector3(entity.scale, record.scale);
+		m_Writer->AddEntity(record);
+	}
+
+	//Patrol routes are stored once each however many tanks use them. A tank without a route has
+	//no route file, so there is no source to record
+	virtual void AddTank(const SSceneEntityDesc& tank)
+	{
+		SSceneBinaryTank record;
+		record.templateName = m_Writer->AddString(tank.templateName);
+		record.name = m_Writer->AddString(tank.name);
+		record.team = tank.team;
+
+		record.route = tank.patrolRoute.empty() ? kSceneBinaryNone : m_Writer->FindRoute(tank.patrolRoute);
+		if (record.route == kSceneBinaryNone && !tank.patrolRoute.empty())
+		{
+			m_Writer->AddSource(m_Reader->filePath + tank.patrolRoute, tank.patrolRoute);
+			vector<CVector3> patrolRoute;
+			m_Reader->ReadPatrolRoute(tank.patrolRoute, patrolRoute);
+			record.route = m_Writer->AddRoute(tank.patrolRoute, patrolRoute);
+		}
+
+		StoreVector3(tank.position, record.position);
+		StoreVector3(tank.rotation, record.rotation);
+		StoreVector3(tank.scale, record.scale);
+		m_Writer->AddTank(record);
+	}
+
+private:
+	XMLReader*          m_Reader;
+	CSceneBinaryWriter* m_Writer;
+};
+
+
+bool XMLReader::ReadEntityTemplate(const string& fileName, SEntityTemplateDesc& desc)
 {
 	string file = filePath + fileName;
 
+	//Template and route files are only read for their attributes so are parsed in-situ, which
+	//avoids copying every string
 	TiXmlDocument doc = TiXmlDocument(file.c_str());
-	bool loadSuccess = doc.LoadFile();
+	doc.SetInSitu(true);
+	if (!doc.LoadFile())
+	{
+		return false;
+	}
 
-	if (loadSuccess)
+	TiXmlElement* rootElement = doc.RootElement();
+	if (!rootElement)
 	{
-		//Define data types to extract
-		string type, name, mesh, replacementTemplate;
-		float maxSpeed, acceleration, turnSpeed, turretturnSpeed, shellSpeed, shellLifetime, radius;
-		int maxHP, shellDamage, ammoCapacity;
+		return false;
+	}
 
-		TiXmlElement* rootElement = doc.RootElement();
-		if (rootElement)
-		{
-			type = rootElement->Attribute("Type");
-			name = rootElement->Attribute("Name");
-			mesh = rootElement->Attribute("Mesh");
-			replacementTemplate = rootElement->Attribute("ReplacementTemplate");
-
-			maxSpeed =			static_cast<float>(atof(rootElement->Attribute("MaxSpeed")));
-			acceleration =		static_cast<float>(atof(rootElement->Attribute("Acceleration")));
-			turnSpeed =			static_cast<float>(atof(rootElement->Attribute("TurnSpeed")));
-			turretturnSpeed =	static_cast<float>(atof(rootElement->Attribute("TurretTurnSpeed")));
-			shellSpeed =		static_cast<float>(atof(rootElement->Attribute("ShellSpeed")));
-			shellLifetime =		static_cast<float>(atof(rootElement->Attribute("ShellLifetime")));
-			radius =			static_cast<float>(atof(rootElement->Attribute("Radius")));
-
-			maxHP =			atoi(rootElement->Attribute("MaxHP"));
-			shellDamage =	atoi(rootElement->Attribute("ShellDamage"));
-			ammoCapacity =	atoi(rootElement->Attribute("AmmoCapacity"));
-		
-			return EntityManager.CreateTankTemplate(type, name, mesh, replacementTemplate, maxSpeed, acceleration, turnSpeed, turretturnSpeed, maxHP, shellDamage, shellSpeed, shellLifetime, radius, ammoCapacity);
-		}	
+	desc.type = GetAttribute(rootElement, "Type");
+	desc.name = GetAttribute(rootElement, "Name");
+	desc.mesh = GetAttribute(rootElement, "Mesh");
+	desc.replacementTemplate = GetAttribute(rootElement, "ReplacementTemplate");
+	return true;
+}
+
+bool XMLReader::ReadTankTemplate(const string& fileName, STankTemplateDesc& desc)
+{
+	string file = filePath + fileName;
+
+	TiXmlDocument doc = TiXmlDocument(file.c_str());
+	doc.SetInSitu(true);
+	if (!doc.LoadFile())
+	{
+		return false;
+	}
+
+	TiXmlElement* rootElement = doc.RootElement();
+	if (!rootElement)
+	{
+		return false;
+	}
+
+	desc.type = GetAttribute(rootElement, "Type");
+	desc.name = GetAttribute(rootElement, "Name");
+	desc.mesh = GetAttribute(rootElement, "Mesh");
+	desc.replacementTemplate = GetAttribute(rootElement, "ReplacementTemplate");
+
+	desc.maxSpeed =			ReadFloat(rootElement, "MaxSpeed");
+	desc.acceleration =		ReadFloat(rootElement, "Acceleration");
+	desc.turnSpeed =		ReadFloat(rootElement, "TurnSpeed");
+	desc.turretTurnSpeed =	ReadFloat(rootElement, "TurretTurnSpeed");
+	desc.shellSpeed =		ReadFloat(rootElement, "ShellSpeed");
+	desc.shellLifetime =	ReadFloat(rootElement, "ShellLifetime");
+	desc.radius =			ReadFloat(rootElement, "Radius");
+
+	desc.maxHP =		ReadInt(rootElement, "MaxHP");
+	desc.shellDamage =	ReadInt(rootElement, "ShellDamage");
+	desc.ammoCapacity =	ReadInt(rootElement, "AmmoCapacity");
+	return true;
+}
+
+CEntityTemplate* XMLReader::LoadEntityTemplate(const string& fileName)
+{
+	SEntityTemplateDesc desc;
+	if (ReadEntityTemplate(fileName, desc))
+	{
+		return EntityManager.CreateTemplate(desc.type, desc.name, desc.mesh, desc.replacementTemplate);
 	}
 	return nullptr;
 }
 
-void XMLReader::LoadScene(const string & filename)
+CTankTemplate* XMLReader::LoadTankTemplate(const string& fileName)
 {
-	string file = filePath + filename;
+	STankTemplateDesc desc;
+	if (ReadTankTemplate(fileName, desc))
+	{
+		return EntityManager.CreateTankTemplate(desc.type, desc.name, desc.mesh, desc.replacementTemplate,
+		                                        desc.maxSpeed, desc.acceleration, desc.turnSpeed, desc.turretTurnSpeed,
+		                                        desc.maxHP, desc.shellDamage, desc.shellSpeed, desc.shellLifetime,
+		                                        desc.radius, desc.ammoCapacity);
+	}
+	return nullptr;
+}
 
-	TiXmlDocument doc = TiXmlDocument(file.c_str());
-	bool loadSuccess = doc.LoadFile();
+string XMLReader::GetCompiledSceneName(const string& filename)
+{
+	string::size_type dot = filename.find_last_of('.');
+	return filename.substr(0, dot) + ".scenebin";
+}
 
-	if (loadSuccess)
+void XMLReader::LoadScene(const string& filename)
+{
+	//Use the compiled scene if it is up to date, otherwise rebuild it from the XML
+	string compiledFile = GetCompiledSceneName(filename);
+	if (LoadCompiledScene(compiledFile))
 	{
-		TiXmlElement* rootElement = doc.RootElement();
+		return;
+	}
+	if (CompileScene(filename, compiledFile) && LoadCompiledScene(compiledFile))
+	{
+		return;
+	}
 
-		if (rootElement)
+	//Could not write or read back the compiled scene (e.g. read-only folder), use the XML
+	LoadSceneXML(filename);
+}
+
+//Create an entity from a compiled scene record
+static void CreateCompiledEntity(CSceneBinaryReader& scene, TUInt32 i)
+{
+	const SSceneBinaryEntity& e = scene.Entity(i);
+	EntityManager.CreateEntity(scene.String(e.templateName), scene.String(e.name), CVector3(e.position),
+	                           CVector3(e.rotation), CVector3(e.scale));
+}
+
+bool XMLReader::LoadCompiledScene(const string& compiledFilename)
+{
+	CSceneBinaryReader scene;
+	if (!scene.Open(filePath + compiledFilename) || !scene.IsUpToDate(filePath))
+	{
+		return false;
+	}
+
+	//Report source files that were missing when the scene was compiled (e.g. template files)
+	for (TUInt32 i = 0; i < scene.NumSources(); ++i)
+	{
+		if (scene.Source(i).size == kSceneBinaryMissing)
 		{
-			//Traverse the templates list
-			TiXmlElement* templatesElt = rootElement->FirstChildElement("Templates");
+			ReportMissingTemplate(scene.String(scene.Source(i).fileName));
+		}
+	}
 
-			//Search for entity templates
-			TiXmlElement* traversalElt = templatesElt->FirstChildElement("EntityTemplate");
-			while (traversalElt)
-			{
-				//Create the found entity template
-				EntityManager.CreateTemplate(traversalElt->Attribute("file"));
+	//Declare the templates, they are only created when used. Records are read directly from the
+	//mapped file
+	for (TUInt32 i = 0; i < scene.NumEntityTemplates(); ++i)
+	{
+		const SSceneBinaryEntityTemplate& t = scene.EntityTemplate(i);
+		SEntityTemplateDesc desc;
+		desc.type = scene.String(t.type);
+		desc.name = scene.String(t.name);
+		desc.mesh = scene.String(t.mesh);
+		desc.replacementTemplate = scene.String(t.replacementTemplate);
+		EntityManager.DeclareTemplate(desc);
+	}
+	for (TUInt32 i = 0; i < scene.NumTankTemplates(); ++i)
+	{
+		const SSceneBinaryTankTemplate& t = scene.TankTemplate(i);
+		STankTemplateDesc desc;
+		desc.type = scene.String(t.type);
+		desc.name = scene.String(t.name);
+		desc.mesh = scene.String(t.mesh);
+		desc.replacementTemplate = scene.String(t.replacementTemplate);
+		desc.maxSpeed = t.maxSpeed;
+		desc.acceleration = t.acceleration;
+		desc.turnSpeed = t.turnSpeed;
+		desc.turretTurnSpeed = t.turretTurnSpeed;
+		desc.shellSpeed = t.shellSpeed;
+		desc.shellLifetime = t.shellLifetime;
+		desc.radius = t.radius;
+		desc.maxHP = t.maxHP;
+		desc.shellDamage = t.shellDamage;
+		desc.ammoCapacity = t.ammoCapacity;
+		EntityManager.DeclareTankTemplate(desc);
+	}
 
-				//Move to the next entity template
-				traversalElt = traversalElt->NextSiblingElement("EntityTemplate");
-			}
-			//Search for tank templates
-			traversalElt = templatesElt->FirstChildElement("TankTemplate");
-			while (traversalElt)
-			{
-				//Create the found tank template
-				EntityManager.CreateTankTemplate(traversalElt->Attribute("file"));
+	//Create the templates used by the scene together, loading their meshes in parallel
+	set<string> templateNames;
+	for (TUInt32 i = 0; i < scene.NumEntities(); ++i)
+	{
+		templateNames.insert(scene.String(scene.Entity(i).templateName));
+	}
+	for (TUInt32 i = 0; i < scene.NumTanks(); ++i)
+	{
+		templateNames.insert(scene.String(scene.Tank(i).templateName));
+	}
+	EntityManager.PrefetchTemplates(vector<string>(templateNames.begin(), templateNames.end()));
 
-				//Move to the next tank template
-				traversalElt = traversalElt->NextSiblingElement("TankTemplate");
-			}
+	//Each route is added to the patrol route cache once and shared by the tanks using it
+	vector<const CPatrolRoute*> patrolRoutes(scene.NumRoutes());
+	for (TUInt32 i = 0; i < scene.NumRoutes(); ++i)
+	{
+		const TFloat32* waypoint = scene.RouteWaypoints(i);
+		vector<CVector3> waypoints(scene.Route(i).numWaypoints);
+		for (TUInt32 w = 0; w < waypoints.size(); ++w, waypoint += 3)
+		{
+			waypoints[w] = CVector3(waypoint);
+		}
+		patrolRoutes[i] = AddPatrolRoute(scene.String(scene.Route(i).fileName), waypoints);
+	}
 
-			//Traverse the entities list
-			TiXmlElement* entitiesElt = rootElement->FirstChildElement("Entities");
-			traversalElt = entitiesElt->FirstChildElement("Entity");
-			while (traversalElt)
-			{
-				string templateName = traversalElt->Attribute("templateName");
-				string name = traversalElt->Attribute("name");
-				CVector3 position, rotation, scale;
+	//Create entities and tanks in the same order as the scene file (and the XML loader), each tank
+	//records how many entities come before it
+	TUInt32 entity = 0;
+	for (TUInt32 i = 0; i < scene.NumTanks(); ++i)
+	{
+		const SSceneBinaryTank& t = scene.Tank(i);
+		for (; entity < t.entitiesBefore; ++entity)
+		{
+			CreateCompiledEntity(scene, entity);
+		}
 
-				//Get entity position, rotation and scale values
-				TiXmlElement* vector3Elt = traversalElt->FirstChildElement("Position");	//Get position
-				if (vector3Elt)
-				{
-					//The element exists, populate based on its data
-					position.x = static_cast<float>(atof(vector3Elt->Attribute("x")));
-					position.y = static_cast<float>(atof(vector3Elt->Attribute("y")));
-					position.z = static_cast<float>(atof(vector3Elt->Attribute("z")));
-				}
-				else
-				{
-					//The element did not exist, use default value
-					position = CVector3::kOrigin;
-				}
+		const CPatrolRoute* patrolRoute = (t.route != kSceneBinaryNone) ? patrolRoutes[t.route]
+		                                                                : AddPatrolRoute("", vector<CVector3>());
+		EntityManager.CreateTank(scene.String(t.templateName), t.team, patrolRoute, scene.String(t.name),
+		                         CVector3(t.position), CVector3(t.rotation), CVector3(t.scale));
+	}
+	for (; entity < scene.NumEntities(); ++entity)
+	{
+		CreateCompiledEntity(scene, entity);
+	}
+	return true;
+}
 
-				vector3Elt = traversalElt->FirstChildElement("Rotation");	//Get rotation
-				if (vector3Elt)
-				{
-					//The element exists, populate based on its data
-					rotation.x = static_cast<float>(atof(vector3Elt->Attribute("x")));
-					rotation.y = static_cast<float>(atof(vector3Elt->Attribute("y")));
-					rotation.z = static_cast<float>(atof(vector3Elt->Attribute("z")));
-				}
-				else
-				{
-					//The element did not exist, use default value
-					rotation = CVector3::kZero;
-				}
+bool XMLReader::CompileScene(const string& filename, const string& compiledFilename)
+{
+	string file = filePath + filename;
 
-				vector3Elt = traversalElt->FirstChildElement("Scale");	//Get scale
-				if (vector3Elt)
-				{
-					//The element exists, populate based on its data
-					scale.x = static_cast<float>(atof(vector3Elt->Attribute("x")));
-					scale.y = static_cast<float>(atof(vector3Elt->Attribute("y")));
-					scale.z = static_cast<float>(atof(vector3Elt->Attribute("z")));
-				}
-				else
-				{
-					//The element did not exist, use default value
-					scale = CVector3::kOne;
-				}
+	CSceneBinaryWriter writer;
+	writer.AddSource(file, filename);
 
-				EntityManager.CreateEntity(templateName, name, position, rotation, scale);
+	//Stream the scene file into the writer
+	CSceneCompiler compiler(this, &writer);
+	CSceneVisitor visitor(&compiler);
+	CXMLStreamParser parser;
+	if (!parser.ParseFile(file, &visitor))
+	{
+		return false;
+	}
+	if (!writer.Write(filePath + compiledFilename))
+	{
+		return false;
+	}
 
-				traversalElt = traversalElt->NextSiblingElement("Entity");
-			}
+	//A scene just compiled must be up to date. If not, a source (e.g. a folder rather than a file)
+	//is changed by writing the compiled scene, and it would be compiled again on every load
+	CSceneBinaryReader scene;
+	if (!scene.Open(filePath + compiledFilename) || !scene.IsUpToDate(filePath))
+	{
+		string report = "Compiled scene " + compiledFilename + " is out of date as soon as it is written\n";
+		OutputDebugStringA(report.c_str());
+		return false;
+	}
+	return true;
+}
 
-			//Traverse the tank list
-			TiXmlElement* tankElt = rootElement->FirstChildElement("Tanks");
-			traversalElt = tankElt->FirstChildElement("Tank");
-			while (traversalElt)
-			{
-				string templateName = traversalElt->Attribute("templateName");
-				string name = traversalElt->Attribute("name");
-				int team = atoi(traversalElt->Attribute("team"));
-				vector<CVector3> patrolRoute = LoadPatrolRoute(traversalElt->Attribute("patrolRoute"));
-				CVector3 position, rotation, scale;
-
-				//Get entity position, rotation and scale values
-				TiXmlElement* vector3Elt = traversalElt->FirstChildElement("Position");	//Get position
-				if (vector3Elt)
-				{
-					//The element exists, populate based on its data
-					position.x = static_cast<float>(atof(vector3Elt->Attribute("x")));
-					position.y = static_cast<float>(atof(vector3Elt->Attribute("y")));
-					position.z = static_cast<float>(atof(vector3Elt->Attribute("z")));
-				}
-				else
-				{
-					//The element did not exist, use default value
-					position = CVector3::kOrigin;
-				}
+void XMLReader::LoadSceneXML(const string & filename)
+{
+	string file = filePath + filename;
 
-				vector3Elt = traversalElt->FirstChildElement("Rotation");	//Get rotation
-				if (vector3Elt)
-				{
-					//The element exists, populate based on its data
-					rotation.x = static_cast<float>(atof(vector3Elt->Attribute("x")));
-					rotation.y = static_cast<float>(atof(vector3Elt->Attribute("y")));
-					rotation.z = static_cast<float>(atof(vector3Elt->Attribute("z")));
-				}
-				else
-				{
-					//The element did not exist, use default value
-					rotation = CVector3::kZero;
-				}
+	//The scene is streamed twice, no document is built. The first pass declares the templates and
+	//finds those used so they can be created together, the second creates the entities as they
+	//are read. As with a single pass, a badly formed file creates what was read before the error
+	CSceneTemplateCollector collector(this);
+	CSceneVisitor collectVisitor(&collector);
+	CXMLStreamParser parser;
+	parser.ParseFile(file, &collectVisitor);
+	collector.PrefetchTemplates();
+
+	CSceneCreator creator(this);
+	CSceneVisitor createVisitor(&creator);
+	parser.ParseFile(file, &createVisitor);
+}
 
-				vector3Elt = traversalElt->FirstChildElement("Scale");	//Get scale
-				if (vector3Elt)
+void XMLReader::LoadTemplates(vector<STemplateLoad>& templates)
+{
+	if (templates.empty())
+	{
+		return;
+	}
+	CTimer totalTimer;
+	CMeshCache& meshCache = EntityManager.GetMeshCache();
+
+	//Find the meshes that need importing, each file once. Imports are assigned to the first
+	//template using them
+	struct SMeshImport
+	{
+		STemplateLoad* load;
+		CMesh*         mesh;
+	};
+	vector<SMeshImport> imports;
+	vector<SMeshImport*> templateImports(templates.size(), nullptr);
+	set<string> importNames;
+	imports.reserve(templates.size());
+	for (TUInt32 i = 0; i < templates.size(); ++i)
+	{
+		templates[i].time.importTime = 0.0f;
+		if (!meshCache.IsCached(templates[i].desc.mesh) &&
+		    importNames.insert(CMeshCache::CanonicalName(templates[i].desc.mesh)).second)
+		{
+			SMeshImport import = { &templates[i], nullptr };
+			imports.push_back(import);
+			templateImports[i] = &imports.back();
+		}
+	}
+
+	//Import meshes on worker threads. Each job only uses its own entry and nothing in the jobs
+	//uses DirectX
+	TUInt32 numThreads = 0;
+	if (!imports.empty())
+	{
+		CWorkerPool pool(min(static_cast<TUInt32>(imports.size()), thread::hardware_concurrency()));
+		numThreads = pool.GetNumThreads();
+		for (TUInt32 i = 0; i < imports.size(); ++i)
+		{
+			SMeshImport* import = &imports[i];
+			pool.AddJob([import]()
+			{
+				CTimer timer;
+				try
 				{
-					//The element exists, populate based on its data
-					scale.x = static_cast<float>(atof(vector3Elt->Attribute("x")));
-					scale.y = static_cast<float>(atof(vector3Elt->Attribute("y")));
-					scale.z = static_cast<float>(atof(vector3Elt->Attribute("z")));
+					import->mesh = new CMesh();
+					if (!import->mesh->Import(import->load->desc.mesh, false))
+					{
+						delete import->mesh;
+						import->mesh = nullptr;
+					}
 				}
-				else
+				catch (...)
 				{
-					//The element did not exist, use default value
-					scale = CVector3::kOne;
+					//Exceptions cannot leave the worker thread. The mesh is loaded again on the main
+					//thread, which will report the error
+					delete import->mesh;
+					import->mesh = nullptr;
 				}
+				import->load->time.importTime = timer.GetTime();
+			});
+		}
+		pool.Wait();
+	}
 
-				EntityManager.CreateTank(templateName, team, patrolRoute, name, position, rotation, scale);
-
-				traversalElt = traversalElt->NextSiblingElement("Tank");
+	//Create DirectX resources and templates in order on this thread. The imported meshes are put
+	//in the mesh cache first, so the templates find them there
+	for (TUInt32 i = 0; i < templates.size(); ++i)
+	{
+		STemplateLoad& load = templates[i];
+		STankTemplateDesc& desc = load.desc;
+		CTimer timer;
+
+		//A mesh that failed to import or create is not cached, the template then loads it again
+		//with the usual error handling
+		CMesh* mesh = templateImports[i] ? templateImports[i]->mesh : nullptr;
+		if (mesh)
+		{
+			if (mesh->CreateResources())
+			{
+				meshCache.Add(desc.mesh, mesh);
+			}
+			else
+			{
+				delete mesh;
 			}
 		}
+
+		if (load.isTank)
+		{
+			EntityManager.CreateTankTemplate(desc.type, desc.name, desc.mesh, desc.replacementTemplate,
+			                                 desc.maxSpeed, desc.acceleration, desc.turnSpeed, desc.turretTurnSpeed,
+			                                 desc.maxHP, desc.shellDamage, desc.shellSpeed, desc.shellLifetime,
+			                                 desc.radius, desc.ammoCapacity);
+		}
+		else
+		{
+			EntityManager.CreateTemplate(desc.type, desc.name, desc.mesh, desc.replacementTemplate);
+		}
+		load.time.createTime = timer.GetTime();
+
+		//Report timings to the debugger output
+		load.time.name = desc.name;
+		load.time.mesh = desc.mesh;
+		templateLoadTimes.push_back(load.time);
+
+		ostringstream report;
+		report << "Template " << load.time.name << " (" << load.time.mesh << "): import "
+		       << load.time.importTime * 1000.0f << "ms, create " << load.time.createTime * 1000.0f << "ms\n";
+		OutputDebugStringA(report.str().c_str());
 	}
+
+	float totalTime = totalTimer.GetTime();
+	templateLoadTotal += totalTime;
+
+	ostringstream report;
+	report << "Loaded " << templates.size() << " templates (" << imports.size() << " meshes) in "
+	       << totalTime * 1000.0f << "ms on " << numThreads << " threads\n";
+	OutputDebugStringA(report.str().c_str());
 }
 
-vector<CVector3> XMLReader::LoadPatrolRoute(const string & filename)
+bool XMLReader::ReadPatrolRoute(const string & filename, vector<CVector3>& patrolRoute)
 {
 	string file = filePath + filename;
-	vector<CVector3> patrolRoute;
 
 	TiXmlDocument doc = TiXmlDocument(file.c_str());
+	doc.SetInSitu(true);
 	bool loadSuccess = doc.LoadFile();
 
 	if (loadSuccess)
@@ -245,19 +776,46 @@ vector<CVector3> XMLReader::LoadPatrolRoute(const string & filename)
 			TiXmlElement* traversalElt = rootElement->FirstChildElement("Waypoint");
 			while (traversalElt)
 			{
-				CVector3 waypoint;
-
-				waypoint.x = static_cast<float>(atof(traversalElt->Attribute("x")));
-				waypoint.y = static_cast<float>(atof(traversalElt->Attribute("y")));
-				waypoint.z = static_cast<float>(atof(traversalElt->Attribute("z")));
-
-				patrolRoute.push_back(waypoint);
+				patrolRoute.push_back(ReadVector3(traversalElt));
 				traversalElt = traversalElt->NextSiblingElement("Waypoint");
 			}
+			return true;
 		}
 	}
+	return false;
+}
+
+const CPatrolRoute* XMLReader::LoadPatrolRoute(const string & filename)
+{
+	//Only read each route file once
+	map<string, CPatrolRoute*>::iterator route = patrolRoutes.find(filename);
+	if (route != patrolRoutes.end())
+	{
+		return route->second;
+	}
+
+	vector<CVector3> waypoints;
+	ReadPatrolRoute(filename, waypoints);
+	return AddPatrolRoute(filename, waypoints);
+}
 
-	return patrolRoute;
+const CPatrolRoute* XMLReader::AddPatrolRoute(const string& filename, const vector<CVector3>& waypoints)
+{
+	CPatrolRoute*& route = patrolRoutes[filename];
+	if (!route)
+	{
+		route = new CPatrolRoute(filename, waypoints);
+	}
+	return route;
+}
+
+void XMLReader::ClearPatrolRoutes()
+{
+	for (map<string, CPatrolRoute*>::iterator route = patrolRoutes.begin(); route != patrolRoutes.end(); ++route)
+	{
+		delete route->second;
+	}
+	patrolRoutes.clear();
 }
 
 //vector<string> XMLReader::LoadEntityTemplateList(const string & filename)
@@ -2,31 +2,100 @@
 
 #include "tinyxml.h"
 #include <string>
+#include <map>
+#include <vector>
 
 #include "Entity.h"
 #include "TankEntity.h"
 #include "ShellEntity.h"
+#include "PatrolRoute.h"
+#include "SceneBinary.h"
 
 namespace gen{
 
+// Template data read from a template XML file
+struct SEntityTemplateDesc
+{
+	string type, name, mesh, replacementTemplate;
+};
+
+struct STankTemplateDesc : public SEntityTemplateDesc
+{
+	float maxSpeed, acceleration, turnSpeed, turretTurnSpeed, shellSpeed, shellLifetime, radius;
+	int maxHP, shellDamage, ammoCapacity;
+};
+
+// Time taken to load a template, in seconds. The mesh is imported on a worker thread, the
+// DirectX resources and template are created on the main thread
+struct STemplateLoadTime
+{
+	string name, mesh;
+	float importTime, createTime;
+};
+
+// A template to be loaded by XMLReader::LoadTemplates
+struct STemplateLoad
+{
+	bool isTank;
+	STankTemplateDesc desc; // Tank values unused for entity templates
+	STemplateLoadTime time;
+
+	STemplateLoad() : isTank(false) {}
+};
+
 class XMLReader
 {
 public:
 	XMLReader(string path = "")
 	{
 		filePath = path;
+		templateLoadTotal = 0.0f;
 	}
 	~XMLReader()
 	{
+		ClearPatrolRoutes();
 	}
 
 	CEntityTemplate* LoadEntityTemplate(const string& filename);
 
 	CTankTemplate* LoadTankTemplate(const string& filename);
-	
+
+	// Load a scene. Uses the compiled version of the scene if it is up to date, otherwise the
+	// scene is compiled from the XML first. Falls back to reading the XML directly if the
+	// compiled scene cannot be written
 	void LoadScene(const string& filename);
 
-	vector<CVector3> LoadPatrolRoute(const string& filename);
+	// Compile a scene XML file, with its templates and patrol routes, into a single binary file
+	// (see SceneBinary.h). Returns false if the XML could not be read, the file written or the
+	// written file is not up to date with its sources
+	bool CompileScene(const string& filename, const string& compiledFilename);
+
+	// Return the name of the compiled scene file used for a scene XML file
+	string GetCompiledSceneName(const string& filename);
+
+	// Return the patrol route read from the given file. Each file is only read once, the same
+	// route is returned to all callers. A missing file gives an empty route
+	const CPatrolRoute* LoadPatrolRoute(const string& filename);
+
+	// Delete all patrol routes, only call when no tanks are using them
+	void ClearPatrolRoutes();
+
+	// Create a batch of templates. Meshes are imported in parallel on worker threads, then the
+	// DirectX resources and templates are created on this thread in the given order. Each mesh
+	// file not already in the mesh cache is imported once however many templates use it. Meshes
+	// that fail to load in parallel are loaded again normally, so errors are reported as usual
+	void LoadTemplates(vector<STemplateLoad>& templates);
+
+	// Load times of each template in the scenes loaded so far, and the total time spent loading
+	// templates. The total is less than the sum of the template times as they load in parallel
+	const vector<STemplateLoadTime>& GetTemplateLoadTimes()
+	{
+		return templateLoadTimes;
+	}
+	float GetTemplateLoadTotal()
+	{
+		return templateLoadTotal;
+	}
 
 	//vector<string> LoadEntityTemplateList(const string& filename);
 	//
@@ -38,7 +107,41 @@ public:
 	}
 
 private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	XMLReader(const XMLReader&);
+	XMLReader& operator=(const XMLReader&);
+
+	// Adds scene file contents to a compiled scene, uses the template and route readers
+	friend class CSceneCompiler;
+
+	// Declares scene templates in the first pass over the scene XML, uses the template readers
+	friend class CSceneTemplateCollector;
+
+	// Read template files without creating the templates
+	bool ReadEntityTemplate(const string& filename, SEntityTemplateDesc& desc);
+	bool ReadTankTemplate(const string& filename, STankTemplateDesc& desc);
+
+	// Read a patrol route file, returns false if the file could not be read
+	bool ReadPatrolRoute(const string& filename, vector<CVector3>& patrolRoute);
+
+	// Add a route to the patrol route cache, or return the existing route with the same name
+	const CPatrolRoute* AddPatrolRoute(const string& filename, const vector<CVector3>& waypoints);
+
+	// Load a scene directly from the XML files. The scene file is streamed twice, declaring the
+	// templates and finding those used, then creating the entities as they are read
+	void LoadSceneXML(const string& filename);
+
+	// Load a compiled scene file, returns false if it is missing, invalid or out of date
+	bool LoadCompiledScene(const string& compiledFilename);
+
 	string filePath;
+
+	// Patrol routes shared by all tanks, indexed by file name
+	map<string, CPatrolRoute*> patrolRoutes;
+
+	// Template load timings
+	vector<STemplateLoadTime> templateLoadTimes;
+	float templateLoadTotal;
 };
 
 }
@@ -0,0 +1,510 @@
+/*******************************************
+	XMLStream.cpp
+
+	Streaming XML parser that drives a
+	TiXmlVisitor without building a document
+********************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "XMLStream.h"
+
+namespace gen
+{
+
+CXMLStreamParser::CXMLStreamParser()
+{
+	m_File = 0;
+	m_Pos = m_End = m_Buffer;
+	m_Row = 1;
+	m_Visitor = 0;
+	m_SkipDepth = 0;
+	m_Stopped = false;
+	m_FoundRoot = false;
+}
+
+CXMLStreamParser::~CXMLStreamParser()
+{
+	while (!m_OpenElements.empty())
+	{
+		delete m_OpenElements.back();
+		m_OpenElements.pop_back();
+	}
+	if (m_File)
+	{
+		fclose( m_File );
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Public interface
+-----------------------------------------------------------------------------------------*/
+
+// Parse the given file calling the visitor for each node. Returns false if the file could not
+// be opened or is not well-formed, use GetError/GetErrorRow for details
+bool CXMLStreamParser::ParseFile( const string& fileName, TiXmlVisitor* visitor )
+{
+	// Reset state from any previous parse
+	while (!m_OpenElements.empty())
+	{
+		delete m_OpenElements.back();
+		m_OpenElements.pop_back();
+	}
+	m_Pos = m_End = m_Buffer;
+	m_Row = 1;
+	m_Visitor = visitor;
+	m_SkipDepth = 0;
+	m_Stopped = false;
+	m_FoundRoot = false;
+	m_Error.clear();
+
+	m_File = fopen( fileName.c_str(), "rb" );
+	if (!m_File)
+	{
+		return SetError( "Failed to open file" );
+	}
+
+	// Skip UTF-8 byte order mark
+	if (Peek() == 0xef)
+	{
+		if (Get() != 0xef || Get() != 0xbb || Get() != 0xbf)
+		{
+			return SetError( "Invalid byte order mark" );
+		}
+	}
+
+	TiXmlDocument document; // Passed to document visits only, stays empty
+	m_Visitor->VisitEnter( document );
+
+	while (!m_Stopped && Peek() != EOF)
+	{
+		bool success = (Peek() == '<') ? ParseMarkup() : ParseText();
+		if (!success)
+		{
+			return false;
+		}
+	}
+
+	if (!m_Stopped)
+	{
+		if (!m_OpenElements.empty())
+		{
+			return SetError( "Unexpected end of file, element not closed" );
+		}
+		if (!m_FoundRoot)
+		{
+			return SetError( "No root element" );
+		}
+		m_Visitor->VisitExit( document );
+	}
+
+	fclose( m_File );
+	m_File = 0;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Parsing
+-----------------------------------------------------------------------------------------*/
+
+// Read the next block of the file into the buffer
+bool CXMLStreamParser::FillBuffer()
+{
+	if (!m_File)
+	{
+		return false;
+	}
+	size_t numRead = fread( m_Buffer, 1, kBufferSize, m_File );
+	m_Pos = m_Buffer;
+	m_End = m_Buffer + numRead;
+	return numRead > 0;
+}
+
+// Parse markup beginning with '<': element tags, comments, CDATA and skipped declarations
+bool CXMLStreamParser::ParseMarkup()
+{
+	Get(); // '<'
+	int c = Peek();
+	if (c == '/')
+	{
+		Get();
+		return ParseEndTag();
+	}
+	if (c == '?')
+	{
+		// Declaration or processing instruction
+		return SkipUntil( "?>", 0 );
+	}
+	if (c == '!')
+	{
+		Get();
+		if (Peek() == '-')
+		{
+			Get();
+			if (Get() != '-')
+			{
+				return SetError( "Malformed comment" );
+			}
+			string comment;
+			if (!SkipUntil( "-->", &comment ))
+			{
+				return false;
+			}
+			if (Visiting())
+			{
+				TiXmlComment node;
+				node.SetValue( comment.c_str() );
+				m_Visitor->Visit( node );
+			}
+			return true;
+		}
+		if (Peek() == '[')
+		{
+			for (const char* expected = "[CDATA["; *expected; ++expected)
+			{
+				if (Get() != *expected)
+				{
+					return SetError( "Malformed CDATA section" );
+				}
+			}
+			string cdata;
+			if (!SkipUntil( "]]>", &cdata ))
+			{
+				return false;
+			}
+			if (Visiting())
+			{
+				TiXmlText node( cdata.c_str() );
+				node.SetCDATA( true );
+				m_Visitor->Visit( node );
+			}
+			return true;
+		}
+		// DOCTYPE or other declaration (internal subsets are not supported)
+		return SkipUntil( ">", 0 );
+	}
+	return ParseStartTag();
+}
+
+// Parse a start tag (after the '<'), opening a new element and visiting it
+bool CXMLStreamParser::ParseStartTag()
+{
+	string name;
+	if (!ReadName( name ))
+	{
+		return false;
+	}
+
+	// Only one root element allowed
+	if (m_OpenElements.empty())
+	{
+		if (m_FoundRoot)
+		{
+			return SetError( "Multiple root elements" );
+		}
+		m_FoundRoot = true;
+	}
+
+	TiXmlElement* element = new TiXmlElement( name.c_str() );
+	m_OpenElements.push_back( element );
+
+	// Attributes
+	string attributeName, value;
+	bool emptyElement = false;
+	for (;;)
+	{
+		SkipWhitespace();
+		int c = Peek();
+		if (c == '>')
+		{
+			Get();
+			break;
+		}
+		if (c == '/')
+		{
+			Get();
+			if (Get() != '>')
+			{
+				return SetError( "Malformed empty element" );
+			}
+			emptyElement = true;
+			break;
+		}
+		if (c == EOF)
+		{
+			return SetError( "Unexpected end of file in start tag" );
+		}
+
+		if (!ReadName( attributeName ))
+		{
+			return false;
+		}
+		SkipWhitespace();
+		if (Get() != '=')
+		{
+			return SetError( "Expected '=' after attribute name" );
+		}
+		SkipWhitespace();
+		if (!ReadAttributeValue( value ))
+		{
+			return false;
+		}
+		if (element->Attribute( attributeName.c_str() ))
+		{
+			return SetError( "Duplicate attribute" );
+		}
+		element->SetAttribute( attributeName.c_str(), value.c_str() );
+	}
+
+	// Visit the element now it is open. A false return skips its children
+	if (m_SkipDepth > 0)
+	{
+		++m_SkipDepth;
+	}
+	else if (!m_Stopped && !m_Visitor->VisitEnter( *element, element->FirstAttribute() ))
+	{
+		m_SkipDepth = 1;
+	}
+
+	if (emptyElement)
+	{
+		CloseElement();
+	}
+	return true;
+}
+
+// Parse an end tag (after the "</"), closing the current element
+bool CXMLStreamParser::ParseEndTag()
+{
+	string name;
+	if (!ReadName( name ))
+	{
+		return false;
+	}
+	SkipWhitespace();
+	if (Get() != '>')
+	{
+		return SetError( "Malformed end tag" );
+	}
+	if (m_OpenElements.empty() || name != m_OpenElements.back()->Value())
+	{
+		return SetError( "Mismatched end tag" );
+	}
+	CloseElement();
+	return true;
+}
+
+// Close the current element - visit it (or leave skipped subtree) then delete it
+void CXMLStreamParser::CloseElement()
+{
+	TiXmlElement* element = m_OpenElements.back();
+	if (m_SkipDepth > 0)
+	{
+		// The element that started the skip is still visited on exit, as with Accept
+		if (--m_SkipDepth == 0 && !m_Stopped && !m_Visitor->VisitExit( *element ))
+		{
+			m_Stopped = true;
+		}
+	}
+	else if (!m_Stopped && !m_Visitor->VisitExit( *element ))
+	{
+		m_Stopped = true;
+	}
+	delete element;
+	m_OpenElements.pop_back();
+}
+
+// Parse text up to the next '<'. Whitespace-only text is ignored (as TinyXML does by default)
+bool CXMLStreamParser::ParseText()
+{
+	string text;
+	bool whitespace = true;
+	for (int c = Peek(); c != '<' && c != EOF; c = Peek())
+	{
+		if (c == '&')
+		{
+			Get();
+			if (!DecodeEntity( text ))
+			{
+				return false;
+			}
+			whitespace = false;
+		}
+		else
+		{
+			text += static_cast<char>(Get());
+			whitespace &= (isspace( c ) != 0);
+		}
+	}
+
+	if (!whitespace)
+	{
+		if (m_OpenElements.empty())
+		{
+			return SetError( "Text outside of root element" );
+		}
+		if (Visiting())
+		{
+			TiXmlText node( text.c_str() );
+			m_Visitor->Visit( node );
+		}
+	}
+	return true;
+}
+
+// Skip characters up to and including the terminator, optionally collecting the skipped content
+bool CXMLStreamParser::SkipUntil( const char* terminator, string* content )
+{
+	size_t length = strlen( terminator );
+	string skipped;
+	for (int c = Get(); c != EOF; c = Get())
+	{
+		skipped += static_cast<char>(c);
+		if (skipped.size() >= length &&
+		    skipped.compare( skipped.size() - length, length, terminator ) == 0)
+		{
+			if (content)
+			{
+				content->assign( skipped, 0, skipped.size() - length );
+			}
+			return true;
+		}
+	}
+	return SetError( "Unexpected end of file" );
+}
+
+// Read an element or attribute name
+bool CXMLStreamParser::ReadName( string& name )
+{
+	name.clear();
+	int c = Peek();
+	if (c == EOF || !(isalpha( c ) || c == '_' || c == ':' || c >= 0x80))
+	{
+		return SetError( "Invalid name" );
+	}
+	while (c != EOF && (isalnum( c ) || c == '_' || c == ':' || c == '-' || c == '.' || c >= 0x80))
+	{
+		name += static_cast<char>(Get());
+		c = Peek();
+	}
+	return true;
+}
+
+// Read a quoted attribute value, decoding entities
+bool CXMLStreamParser::ReadAttributeValue( string& value )
+{
+	value.clear();
+	int quote = Get();
+	if (quote != '"' && quote != '\'')
+	{
+		return SetError( "Attribute value not quoted" );
+	}
+	for (int c = Get(); c != quote; c = Get())
+	{
+		if (c == EOF)
+		{
+			return SetError( "Unexpected end of file in attribute value" );
+		}
+		if (c == '<')
+		{
+			return SetError( "'<' in attribute value" );
+		}
+		if (c == '&')
+		{
+			if (!DecodeEntity( value ))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			value += static_cast<char>(c);
+		}
+	}
+	return true;
+}
+
+// Decode an entity reference (after the '&') and append it to the output
+bool CXMLStreamParser::DecodeEntity( string& out )
+{
+	string entity;
+	for (int c = Get(); c != ';'; c = Get())
+	{
+		if (c == EOF || entity.size() > 10)
+		{
+			return SetError( "Malformed entity" );
+		}
+		entity += static_cast<char>(c);
+	}
+
+	if      (entity == "amp")  out += '&';
+	else if (entity == "lt")   out += '<';
+	else if (entity == "gt")   out += '>';
+	else if (entity == "quot") out += '"';
+	else if (entity == "apos") out += '\'';
+	else if (entity.size() > 1 && entity[0] == '#')
+	{
+		// Character reference, encoded as UTF-8
+		char* end;
+		unsigned long code = (entity[1] == 'x') ? strtoul( entity.c_str() + 2, &end, 16 )
+		                                        : strtoul( entity.c_str() + 1, &end, 10 );
+		if (*end != '\0' || code == 0 || code > 0x10ffff)
+		{
+			return SetError( "Invalid character reference" );
+		}
+		if (code < 0x80)
+		{
+			out += static_cast<char>(code);
+		}
+		else if (code < 0x800)
+		{
+			out += static_cast<char>(0xc0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3f));
+		}
+		else if (code < 0x10000)
+		{
+			out += static_cast<char>(0xe0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+			out += static_cast<char>(0x80 | (code & 0x3f));
+		}
+		else
+		{
+			out += static_cast<char>(0xf0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+			out += static_cast<char>(0x80 | (code & 0x3f));
+		}
+	}
+	else
+	{
+		return SetError( "Unknown entity" );
+	}
+	return true;
+}
+
+void CXMLStreamParser::SkipWhitespace()
+{
+	for (int c = Peek(); c != EOF && isspace( c ); c = Peek())
+	{
+		Get();
+	}
+}
+
+// Record an error, close the file and return false
+bool CXMLStreamParser::SetError( const char* error )
+{
+	m_Error = error;
+	if (m_File)
+	{
+		fclose( m_File );
+		m_File = 0;
+	}
+	return false;
+}
+
+
+} // namespace gen
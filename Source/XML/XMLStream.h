@@ -0,0 +1,119 @@
+/*******************************************
+	XMLStream.h
+
+	Streaming XML parser that drives a
+	TiXmlVisitor without building a document
+********************************************/
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "tinyxml.h"
+#include "Defines.h"
+
+namespace gen
+{
+
+// Reads an XML file in small blocks and calls TiXmlVisitor functions as elements open and close,
+// in the same order as TiXmlDocument::Accept would. Each element is passed with its attributes
+// but no children, and is deleted when it closes, so memory use depends on the nesting depth
+// rather than the size of the file. This allows scenes to be created while they are read.
+// Supported: elements, attributes, text, comments, CDATA. Declarations, DOCTYPE and processing
+// instructions are skipped. Text is passed as written, whitespace is not condensed.
+// If VisitEnter returns false the element's children are skipped, if VisitExit returns false
+// parsing stops early (not an error)
+class CXMLStreamParser
+{
+/////////////////////////////////////
+//	Constructors/Destructors
+public:
+	CXMLStreamParser();
+	~CXMLStreamParser();
+
+private:
+	// Prevent use of copy constructor and assignment operator (private and not defined)
+	CXMLStreamParser( const CXMLStreamParser& );
+	CXMLStreamParser& operator=( const CXMLStreamParser& );
+
+
+/////////////////////////////////////
+//	Public interface
+public:
+
+	// Parse the given file calling the visitor for each node. Returns false if the file could
+	// not be opened or is not well-formed, use GetError/GetErrorRow for details
+	bool ParseFile( const string& fileName, TiXmlVisitor* visitor );
+
+	// Error description and line of last failed parse
+	const string& GetError()
+	{
+		return m_Error;
+	}
+	TUInt32 GetErrorRow()
+	{
+		return m_Row;
+	}
+
+
+/////////////////////////////////////
+//	Private interface
+private:
+
+	// Character input - returns EOF at the end of the file
+	int Peek()
+	{
+		if (m_Pos == m_End && !FillBuffer()) return EOF;
+		return static_cast<unsigned char>(*m_Pos);
+	}
+	int Get()
+	{
+		if (m_Pos == m_End && !FillBuffer()) return EOF;
+		char c = *m_Pos++;
+		if (c == '\n') ++m_Row;
+		return static_cast<unsigned char>(c);
+	}
+	bool FillBuffer();
+
+	// Parsing steps, all return false on error
+	bool ParseMarkup();
+	bool ParseStartTag();
+	bool ParseEndTag();
+	bool ParseText();
+	bool SkipUntil( const char* terminator, string* content );
+	bool ReadName( string& name );
+	bool ReadAttributeValue( string& value );
+	bool DecodeEntity( string& out );
+	void SkipWhitespace();
+
+	bool SetError( const char* error );
+
+	// Visitor callbacks, respecting skipped subtrees
+	bool Visiting()
+	{
+		return m_SkipDepth == 0 && !m_Stopped;
+	}
+	void CloseElement();
+
+	static const TUInt32 kBufferSize = 16 * 1024;
+
+	FILE*  m_File;
+	char   m_Buffer[kBufferSize];
+	char*  m_Pos;
+	char*  m_End;
+	TUInt32 m_Row;
+
+	TiXmlVisitor*         m_Visitor;
+	vector<TiXmlElement*> m_OpenElements; // Stack of currently open elements
+	TUInt32               m_SkipDepth;    // Depth of open elements being skipped, 0 if visiting
+	bool                  m_Stopped;      // Visitor requested early stop
+	bool                  m_FoundRoot;
+
+	string m_Error;
+};
+
+
+} // namespace gen
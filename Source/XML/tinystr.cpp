@@ -30,8 +30,8 @@ distribution.
 const TiXmlString::size_type TiXmlString::npos = static_cast< TiXmlString::size_type >(-1);
 
 
-// Null rep.
-TiXmlString::Rep TiXmlString::nullrep_ = { 0, 0, { '\0' } };
+// Null string.
+char TiXmlString::nullstr_[1] = { '\0' };
 
 
 void TiXmlString::reserve (size_type cap)
@@ -48,8 +48,9 @@ void TiXmlString::reserve (size_type cap)
 
 TiXmlString& TiXmlString::assign(const char* str, size_type len)
 {
+	// Views (and the null string) have no capacity so are always replaced
 	size_type cap = capacity();
-	if (len > cap || cap > 3*(len + 8))
+	if (len > cap || cap > 3*(len + 8) || cap == 0)
 	{
 		TiXmlString tmp;
 		tmp.init(len);
@@ -51,6 +51,11 @@ distribution.
    Only the member functions relevant to the TinyXML project have been implemented.
    The buffer allocation is made by a simplistic power of 2 like mechanism : if we increase
    a string and there's no more room, we allocate a buffer twice as big as we need.
+
+   A string may also be a view of characters owned by someone else (used by in-situ document
+   parsing, where strings point into the loaded file buffer). A view has no capacity - any
+   modification first copies it into an owned buffer, and copies of a view are owned. The
+   character after a view is overwritten with a terminator on the first call to c_str().
 */
 class TiXmlString
 {
@@ -63,26 +68,26 @@ class TiXmlString
 
 
 	// TiXmlString empty constructor
-	TiXmlString () : rep_(&nullrep_)
+	TiXmlString () : str_(nullstr_), size_(0), capacity_(0)
 	{
 	}
 
 	// TiXmlString copy constructor
-	TiXmlString ( const TiXmlString & copy) : rep_(0)
+	TiXmlString ( const TiXmlString & copy) : str_(nullstr_), size_(0), capacity_(0)
 	{
 		init(copy.length());
 		memcpy(start(), copy.data(), length());
 	}
 
 	// TiXmlString constructor, based on a string
-	TIXML_EXPLICIT TiXmlString ( const char * copy) : rep_(0)
+	TIXML_EXPLICIT TiXmlString ( const char * copy) : str_(nullstr_), size_(0), capacity_(0)
 	{
 		init( static_cast<size_type>( strlen(copy) ));
 		memcpy(start(), copy, length());
 	}
 
 	// TiXmlString constructor, based on a string
-	TIXML_EXPLICIT TiXmlString ( const char * str, size_type len) : rep_(0)
+	TIXML_EXPLICIT TiXmlString ( const char * str, size_type len) : str_(nullstr_), size_(0), capacity_(0)
 	{
 		init(len);
 		memcpy(start(), str, len);
@@ -125,36 +130,40 @@ class TiXmlString
 
 
 	// Convert a TiXmlString into a null-terminated char *
-	const char * c_str () const { return rep_->str; }
+	const char * c_str () const
+	{
+		if (str_[size_] != '\0') str_[size_] = '\0'; // Only a view can be unterminated
+		return str_;
+	}
 
 	// Convert a TiXmlString into a char * (need not be null terminated).
-	const char * data () const { return rep_->str; }
+	const char * data () const { return str_; }
 
 	// Return the length of a TiXmlString
-	size_type length () const { return rep_->size; }
+	size_type length () const { return size_; }
 
 	// Alias for length()
-	size_type size () const { return rep_->size; }
+	size_type size () const { return size_; }
 
 	// Checks if a TiXmlString is empty
-	bool empty () const { return rep_->size == 0; }
+	bool empty () const { return size_ == 0; }
 
 	// Return capacity of string
-	size_type capacity () const { return rep_->capacity; }
+	size_type capacity () const { return capacity_; }
 
 
 	// single char extraction
 	const char& at (size_type index) const
 	{
 		assert( index < length() );
-		return rep_->str[ index ];
+		return str_[ index ];
 	}
 
 	// [] operator
 	char& operator [] (size_type index) const
 	{
 		assert( index < length() );
-		return rep_->str[ index ];
+		return str_[ index ];
 	}
 
 	// find a char in a string. Return TiXmlString::npos if not found
@@ -168,9 +177,9 @@ class TiXmlString
 	{
 		if (offset >= length()) return npos;
 
-		for (const char* p = c_str() + offset; *p != '\0'; ++p)
+		for (const char* p = data() + offset; p != data() + length(); ++p)
 		{
-		   if (*p == tofind) return static_cast< size_type >( p - c_str() );
+		   if (*p == tofind) return static_cast< size_type >( p - data() );
 		}
 		return npos;
 	}
@@ -194,60 +203,68 @@ class TiXmlString
 
 	TiXmlString& append (const char* str, size_type len);
 
+	// Make this string a view of characters owned elsewhere, which must outlive the string.
+	// The character at str[len] must be writable and not needed once the view is in use
+	void assign_view (char* str, size_type len)
+	{
+		quit();
+		str_ = str;
+		size_ = len;
+		capacity_ = 0;
+	}
+
+	// Return true if the string is a view of characters it does not own
+	bool is_view () const { return capacity_ == 0 && str_ != nullstr_; }
+
 	void swap (TiXmlString& other)
 	{
-		Rep* r = rep_;
-		rep_ = other.rep_;
-		other.rep_ = r;
+		char* s = str_;
+		str_ = other.str_;
+		other.str_ = s;
+		size_type sz = size_;
+		size_ = other.size_;
+		other.size_ = sz;
+		size_type cap = capacity_;
+		capacity_ = other.capacity_;
+		other.capacity_ = cap;
 	}
 
   private:
 
 	void init(size_type sz) { init(sz, sz); }
-	void set_size(size_type sz) { rep_->str[ rep_->size = sz ] = '\0'; }
-	char* start() const { return rep_->str; }
-	char* finish() const { return rep_->str + rep_->size; }
-
-	struct Rep
-	{
-		size_type size, capacity;
-		char str[1];
-	};
+	void set_size(size_type sz) { str_[ size_ = sz ] = '\0'; }
+	char* start() const { return str_; }
+	char* finish() const { return str_ + size_; }
 
 	void init(size_type sz, size_type cap)
 	{
 		if (cap)
 		{
-			// Lee: the original form:
-			//	rep_ = static_cast<Rep*>(operator new(sizeof(Rep) + cap));
-			// doesn't work in some cases of new being overloaded. Switching
-			// to the normal allocation, although use an 'int' for systems
-			// that are overly picky about structure alignment.
-			const size_type bytesNeeded = sizeof(Rep) + cap;
-			const size_type intsNeeded = ( bytesNeeded + sizeof(int) - 1 ) / sizeof( int ); 
-			rep_ = reinterpret_cast<Rep*>( new int[ intsNeeded ] );
-
-			rep_->str[ rep_->size = sz ] = '\0';
-			rep_->capacity = cap;
+			str_ = new char[ cap + 1 ];
+			str_[ size_ = sz ] = '\0';
+			capacity_ = cap;
 		}
 		else
 		{
-			rep_ = &nullrep_;
+			str_ = nullstr_;
+			size_ = 0;
+			capacity_ = 0;
 		}
 	}
 
 	void quit()
 	{
-		if (rep_ != &nullrep_)
+		// Only owned strings have capacity
+		if (capacity_)
 		{
-			// The rep_ is really an array of ints. (see the allocator, above).
-			// Cast it back before delete, so the compiler won't incorrectly call destructors.
-			delete [] ( reinterpret_cast<int*>( rep_ ) );
+			delete [] str_;
 		}
 	}
 
-	Rep * rep_;
-	static Rep nullrep_;
+	char*     str_;
+	size_type size_;
+	size_type capacity_;
+	static char nullstr_[1];
 
 } ;
 
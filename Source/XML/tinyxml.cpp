@@ -23,6 +23,8 @@ distribution.
 */
 
 #include <ctype.h>
+#include <stdlib.h>
+#include <new>
 
 #ifdef TIXML_USE_STL
 #include <sstream>
@@ -914,6 +916,8 @@ TiXmlDocument::TiXmlDocument() : TiXmlNode( TiXmlNode::TINYXML_DOCUMENT )
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	inSitu = parsingInSitu = false;
+	inSituBuffer = 0;
 	ClearError();
 }
 
@@ -921,6 +925,8 @@ TiXmlDocument::TiXmlDocument( const char * documentName ) : TiXmlNode( TiXmlNode
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	inSitu = parsingInSitu = false;
+	inSituBuffer = 0;
 	value = documentName;
 	ClearError();
 }
@@ -931,6 +937,8 @@ TiXmlDocument::TiXmlDocument( const std::string& documentName ) : TiXmlNode( TiX
 {
 	tabsize = 4;
 	useMicrosoftBOM = false;
+	inSitu = parsingInSitu = false;
+	inSituBuffer = 0;
     value = documentName;
 	ClearError();
 }
@@ -939,6 +947,8 @@ TiXmlDocument::TiXmlDocument( const std::string& documentName ) : TiXmlNode( TiX
 
 TiXmlDocument::TiXmlDocument( const TiXmlDocument& copy ) : TiXmlNode( TiXmlNode::TINYXML_DOCUMENT )
 {
+	parsingInSitu = false;
+	inSituBuffer = 0;
 	copy.CopyTo( this );
 }
 
@@ -946,11 +956,49 @@ TiXmlDocument::TiXmlDocument( const TiXmlDocument& copy ) : TiXmlNode( TiXmlNode
 TiXmlDocument& TiXmlDocument::operator=( const TiXmlDocument& copy )
 {
 	Clear();
+	ClearInSitu();
 	copy.CopyTo( this );
 	return *this;
 }
 
 
+TiXmlDocument::~TiXmlDocument()
+{
+	// Delete the nodes before the arena and buffer they may use
+	Clear();
+	ClearInSitu();
+}
+
+
+void TiXmlDocument::ClearInSitu()
+{
+	arena.Clear();
+	delete [] inSituBuffer;
+	inSituBuffer = 0;
+}
+
+
+// Make sure all the in-situ strings in a node and its children are terminated, so the loaded
+// document can be read without any further writes to the buffer
+static void TerminateInSituStrings( const TiXmlNode* node )
+{
+	node->Value();
+	const TiXmlElement* element = node->ToElement();
+	if ( element )
+	{
+		for ( const TiXmlAttribute* attrib = element->FirstAttribute(); attrib; attrib = attrib->Next() )
+		{
+			attrib->Name();
+			attrib->Value();
+		}
+	}
+	for ( const TiXmlNode* child = node->FirstChild(); child; child = child->NextSibling() )
+	{
+		TerminateInSituStrings( child );
+	}
+}
+
+
 bool TiXmlDocument::LoadFile( TiXmlEncoding encoding )
 {
 	return LoadFile( Value(), encoding );
@@ -993,6 +1041,7 @@ bool TiXmlDocument::LoadFile( FILE* file, TiXmlEncoding encoding )
 
 	// Delete the existing data:
 	Clear();
+	ClearInSitu();
 	location.Clear();
 
 	// Get the file size, so we can pre-allocate the string. HUGE speed impact.
@@ -1074,6 +1123,17 @@ bool TiXmlDocument::LoadFile( FILE* file, TiXmlEncoding encoding )
 	assert( q <= (buf+length) );
 	*q = 0;
 
+	if ( inSitu )
+	{
+		// Keep the buffer, the document strings refer to it
+		inSituBuffer = buf;
+		parsingInSitu = true;
+		Parse( buf, 0, encoding );
+		parsingInSitu = false;
+		TerminateInSituStrings( this );
+		return !Error();
+	}
+
 	Parse( buf, 0, encoding );
 
 	delete [] buf;
@@ -1122,6 +1182,7 @@ void TiXmlDocument::CopyTo( TiXmlDocument* target ) const
 	target->tabsize = tabsize;
 	target->errorLocation = errorLocation;
 	target->useMicrosoftBOM = useMicrosoftBOM;
+	target->inSitu = inSitu;
 
 	TiXmlNode* node = 0;
 	for ( node = firstChild; node; node = node->NextSibling() )
@@ -1513,11 +1574,7 @@ TiXmlAttributeSet::~TiXmlAttributeSet()
 
 void TiXmlAttributeSet::Add( TiXmlAttribute* addMe )
 {
-    #ifdef TIXML_USE_STL
-	assert( !Find( TIXML_STRING( addMe->Name() ) ) );	// Shouldn't be multiply adding to the set.
-	#else
-	assert( !Find( addMe->Name() ) );	// Shouldn't be multiply adding to the set.
-	#endif
+	assert( !Find( addMe->NameTStr() ) );	// Shouldn't be multiply adding to the set.
 
 	addMe->next = &sentinel;
 	addMe->prev = sentinel.prev;
@@ -1569,6 +1626,21 @@ TiXmlAttribute* TiXmlAttributeSet::FindOrCreate( const std::string& _name )
 #endif
 
 
+#ifndef TIXML_USE_STL
+TiXmlAttribute* TiXmlAttributeSet::Find( const TiXmlString& name ) const
+{
+	// Compare lengths and characters, so in-situ strings are not terminated during parsing
+	for( TiXmlAttribute* node = sentinel.next; node != &sentinel; node = node->next )
+	{
+		if (    node->name.length() == name.length()
+			 && memcmp( node->name.data(), name.data(), name.length() ) == 0 )
+			return node;
+	}
+	return 0;
+}
+#endif
+
+
 TiXmlAttribute* TiXmlAttributeSet::Find( const char* name ) const
 {
 	for( TiXmlAttribute* node = sentinel.next; node != &sentinel; node = node->next )
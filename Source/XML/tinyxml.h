@@ -93,6 +93,43 @@ const int TIXML_MAJOR_VERSION = 2;
 const int TIXML_MINOR_VERSION = 6;
 const int TIXML_PATCH_VERSION = 2;
 
+/*	A simple bump allocator. Documents loaded in-situ (see TiXmlDocument::SetInSitu)
+	allocate their nodes and attributes from an arena, which releases all its memory
+	in one go when it is cleared or destroyed.
+*/
+class TiXmlArena
+{
+public:
+	TiXmlArena() : blocks(0), next(0), end(0), used(0)	{}
+	~TiXmlArena()										{ Clear(); }
+
+	/// Allocate memory, aligned for any TinyXML object.
+	void* Alloc( size_t size );
+
+	/// Release all memory allocated from the arena.
+	void Clear();
+
+	/// Return the number of bytes allocated from the arena since it was last cleared.
+	size_t Used() const									{ return used; }
+
+private:
+	TiXmlArena( const TiXmlArena& );				// not implemented.
+	void operator=( const TiXmlArena& );			// not implemented.
+
+	struct Block
+	{
+		Block* prev;
+		size_t size;
+	};
+	enum { BLOCK_SIZE = 64 * 1024 };
+
+	Block* blocks;
+	char*  next;
+	char*  end;
+	size_t used;
+};
+
+
 /*	Internal structure for tracking location of items 
 	in the XML file.
 */
@@ -201,6 +238,15 @@ public:
 	TiXmlBase()	:	userData(0)		{}
 	virtual ~TiXmlBase()			{}
 
+	/*	Nodes and attributes are allocated from the heap or from a document arena. A small
+		header records which, so they can be deleted in the same way - delete only runs the
+		destructor for arena objects, the memory is released with the arena.
+	*/
+	static void* operator new( size_t size );
+	static void* operator new( size_t size, TiXmlArena* arena );	// arena may be null (heap)
+	static void operator delete( void* p );
+	static void operator delete( void* p, TiXmlArena* arena );
+
 	/**	All TinyXml classes can print themselves to a filestream
 		or the string class (TiXmlString in non-STL mode, std::string
 		in STL mode.) Either or both cfile and str can be null.
@@ -305,9 +351,10 @@ protected:
 
 	/*	Reads an XML name into the string provided. Returns
 		a pointer just past the last character of the name,
-		or 0 if the function has an error.
+		or 0 if the function has an error. If inSitu is set
+		the name is a view into the (writable) input.
 	*/
-	static const char* ReadName( const char* p, TIXML_STRING* name, TiXmlEncoding encoding );
+	static const char* ReadName( const char* p, TIXML_STRING* name, TiXmlEncoding encoding, bool inSitu = false );
 
 	/*	Reads text. Returns a pointer past the given end tag.
 		Wickedly complex options, but it keeps the (sensitive) code in one place.
@@ -317,7 +364,13 @@ protected:
 									bool ignoreWhiteSpace,		// whether to keep the white space
 									const char* endTag,			// what ends this text
 									bool ignoreCase,			// whether to ignore case in the end tag
-									TiXmlEncoding encoding );	// the current encoding
+									TiXmlEncoding encoding,		// the current encoding
+									TiXmlParsingData* inSitu = 0 );	// if set decode in place in the (writable) input, text is a view
+	#ifndef TIXML_USE_STL
+	static const char* ReadTextInSitu( const char* in, TIXML_STRING* text, bool ignoreWhiteSpace,
+									   const char* endTag, bool ignoreCase, TiXmlEncoding encoding,
+									   TiXmlParsingData* data );
+	#endif
 
 	// If an entity has been found, transform it into a character.
 	static const char* GetEntity( const char* in, char* value, int* length, TiXmlEncoding encoding );
@@ -750,7 +803,7 @@ protected:
 	#endif
 
 	// Figure out what is at *p, and parse it. Returns null if it is not an xml node.
-	TiXmlNode* Identify( const char* start, TiXmlEncoding encoding );
+	TiXmlNode* Identify( const char* start, TiXmlEncoding encoding, TiXmlArena* arena = 0 );
 
 	TiXmlNode*		parent;
 	NodeType		type;
@@ -818,6 +871,7 @@ public:
 
 	// Get the tinyxml string representation
 	const TIXML_STRING& NameTStr() const { return name; }
+	const TIXML_STRING& ValueTStr() const { return value; }
 
 	/** QueryIntValue examines the value string. It is an alternative to the
 		IntValue() method with richer error checking.
@@ -920,6 +974,8 @@ public:
 #	ifdef TIXML_USE_STL
 	TiXmlAttribute*	Find( const std::string& _name ) const;
 	TiXmlAttribute* FindOrCreate( const std::string& _name );
+#	else
+	TiXmlAttribute*	Find( const TiXmlString& _name ) const;	// does not need a terminated name
 #	endif
 
 
@@ -1406,7 +1462,7 @@ public:
 	TiXmlDocument( const TiXmlDocument& copy );
 	TiXmlDocument& operator=( const TiXmlDocument& copy );
 
-	virtual ~TiXmlDocument() {}
+	virtual ~TiXmlDocument();
 
 	/** Load a file using the current document value.
 		Returns true if successful. Will delete any existing
@@ -1428,6 +1484,18 @@ public:
 	/// Save a file using the given FILE*. Returns true if successful.
 	bool SaveFile( FILE* ) const;
 
+	/** In-situ mode, used by the LoadFile methods. The loaded file is kept in memory for the
+		life of the document and the names, attribute values and text of the parsed nodes are
+		views into it rather than copies (entities are decoded in place). The nodes themselves
+		are allocated from an arena owned by the document and released in one go. This is much
+		faster for large files. Nodes from an in-situ document may be deleted, modified or
+		cloned as usual, but must not be moved to another document.
+		Off by default. Only available when TIXML_USE_STL is not defined (nodes still use the
+		arena with STL strings).
+	*/
+	void SetInSitu( bool _inSitu )		{ inSitu = _inSitu; }
+	bool InSitu() const					{ return inSitu; }
+
 	#ifdef TIXML_USE_STL
 	bool LoadFile( const std::string& filename, TiXmlEncoding encoding = TIXML_DEFAULT_ENCODING )			///< STL std::string version.
 	{
@@ -1546,12 +1614,20 @@ protected :
 private:
 	void CopyTo( TiXmlDocument* target ) const;
 
+	// Release the in-situ buffer and arena, all nodes must have been deleted
+	void ClearInSitu();
+
 	bool error;
 	int  errorId;
 	TIXML_STRING errorDesc;
 	int tabsize;
 	TiXmlCursor errorLocation;
 	bool useMicrosoftBOM;		// the UTF-8 BOM were found when read. Note this, and try to write.
+
+	bool inSitu;				// LoadFile parses in-situ
+	bool parsingInSitu;			// The current Parse call is on the in-situ buffer
+	char* inSituBuffer;			// File data referred to by in-situ strings
+	TiXmlArena arena;			// Nodes of in-situ documents
 };
 
 
@@ -0,0 +1,119 @@
+/*
+www.sourceforge.net/projects/tinyxml
+Original code by Lee Thomason (www.grinninglizard.com)
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any
+damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any
+purpose, including commercial applications, and to alter it and
+redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this
+software in a product, an acknowledgment in the product documentation
+would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and
+must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#include <stdlib.h>
+#include <new>
+
+#include "tinyxml.h"
+
+// Node allocation, heap or arena (see TiXmlArena). These are kept apart from the code that
+// creates nodes so they are not inlined into it: a compiler that sees the allocation inside
+// operator new may not recognise that it pairs with the class operator delete
+// (GCC -Wmismatched-new-delete).
+
+// Header placed before each TiXmlBase object to record where it was allocated. Sized and
+// aligned for any object type.
+union TiXmlAllocHeader
+{
+	double align;
+	TiXmlArena* arena;
+};
+
+
+void* TiXmlArena::Alloc( size_t size )
+{
+	size = ( size + sizeof( TiXmlAllocHeader ) - 1 ) & ~( sizeof( TiXmlAllocHeader ) - 1 );
+	if ( size > (size_t)( end - next ) )
+	{
+		// Start a new block, large requests get a block of their own
+		size_t blockSize = sizeof( TiXmlAllocHeader ) + ( size > BLOCK_SIZE / 4 ? size : (size_t)BLOCK_SIZE );
+		char* mem = (char*)malloc( blockSize );
+		if ( !mem )
+			return 0;
+
+		Block* block = (Block*)mem;
+		block->prev = blocks;
+		block->size = blockSize;
+		blocks = block;
+		next = mem + sizeof( TiXmlAllocHeader );
+		end = mem + blockSize;
+	}
+	void* p = next;
+	next += size;
+	used += size;
+	return p;
+}
+
+
+void TiXmlArena::Clear()
+{
+	while ( blocks )
+	{
+		Block* prev = blocks->prev;
+		free( blocks );
+		blocks = prev;
+	}
+	next = end = 0;
+	used = 0;
+}
+
+
+void* TiXmlBase::operator new( size_t size )
+{
+	TiXmlAllocHeader* header = (TiXmlAllocHeader*)malloc( sizeof( TiXmlAllocHeader ) + size );
+	if ( !header )
+		throw std::bad_alloc();
+	header->arena = 0;
+	return header + 1;
+}
+
+
+void* TiXmlBase::operator new( size_t size, TiXmlArena* arena )
+{
+	size_t total = sizeof( TiXmlAllocHeader ) + size;
+	TiXmlAllocHeader* header = (TiXmlAllocHeader*)( arena ? arena->Alloc( total ) : malloc( total ) );
+	if ( !header )
+		throw std::bad_alloc();
+	header->arena = arena;
+	return header + 1;
+}
+
+
+void TiXmlBase::operator delete( void* p )
+{
+	if ( !p )
+		return;
+
+	// Arena memory is released when the arena is cleared
+	TiXmlAllocHeader* header = (TiXmlAllocHeader*)p - 1;
+	if ( !header->arena )
+		free( header );
+}
+
+
+void TiXmlBase::operator delete( void* p, TiXmlArena* )
+{
+	// Only called if a constructor throws
+	operator delete( p );
+}
@@ -176,20 +176,35 @@ class TiXmlParsingData
 
 	const TiXmlCursor& Cursor() const	{ return cursor; }
 
+	// Arena for new nodes when parsing in-situ, otherwise null
+	TiXmlArena* Arena() const			{ return arena; }
+
+	// Whether strings are decoded in place and refer to the input
+	bool InSitu() const
+	{
+		#ifdef TIXML_USE_STL
+		return false;
+		#else
+		return arena != 0;
+		#endif
+	}
+
   private:
 	// Only used by the document!
-	TiXmlParsingData( const char* start, int _tabsize, int row, int col )
+	TiXmlParsingData( const char* start, int _tabsize, int row, int col, TiXmlArena* _arena )
 	{
 		assert( start );
 		stamp = start;
 		tabsize = _tabsize;
 		cursor.row = row;
 		cursor.col = col;
+		arena = _arena;
 	}
 
 	TiXmlCursor		cursor;
 	const char*		stamp;
 	int				tabsize;
+	TiXmlArena*		arena;
 };
 
 
@@ -398,7 +413,7 @@ const char* TiXmlBase::SkipWhiteSpace( const char* p, TiXmlEncoding encoding )
 // One of TinyXML's more performance demanding functions. Try to keep the memory overhead down. The
 // "assign" optimization removes over 10% of the execution time.
 //
-const char* TiXmlBase::ReadName( const char* p, TIXML_STRING * name, TiXmlEncoding encoding )
+const char* TiXmlBase::ReadName( const char* p, TIXML_STRING * name, TiXmlEncoding encoding, bool inSitu )
 {
 	// Oddly, not supported on some comilers,
 	//name->clear();
@@ -428,6 +443,15 @@ const char* TiXmlBase::ReadName( const char* p, TIXML_STRING * name, TiXmlEncodi
 			++p;
 		}
 		if ( p-start > 0 ) {
+			#ifndef TIXML_USE_STL
+			if ( inSitu )
+			{
+				name->assign_view( const_cast<char*>( start ), p-start );
+				return p;
+			}
+			#else
+			(void)inSitu;
+			#endif
 			name->assign( start, p-start );
 		}
 		return p;
@@ -576,9 +600,20 @@ const char* TiXmlBase::ReadText(	const char* p,
 									bool trimWhiteSpace, 
 									const char* endTag, 
 									bool caseInsensitive,
-									TiXmlEncoding encoding )
+									TiXmlEncoding encoding,
+									TiXmlParsingData* inSitu )
 {
     *text = "";
+
+	#ifndef TIXML_USE_STL
+	if ( inSitu )
+	{
+		return ReadTextInSitu( p, text, trimWhiteSpace, endTag, caseInsensitive, encoding, inSitu );
+	}
+	#else
+	(void)inSitu;
+	#endif
+
 	if (    !trimWhiteSpace			// certain tags always keep whitespace
 		 || !condenseWhiteSpace )	// if true, whitespace is always kept
 	{
@@ -636,6 +671,115 @@ const char* TiXmlBase::ReadText(	const char* p,
 	return ( p && *p ) ? p : 0;
 }
 
+#ifndef TIXML_USE_STL
+
+// In-situ version of ReadText. The text is first scanned to find its end. If it needs no
+// decoding it is used where it is, otherwise it is decoded over the input, starting where the
+// text starts. Decoding never makes text longer (entities shrink, white space condenses) so the
+// write position never passes the read position. The text becomes a view of the result.
+const char* TiXmlBase::ReadTextInSitu(	const char* p,
+										TIXML_STRING * text,
+										bool trimWhiteSpace,
+										const char* endTag,
+										bool caseInsensitive,
+										TiXmlEncoding encoding,
+										TiXmlParsingData* data )
+{
+	bool condense = trimWhiteSpace && condenseWhiteSpace;
+	if ( condense )
+	{
+		// Remove leading white space:
+		p = SkipWhiteSpace( p, encoding );
+	}
+	if ( !p )
+		return 0;
+
+	// Find the end of the text and the length of the decoded text
+	const char* const start = p;
+	const char* end = p;		// End of the last non white space character
+	size_t decodedLength = 0;	// Up to end
+	bool decode = false;
+	bool whitespace = false;
+	while (	   p && *p
+			&& !StringEqual( p, endTag, caseInsensitive, encoding ) )
+	{
+		if ( condense && IsWhiteSpace( *p ) )
+		{
+			// Any run of white space other than a single space is condensed
+			if ( whitespace || *p != ' ' )
+				decode = true;
+			whitespace = true;
+			++p;
+		}
+		else
+		{
+			if ( whitespace )
+			{
+				++decodedLength;
+				whitespace = false;
+			}
+			if ( *p != '&' && (unsigned char)*p < 0x80 )
+			{
+				++p;	// common case
+				++decodedLength;
+			}
+			else
+			{
+				// Entities are decoded, multi-byte characters are copied as is
+				if ( *p == '&' )
+					decode = true;
+				int len;
+				char cArr[4] = { 0, 0, 0, 0 };
+				p = GetChar( p, cArr, &len, encoding );
+				decodedLength += len;
+			}
+			end = p;
+		}
+	}
+	if ( !condense )
+		end = p ? p : end;
+
+	if ( decode && end > start )
+	{
+		// Move the cursor past the text before changing it, as locations are found from the input
+		data->Stamp( end, encoding );
+
+		char* q = const_cast<char*>( start );
+		const char* r = start;
+		whitespace = false;
+		while ( r < end )
+		{
+			if ( condense && IsWhiteSpace( *r ) )
+			{
+				whitespace = true;
+				++r;
+			}
+			else
+			{
+				if ( whitespace )
+				{
+					*q++ = ' ';
+					whitespace = false;
+				}
+				int len;
+				char cArr[4] = { 0, 0, 0, 0 };
+				r = GetChar( r, cArr, &len, encoding );
+				for ( int i = 0; i < len; ++i )
+					*q++ = cArr[i];
+			}
+		}
+		assert( (size_t)( q - start ) == decodedLength );
+	}
+	if ( decodedLength )
+		text->assign_view( const_cast<char*>( start ), decodedLength );
+
+	if ( p && *p )
+		p += strlen( endTag );
+	return ( p && *p ) ? p : 0;
+}
+
+#endif
+
 #ifdef TIXML_USE_STL
 
 void TiXmlDocument::StreamIn( std::istream * in, TIXML_STRING * tag )
@@ -728,7 +872,7 @@ const char* TiXmlDocument::Parse( const char* p, TiXmlParsingData* prevData, TiX
 		location.row = 0;
 		location.col = 0;
 	}
-	TiXmlParsingData data( p, TabSize(), location.row, location.col );
+	TiXmlParsingData data( p, TabSize(), location.row, location.col, parsingInSitu ? &arena : 0 );
 	location = data.Cursor();
 
 	if ( encoding == TIXML_ENCODING_UNKNOWN )
@@ -753,7 +897,7 @@ const char* TiXmlDocument::Parse( const char* p, TiXmlParsingData* prevData, TiX
 
 	while ( p && *p )
 	{
-		TiXmlNode* node = Identify( p, encoding );
+		TiXmlNode* node = Identify( p, encoding, data.Arena() );
 		if ( node )
 		{
 			p = node->Parse( p, &data, encoding );
@@ -815,7 +959,7 @@ void TiXmlDocument::SetError( int err, const char* pError, TiXmlParsingData* dat
 }
 
 
-TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
+TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding, TiXmlArena* arena )
 {
 	TiXmlNode* returnNode = 0;
 
@@ -849,21 +993,21 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Declaration\n" );
 		#endif
-		returnNode = new TiXmlDeclaration();
+		returnNode = new (arena) TiXmlDeclaration();
 	}
 	else if ( StringEqual( p, commentHeader, false, encoding ) )
 	{
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Comment\n" );
 		#endif
-		returnNode = new TiXmlComment();
+		returnNode = new (arena) TiXmlComment();
 	}
 	else if ( StringEqual( p, cdataHeader, false, encoding ) )
 	{
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing CDATA\n" );
 		#endif
-		TiXmlText* text = new TiXmlText( "" );
+		TiXmlText* text = new (arena) TiXmlText( "" );
 		text->SetCDATA( true );
 		returnNode = text;
 	}
@@ -872,7 +1016,7 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Unknown(1)\n" );
 		#endif
-		returnNode = new TiXmlUnknown();
+		returnNode = new (arena) TiXmlUnknown();
 	}
 	else if (    IsAlpha( *(p+1), encoding )
 			  || *(p+1) == '_' )
@@ -880,14 +1024,14 @@ TiXmlNode* TiXmlNode::Identify( const char* p, TiXmlEncoding encoding )
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Element\n" );
 		#endif
-		returnNode = new TiXmlElement( "" );
+		returnNode = new (arena) TiXmlElement( "" );
 	}
 	else
 	{
 		#ifdef DEBUG_PARSER
 			TIXML_LOG( "XML parsing Unknown(2)\n" );
 		#endif
-		returnNode = new TiXmlUnknown();
+		returnNode = new (arena) TiXmlUnknown();
 	}
 
 	if ( returnNode )
@@ -1068,7 +1212,7 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 	// Read the name.
 	const char* pErr = p;
 
-    p = ReadName( p, &value, encoding );
+    p = ReadName( p, &value, encoding, data && data->InSitu() );
 	if ( !p || !*p )
 	{
 		if ( document )	document->SetError( TIXML_ERROR_FAILED_TO_READ_ELEMENT_NAME, pErr, data, encoding );
@@ -1139,7 +1283,7 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 		else
 		{
 			// Try to read an attribute:
-			TiXmlAttribute* attrib = new TiXmlAttribute();
+			TiXmlAttribute* attrib = new ( data ? data->Arena() : 0 ) TiXmlAttribute();
 			if ( !attrib )
 			{
 				return 0;
@@ -1157,11 +1301,7 @@ const char* TiXmlElement::Parse( const char* p, TiXmlParsingData* data, TiXmlEnc
 			}
 
 			// Handle the strange case of double attributes:
-			#ifdef TIXML_USE_STL
 			TiXmlAttribute* node = attributeSet.Find( attrib->NameTStr() );
-			#else
-			TiXmlAttribute* node = attributeSet.Find( attrib->Name() );
-			#endif
 			if ( node )
 			{
 				if ( document ) document->SetError( TIXML_ERROR_PARSING_ELEMENT, pErr, data, encoding );
@@ -1189,7 +1329,7 @@ const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXm
 		if ( *p != '<' )
 		{
 			// Take what we have, make a text element.
-			TiXmlText* textNode = new TiXmlText( "" );
+			TiXmlText* textNode = new ( data ? data->Arena() : 0 ) TiXmlText( "" );
 
 			if ( !textNode )
 			{
@@ -1223,7 +1363,7 @@ const char* TiXmlElement::ReadValue( const char* p, TiXmlParsingData* data, TiXm
 			}
 			else
 			{
-				TiXmlNode* node = Identify( p, encoding );
+				TiXmlNode* node = Identify( p, encoding, data ? data->Arena() : 0 );
 				if ( node )
 				{
 					p = node->Parse( p, data, encoding );
@@ -1401,7 +1541,8 @@ const char* TiXmlAttribute::Parse( const char* p, TiXmlParsingData* data, TiXmlE
 	}
 	// Read the name, the '=' and the value.
 	const char* pErr = p;
-	p = ReadName( p, &name, encoding );
+	TiXmlParsingData* inSitu = ( data && data->InSitu() ) ? data : 0;
+	p = ReadName( p, &name, encoding, inSitu != 0 );
 	if ( !p || !*p )
 	{
 		if ( document ) document->SetError( TIXML_ERROR_READING_ATTRIBUTES, pErr, data, encoding );
@@ -1430,13 +1571,13 @@ const char* TiXmlAttribute::Parse( const char* p, TiXmlParsingData* data, TiXmlE
 	{
 		++p;
 		end = "\'";		// single quote in string
-		p = ReadText( p, &value, false, end, false, encoding );
+		p = ReadText( p, &value, false, end, false, encoding, inSitu );
 	}
 	else if ( *p == DOUBLE_QUOTE )
 	{
 		++p;
 		end = "\"";		// double quote in string
-		p = ReadText( p, &value, false, end, false, encoding );
+		p = ReadText( p, &value, false, end, false, encoding, inSitu );
 	}
 	else
 	{
@@ -1538,7 +1679,7 @@ const char* TiXmlText::Parse( const char* p, TiXmlParsingData* data, TiXmlEncodi
 		bool ignoreWhite = true;
 
 		const char* end = "<";
-		p = ReadText( p, &value, ignoreWhite, end, false, encoding );
+		p = ReadText( p, &value, ignoreWhite, end, false, encoding, ( data && data->InSitu() ) ? data : 0 );
 		if ( p && *p )
 			return p-1;	// don't truncate the '<'
 		return 0;
@@ -1604,19 +1745,19 @@ const char* TiXmlDeclaration::Parse( const char* p, TiXmlParsingData* data, TiXm
 		{
 			TiXmlAttribute attrib;
 			p = attrib.Parse( p, data, _encoding );		
-			version = attrib.Value();
+			version = attrib.ValueTStr();
 		}
 		else if ( StringEqual( p, "encoding", true, _encoding ) )
 		{
 			TiXmlAttribute attrib;
 			p = attrib.Parse( p, data, _encoding );		
-			encoding = attrib.Value();
+			encoding = attrib.ValueTStr();
 		}
 		else if ( StringEqual( p, "standalone", true, _encoding ) )
 		{
 			TiXmlAttribute attrib;
 			p = attrib.Parse( p, data, _encoding );		
-			standalone = attrib.Value();
+			standalone = attrib.ValueTStr();
 		}
 		else
 		{